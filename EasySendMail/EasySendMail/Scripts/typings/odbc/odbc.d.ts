@@ -67,6 +67,9 @@
         close(callback: (error: any) => void): any;
     }
 
+    //phase timings of query(), see "Query timing" in the README of the binding
+    export function getStats(options?: { reset?: boolean }): any;
+
     //Expose constants
     //Object.keys(odbc.ODBC).forEach(function (key) {
     //    if (typeof odbc.ODBC[key] !== "function") {
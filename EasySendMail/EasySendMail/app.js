@@ -2,6 +2,7 @@
 var express = require('express');
 var routes = require('./routes/index');
 var user = require('./routes/user');
+var interventi = require('./routes/interventi');
 var http = require('http');
 var path = require('path');
 var app = express();
@@ -10,7 +11,9 @@ app.set('port', process.env.PORT || 3000);
 app.set('views', path.join(__dirname, 'views'));
 app.set('view engine', 'jade');
 app.use(express.favicon());
-app.use(express.logger('dev'));
+if ('benchmark' != app.get('env')) {
+    app.use(express.logger('dev'));
+}
 app.use(express.json());
 app.use(express.urlencoded());
 app.use(express.methodOverride());
@@ -24,72 +27,82 @@ if ('development' == app.get('env')) {
 }
 app.get('/', routes.index);
 app.get('/users', user.list);
+app.get('/interventi', interventi.list);
+app.get('/interventi/:id', interventi.get);
+app.get('/odbc/stats', interventi.stats);
 http.createServer(app).listen(app.get('port'), function () {
     console.log('Express server listening on port ' + app.get('port'));
 });
 //https://github.com/Microsoft/TypeScript/wiki/Modules
-var odbc = require("odbc");
-var db = new odbc.Database({ fetchMode: 3 });
-var cn = "Driver=ODBC Driver;Server=nnnn.nnn.nnn.nnn;Database=DB_SOMEDB;UID=login;PWD=password;UseLongVarchar=Yes";
-db.open(cn, function (err) {
-    db.queryResult('SELECT * FROM TABLE_INTERVENTI WHERE ID = ?', [326], function (err, result) {
-        //now you have to use some async callback management
-        //to fetch all your rows. But here we just get the first one:
-        //Type = -1 ==> String
-        //Type = 8 ==> Number
-        //Type = [2..8] => Double
-        //Type = [9, 91] => Date
-        //Type = [10, 92] => Time
-        //Type = [11, 93] => DateTime (Timestamp)
-        //console.log(result.getColumnNamesSync());
-        //var arrayColumns = result.getColumnNamesSync();
-        //console.log(arrayColumns);
-        //for (var i = 0; i < arrayColumns.length; i++) {
-        //    var row = arrayColumns[i];
-        //    var fieldName = row.NAME;
-        //    var fieldType = row.TYPE;
-        //    console.log("fieldName: " + fieldName);
-        //    console.log("fieldType: " + fieldType);
-        //}
-        var arrayColumns = result.getColumnNamesSync();
-        var data = result.fetchSync();
-        while (data != null) {
-            for (var i = 0; i < arrayColumns.length; i++) {
-                var fieldName = arrayColumns[i].NAME;
-                var fieldType = arrayColumns[i].TYPE;
-                console.log("name: " + fieldName + "<==> type: " + fieldType + "<==> value: " + data[i]);
+var odbc = require(process.env.ODBC_MODULE || "odbc");
+var cn = process.env.ODBC_CONNECTION_STRING || "Driver=ODBC Driver;Server=nnnn.nnn.nnn.nnn;Database=DB_SOMEDB;UID=login;PWD=password;UseLongVarchar=Yes";
+interventi.open(odbc, cn, parseInt(process.env.ODBC_CONNECTIONS, 10) || 1, function (err) {
+    if (err)
+        return console.log("interventi err: " + err);
+});
+//the startup query only gets in the way of benchmarks
+if ('benchmark' != app.get('env')) {
+    var db = new odbc.Database({ fetchMode: 3 });
+    db.open(cn, function (err) {
+        db.queryResult('SELECT * FROM TABLE_INTERVENTI WHERE ID = ?', [326], function (err, result) {
+            //now you have to use some async callback management
+            //to fetch all your rows. But here we just get the first one:
+            //Type = -1 ==> String
+            //Type = 8 ==> Number
+            //Type = [2..8] => Double
+            //Type = [9, 91] => Date
+            //Type = [10, 92] => Time
+            //Type = [11, 93] => DateTime (Timestamp)
+            //console.log(result.getColumnNamesSync());
+            //var arrayColumns = result.getColumnNamesSync();
+            //console.log(arrayColumns);
+            //for (var i = 0; i < arrayColumns.length; i++) {
+            //    var row = arrayColumns[i];
+            //    var fieldName = row.NAME;
+            //    var fieldType = row.TYPE;
+            //    console.log("fieldName: " + fieldName);
+            //    console.log("fieldType: " + fieldType);
+            //}
+            var arrayColumns = result.getColumnNamesSync();
+            var data = result.fetchSync();
+            while (data != null) {
+                for (var i = 0; i < arrayColumns.length; i++) {
+                    var fieldName = arrayColumns[i].NAME;
+                    var fieldType = arrayColumns[i].TYPE;
+                    console.log("name: " + fieldName + "<==> type: " + fieldType + "<==> value: " + data[i]);
+                }
+                data = result.fetchSync();
             }
-            data = result.fetchSync();
-        }
-        //result.fetch(function (err, data) {
-        //    //the first record
-        //    //console.log(data);
-        //    var arrayColumns = result.getColumnNamesSync();
-        //    var arrayAll = data;
-        //    for (var i = 0; i < arrayAll.length; i++) {
-        //        var fieldName = arrayColumns[i].NAME;
-        //        var fieldType = arrayColumns[i].TYPE;
-        //        var value = arrayAll[i];
-        //        console.log("name: " + fieldName + "<==> type: " + fieldType + "<==> value: " + value);
-        //    }
-        //});
-        //result.fetchAll(function (err, rows) {
-        //    var arrayColumns = result.getColumnNamesSync();
-        //    var arrayAll = rows[0];
-        //    for (var i = 0; i < arrayAll.length; i++) {
-        //        var fieldName = arrayColumns[i].NAME;
-        //        var fieldType = arrayColumns[i].TYPE;
-        //        var value = arrayAll[i];
-        //        console.log("name: " + fieldName + "<==> type: " + fieldType + "<==> value: " + value);
-        //    }
-        //    //console.log(rows);
-        //    //[ [ 1, 2 ] ]
-        //});
+            //result.fetch(function (err, data) {
+            //    //the first record
+            //    //console.log(data);
+            //    var arrayColumns = result.getColumnNamesSync();
+            //    var arrayAll = data;
+            //    for (var i = 0; i < arrayAll.length; i++) {
+            //        var fieldName = arrayColumns[i].NAME;
+            //        var fieldType = arrayColumns[i].TYPE;
+            //        var value = arrayAll[i];
+            //        console.log("name: " + fieldName + "<==> type: " + fieldType + "<==> value: " + value);
+            //    }
+            //});
+            //result.fetchAll(function (err, rows) {
+            //    var arrayColumns = result.getColumnNamesSync();
+            //    var arrayAll = rows[0];
+            //    for (var i = 0; i < arrayAll.length; i++) {
+            //        var fieldName = arrayColumns[i].NAME;
+            //        var fieldType = arrayColumns[i].TYPE;
+            //        var value = arrayAll[i];
+            //        console.log("name: " + fieldName + "<==> type: " + fieldType + "<==> value: " + value);
+            //    }
+            //    //console.log(rows);
+            //    //[ [ 1, 2 ] ]
+            //});
+        });
     });
-});
-db.close(function () {
-    console.log('done');
-});
+    db.close(function () {
+        console.log('done');
+    });
+}
 //db.open(cn, function (err) {
 //    if (err)
 //        return console.log("start err: " + err);
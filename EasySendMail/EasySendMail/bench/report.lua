@@ -0,0 +1,36 @@
+-- wrk script for run-wrk.js
+--
+-- With an argument n every request asks for a random id between 1 and n,
+-- appended to the path of the URL. When the run is done the latency
+-- percentiles are printed as one JSON line.
+
+local ids = 0
+
+-- give every thread its own random sequence
+setup = function(thread)
+    thread:set("seed", math.random(1000000))
+end
+
+init = function(args)
+    ids = tonumber(args[1]) or 0
+    math.randomseed(os.time() + (seed or 0))
+end
+
+request = function()
+    if ids > 0 then
+        return wrk.format(nil, wrk.path .. "/" .. math.random(ids))
+    end
+
+    return wrk.format(nil, wrk.path)
+end
+
+done = function(summary, latency, requests)
+    local errors = summary.errors
+
+    io.write(string.format(
+        '{"requests":%d,"seconds":%.3f,"errors":%d,"non2xx":%d,"p50":%.3f,"p90":%.3f,"p99":%.3f,"p999":%.3f,"max":%.3f}\n',
+        summary.requests, summary.duration / 1e6,
+        errors.connect + errors.read + errors.write + errors.timeout, errors.status,
+        latency:percentile(50) / 1e3, latency:percentile(90) / 1e3,
+        latency:percentile(99) / 1e3, latency:percentile(99.9) / 1e3, latency.max / 1e3))
+end
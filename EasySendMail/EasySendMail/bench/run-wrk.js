@@ -0,0 +1,242 @@
+//Starts app.js against an ODBC data source and drives one of its database
+//routes with wrk at increasing connection counts. For every count it
+//prints the HTTP latency percentiles of wrk next to the phase timings of
+//the binding's query() (odbc.getStats()) for the same interval.
+//
+//usage: node bench/run-wrk.js [options]
+//
+//  --cn <connection string>   data source of the app (default: the synthetic
+//                             driver of the binding)
+//  --odbc <path>              build of the binding the app loads (default:
+//                             ../../node_odbc/node_odbc_64)
+//  --route <path>             route to request (default: /interventi)
+//  --ids <n>                  append a random id from 1 to n to the route
+//                             (default: 1000)
+//  --connections <1,8,..>     wrk connection counts (default: 1,8,32,128)
+//  --threads <n>              wrk threads, at most one per connection (default: 4)
+//  --duration <s>             seconds per connection count (default: 10)
+//  --pool <n>                 ODBC connections of the app (default: 4)
+//  --port <n>                 port of the app (default: 3999)
+//  --out <file>               write the results as JSON
+//
+//wrk is taken from the WRK environment variable or from the PATH.
+
+var fs = require('fs');
+var http = require('http');
+var path = require('path');
+var spawn = require('child_process').spawn;
+
+var app = path.join(__dirname, '..');
+var binding = path.join(app, '..', '..', 'node_odbc', 'node_odbc_64');
+
+var options = {
+    cn: 'DRIVER=' + path.join(binding, 'build', 'Release', 'lib.target', 'odbc_synth.so')
+        + ';ROWS=1;COLUMNS=int,varchar(40),timestamp,double',
+    odbc: binding,
+    route: '/interventi',
+    ids: 1000,
+    connections: [1, 8, 32, 128],
+    threads: 4,
+    duration: 10,
+    pool: 4,
+    port: 3999,
+    out: null
+};
+
+for (var i = 2; i < process.argv.length; i++) {
+    var arg = process.argv[i], value = process.argv[++i];
+
+    switch (arg) {
+        case '--cn': options.cn = value; break;
+        case '--odbc': options.odbc = path.resolve(value); break;
+        case '--route': options.route = value; break;
+        case '--ids': options.ids = Number(value); break;
+        case '--connections': options.connections = value.split(',').map(Number); break;
+        case '--threads': options.threads = Number(value); break;
+        case '--duration': options.duration = Number(value); break;
+        case '--pool': options.pool = Number(value); break;
+        case '--port': options.port = Number(value); break;
+        case '--out': options.out = value; break;
+        default:
+            console.error('unknown option ' + arg);
+            process.exit(2);
+    }
+}
+
+var wrk = process.env.WRK || 'wrk';
+var url = 'http://127.0.0.1:' + options.port + options.route;
+
+var env = Object.create(process.env);
+env.NODE_ENV = 'benchmark';
+env.PORT = String(options.port);
+env.ODBC_MODULE = options.odbc;
+env.ODBC_CONNECTION_STRING = options.cn;
+env.ODBC_CONNECTIONS = String(options.pool);
+
+var server = spawn(process.execPath, [path.join(app, 'app.js')], { cwd: app, env: env });
+
+server.stdout.pipe(process.stdout);
+server.stderr.pipe(process.stderr);
+server.on('exit', function (code) {
+    console.error('app.js exited with ' + code);
+    process.exit(1);
+});
+
+var report = {
+    date: new Date().toISOString(),
+    node: process.version,
+    route: options.route,
+    cn: options.cn,
+    pool: options.pool,
+    results: []
+};
+
+waitForApp(50, function (err) {
+    if (err) {
+        return stop(err);
+    }
+
+    var counts = options.connections.slice();
+
+    (function next() {
+        var connections = counts.shift();
+
+        if (!connections) {
+            return stop();
+        }
+
+        getJSON('/odbc/stats?reset=1', function (err) {
+            if (err) {
+                return stop(err);
+            }
+
+            runWrk(connections, function (err, latency) {
+                if (err) {
+                    return stop(err);
+                }
+
+                getJSON('/odbc/stats?reset=1', function (err, stats) {
+                    if (err) {
+                        return stop(err);
+                    }
+
+                    var result = {
+                        connections: connections,
+                        throughput: latency.requests / latency.seconds,
+                        http: latency,
+                        odbc: stats
+                    };
+
+                    report.results.push(result);
+                    print(result);
+                    next();
+                });
+            });
+        });
+    })();
+});
+
+function runWrk(connections, callback) {
+    var args = [
+        '-t', String(Math.min(options.threads, connections)),
+        '-c', String(connections),
+        '-d', options.duration + 's',
+        '-s', path.join(__dirname, 'report.lua'),
+        url, '--', String(options.ids)
+    ];
+    var child = spawn(wrk, args);
+    var output = '';
+
+    child.once('error', function (err) {
+        child.removeAllListeners('exit');
+        callback(new Error('cannot run ' + wrk + ' (' + err.message + '), set WRK to the path of wrk'));
+    });
+    child.stdout.on('data', function (data) {
+        output += data;
+    });
+    child.stderr.pipe(process.stderr);
+    child.on('exit', function (code) {
+        var line = output.split('\n').filter(function (line) {
+            return line.charAt(0) == '{';
+        }).pop();
+
+        if (code !== 0 || !line) {
+            return callback(new Error('wrk exited with ' + code + '\n' + output));
+        }
+
+        callback(null, JSON.parse(line));
+    });
+}
+
+function print(result) {
+    var latency = result.http;
+    var odbc = result.odbc;
+
+    console.log('c=' + result.connections + ': ' + Math.floor(result.throughput) + ' req/s'
+        + ', http p50 ' + latency.p50.toFixed(2) + 'ms p99 ' + latency.p99.toFixed(2) + 'ms p999 ' + latency.p999.toFixed(2) + 'ms'
+        + (latency.errors || latency.non2xx ? ', ' + latency.errors + ' errors, ' + latency.non2xx + ' non 2xx' : ''));
+
+    ['queue', 'execute', 'fetch', 'materialize', 'wait', 'callback', 'total'].forEach(function (phase) {
+        if (odbc[phase]) {
+            console.log('    odbc ' + phase + ': p50 ' + odbc[phase].p50 + 'ms p99 ' + odbc[phase].p99 + 'ms (' + odbc[phase].count + ' queries)');
+        }
+    });
+}
+
+//the app is up once the route answers
+function waitForApp(tries, callback) {
+    http.get(url + (options.ids ? '/1' : ''), function (res) {
+        res.resume();
+
+        if (res.statusCode == 200) {
+            return callback(null);
+        }
+
+        retry(new Error('GET ' + options.route + ' returned ' + res.statusCode));
+    }).on('error', retry);
+
+    function retry(err) {
+        if (--tries <= 0) {
+            return callback(err);
+        }
+
+        setTimeout(function () {
+            waitForApp(tries, callback);
+        }, 200);
+    }
+}
+
+function getJSON(route, callback) {
+    http.get('http://127.0.0.1:' + options.port + route, function (res) {
+        var body = '';
+
+        res.setEncoding('utf8');
+        res.on('data', function (data) {
+            body += data;
+        });
+        res.on('end', function () {
+            try {
+                callback(null, JSON.parse(body));
+            }
+            catch (e) {
+                callback(new Error('GET ' + route + ' returned ' + res.statusCode + ': ' + body));
+            }
+        });
+    }).on('error', callback);
+}
+
+function stop(err) {
+    server.removeAllListeners('exit');
+    server.kill();
+
+    if (err) {
+        console.error(err.message);
+        return process.exit(1);
+    }
+
+    if (options.out) {
+        fs.writeFileSync(options.out, JSON.stringify(report, null, 2) + '\n');
+    }
+
+    process.exit(0);
+}
@@ -0,0 +1,52 @@
+"use strict";
+var odbc;
+var connections = [];
+var next = 0;
+//opens count connections; the routes take turns using them
+function open(module, cn, count, callback) {
+    var opened = 0;
+    var failed = null;
+    odbc = module;
+    for (var i = 0; i < count; i++) {
+        var db = new odbc.Database({ fetchMode: 3 });
+        connections.push(db);
+        db.open(cn, function (err) {
+            failed = failed || err;
+            if (++opened == count) {
+                callback(failed);
+            }
+        });
+    }
+}
+exports.open = open;
+function connection() {
+    next = (next + 1) % connections.length;
+    return connections[next];
+}
+function list(req, res) {
+    connection().query('SELECT * FROM TABLE_INTERVENTI', function (err, rows) {
+        if (err)
+            return res.send(500, String(err));
+        res.json(rows);
+    });
+}
+exports.list = list;
+;
+function get(req, res) {
+    connection().query('SELECT * FROM TABLE_INTERVENTI WHERE ID = ?', [parseInt(req.params.id, 10)], function (err, rows) {
+        if (err)
+            return res.send(500, String(err));
+        if (!rows.length)
+            return res.send(404);
+        res.json(rows[0]);
+    });
+}
+exports.get = get;
+;
+//the phase timings of the queries since the last ?reset=1
+function stats(req, res) {
+    res.json(odbc.getStats({ reset: req.query.reset == '1' }));
+}
+exports.stats = stats;
+;
+//# sourceMappingURL=interventi.js.map
\ No newline at end of file
@@ -0,0 +1,62 @@
+﻿/*
+ * GET interventi from the ODBC database.
+ */
+import express = require('express');
+import odbcTypes = require('odbc');
+
+var odbc: typeof odbcTypes;
+var connections: odbcTypes.Database[] = [];
+var next = 0;
+
+//opens count connections; the routes take turns using them
+export function open(module: typeof odbcTypes, cn: string, count: number, callback: (error: any) => void) {
+    var opened = 0;
+    var failed = null;
+
+    odbc = module;
+
+    for (var i = 0; i < count; i++) {
+        var db = new odbc.Database({ fetchMode: 3 });
+
+        connections.push(db);
+        db.open(cn, function (err) {
+            failed = failed || err;
+
+            if (++opened == count) {
+                callback(failed);
+            }
+        });
+    }
+}
+
+function connection(): odbcTypes.Database {
+    next = (next + 1) % connections.length;
+
+    return connections[next];
+}
+
+export function list(req: express.Request, res: express.Response) {
+    connection().query('SELECT * FROM TABLE_INTERVENTI', function (err, rows) {
+        if (err)
+            return res.send(500, String(err));
+
+        res.json(rows);
+    });
+};
+
+export function get(req: express.Request, res: express.Response) {
+    connection().query('SELECT * FROM TABLE_INTERVENTI WHERE ID = ?', [parseInt(req.params.id, 10)], function (err, rows) {
+        if (err)
+            return res.send(500, String(err));
+
+        if (!rows.length)
+            return res.send(404);
+
+        res.json(rows[0]);
+    });
+};
+
+//the phase timings of the queries since the last ?reset=1
+export function stats(req: express.Request, res: express.Response) {
+    res.json(odbc.getStats({ reset: req.query.reset == '1' }));
+};
@@ -1,18 +1,43 @@
 {
+  'variables' : {
+    #USDT probes (src/odbc_probes.h), -Dodbc_usdt=true; linux only
+    'odbc_usdt%' : 'false',
+    #synthetic ODBC driver for benchmarks (test/driver), -Dodbc_synth=true
+    'odbc_synth%' : 'false',
+    'odbc_sources' : [
+      'src/odbc.cpp',
+      'src/odbc_connection.cpp',
+      'src/odbc_statement.cpp',
+      'src/odbc_result.cpp',
+      'src/odbc_executor.cpp',
+      'src/odbc_shared_pool.cpp',
+      'src/odbc_cache.cpp',
+      'src/odbc_stats.cpp',
+      'src/odbc_metrics.cpp',
+      'src/odbc_slowlog.cpp',
+      'src/odbc_trace.cpp',
+      'src/odbc_narrow.cpp',
+      'src/odbc_text.cpp',
+      'src/odbc_intern.cpp',
+      'src/odbc_aggregate.cpp'
+    ]
+  },
   'targets' : [
     {
       'target_name' : 'odbc_bindings',
       'sources' : [ 
-        'src/odbc.cpp',
-        'src/odbc_connection.cpp',
-        'src/odbc_statement.cpp',
-        'src/odbc_result.cpp',
+        '<@(odbc_sources)',
         'src/dynodbc.cpp'
       ],
       'defines' : [
         'UNICODE'
       ],
       'conditions' : [
+        [ 'odbc_usdt == "true" and OS == "linux"', {
+          'defines' : [
+            'ODBC_USDT'
+          ]
+        }],
         [ 'OS == "linux"', {
           'libraries' : [ 
             '-lodbc' 
@@ -38,5 +63,43 @@
         }]
       ]
     }
+  ],
+  'conditions' : [
+    [ 'odbc_synth == "true" and OS == "linux"', {
+      'targets' : [
+        {
+          'target_name' : 'odbc_synth',
+          'type' : 'shared_library',
+          'product_prefix' : '',
+          'sources' : [
+            'test/driver/odbc_synth.c'
+          ]
+        },
+        {
+          #the addon's kernels linked straight to the synthetic driver,
+          #see test/run-microbench.js
+          'target_name' : 'odbc_microbench',
+          'sources' : [
+            '<@(odbc_sources)',
+            'test/driver/odbc_synth.c',
+            'test/microbench/odbc_microbench.cpp',
+            'test/microbench/odbc_microbench_alloc.c'
+          ],
+          'include_dirs' : [
+            'src'
+          ],
+          'defines' : [
+            'UNICODE',
+            'ODBC_MICROBENCH'
+          ],
+          'cflags' : [
+            '-g'
+          ],
+          'ldflags' : [
+            '-Wl,-Bsymbolic'
+          ]
+        }
+      ]
+    }]
   ]
 }
@@ -0,0 +1,108 @@
+module.exports = MetadataCache;
+
+//Rows returned by the catalog functions (tables(), columns() and so
+//describe()), keyed by the arguments they were called with. Every caller
+//gets the same frozen array of frozen rows, and concurrent requests for an
+//entry which is not cached yet share one catalog query.
+//
+//options.ttl - ms an entry stays valid (default: until refresh())
+function MetadataCache(options) {
+  var self = this;
+
+  options = options || {};
+
+  self.ttl = options.ttl || 0;
+  self.entries = {};
+  self.hits = 0;
+  self.misses = 0;
+}
+
+//call back with the rows cached under key, or call load(done) to get them;
+//table is remembered so that refresh(table) can find the entry
+MetadataCache.prototype.fetch = function (key, table, load, cb) {
+  var self = this
+    , entry = self.entries[key]
+    ;
+
+  if (entry && entry.rows && (!entry.expires || Date.now() < entry.expires)) {
+    self.hits += 1;
+
+    return process.nextTick(function () {
+      cb(null, entry.rows);
+    });
+  }
+
+  if (entry && entry.waiting) {
+    self.hits += 1;
+    entry.waiting.push(cb);
+
+    return;
+  }
+
+  self.misses += 1;
+
+  entry = self.entries[key] = {
+    table : (table) ? String(table).toUpperCase() : null
+    , rows : null
+    , expires : 0
+    , waiting : [cb]
+    };
+
+  load(function (err, rows) {
+    var waiting = entry.waiting;
+
+    entry.waiting = null;
+
+    if (err) {
+      if (self.entries[key] === entry) {
+        delete self.entries[key];
+      }
+    }
+    else {
+      entry.rows = freeze(rows || []);
+      entry.expires = (self.ttl) ? Date.now() + self.ttl : 0;
+    }
+
+    waiting.forEach(function (cb) {
+      cb(err, (err) ? [] : entry.rows);
+    });
+  });
+};
+
+//drop every entry, or with a table name only the entries about that table
+//and the table listings
+MetadataCache.prototype.refresh = function (table) {
+  var self = this;
+
+  table = (table) ? String(table).toUpperCase() : null;
+
+  Object.keys(self.entries).forEach(function (key) {
+    var entry = self.entries[key];
+
+    if (entry.waiting) {
+      //in flight; its result is delivered but not kept
+      delete self.entries[key];
+    }
+    else if (!table || entry.table === table || entry.table === null) {
+      delete self.entries[key];
+    }
+  });
+};
+
+MetadataCache.prototype.stats = function () {
+  var self = this;
+
+  return {
+    entries : Object.keys(self.entries).length
+    , hits : self.hits
+    , misses : self.misses
+    };
+};
+
+function freeze(rows) {
+  rows.forEach(function (row) {
+    Object.freeze(row);
+  });
+
+  return Object.freeze(rows);
+}
@@ -0,0 +1,402 @@
+module.exports = MultiPool;
+
+//SQLSTATE classes which mean the member itself is in trouble rather than
+//the statement: connection exceptions and timeouts
+var MEMBER_FAILURE = /^(08|HYT)/;
+
+//A pool over several data sources, typically a primary and its read
+//replicas. Each member has its own Pool; open() picks the healthy member
+//with the fewest queries in flight relative to its weight.
+//
+//options.members       - [{ connectionString, weight = 1, role = "any" }]
+//                        role is "read", "write" or "any"
+//options.probeInterval - ms between attempts to reconnect to a member that
+//                        was taken out of rotation (default 5000)
+//options.probeSql      - query which must succeed on a new connection before
+//                        a member is put back (default "select 1")
+//
+//All other options are passed on to each member's Pool (max, executor...)
+function MultiPool(options) {
+  var self = this
+    , Pool = require("./odbc").Pool
+    ;
+
+  options = options || {};
+
+  if (!options.members || !options.members.length) {
+    throw new Error("[node-odbc] MultiPool requires at least one member");
+  }
+
+  self.probeInterval = options.probeInterval || 5000;
+  self.probeSql = options.probeSql || "select 1";
+  self.probeTimer = null;
+  self.poolOptions = {};
+
+  Object.keys(options).forEach(function (key) {
+    if (key !== "members" && key !== "probeInterval" && key !== "probeSql") {
+      self.poolOptions[key] = options[key];
+    }
+  });
+
+  self.members = options.members.map(function (member, index) {
+    return {
+      index : index
+      , connectionString : member.connectionString
+      , weight : member.weight || 1
+      , role : member.role || "any"
+      , pool : new Pool(self.poolOptions)
+      , opening : 0
+      , inFlight : 0
+      , leased : 0
+      , acquired : 0
+      , failures : 0
+      , healthy : true
+      , lastError : null
+      };
+  });
+}
+
+//open([{ role, priority, deadline, timeout }], callback)
+//
+//role "read" prefers read and any members and falls back to write members
+//when none of them is healthy; role "write" only uses write and any members.
+MultiPool.prototype.open = function (options, callback) {
+  var self = this
+    , tried = []
+    ;
+
+  if (typeof(options) == 'function') {
+    callback = options;
+    options = null;
+  }
+
+  options = options || {};
+
+  (function attempt() {
+    var member = pick(self, options.role || "any", tried)
+      , openOptions = {}
+      ;
+
+    if (!member) {
+      return callback(new Error("[node-odbc] No healthy MultiPool member for role " + (options.role || "any")));
+    }
+
+    tried.push(member);
+
+    ["priority", "deadline", "timeout"].forEach(function (key) {
+      if (options[key] !== undefined) {
+        openOptions[key] = options[key];
+      }
+    });
+
+    //counted as soon as it is routed so that concurrent open() calls spread
+    member.opening += 1;
+
+    member.pool.open(member.connectionString, openOptions, function (err, db) {
+      member.opening -= 1;
+
+      if (err) {
+
+        if (err.code === "EDEADLINE") {
+          return callback(err);
+        }
+
+        eject(self, member, err);
+
+        return attempt();
+      }
+
+      member.acquired += 1;
+      member.leased += 1;
+      lease(self, member, db);
+
+      callback(null, db);
+    });
+  })();
+};
+
+//per member routing and health information
+MultiPool.prototype.stats = function () {
+  var self = this;
+
+  return self.members.map(function (member) {
+    return {
+      index : member.index
+      , role : member.role
+      , weight : member.weight
+      , healthy : member.healthy
+      , inFlight : member.inFlight
+      , leased : member.leased
+      , acquired : member.acquired
+      , failures : member.failures
+      , lastError : member.lastError
+      , queue : member.pool.queueStats()
+      };
+  });
+};
+
+MultiPool.prototype.close = function (callback) {
+  var self = this
+    , remaining = self.members.length
+    ;
+
+  if (self.probeTimer) {
+    clearInterval(self.probeTimer);
+    self.probeTimer = null;
+  }
+
+  self.members.forEach(function (member) {
+    member.pool.close(function () {
+      if (--remaining === 0 && callback) {
+        callback();
+      }
+    });
+  });
+};
+
+function serves(member, role) {
+  return member.role === "any" || role === "any" || member.role === role;
+}
+
+//fewest queries in flight and connections being opened, scaled by weight;
+//ties go to the member with fewer connections handed out, then to the member
+//listed first so that a primary can be preferred simply by ordering
+function pick(self, role, tried) {
+  var best = null
+    , bestScore
+    , candidates
+    ;
+
+  candidates = self.members.filter(function (member) {
+    return member.healthy && tried.indexOf(member) === -1 && serves(member, role);
+  });
+
+  if (!candidates.length && role === "read") {
+    //reads may go to the primary when every replica is down
+    candidates = self.members.filter(function (member) {
+      return member.healthy && tried.indexOf(member) === -1;
+    });
+  }
+
+  candidates.forEach(function (member) {
+    var score = (member.opening + member.inFlight) / member.weight;
+
+    if (!best || score < bestScore
+      || (score === bestScore && member.leased / member.weight < best.leased / best.weight)) {
+      best = member;
+      bestScore = score;
+    }
+  });
+
+  return best;
+}
+
+//track the connection while it is out, count its queries and watch them
+//for member failures
+function lease(self, member, db) {
+  var close = db.close
+    , prepare
+    ;
+
+  db.close = function (cb) {
+    db.close = close;
+    member.leased -= 1;
+
+    return close.call(db, cb || function () {});
+  };
+
+  //a pooled Database always belongs to the same member, so wrap it once
+  if (db.multiPoolWatched) {
+    return;
+  }
+
+  db.multiPoolWatched = true;
+
+  //query() calls back once per result set, the last time without
+  //moreResults
+  watch(self, member, db, "query", true);
+  watch(self, member, db, "queryMulti", false);
+  watch(self, member, db, "queryResult", false);
+
+  prepare = db.prepare;
+
+  db.prepare = function () {
+    var args = Array.prototype.slice.call(arguments)
+      , cb = args[args.length - 1]
+      , result
+      ;
+
+    if (typeof(cb) == 'function') {
+      args[args.length - 1] = function (err, stmt) {
+        if (stmt) {
+          watchStatement(self, member, stmt);
+        }
+
+        return cb.apply(this, arguments);
+      };
+
+      return prepare.apply(db, args);
+    }
+
+    result = prepare.apply(db, args);
+
+    if (!result || typeof(result.then) != 'function') {
+      return result;
+    }
+
+    return result.then(function (stmt) {
+      if (stmt) {
+        watchStatement(self, member, stmt);
+      }
+
+      return stmt;
+    });
+  };
+}
+
+function watchStatement(self, member, stmt) {
+  watch(self, member, stmt, "execute", false);
+  watch(self, member, stmt, "executeNonQuery", false);
+}
+
+//wrap target[name] so that the call counts as in flight on member until it
+//calls back or, without a callback, until the promise it returns settles
+function watch(self, member, target, name, perResultSet) {
+  var fn = target[name]
+    , promising = false
+    ;
+
+  target[name] = function () {
+    var args = Array.prototype.slice.call(arguments)
+      , cb = args[args.length - 1]
+      , result
+      ;
+
+    //the promise forms of query() and execute() call back into target[name]
+    //with a callback of their own; that call is already counted
+    if (promising) {
+      return fn.apply(target, args);
+    }
+
+    if (typeof(cb) != 'function') {
+      promising = true;
+
+      try {
+        result = fn.apply(target, args);
+      }
+      finally {
+        promising = false;
+      }
+
+      if (!result || typeof(result.then) != 'function') {
+        return result;
+      }
+
+      member.inFlight += 1;
+
+      return result.then(function (data) {
+        member.inFlight -= 1;
+
+        return data;
+      }, function (err) {
+        member.inFlight -= 1;
+        checkFailure(self, member, err);
+
+        throw err;
+      });
+    }
+
+    member.inFlight += 1;
+
+    args[args.length - 1] = function (err, data, moreResults) {
+      if (!perResultSet || !moreResults) {
+        member.inFlight -= 1;
+      }
+
+      checkFailure(self, member, err);
+
+      return cb.apply(this, arguments);
+    };
+
+    return fn.apply(target, args);
+  };
+}
+
+function checkFailure(self, member, err) {
+  if (err && err.state && MEMBER_FAILURE.test(err.state)) {
+    eject(self, member, err);
+  }
+}
+
+function eject(self, member, err) {
+  member.failures += 1;
+  member.lastError = (err && err.message) || String(err);
+
+  if (!member.healthy) {
+    return;
+  }
+
+  member.healthy = false;
+
+  if (!self.probeTimer) {
+    self.probeTimer = setInterval(function () {
+      probe(self);
+    }, self.probeInterval);
+
+    if (self.probeTimer.unref) {
+      self.probeTimer.unref();
+    }
+  }
+}
+
+//try to reconnect to every member that is out of rotation. The probe opens
+//a Database of its own rather than going through the member's pool, which
+//could hand back an idle connection that was opened before the failure
+function probe(self) {
+  var Database = require("./odbc").Database
+    , ejected
+    ;
+
+  ejected = self.members.filter(function (member) {
+    return !member.healthy && !member.probing;
+  });
+
+  if (!ejected.length && self.members.every(function (member) { return member.healthy; })) {
+    clearInterval(self.probeTimer);
+    self.probeTimer = null;
+
+    return;
+  }
+
+  ejected.forEach(function (member) {
+    var db = new Database(self.poolOptions);
+
+    member.probing = true;
+
+    db.open(member.connectionString, function (err) {
+      if (err) {
+        member.probing = false;
+        member.lastError = err.message;
+
+        return;
+      }
+
+      db.query(self.probeSql, function (err, data, moreResults) {
+        if (moreResults) {
+          return;
+        }
+
+        member.probing = false;
+
+        if (err) {
+          member.lastError = err.message;
+        }
+        else {
+          member.healthy = true;
+        }
+
+        db.close(function () {});
+      });
+    });
+  });
+}
@@ -17,6 +17,8 @@
 
 var odbc = require("bindings")("odbc_bindings")
   , SimpleQueue = require("./simple-queue")
+  , Scheduler = require("./scheduler")
+  , MetadataCache = require("./metadata-cache")
   , util = require("util")
   ;
 
@@ -31,7 +33,83 @@ module.exports.ODBC = odbc.ODBC;
 module.exports.ODBCConnection = odbc.ODBCConnection;
 module.exports.ODBCStatement = odbc.ODBCStatement;
 module.exports.ODBCResult = odbc.ODBCResult;
+module.exports.ODBCExecutor = odbc.ODBCExecutor;
+module.exports.ODBCCache = odbc.ODBCCache;
+module.exports.MetadataCache = MetadataCache;
 module.exports.loadODBCLibrary = odbc.loadODBCLibrary;
+module.exports.getStats = odbc.getStats;
+module.exports.metrics = odbc.metrics;
+module.exports.setSlowQueryLog = odbc.setSlowQueryLog;
+module.exports.drainSlowQueries = drainSlowQueries;
+module.exports.metricsText = metricsText;
+module.exports.metricsHandler = metricsHandler;
+module.exports.setTrace = odbc.setTrace;
+module.exports.setExternalStringThreshold = odbc.setExternalStringThreshold;
+
+//odbc.metrics() and the query latency percentiles in the Prometheus text
+//exposition format
+function metricsText() {
+  var m = odbc.metrics(), stats = odbc.getStats(), lines = [];
+  
+  function metric(name, type, help, samples) {
+    lines.push("# HELP " + name + " " + help);
+    lines.push("# TYPE " + name + " " + type);
+    
+    samples.forEach(function (sample) {
+      lines.push(name + (sample[0] ? "{" + sample[0] + "}" : "") + " " + sample[1]);
+    });
+  }
+  
+  function labelled(label, values) {
+    return Object.keys(values).map(function (key) {
+      return [label + '="' + key + '"', values[key]];
+    });
+  }
+  
+  metric("odbc_handles", "gauge", "Allocated ODBC handles.", labelled("type", {
+    env : m.envHandles, dbc : m.dbcHandles, stmt : m.stmtHandles
+  }));
+  metric("odbc_open_results", "gauge", "ODBCResult objects not yet garbage collected.", [["", m.results]]);
+  metric("odbc_buffer_bytes", "gauge", "Bytes of fetch buffers held by results and statements.", [["", m.bufferBytes]]);
+  metric("odbc_rows_fetched_total", "counter", "Rows fetched from the driver.", [["", m.rowsFetched]]);
+  metric("odbc_bytes_decoded_total", "counter", "Bytes of column data read from the driver.", [["", m.bytesDecoded]]);
+  metric("odbc_external_string_bytes", "gauge", "Bytes of text values held outside of the V8 heap.", [["", m.externalStringBytes]]);
+  metric("odbc_driver_calls_total", "counter", "Calls into the ODBC driver manager.", labelled("function", m.calls));
+  metric("odbc_errors_total", "counter", "Diagnostic records by SQLSTATE.", labelled("sqlstate", m.errors));
+  
+  metric("odbc_query_seconds", "summary", "Query latency by phase.", [].concat.apply([], Object.keys(stats).map(function (phase) {
+    var s = stats[phase], label = 'phase="' + phase + '"';
+    
+    return [
+      [label + ',quantile="0.5"', s.p50 / 1000]
+      , [label + ',quantile="0.9"', s.p90 / 1000]
+      , [label + ',quantile="0.99"', s.p99 / 1000]
+    ];
+  })));
+  
+  Object.keys(stats).forEach(function (phase) {
+    lines.push('odbc_query_seconds_sum{phase="' + phase + '"} ' + stats[phase].mean * stats[phase].count / 1000);
+    lines.push('odbc_query_seconds_count{phase="' + phase + '"} ' + stats[phase].count);
+  });
+  
+  return lines.join("\n") + "\n";
+}
+
+//the queries logged by the slow query log since the last call
+function drainSlowQueries() {
+  return odbc.drainSlowQueries().map(function (line) {
+    return JSON.parse(line);
+  });
+}
+
+//an http request listener which serves metricsText(), eg
+//http.createServer(odbc.metricsHandler()).listen(9464)
+function metricsHandler() {
+  return function (req, res) {
+    res.writeHead(200, { "Content-Type" : "text/plain; version=0.0.4" });
+    res.end(metricsText());
+  };
+}
 
 module.exports.open = function (connectionString, options, cb) {
   var db;
@@ -65,8 +143,10 @@ function Database(options) {
     }
   }
   
-  self.odbc = (options.odbc) ? options.odbc : new odbc.ODBC();
-  self.queue = new SimpleQueue();
+  //the environment is only allocated by open(); connections of a
+  //SharedPool do not need one
+  self.odbc = (options.odbc) ? options.odbc : null;
+  self.queue = new Scheduler();
   self.fetchMode = options.fetchMode || null;
   self.connected = false;
   self.connectTimeout = (options.hasOwnProperty('connectTimeout')) 
@@ -77,6 +157,71 @@ function Database(options) {
     ? options.loginTimeout
     : null
     ;
+  //'utf8' to exchange text with the driver as UTF-8 through the ANSI
+  //functions instead of UTF-16
+  self.encoding = options.encoding || null;
+  
+  if (self.encoding && !/^utf-?(8|16)$/.test(self.encoding)) {
+    throw new TypeError("encoding must be 'utf8' or 'utf16'");
+  }
+  self.executor = createExecutor(options.executor);
+  self.cache = createCache(options.cache);
+  self.metadataCache = createMetadataCache(options.metadataCache);
+  self.connectionString = null;
+  //share the strings of repeated values in text columns of results
+  self.intern = options.intern || false;
+  self.pipeline = options.pipeline || false;
+  self.pipelineDepth = 0;
+  self.pipelineHold = null;
+  //milliseconds; overrides the threshold of odbc.setSlowQueryLog()
+  self.slowQueryThreshold = (options.hasOwnProperty('slowQueryThreshold'))
+    ? options.slowQueryThreshold
+    : null
+    ;
+}
+
+//options.executor may be an ODBCExecutor instance to share, a number of
+//threads for a new executor, or true for a new single-threaded executor
+function createExecutor(executor) {
+  if (!executor) {
+    return null;
+  }
+  
+  if (executor instanceof odbc.ODBCExecutor) {
+    return executor;
+  }
+  
+  return new odbc.ODBCExecutor((typeof executor === 'number') ? executor : 1);
+}
+
+//options.cache may be an ODBCCache instance to share, true for a new cache
+//with the default limits, or { maxBytes, ttl } for a new cache
+function createCache(cache) {
+  if (!cache) {
+    return null;
+  }
+  
+  if (cache instanceof odbc.ODBCCache) {
+    return cache;
+  }
+  
+  return (typeof cache === 'object')
+    ? new odbc.ODBCCache(cache.maxBytes, cache.ttl)
+    : new odbc.ODBCCache();
+}
+
+//options.metadataCache may be a MetadataCache to share, true for a new
+//cache without expiry or { ttl } for a new cache
+function createMetadataCache(metadataCache) {
+  if (!metadataCache) {
+    return null;
+  }
+  
+  if (metadataCache instanceof MetadataCache) {
+    return metadataCache;
+  }
+  
+  return new MetadataCache((typeof metadataCache === 'object') ? metadataCache : null);
 }
 
 //Expose constants
@@ -93,6 +238,10 @@ Object.keys(odbc.ODBC).forEach(function (key) {
 Database.prototype.open = function (connectionString, cb) {
   var self = this;
   
+  if (typeof(cb) != 'function') {
+    return promised(self, self.open, [connectionString]);
+  }
+  
   if (typeof(connectionString) == "object") {
     var obj = connectionString;
     connectionString = "";
@@ -102,11 +251,18 @@ Database.prototype.open = function (connectionString, cb) {
     });
   }
   
+  self.connectionString = connectionString;
+  self.odbc = self.odbc || new odbc.ODBC();
+  
   self.odbc.createConnection(function (err, conn) {
     if (err) return cb(err);
     
     self.conn = conn;
     
+    if (self.executor) {
+      self.conn.setExecutor(self.executor);
+    }
+    
     if (self.connectTimeout || self.connectTimeout === 0) {
       self.conn.connectTimeout = self.connectTimeout;
     }
@@ -114,6 +270,10 @@ Database.prototype.open = function (connectionString, cb) {
     if (self.loginTimeout || self.loginTimeout === 0) {
       self.conn.loginTimeout = self.loginTimeout;
     }
+    
+    if (self.encoding) {
+      self.conn.encoding = self.encoding;
+    }
 
     self.conn.open(connectionString, function (err, result) {
       if (err) return cb(err);
@@ -128,8 +288,13 @@ Database.prototype.open = function (connectionString, cb) {
 Database.prototype.openSync = function (connectionString) {
   var self =  this;
   
+  self.odbc = self.odbc || new odbc.ODBC();
   self.conn = self.odbc.createConnectionSync();
   
+  if (self.executor) {
+    self.conn.setExecutor(self.executor);
+  }
+  
   if (self.connectTimeout || self.connectTimeout === 0) {
     self.conn.connectTimeout = self.connectTimeout;
   }
@@ -138,6 +303,10 @@ Database.prototype.openSync = function (connectionString) {
     self.conn.loginTimeout = self.loginTimeout;
   }
   
+  if (self.encoding) {
+    self.conn.encoding = self.encoding;
+  }
+  
   if (typeof(connectionString) == "object") {
     var obj = connectionString;
     connectionString = "";
@@ -147,6 +316,8 @@ Database.prototype.openSync = function (connectionString) {
     });
   }
   
+  self.connectionString = connectionString;
+  
   var result = self.conn.openSync(connectionString);
   
   if (result) {
@@ -188,17 +359,48 @@ Database.prototype.closeSync = function () {
 }
 
 Database.prototype.query = function (sql, params, cb) {
-  var self = this;
+  var self = this, schedule, caching, key, rows, queued = hrtime();
   
   if (typeof(params) == 'function') {
     cb = params;
     params = null;
   }
   
+  if (typeof(cb) != 'function') {
+    return promisedQuery(self, sql, params);
+  }
+  
+  //query({ sql, params, priority, deadline, timeout, cache }, cb)
+  if (sql && typeof(sql) == 'object') {
+    params = sql.params || params;
+    caching = sql.cache;
+    schedule = scheduleOptions(sql, function (err) {
+      cb(err, [], false);
+    });
+    sql = sql.sql;
+  }
+  
    if (!self.connected) {
     return cb({ message : "Connection not open."}, [], false);
   }
   
+  if (caching && self.cache) {
+    key = cacheKey(self.connectionString, sql, params, self.fetchMode);
+    rows = self.cache.get(key);
+    
+    if (rows) {
+      return process.nextTick(function () {
+        cb(null, rows, false);
+      });
+    }
+    
+    cb = cacheRows(self, key, caching, cb);
+  }
+  
+  if (self.pipeline) {
+    return pipelineQuery(self, sql, params, schedule, cb);
+  }
+  
   self.queue.push(function (next) {
     function cbQuery (initialErr, result) {
       fetchMore();
@@ -207,8 +409,12 @@ Database.prototype.query = function (sql, params, cb) {
         if (self.fetchMode) {
           result.fetchMode = self.fetchMode;
         }
+        
+        if (self.intern) {
+          result.intern = true;
+        }
          
-        result.fetchAll(function (err, data) {
+        result.fetchAll(function (err, data, timing) {
           var moreResults, moreResultsError = null;
           
           try {
@@ -226,7 +432,7 @@ Database.prototype.query = function (sql, params, cb) {
             result.closeSync();
           }
           
-          cb(err || initialErr, data, moreResults);
+          cb(err || initialErr, data, moreResults, timing);
           initialErr = null;
             
           while (moreResultsError) {
@@ -251,15 +457,172 @@ Database.prototype.query = function (sql, params, cb) {
       }
     }
     
+    //queued lets the addon include the time spent in self.queue in the
+    //timing passed to the callback
+    var options = { sql : sql, queued : queued };
+    
     if (params) {
-      self.conn.query(sql, params, cbQuery);
+      options.params = params;
     }
-    else {
-      self.conn.query(sql, cbQuery);
+    
+    if (self.slowQueryThreshold !== null) {
+      options.slowThreshold = self.slowQueryThreshold;
     }
-  });
+    
+    self.conn.query(options, cbQuery);
+  }, schedule);
+};
+
+//process.hrtime() in nanoseconds, the clock the addon times queries with
+function hrtime() {
+  var t = process.hrtime();
+  
+  return t[0] * 1e9 + t[1];
+}
+
+//a cache may be shared by databases on different DSNs, so the connection
+//string is part of the key
+function cacheKey(connectionString, sql, params, fetchMode) {
+  return (connectionString || "") + "\u0000" + sql + "\u0000" + JSON.stringify(params || []) + "\u0000" + (fetchMode || "");
+}
+
+//wrap a query callback so that the rows of a query with exactly one result
+//set are stored in self.cache. caching is true or { ttl, tags }
+function cacheRows(self, key, caching, cb) {
+  var multiple = false
+    , options = (typeof(caching) == 'object') ? caching : {}
+    ;
+  
+  return function (err, data, moreResults) {
+    if (moreResults) {
+      multiple = true;
+    }
+    else if (!err && !multiple && Array.isArray(data)) {
+      self.cache.set(key, data, options.ttl, options.tags);
+    }
+    
+    return cb.apply(this, arguments);
+  };
+}
+
+//drop every cached result tagged with tag
+Database.prototype.invalidate = function (tag) {
+  var self = this;
+  
+  return (self.cache) ? self.cache.invalidate(tag) : 0;
 };
 
+Database.prototype.cacheStats = function () {
+  var self = this;
+  
+  return (self.cache) ? self.cache.stats() : null;
+};
+
+//Run a batch and collect all of its result sets on the worker thread.
+//cb(err, [{ columns, rows, rowCount }, ...])
+Database.prototype.queryMulti = function (sql, params, cb) {
+  var self = this, schedule, options;
+  
+  if (typeof(params) == 'function') {
+    cb = params;
+    params = null;
+  }
+  
+  if (sql && typeof(sql) == 'object') {
+    params = sql.params || params;
+    schedule = scheduleOptions(sql, function (err) {
+      cb(err, []);
+    });
+    sql = sql.sql;
+  }
+  
+  if (!self.connected) {
+    return cb({ message : "Connection not open."}, []);
+  }
+  
+  self.queue.push(function (next) {
+    options = { sql : sql, params : params || [] };
+    
+    if (self.fetchMode) {
+      options.fetchMode = self.fetchMode;
+    }
+    
+    self.conn.queryMulti(options, function (err, sets) {
+      cb(err, sets);
+      
+      return next();
+    });
+  }, schedule);
+};
+
+//Scheduling options accepted by query(), prepare() and execute(). onExpire
+//is called instead of the request if its deadline passes while queued.
+function scheduleOptions(options, onExpire) {
+  if (!options) {
+    return null;
+  }
+  
+  return {
+    priority : options.priority
+    , deadline : options.deadline
+    , timeout : options.timeout
+    , onExpire : onExpire
+  };
+}
+
+//queue wait statistics per priority class
+Database.prototype.queueStats = function () {
+  return this.queue.stats();
+};
+
+//With options.pipeline, queries are handed to the connection's native
+//pipeline as soon as they are issued instead of waiting for the previous
+//one to call back. The queue is parked while any pipelined query is in
+//flight, so everything else (close, queryResult, ...) still runs in order.
+function pipelineQuery(self, sql, params, schedule, cb) {
+  if (self.pipelineHold && !self.queue.size()) {
+    //the queue is parked on the pipeline and nothing is waiting behind it
+    return submitPipelined(self, sql, params, cb);
+  }
+  
+  self.queue.push(function (next) {
+    self.pipelineHold = next;
+    
+    submitPipelined(self, sql, params, cb);
+  }, schedule);
+}
+
+function submitPipelined(self, sql, params, cb) {
+  var options = { sql : sql, params : params || [] };
+  
+  if (self.fetchMode) {
+    options.fetchMode = self.fetchMode;
+  }
+  
+  self.pipelineDepth += 1;
+  
+  self.conn.pipeline(options, function (err, sets) {
+    if (!sets.length) {
+      cb(err, [], false);
+    }
+    
+    for (var i = 0; i < sets.length; i++) {
+      //an error stops the command, so it belongs to the last result set
+      cb((i === sets.length - 1) ? err : null, sets[i], i < sets.length - 1);
+    }
+    
+    self.pipelineDepth -= 1;
+    
+    if (!self.pipelineDepth && self.pipelineHold) {
+      var next = self.pipelineHold;
+      
+      self.pipelineHold = null;
+      
+      return next();
+    }
+  });
+}
+
 Database.prototype.queryResult = function (sql, params, cb) {
   var self = this;
   
@@ -292,6 +655,10 @@ Database.prototype.queryResult = function (sql, params, cb) {
         result.fetchMode = self.fetchMode;
       }
       
+      if (self.intern) {
+        result.intern = true;
+      }
+      
       cb(err, result);
       
       return next();
@@ -317,6 +684,10 @@ Database.prototype.queryResultSync = function (sql, params) {
     result.fetchMode = self.fetchMode;
   }
   
+  if (self.intern) {
+    result.intern = true;
+  }
+  
   return result;
 };
 
@@ -338,6 +709,10 @@ Database.prototype.querySync = function (sql, params) {
     result.fetchMode = self.fetchMode;
   }
   
+  if (self.intern) {
+    result.intern = true;
+  }
+  
   var data = result.fetchAllSync();
   
   result.closeSync();
@@ -411,44 +786,62 @@ Database.prototype.rollbackTransactionSync = function () {
 
 Database.prototype.columns = function(catalog, schema, table, column, callback) {
   var self = this;
-  if (!self.queue) self.queue = [];
   
   callback = callback || arguments[arguments.length - 1];
   
-  self.queue.push(function (next) {
-    self.conn.columns(catalog, schema, table, column, function (err, result) {
-      if (err) return callback(err, [], false);
-
-      result.fetchAll(function (err, data) {
-        result.closeSync();
-
-        callback(err, data);
-        
-        return next();
-      });
-    });
-  });
+  catalogQuery(self, "columns", [catalog, schema, table, column], table, callback);
 };
 
 Database.prototype.tables = function(catalog, schema, table, type, callback) {
   var self = this;
-  if (!self.queue) self.queue = [];
   
   callback = callback || arguments[arguments.length - 1];
   
-  self.queue.push(function (next) {
-    self.conn.tables(catalog, schema, table, type, function (err, result) {
-      if (err) return callback(err, [], false);
-
-      result.fetchAll(function (err, data) {
-        result.closeSync();
+  catalogQuery(self, "tables", [catalog, schema, table, type], table, callback);
+};
 
-        callback(err, data);
+//run one of the catalog functions of the connection, through the metadata
+//cache if there is one
+function catalogQuery(self, method, args, table, callback) {
+  var key;
+  
+  function load(done) {
+    self.queue.push(function (next) {
+      self.conn[method].apply(self.conn, args.concat(function (err, result) {
+        if (err) {
+          done(err, [], false);
+          return next();
+        }
         
-        return next();
-      });
+        result.fetchAll(function (err, data) {
+          result.closeSync();
+          
+          done(err, data);
+          
+          return next();
+        });
+      }));
     });
-  });
+  }
+  
+  if (!self.metadataCache) {
+    return load(callback);
+  }
+  
+  key = JSON.stringify([self.connectionString, method].concat(args.map(function (arg) {
+    return (arg === undefined) ? null : arg;
+  })));
+  
+  self.metadataCache.fetch(key, table, load, callback);
+}
+
+//forget cached catalog data, for one table or all of it
+Database.prototype.refreshMetadata = function (table) {
+  var self = this;
+  
+  if (self.metadataCache) {
+    self.metadataCache.refresh(table);
+  }
 };
 
 Database.prototype.describe = function(obj, callback) {
@@ -499,20 +892,34 @@ Database.prototype.describe = function(obj, callback) {
   }
 };
 
-Database.prototype.prepare = function (sql, cb) {
+Database.prototype.prepare = function (sql, options, cb) {
   var self = this;
   
-  self.conn.createStatement(function (err, stmt) {
-    if (err) return cb(err);
-    
-    stmt.queue = new SimpleQueue();
-    
-    stmt.prepare(sql, function (err) {
-      if (err) return cb(err);
+  if (typeof(options) == 'function') {
+    cb = options;
+    options = null;
+  }
+  
+  self.queue.push(function (next) {
+    self.conn.createStatement(function (err, stmt) {
+      if (err) {
+        cb(err);
+        return next();
+      }
       
-      return cb(null, stmt);
+      stmt.queue = new Scheduler();
+      
+      stmt.prepare(sql, function (err) {
+        if (err) {
+          cb(err);
+          return next();
+        }
+        
+        cb(null, stmt);
+        return next();
+      });
     });
-  });
+  }, scheduleOptions(options, cb));
 }
 
 Database.prototype.prepareSync = function (sql, cb) {
@@ -520,7 +927,7 @@ Database.prototype.prepareSync = function (sql, cb) {
   
   var stmt = self.conn.createStatementSync();
   
-  stmt.queue = new SimpleQueue();
+  stmt.queue = new Scheduler();
     
   stmt.prepareSync(sql);
     
@@ -534,16 +941,26 @@ odbc.ODBCStatement.prototype._executeNonQuery = odbc.ODBCStatement.prototype.exe
 odbc.ODBCStatement.prototype._prepare = odbc.ODBCStatement.prototype.prepare;
 odbc.ODBCStatement.prototype._bind = odbc.ODBCStatement.prototype.bind;
 
-odbc.ODBCStatement.prototype.execute = function (params, cb) {
+odbc.ODBCStatement.prototype.execute = function (params, options, cb) {
   var self = this;
   
-  self.queue = self.queue || new SimpleQueue();
+  self.queue = self.queue || new Scheduler();
+  
+  //execute(params, { priority, deadline, timeout }, cb)
+  if (typeof(options) == 'function') {
+    cb = options;
+    options = null;
+  }
   
   if (!cb) {
     cb = params;
     params = null;
   }
   
+  if (typeof(cb) != 'function') {
+    return promised(self, self.execute, [cb || null, options || null]);
+  }
+  
   self.queue.push(function (next) {
     //If params were passed to this function, then bind them and
     //then execute.
@@ -574,13 +991,13 @@ odbc.ODBCStatement.prototype.execute = function (params, cb) {
         return next();
       });
     }
-  });
+  }, scheduleOptions(options, cb));
 };
 
 odbc.ODBCStatement.prototype.executeDirect = function (sql, cb) {
   var self = this;
   
-  self.queue = self.queue || new SimpleQueue();
+  self.queue = self.queue || new Scheduler();
   
   self.queue.push(function (next) {
     self._executeDirect(sql, function (err, result) {
@@ -591,10 +1008,16 @@ odbc.ODBCStatement.prototype.executeDirect = function (sql, cb) {
   });
 };
 
-odbc.ODBCStatement.prototype.executeNonQuery = function (params, cb) {
+odbc.ODBCStatement.prototype.executeNonQuery = function (params, options, cb) {
   var self = this;
   
-  self.queue = self.queue || new SimpleQueue();
+  self.queue = self.queue || new Scheduler();
+  
+  //executeNonQuery(params, { priority, deadline, timeout }, cb)
+  if (typeof(options) == 'function') {
+    cb = options;
+    options = null;
+  }
   
   if (!cb) {
     cb = params;
@@ -631,13 +1054,13 @@ odbc.ODBCStatement.prototype.executeNonQuery = function (params, cb) {
         return next();
       });
     }
-  });
+  }, scheduleOptions(options, cb));
 };
 
 odbc.ODBCStatement.prototype.prepare = function (sql, cb) {
   var self = this;
   
-  self.queue = self.queue || new SimpleQueue();
+  self.queue = self.queue || new Scheduler();
   
   self.queue.push(function (next) {
     self._prepare(sql, function (err) {
@@ -671,7 +1094,11 @@ odbc.ODBCResult.prototype._fetch = odbc.ODBCResult.prototype.fetch;
 odbc.ODBCResult.prototype.fetch = function (cb) {
   var self = this;
 
-  self.queue = self.queue || new SimpleQueue();
+  if (typeof(cb) != 'function') {
+    return promised(self, self.fetch, []);
+  }
+
+  self.queue = self.queue || new Scheduler();
 
   self.queue.push(function (next) {
     self._fetch(function (err, data) {
@@ -682,7 +1109,94 @@ odbc.ODBCResult.prototype.fetch = function (cb) {
   });
 };
 
+//for await (const rows of result) yields arrays of up to result.batchSize
+//rows (default 100), each read by one native fetchBatch() call queued on
+//result.queue like fetch()
+if (typeof(Symbol) != 'undefined' && Symbol.asyncIterator) {
+  odbc.ODBCResult.prototype[Symbol.asyncIterator] = function () {
+    var self = this
+      , done = false
+      ;
+
+    return {
+      next : function () {
+        var deferred;
+
+        if (done) {
+          return Promise.resolve({ value : undefined, done : true });
+        }
+
+        deferred = odbc.createPromise();
+
+        self.queue = self.queue || new Scheduler();
+
+        self.queue.push(function (next) {
+          self.fetchBatch(self.batchSize || 100, function (err, rows) {
+            deferred.callback(err, rows);
+
+            return next();
+          });
+        });
+
+        return deferred.promise.then(function (rows) {
+          done = !rows;
+
+          return { value : rows || undefined, done : done };
+        });
+      }
+      , return : function () {
+        done = true;
+
+        return Promise.resolve({ value : undefined, done : true });
+      }
+    };
+  };
+}
+
+//Call method with the addon's promise callback appended to args and return
+//the promise it settles; the queued methods use this when they are called
+//without a callback
+function promised(self, method, args) {
+  var deferred = odbc.createPromise();
+  
+  try {
+    method.apply(self, args.concat(deferred.callback));
+  }
+  catch (e) {
+    deferred.callback(e);
+  }
+  
+  return deferred.promise;
+}
+
+//query() without a callback: the callback is called once per result set,
+//so the rows are collected and the promise is settled after the last set,
+//with the rows of the only set or an array of the rows of each set
+function promisedQuery(self, sql, params) {
+  var deferred = odbc.createPromise()
+    , sets = []
+    , error = null
+    ;
+  
+  try {
+    self.query(sql, params, function (err, rows, moreResults) {
+      error = error || err;
+      sets.push(rows);
+      
+      if (!moreResults) {
+        deferred.callback(error, (sets.length > 1) ? sets : rows);
+      }
+    });
+  }
+  catch (e) {
+    deferred.callback(e);
+  }
+  
+  return deferred.promise;
+}
+
 module.exports.Pool = Pool;
+module.exports.MultiPool = require("./multi-pool");
 
 Pool.count = 0;
 
@@ -694,12 +1208,82 @@ function Pool (options) {
   self.odbc = new odbc.ODBC();
   self.options = options || {}
   self.options.odbc = self.odbc;
+  //executor : true gives each connection opened by this pool an executor
+  //thread of its own; a thread count or an ODBCExecutor is shared by all of
+  //them
+  if (self.options.executor !== true) {
+    self.options.executor = createExecutor(self.options.executor);
+  }
+  //and one result cache and metadata cache
+  self.options.cache = createCache(self.options.cache);
+  self.options.metadataCache = createMetadataCache(self.options.metadataCache);
+  //options.max limits the connections per connection string; open() calls
+  //beyond that wait in a scheduler. Without max the scheduler is unbounded,
+  //so deadlines and queueStats() still apply
+  self.max = self.options.max || 0;
+  self.schedulers = {};
 }
 
-Pool.prototype.open = function (connectionString, callback) {
+//open(connectionString, [{ priority, deadline, timeout }], callback)
+Pool.prototype.open = function (connectionString, options, callback) {
   var self = this
-    , db
+    , scheduler
     ;
+  
+  if (typeof(options) == 'function') {
+    callback = options;
+    options = null;
+  }
+  
+  scheduler = self.schedulers[connectionString] = self.schedulers[connectionString]
+    || new Scheduler(self.max || Infinity);
+  
+  scheduler.push(function (release) {
+    openConnection(self, connectionString, function (err, db) {
+      if (err) {
+        release();
+        return callback(err);
+      }
+      
+      //the slot is given back once the connection is back in the pool
+      db.poolRelease = release;
+      
+      callback(null, db);
+    });
+  }, scheduleOptions(options || {}, callback));
+};
+
+Pool.prototype.invalidate = function (tag) {
+  var self = this;
+  
+  return (self.options.cache) ? self.options.cache.invalidate(tag) : 0;
+};
+
+Pool.prototype.cacheStats = function () {
+  var self = this;
+  
+  return (self.options.cache) ? self.options.cache.stats() : null;
+};
+
+Pool.prototype.refreshMetadata = function (table) {
+  var self = this;
+  
+  if (self.options.metadataCache) {
+    self.options.metadataCache.refresh(table);
+  }
+};
+
+//queue wait statistics of open() calls, merged over all connection strings
+Pool.prototype.queueStats = function () {
+  var self = this;
+  
+  return Scheduler.mergeStats(Object.keys(self.schedulers).map(function (key) {
+    return self.schedulers[key].stats();
+  }));
+};
+
+function openConnection(self, connectionString, callback) {
+  var db;
 
   //check to see if we already have a connection for this connection string
   if (self.availablePool[connectionString] && self.availablePool[connectionString].length) {
@@ -726,15 +1310,21 @@ Pool.prototype.open = function (connectionString, callback) {
 
         //re-open the connection using the connection string
         db.open(connectionString, function (error) {
+          var release = db.poolRelease;
+          
+          db.poolRelease = null;
+          
           if (error) {
             console.error(error);
-            return;
+            return release && release();
           }
           
           //add this clean connection to the connection pool
           self.availablePool[connectionString] = self.availablePool[connectionString] || [];
           self.availablePool[connectionString].push(db);
           exports.debug && console.dir(self);
+          
+          return release && release();
         });
       });
     };
@@ -748,7 +1338,7 @@ Pool.prototype.open = function (connectionString, callback) {
       callback(error, db);
     });
   }
-};
+}
 
 Pool.prototype.close = function (callback) {
   var self = this
@@ -816,3 +1406,93 @@ Pool.prototype.close = function (callback) {
     }
   }, 2000);
 };
+
+module.exports.SharedPool = SharedPool;
+
+//A pool kept by the native addon for the whole process. Every thread which
+//creates a SharedPool with the same name uses the same connections, so the
+//main thread and its worker_threads together never hold more than
+//options.max connections.
+//
+//options.max            - connections in the pool (default 10)
+//options.acquireTimeout - ms acquire() waits for a free connection
+//                         (default 30000)
+//
+//All other options are passed on to the Database of each acquire().
+function SharedPool (name, connectionString, options) {
+  var self = this;
+  
+  options = options || {};
+  
+  if (typeof(connectionString) == "object") {
+    var obj = connectionString;
+    connectionString = "";
+    
+    Object.keys(obj).forEach(function (key) {
+      connectionString += key + "=" + obj[key] + ";";
+    });
+  }
+  
+  self.name = name;
+  self.options = options;
+  //as for Pool, executor : true gives each acquired Database an executor
+  //thread of its own; a thread count or an ODBCExecutor is shared
+  if (self.options.executor !== true) {
+    self.options.executor = createExecutor(self.options.executor);
+  }
+  self.options.cache = createCache(self.options.cache);
+  self.options.metadataCache = createMetadataCache(self.options.metadataCache);
+  self.connectionString = connectionString;
+  self.id = odbc.sharedPoolOpen(name, connectionString
+    , options.max || 0
+    , (options.hasOwnProperty('acquireTimeout')) ? options.acquireTimeout : -1);
+}
+
+//acquire(callback) calls back with an open Database; db.close() hands the
+//connection back to the pool
+SharedPool.prototype.acquire = function (cb) {
+  var self = this;
+  
+  if (self.id === null) {
+    return cb(new Error("[node-odbc] SharedPool is closed"));
+  }
+  
+  odbc.sharedPoolAcquire(self.id, function (err, conn) {
+    var db;
+    
+    if (err) return cb(err);
+    
+    db = new Database(self.options);
+    db.conn = conn;
+    db.connected = true;
+    db.connectionString = self.connectionString;
+    
+    if (db.executor) {
+      conn.setExecutor(db.executor);
+    }
+    
+    if (db.encoding) {
+      conn.encoding = db.encoding;
+    }
+    
+    cb(null, db);
+  });
+};
+
+//counters of the native pool, summed over every thread using it
+SharedPool.prototype.stats = function () {
+  var self = this;
+  
+  return (self.id === null) ? null : odbc.sharedPoolStats(self.id);
+};
+
+//drop this thread's reference; the connections are disconnected once every
+//thread has closed the pool and every connection has been handed back
+SharedPool.prototype.close = function () {
+  var self = this;
+  
+  if (self.id !== null) {
+    odbc.sharedPoolClose(self.id);
+    self.id = null;
+  }
+};
@@ -0,0 +1,223 @@
+module.exports = Scheduler;
+
+//Priority classes, served strictly in this order. Within a class requests
+//are served first in, first out.
+Scheduler.PRIORITIES = ["high", "normal", "low"];
+
+//Drop-in replacement for SimpleQueue which knows about priorities and
+//deadlines. push(fn, options) queues fn(next); at most `concurrency`
+//functions (Infinity for no limit) run at once and each one must call next()
+//when it is done.
+//
+//options.priority - "high", "normal" (default) or "low"
+//options.deadline - Date.now() based time after which the request is stale
+//options.timeout  - same as deadline, relative to now in milliseconds
+//options.onExpire - called with an error instead of running fn when the
+//                   deadline passes while the request is still queued. It
+//                   is called on a later tick, never from inside push(),
+//                   next() or another request's callback
+function Scheduler(concurrency) {
+  var self = this;
+
+  self.concurrency = concurrency || 1;
+  self.running = 0;
+  self.classes = [];
+  self.counters = [];
+
+  Scheduler.PRIORITIES.forEach(function () {
+    self.classes.push([]);
+    self.counters.push({ started : 0, expired : 0, totalWait : 0, maxWait : 0 });
+  });
+}
+
+Scheduler.prototype.push = function (fn, options) {
+  var self = this
+    , task
+    ;
+
+  options = options || {};
+
+  task = {
+    fn : fn
+    , priority : priorityIndex(options.priority)
+    , queued : Date.now()
+    , deadline : options.deadline || null
+    , onExpire : options.onExpire || null
+    , timer : null
+    };
+
+  if (options.timeout) {
+    task.deadline = task.queued + options.timeout;
+  }
+
+  self.classes[task.priority].push(task);
+
+  if (task.deadline) {
+    //shed the request as soon as it goes stale rather than waiting for it
+    //to reach the front of the queue
+    task.timer = setTimeout(function () {
+      var list = self.classes[task.priority]
+        , index = list.indexOf(task)
+        ;
+
+      if (index !== -1) {
+        list.splice(index, 1);
+        expire(self, task);
+      }
+    }, Math.max(task.deadline - task.queued, 0));
+
+    if (task.timer.unref) {
+      task.timer.unref();
+    }
+  }
+
+  self.maybeNext();
+};
+
+Scheduler.prototype.maybeNext = function () {
+  var self = this;
+
+  while (self.running < self.concurrency && self.size()) {
+    self.next();
+  }
+};
+
+Scheduler.prototype.next = function () {
+  var self = this
+    , task
+    , now
+    , done = false
+    ;
+
+  while ((task = shift(self))) {
+    now = Date.now();
+
+    if (task.timer) {
+      clearTimeout(task.timer);
+    }
+
+    if (task.deadline && now >= task.deadline) {
+      expire(self, task);
+      continue;
+    }
+
+    recordWait(self.counters[task.priority], now - task.queued);
+
+    self.running += 1;
+
+    task.fn(function () {
+      //guard against a function calling next() more than once
+      if (done) return;
+
+      done = true;
+      self.running -= 1;
+
+      self.maybeNext();
+    });
+
+    return;
+  }
+};
+
+//number of requests waiting to run
+Scheduler.prototype.size = function () {
+  var self = this
+    , size = 0
+    ;
+
+  for (var i = 0; i < self.classes.length; i++) {
+    size += self.classes[i].length;
+  }
+
+  return size;
+};
+
+//queue wait statistics per priority class, in milliseconds
+Scheduler.prototype.stats = function () {
+  var self = this
+    , stats = {}
+    ;
+
+  Scheduler.PRIORITIES.forEach(function (name, i) {
+    var counter = self.counters[i];
+
+    stats[name] = {
+      waiting : self.classes[i].length
+      , started : counter.started
+      , expired : counter.expired
+      , totalWait : counter.totalWait
+      , maxWait : counter.maxWait
+      , meanWait : (counter.started) ? counter.totalWait / counter.started : 0
+      };
+  });
+
+  return stats;
+};
+
+//add the stats of several schedulers together
+Scheduler.mergeStats = function (list) {
+  var stats = {};
+
+  Scheduler.PRIORITIES.forEach(function (name) {
+    var merged = { waiting : 0, started : 0, expired : 0, totalWait : 0, maxWait : 0, meanWait : 0 };
+
+    list.forEach(function (item) {
+      var s = item[name];
+
+      merged.waiting += s.waiting;
+      merged.started += s.started;
+      merged.expired += s.expired;
+      merged.totalWait += s.totalWait;
+      merged.maxWait = Math.max(merged.maxWait, s.maxWait);
+    });
+
+    merged.meanWait = (merged.started) ? merged.totalWait / merged.started : 0;
+    stats[name] = merged;
+  });
+
+  return stats;
+};
+
+function priorityIndex(priority) {
+  var index = Scheduler.PRIORITIES.indexOf(priority || "normal");
+
+  if (index === -1) {
+    throw new Error("[node-odbc] Unknown priority: " + priority);
+  }
+
+  return index;
+}
+
+function shift(self) {
+  for (var i = 0; i < self.classes.length; i++) {
+    if (self.classes[i].length) {
+      return self.classes[i].shift();
+    }
+  }
+
+  return null;
+}
+
+function recordWait(counter, wait) {
+  counter.started += 1;
+  counter.totalWait += wait;
+
+  if (wait > counter.maxWait) {
+    counter.maxWait = wait;
+  }
+}
+
+function expire(self, task) {
+  var err = new Error("[node-odbc] Request deadline expired before it was sent to the database");
+
+  err.code = "EDEADLINE";
+  err.waited = Date.now() - task.queued;
+
+  self.counters[task.priority].expired += 1;
+
+  if (task.onExpire) {
+    process.nextTick(function () {
+      task.onExpire(err);
+    });
+  }
+}
@@ -27,6 +27,15 @@
 #include "odbc_connection.h"
 #include "odbc_result.h"
 #include "odbc_statement.h"
+#include "odbc_executor.h"
+#include "odbc_shared_pool.h"
+#include "odbc_cache.h"
+#include "odbc_stats.h"
+#include "odbc_metrics.h"
+#include "odbc_slowlog.h"
+#include "odbc_probes.h"
+#include "odbc_text.h"
+#include "odbc_intern.h"
 
 #ifdef dynodbc
 #include "dynodbc.h"
@@ -36,24 +45,140 @@
 	#include "strptime.h"
 #endif
 
+#define ODBC_TRACE_CATEGORY TRACE_CORE
+
 using namespace v8;
 using namespace node;
 
+//the semaphores of the USDT probes, if they are compiled in
+ODBC_PROBES(ODBC_PROBE_DEFINE)
+
 uv_mutex_t ODBC::g_odbcMutex;
-uv_async_t ODBC::g_async;
 
-Persistent<FunctionTemplate> ODBC::constructor_template;
+static uv_once_t g_processOnce = UV_ONCE_INIT;
+static uv_key_t g_stateKey;
+
+static void InitProcess() {
+	// Initialize the cross platform mutex provided by libuv; it is shared by
+	// every isolate that loads the addon
+	uv_mutex_init(&ODBC::g_odbcMutex);
+	uv_key_create(&g_stateKey);
+}
+
+/*
+ * State
+ *
+ * The state of the isolate running on the calling thread. Node runs each
+ * isolate (main thread, worker_threads) on its own thread.
+ */
+ODBCState* ODBC::State() {
+	return (ODBCState *) uv_key_get(&g_stateKey);
+}
+
+/*
+ * CreateState
+ */
+ODBCState* ODBC::CreateState(v8::Isolate* isolate) {
+	uv_once(&g_processOnce, InitProcess);
+
+	ODBCState* state = State();
+
+	if (state) {
+		//loaded again in another context of the same isolate
+		return state;
+	}
+
+	DEBUG_PRINTF("ODBC::CreateState\n");
+
+	state = new ODBCState();
+	state->isolate = isolate;
+	state->groups = NULL;
+	state->waiters = NULL;
+	memset(state->histograms, 0, sizeof(state->histograms));
+#if NODE_VERSION_AT_LEAST(9, 3, 0)
+	state->loop = node::GetCurrentEventLoop(isolate);
+#else
+	state->loop = uv_default_loop();
+#endif
+
+	state->optionSql.Reset(isolate, String::NewFromUtf8(isolate, "sql"));
+	state->optionParams.Reset(isolate, String::NewFromUtf8(isolate, "params"));
+	state->optionNoResults.Reset(isolate, String::NewFromUtf8(isolate, "noResults"));
+	state->optionFetchMode.Reset(isolate, String::NewFromUtf8(isolate, "fetchMode"));
+
+#if NODE_VERSION_AT_LEAST(0, 7, 9)
+	// Initialize uv_async so that we can prevent node from exiting
+	uv_async_init(state->loop, &state->async, (uv_async_cb)ODBC::WatcherCallback);
+  
+	// Not sure if the init automatically calls uv_ref() because there is weird
+	// behavior going on. When the uv_async_t above is initialized, there seems
+	// to be a ref which will keep it alive but we only want this available so
+	// that we can uv_ref() later on when we have a connection.
+	// so to work around this, I am possibly mistakenly calling uv_unref() once
+	// so that there are no references on the loop.
+	uv_unref((uv_handle_t *)&state->async);
+#endif
+
+	uv_key_set(&g_stateKey, state);
+
+#if NODE_VERSION_AT_LEAST(10, 2, 0)
+	node::AddEnvironmentCleanupHook(isolate, ODBC::DestroyState, state);
+#else
+	node::AtExit(ODBC::DestroyState, state);
+#endif
+
+	return state;
+}
+
+static void StateCloseCallback(uv_handle_t* handle) {
+	delete (ODBCState *) handle->data;
+}
+
+/*
+ * DestroyState
+ *
+ * Cleanup hook of the environment which created the state: stops the
+ * executor threads started from it, gives up its waiting shared pool
+ * acquires, stops the trace flusher with the last environment and releases
+ * the persistent handles.
+ */
+void ODBC::DestroyState(void* arg) {
+	DEBUG_PRINTF("ODBC::DestroyState\n");
+	ODBCState* state = (ODBCState *) arg;
+
+	ODBCThreadGroup::ShutdownAll(state);
+	ODBCSharedPool::DestroyWaiters(state);
+	ODBCTrace::Shutdown();
+
+	state->odbcTemplate.Reset();
+	state->connectionTemplate.Reset();
+	state->statementTemplate.Reset();
+	state->resultTemplate.Reset();
+	state->executorTemplate.Reset();
+	state->optionSql.Reset();
+	state->optionParams.Reset();
+	state->optionNoResults.Reset();
+	state->optionFetchMode.Reset();
+
+	if (State() == state) {
+		uv_key_set(&g_stateKey, NULL);
+	}
+
+	state->async.data = state;
+	uv_close((uv_handle_t *) &state->async, StateCloseCallback);
+}
 
 void ODBC::Init(v8::Handle<Object> target) {
 	DEBUG_PRINTF("ODBC::Init\n");
 	v8::Isolate* isolate = v8::Isolate::GetCurrent();
 	v8::EscapableHandleScope scope(isolate);
+	ODBCState* state = State();
 
 	Local<FunctionTemplate> t = FunctionTemplate::New(isolate, ODBC::New);
 	//Local<FunctionTemplate> t = FunctionTemplate::New(isolate, New);
 
 	// Constructor Template
-	constructor_template.Reset(isolate, t);
+	state->odbcTemplate.Reset(isolate, t);
 	//constructor_template = Persistent<FunctionTemplate>::New(t);
 	t->SetClassName(String::NewFromUtf8(isolate, "ODBC", String::kInternalizedString));
 	//constructor_template->SetClassName(String::NewFromUtf8(isolate, "ODBC", String::kInternalizedString));
@@ -78,23 +203,8 @@ void ODBC::Init(v8::Handle<Object> target) {
 
 	// Attach the Database Constructor to the target object
 	target->Set(v8::String::NewFromUtf8(isolate, "ODBC", String::kInternalizedString), t->GetFunction());
-  
-#if NODE_VERSION_AT_LEAST(0, 7, 9)
-	// Initialize uv_async so that we can prevent node from exiting
-	uv_async_init( uv_default_loop(), &ODBC::g_async,	 (uv_async_cb)ODBC::WatcherCallback);
-  
-	// Not sure if the init automatically calls uv_ref() because there is weird
-	// behavior going on. When ODBC::Init is called which initializes the 
-	// uv_async_t g_async above, there seems to be a ref which will keep it alive
-	// but we only want this available so that we can uv_ref() later on when
-	// we have a connection.
-	// so to work around this, I am possibly mistakenly calling uv_unref() once
-	// so that there are no references on the loop.
-	uv_unref((uv_handle_t *)&ODBC::g_async);
-#endif
-  
-	// Initialize the cross platform mutex provided by libuv
-	uv_mutex_init(&ODBC::g_odbcMutex);
+
+	target->Set(String::NewFromUtf8(isolate, "createPromise"), FunctionTemplate::New(isolate, CreatePromise)->GetFunction());
 }
 
 ODBC::~ODBC() {
@@ -108,6 +218,8 @@ void ODBC::Free() {
 		uv_mutex_lock(&ODBC::g_odbcMutex);
     
 		if (m_hEnv) {
+			ODBC_COUNT_CALL(SQLFreeHandle);
+			ODBCMetrics::Handle(SQL_HANDLE_ENV, m_hEnv, -1);
 			SQLFreeHandle(SQL_HANDLE_ENV, m_hEnv);
 			m_hEnv = NULL;      
 		}
@@ -128,7 +240,9 @@ void ODBC::New(const v8::FunctionCallbackInfo<v8::Value>& args) {
   
 	uv_mutex_lock(&ODBC::g_odbcMutex);
   
+	ODBC_COUNT_CALL(SQLAllocHandle);
 	int ret = SQLAllocHandle(SQL_HANDLE_ENV, SQL_NULL_HANDLE, &dbo->m_hEnv);
+	ODBCMetrics::Handle(SQL_HANDLE_ENV, dbo->m_hEnv, 1);
   
 	uv_mutex_unlock(&ODBC::g_odbcMutex);
   
@@ -141,6 +255,7 @@ void ODBC::New(const v8::FunctionCallbackInfo<v8::Value>& args) {
 		throw objError;
 	}
   
+	ODBC_COUNT_CALL(SQLSetEnvAttr);
 	SQLSetEnvAttr(dbo->m_hEnv, SQL_ATTR_ODBC_VERSION, (SQLPOINTER) SQL_OV_ODBC3, SQL_IS_UINTEGER);
   
 	scope.Escape(args.Holder());
@@ -182,7 +297,7 @@ void ODBC::CreateConnection(const v8::FunctionCallbackInfo<v8::Value>& args) {
 
 	work_req->data = data;
 
-	uv_queue_work(uv_default_loop(), work_req, UV_CreateConnection, (uv_after_work_cb)UV_AfterCreateConnection);
+	ODBC::QueueWork(NULL, work_req, UV_CreateConnection, (uv_after_work_cb)UV_AfterCreateConnection);
 
 	dbo->Ref();
 
@@ -202,7 +317,9 @@ void ODBC::UV_CreateConnection(uv_work_t* req) {
 
 	uv_mutex_lock(&ODBC::g_odbcMutex);
 
+	ODBC_COUNT_CALL(SQLAllocHandle);
 	data->result = SQLAllocHandle(SQL_HANDLE_DBC, data->dbo->m_hEnv, &data->hDBC);
+	ODBCMetrics::Handle(SQL_HANDLE_DBC, data->hDBC, 1);
 
 	uv_mutex_unlock(&ODBC::g_odbcMutex);
 }
@@ -230,7 +347,7 @@ void ODBC::UV_AfterCreateConnection(uv_work_t* req, int status) {
 		args[0] = External::New(isolate, data->dbo->m_hEnv);
 		args[1] = External::New(isolate, data->hDBC);
     
-		v8::Local<v8::FunctionTemplate> ft = v8::Local<v8::FunctionTemplate>::New(isolate, ODBCConnection::constructor_template);
+		v8::Local<v8::FunctionTemplate> ft = v8::Local<v8::FunctionTemplate>::New(isolate, ODBC::State()->connectionTemplate);
 		Local<Object> js_result = ft->GetFunction()->NewInstance(2, args);
 
 		args[0] = Local<Value>::New(isolate, Null(isolate));
@@ -266,7 +383,9 @@ void ODBC::CreateConnectionSync(const v8::FunctionCallbackInfo<v8::Value>& args)
 	uv_mutex_lock(&ODBC::g_odbcMutex);
   
 	//allocate a new connection handle
+	ODBC_COUNT_CALL(SQLAllocHandle);
 	SQLRETURN ret = SQLAllocHandle(SQL_HANDLE_DBC, dbo->m_hEnv, &hDBC);
+	ODBCMetrics::Handle(SQL_HANDLE_DBC, hDBC, 1);
   
 	if (!SQL_SUCCEEDED(ret)) {
 		DEBUG_PRINTF("ODBC::CreateConnectionSync error\n");
@@ -279,7 +398,7 @@ void ODBC::CreateConnectionSync(const v8::FunctionCallbackInfo<v8::Value>& args)
 	params[0] = External::New(isolate, dbo->m_hEnv);
 	params[1] = External::New(isolate, hDBC);
 
-	v8::Local<v8::FunctionTemplate> ft = v8::Local<v8::FunctionTemplate>::New(isolate, ODBCConnection::constructor_template);
+	v8::Local<v8::FunctionTemplate> ft = v8::Local<v8::FunctionTemplate>::New(isolate, ODBC::State()->connectionTemplate);
 	Local<Object> js_result = ft->GetFunction()->NewInstance(2, params);
 
 	DEBUG_PRINTF("ODBC::CreateConnectionSync End\n");
@@ -289,7 +408,7 @@ void ODBC::CreateConnectionSync(const v8::FunctionCallbackInfo<v8::Value>& args)
 /*
  * GetColumns
  */
-Column* ODBC::GetColumns(SQLHSTMT hStmt, short* colCount) {
+Column* ODBC::GetColumns(SQLHSTMT hStmt, short* colCount, bool utf8) {
 	SQLRETURN ret;
 	SQLSMALLINT buflen;
 
@@ -297,6 +416,7 @@ Column* ODBC::GetColumns(SQLHSTMT hStmt, short* colCount) {
 	*colCount = 0; 
 
 	//get the number of columns in the result set
+	ODBC_COUNT_CALL(SQLNumResultCols);
 	ret = SQLNumResultCols(hStmt, colCount);
   
 	if (!SQL_SUCCEEDED(ret)) {
@@ -308,6 +428,8 @@ Column* ODBC::GetColumns(SQLHSTMT hStmt, short* colCount) {
 	for (int i = 0; i < *colCount; i++) {
 		//save the index number of this column
 		columns[i].index = i + 1;
+		columns[i].utf8 = utf8;
+		columns[i].intern = NULL;
 		//TODO:that's a lot of memory for each field name....
 		columns[i].name = new unsigned char[MAX_FIELD_SIZE];
     
@@ -315,6 +437,7 @@ Column* ODBC::GetColumns(SQLHSTMT hStmt, short* colCount) {
 		columns[i].name[0] = '\0';
     
 		//get the column name
+		ODBC_COUNT_CALL(SQLColAttribute);
 		ret = SQLColAttribute(hStmt,
 			columns[i].index,
 #ifdef STRICT_COLUMN_NAMES
@@ -331,6 +454,7 @@ Column* ODBC::GetColumns(SQLHSTMT hStmt, short* colCount) {
 		columns[i].len = buflen;
     
 		//get the column type and store it directly in column[i].type
+		ODBC_COUNT_CALL(SQLColAttribute);
 		ret = SQLColAttribute(hStmt,
 			columns[i].index,
 			SQL_DESC_TYPE,
@@ -349,6 +473,7 @@ Column* ODBC::GetColumns(SQLHSTMT hStmt, short* colCount) {
 void ODBC::FreeColumns(Column* columns, short* colCount) {
 	for(int i = 0; i < *colCount; i++) {
 		delete [] columns[i].name;
+		delete columns[i].intern;
 	}
 
 	delete [] columns;
@@ -356,6 +481,152 @@ void ODBC::FreeColumns(Column* columns, short* colCount) {
 	*colCount = 0;
 }
 
+/*
+ * GetUTF8ColumnValue
+ *
+ * Text of a column of a connection opened with encoding 'utf8'. Chunks of
+ * a long value may end in the middle of a character, so they are only
+ * decoded once all of them have been read.
+ */
+static Handle<Value> GetUTF8ColumnValue(SQLHSTMT hStmt, Column column, uint16_t* buffer, int bufferLength) {
+	v8::Isolate* isolate = v8::Isolate::GetCurrent();
+	v8::EscapableHandleScope scope(isolate);
+
+	char* chunk = (char *) buffer;
+	char* value = NULL;
+	size_t length = 0;
+	int count = 0;
+	SQLLEN len = 0;
+	SQLRETURN ret;
+
+	do {
+		ODBC_COUNT_CALL(SQLGetData);
+		ret = SQLGetData(hStmt, column.index, SQL_C_CHAR, chunk, bufferLength, &len);
+		ODBCMetrics::Decoded(ret, len);
+
+		DEBUG_PRINTF("GetUTF8ColumnValue: index=%i type=%i len=%lld ret=%i\n", column.index, (int) column.type, (long long) len, ret);
+
+		if ((len == SQL_NULL_DATA && count == 0) || ret == SQL_NO_DATA) {
+			break;
+		}
+
+		if (!SQL_SUCCEEDED(ret)) {
+			free(value);
+
+			return isolate->ThrowException(ODBC::GetSQLError(SQL_HANDLE_STMT, hStmt, (char *) "[node-odbc] Error in ODBC::GetColumnValue"));
+		}
+
+		size_t chunkLength = strlen(chunk);
+
+		count += 1;
+
+		//the whole value fit in the buffer: no copy
+		if (count == 1 && (ret == SQL_SUCCESS || len == 0)) {
+			if (column.intern) {
+				return scope.Escape(column.intern->Get(isolate, chunk, (int) chunkLength, true));
+			}
+
+			return scope.Escape(String::NewFromUtf8(isolate, chunk, String::kNormalString, (int) chunkLength));
+		}
+
+		value = (char *) realloc(value, length + chunkLength);
+		memcpy(value + length, chunk, chunkLength);
+		length += chunkLength;
+
+		if (len == 0 || ret == SQL_SUCCESS) {
+			break;
+		}
+	} while (true);
+
+	if (count == 0) {
+		return scope.Escape(Local<Value>(Null(isolate)));
+	}
+
+	Local<String> str = String::NewFromUtf8(isolate, value, String::kNormalString, (int) length);
+
+	free(value);
+
+	return scope.Escape(str);
+}
+
+#ifdef UNICODE
+/*
+ * GetWideColumnValue
+ *
+ * Text of a column fetched as UTF-16. A value which fits in the buffer is
+ * converted from it; the chunks of a longer one are collected in a native
+ * buffer which the string adopts, so that large values can stay outside
+ * of the V8 heap (see ODBCText::AdoptString).
+ */
+static Handle<Value> GetWideColumnValue(SQLHSTMT hStmt, Column column, uint16_t* buffer, int bufferLength) {
+	v8::Isolate* isolate = v8::Isolate::GetCurrent();
+	v8::EscapableHandleScope scope(isolate);
+
+	uint16_t* value = NULL;
+	int length = 0;
+	int count = 0;
+	SQLLEN len = 0;
+	SQLRETURN ret;
+
+	do {
+		ODBC_COUNT_CALL(SQLGetData);
+		ret = SQLGetData(hStmt, column.index, SQL_C_TCHAR, (char *) buffer, bufferLength, &len);
+		ODBCMetrics::Decoded(ret, len);
+
+		DEBUG_PRINTF("GetWideColumnValue: index=%i type=%i len=%lld ret=%i\n", column.index, (int) column.type, (long long) len, ret);
+
+		if ((len == SQL_NULL_DATA && count == 0) || ret == SQL_NO_DATA) {
+			break;
+		}
+
+		if (!SQL_SUCCEEDED(ret)) {
+			free(value);
+
+			return isolate->ThrowException(ODBC::GetSQLError(SQL_HANDLE_STMT, hStmt, (char *) "[node-odbc] Error in ODBC::GetColumnValue"));
+		}
+
+		count += 1;
+
+		//the whole value fit in the buffer
+		if (count == 1 && (ret == SQL_SUCCESS || len == 0)) {
+			int chars = (len >= 0) ? (int) (len / sizeof(uint16_t)) : -1;
+
+			if (column.intern) {
+				if (chars < 0) {
+					for (chars = 0; buffer[chars]; chars++) {
+					}
+				}
+
+				return scope.Escape(column.intern->Get(isolate, buffer, chars * sizeof(uint16_t), false));
+			}
+
+			return scope.Escape(ODBCText::NewString(isolate, buffer, chars));
+		}
+
+		//a full buffer is null terminated wherever the driver cut it
+		int chunkLength = 0;
+
+		while (buffer[chunkLength]) {
+			chunkLength++;
+		}
+
+		value = (uint16_t *) realloc(value, (length + chunkLength) * sizeof(uint16_t));
+		memcpy(value + length, buffer, chunkLength * sizeof(uint16_t));
+		length += chunkLength;
+
+		if (len == 0 || ret == SQL_SUCCESS) {
+			break;
+		}
+	} while (true);
+
+	if (count == 0) {
+		return scope.Escape(Local<Value>(Null(isolate)));
+	}
+
+	return scope.Escape(ODBCText::AdoptString(isolate, value, length));
+}
+#endif
+
 /*
  * GetColumnValue
  */
@@ -377,9 +648,11 @@ Handle<Value> ODBC::GetColumnValue(SQLHSTMT hStmt, Column column, uint16_t* buff
 		case SQL_TINYINT : {
 			long value;
         
+			ODBC_COUNT_CALL(SQLGetData);
 			ret = SQLGetData(hStmt, column.index, SQL_C_SLONG, &value, sizeof(value), &len);
+			ODBCMetrics::Decoded(ret, len);
         
-			DEBUG_PRINTF("ODBC::GetColumnValue - Integer: index=%i name=%s type=%i len=%i ret=%i\n", column.index, column.name, column.type, len, ret);
+			DEBUG_PRINTF("ODBC::GetColumnValue - Integer: index=%i name=%s type=%i len=%lld ret=%i\n", column.index, column.name, (int) column.type, (long long) len, ret);
         
 			if (len == SQL_NULL_DATA) {
 				return Null(isolate);
@@ -400,9 +673,11 @@ Handle<Value> ODBC::GetColumnValue(SQLHSTMT hStmt, Column column, uint16_t* buff
 		case SQL_DOUBLE : {
 			double value;
         
+			ODBC_COUNT_CALL(SQLGetData);
 			ret = SQLGetData(hStmt, column.index, SQL_C_DOUBLE, &value, sizeof(value), &len);
+			ODBCMetrics::Decoded(ret, len);
         
-			DEBUG_PRINTF("ODBC::GetColumnValue - Number: index=%i name=%s type=%i len=%i ret=%i val=%f\n", column.index, column.name, column.type, len, ret, value);
+			DEBUG_PRINTF("ODBC::GetColumnValue - Number: index=%i name=%s type=%i len=%lld ret=%i val=%f\n", column.index, column.name, (int) column.type, (long long) len, ret, value);
         
 			if (len == SQL_NULL_DATA) {
 				return Null(isolate);
@@ -422,9 +697,11 @@ Handle<Value> ODBC::GetColumnValue(SQLHSTMT hStmt, Column column, uint16_t* buff
 #ifdef _WIN32
 			struct tm timeInfo = {};
 
+			ODBC_COUNT_CALL(SQLGetData);
 			ret = SQLGetData(hStmt, column.index, SQL_C_CHAR, (char *) buffer, bufferLength, &len);
+			ODBCMetrics::Decoded(ret, len);
 
-			DEBUG_PRINTF("ODBC::GetColumnValue - W32 Timestamp: index=%i name=%s type=%i len=%i\n", column.index, column.name, column.type, len);
+			DEBUG_PRINTF("ODBC::GetColumnValue - W32 Timestamp: index=%i name=%s type=%i len=%lld\n", column.index, column.name, (int) column.type, (long long) len);
 
 			if (len == SQL_NULL_DATA) {
 				return Null(isolate);
@@ -462,9 +739,11 @@ Handle<Value> ODBC::GetColumnValue(SQLHSTMT hStmt, Column column, uint16_t* buff
 
 			SQL_TIMESTAMP_STRUCT odbcTime;
       
+			ODBC_COUNT_CALL(SQLGetData);
 			ret = SQLGetData(hStmt, column.index, SQL_C_TYPE_TIMESTAMP, &odbcTime, bufferLength, &len);
+			ODBCMetrics::Decoded(ret, len);
 
-			DEBUG_PRINTF("ODBC::GetColumnValue - Unix Timestamp: index=%i name=%s type=%i len=%i\n", column.index, column.name, column.type, len);
+			DEBUG_PRINTF("ODBC::GetColumnValue - Unix Timestamp: index=%i name=%s type=%i len=%lld\n", column.index, column.name, (int) column.type, (long long) len);
 
 			if (len == SQL_NULL_DATA) {
 				return Null(isolate);
@@ -496,9 +775,11 @@ Handle<Value> ODBC::GetColumnValue(SQLHSTMT hStmt, Column column, uint16_t* buff
 		case SQL_BIT :
 			//again, i'm not sure if this is cross database safe, but it works for 
 			//MSSQL
+			ODBC_COUNT_CALL(SQLGetData);
 			ret = SQLGetData(hStmt, column.index, SQL_C_CHAR, (char *) buffer, bufferLength, &len);
+			ODBCMetrics::Decoded(ret, len);
 
-			DEBUG_PRINTF("ODBC::GetColumnValue - Bit: index=%i name=%s type=%i len=%i\n", column.index, column.name, column.type, len);
+			DEBUG_PRINTF("ODBC::GetColumnValue - Bit: index=%i name=%s type=%i len=%lld\n", column.index, column.name, (int) column.type, (long long) len);
 
 			if (len == SQL_NULL_DATA) {
 				return Null(isolate);
@@ -511,13 +792,21 @@ Handle<Value> ODBC::GetColumnValue(SQLHSTMT hStmt, Column column, uint16_t* buff
 				//return Boolean::New(( *buffer == '0') ? false : true );
 			}
 		default :
+			if (column.utf8) {
+				return scope.Escape(GetUTF8ColumnValue(hStmt, column, buffer, bufferLength));
+			}
+#ifdef UNICODE
+			return scope.Escape(GetWideColumnValue(hStmt, column, buffer, bufferLength));
+#else
 			Local<String> str;
 			int count = 0;
       
 			do {
+				ODBC_COUNT_CALL(SQLGetData);
 				ret = SQLGetData(hStmt, column.index, SQL_C_TCHAR, (char *) buffer, bufferLength, &len);
+				ODBCMetrics::Decoded(ret, len);
 
-				DEBUG_PRINTF("ODBC::GetColumnValue - String: index=%i name=%s type=%i len=%i value=%s ret=%i bufferLength=%i\n", column.index, column.name, column.type, len, (char *)buffer, ret, bufferLength);
+				DEBUG_PRINTF("ODBC::GetColumnValue - String: index=%i name=%s type=%i len=%lld value=%s ret=%i bufferLength=%i\n", column.index, column.name, (int) column.type, (long long) len, (char *)buffer, ret, bufferLength);
 
 				if (len == SQL_NULL_DATA && str.IsEmpty()) {
 					return Null(isolate);
@@ -538,19 +827,11 @@ Handle<Value> ODBC::GetColumnValue(SQLHSTMT hStmt, Column column, uint16_t* buff
 					//we have not captured all of the data yet
 					if (count == 0) {
 						//no concatenation required, this is our first pass
-#ifdef UNICODE
-						str = String::NewFromTwoByte(isolate, (uint16_t *)buffer);
-#else
 						str = String::NewFromUtf8(isolate, (char *)buffer);
-#endif
 					}
 					else {
 						//we need to concatenate
-#ifdef UNICODE
-						str = String::Concat(str, String::NewFromTwoByte(isolate, (uint16_t *)buffer));
-#else
 						str = String::Concat(str, String::NewFromUtf8(isolate, (char *)buffer));
-#endif
 					}
           
 					//if len is zero let's break out of the loop now and not attempt to
@@ -582,6 +863,7 @@ Handle<Value> ODBC::GetColumnValue(SQLHSTMT hStmt, Column column, uint16_t* buff
      
 			return scope.Escape(str);
 			//return str;
+#endif
 	}
 }
 
@@ -628,140 +910,940 @@ Handle<Value> ODBC::GetRecordArray(SQLHSTMT hStmt, Column* columns, short* colCo
 }
 
 /*
- * GetParametersFromArray
+ * RowSetWrite
  */
-Parameter* ODBC::GetParametersFromArray (Local<Array> values, int *paramCount) {
-	DEBUG_PRINTF("ODBC::GetParametersFromArray\n");
-	*paramCount = values->Length();
-  
-	Parameter* params = NULL;
-  
-	if (*paramCount > 0) {
-		params = (Parameter *) malloc(*paramCount * sizeof(Parameter));
-	}
-  
-	for (int i = 0; i < *paramCount; i++) {
-		Local<Value> value = values->Get(i);
-    
-		params[i].ColumnSize       = 0;
-		params[i].StrLen_or_IndPtr = SQL_NULL_DATA;
-		params[i].BufferLength     = 0;
-		params[i].DecimalDigits    = 0;
+//grow the rowset by length bytes and return a pointer to them
+static char* RowSetReserve(RowSet* rowSet, size_t length) {
+	if (rowSet->length + length > rowSet->capacity) {
+		size_t capacity = rowSet->capacity ? rowSet->capacity : 4096;
 
-		DEBUG_PRINTF("ODBC::GetParametersFromArray - &param[%i].length = %X\n", i, &params[i].StrLen_or_IndPtr);
+		while (capacity < rowSet->length + length) {
+			capacity *= 2;
+		}
 
-		if (value->IsString()) {
-			Local<String> string = value->ToString();
-			int length = string->Length();
-      
-			params[i].ValueType         = SQL_C_TCHAR;
-			params[i].ColumnSize        = 0; //SQL_SS_LENGTH_UNLIMITED 
-#ifdef UNICODE
-			params[i].ParameterType     = SQL_WVARCHAR;
-			params[i].BufferLength      = (length * sizeof(uint16_t)) + sizeof(uint16_t);
-#else
-			params[i].ParameterType     = SQL_VARCHAR;
-			params[i].BufferLength      = string->Utf8Length() + 1;
-#endif
-			params[i].ParameterValuePtr = malloc(params[i].BufferLength);
-			params[i].StrLen_or_IndPtr  = SQL_NTS;//params[i].BufferLength;
+		rowSet->data = (char *) realloc(rowSet->data, capacity);
+		rowSet->capacity = capacity;
+	}
 
-#ifdef UNICODE
-			string->Write((uint16_t *) params[i].ParameterValuePtr);
-#else
-			string->WriteUtf8((char *) params[i].ParameterValuePtr);
-#endif
+	char* start = rowSet->data + rowSet->length;
 
-			DEBUG_PRINTF("ODBC::GetParametersFromArray - IsString(): params[%i] c_type=%i type=%i buffer_length=%i size=%i length=%i value=%s\n", i, params[i].ValueType, params[i].ParameterType,
-				params[i].BufferLength, params[i].ColumnSize, params[i].StrLen_or_IndPtr, 
-				(char*) params[i].ParameterValuePtr);
-		}
-		else if (value->IsNull()) {
-			params[i].ValueType = SQL_C_DEFAULT;
-			params[i].ParameterType   = SQL_VARCHAR;
-			params[i].StrLen_or_IndPtr = SQL_NULL_DATA;
+	rowSet->length += length;
 
-			DEBUG_PRINTF("ODBC::GetParametersFromArray - IsNull(): params[%i] c_type=%i type=%i buffer_length=%i size=%i length=%i\n",
-				i, params[i].ValueType, params[i].ParameterType,
-				params[i].BufferLength, params[i].ColumnSize, params[i].StrLen_or_IndPtr);
-		}
-		else if (value->IsInt32()) {
-			int64_t  *number = new int64_t(value->IntegerValue());
-			params[i].ValueType = SQL_C_SBIGINT;
-			params[i].ParameterType   = SQL_BIGINT;
-			params[i].ParameterValuePtr = number;
-			params[i].StrLen_or_IndPtr = 0;
-      
-			DEBUG_PRINTF("ODBC::GetParametersFromArray - IsInt32(): params[%i] c_type=%i type=%i buffer_length=%i size=%i length=%i value=%lld\n", i, params[i].ValueType, params[i].ParameterType,
-				params[i].BufferLength, params[i].ColumnSize, params[i].StrLen_or_IndPtr,
-				*number);
-		}
-		else if (value->IsNumber()) {
-			double *number   = new double(value->NumberValue());
-      
-			params[i].ValueType         = SQL_C_DOUBLE;
-			params[i].ParameterType     = SQL_DECIMAL;
-			params[i].ParameterValuePtr = number;
-			params[i].BufferLength      = sizeof(double);
-			params[i].StrLen_or_IndPtr  = params[i].BufferLength;
-			params[i].DecimalDigits     = 7;
-			params[i].ColumnSize        = sizeof(double);
+	return start;
+}
 
-			DEBUG_PRINTF("ODBC::GetParametersFromArray - IsNumber(): params[%i] c_type=%i type=%i buffer_length=%i size=%i length=%i value=%f\n",
-				i, params[i].ValueType, params[i].ParameterType,
-				params[i].BufferLength, params[i].ColumnSize, params[i].StrLen_or_IndPtr,
-				*number);
-		}
-		else if (value->IsBoolean()) {
-			bool *boolean = new bool(value->BooleanValue());
-			params[i].ValueType         = SQL_C_BIT;
-			params[i].ParameterType     = SQL_BIT;
-			params[i].ParameterValuePtr = boolean;
-			params[i].StrLen_or_IndPtr  = 0;
-      
-			DEBUG_PRINTF("ODBC::GetParametersFromArray - IsBoolean(): params[%i] c_type=%i type=%i buffer_length=%i size=%i length=%i\n",
-				i, params[i].ValueType, params[i].ParameterType,
-				params[i].BufferLength, params[i].ColumnSize, params[i].StrLen_or_IndPtr);
-		}
-	} 
-  
-	return params;
+static void RowSetWrite(RowSet* rowSet, const void* data, size_t length) {
+	memcpy(RowSetReserve(rowSet, length), data, length);
+}
+
+static void RowSetWriteTag(RowSet* rowSet, uint8_t tag) {
+	RowSetWrite(rowSet, &tag, sizeof(tag));
 }
 
 /*
- * CallbackSQLError
+ * RowSetGetUTF8Cell
+ *
+ * RowSetGetCell for the text of a connection opened with encoding 'utf8':
+ * the bytes are stored as they come and decoded on the main thread.
  */
+static SQLRETURN RowSetGetUTF8Cell(SQLHSTMT hStmt, Column column, uint16_t* buffer, int bufferLength, RowSet* rowSet) {
+	size_t start = rowSet->length;
+	char* chunk = (char *) buffer;
+	uint32_t length = 0;
+	int count = 0;
+	SQLLEN len = 0;
+	SQLRETURN ret;
 
-Handle<Value> ODBC::CallbackSQLError(SQLSMALLINT handleType, SQLHANDLE handle, Persistent<Function, CopyablePersistentTraits<v8::Function>> cb) {
-	v8::Isolate* isolate = v8::Isolate::GetCurrent();
-	v8::EscapableHandleScope scope(isolate);
+	//the length is patched in once all of the chunks have been read
+	RowSetWriteTag(rowSet, ROWSET_CHARS);
+	RowSetWrite(rowSet, &length, sizeof(length));
 
-	return CallbackSQLError(handleType, handle, (char *) "[node-odbc] SQL_ERROR", cb);
-	//return scope.Close(CallbackSQLError(handleType, handle, (char *) "[node-odbc] SQL_ERROR", cb));
-}
+	do {
+		ODBC_COUNT_CALL(SQLGetData);
+		ret = SQLGetData(hStmt, column.index, SQL_C_CHAR, chunk, bufferLength, &len);
+		ODBCMetrics::Decoded(ret, len);
 
-Handle<Value> ODBC::CallbackSQLError(SQLSMALLINT handleType, SQLHANDLE handle, char* message, Persistent<Function, CopyablePersistentTraits<v8::Function>> cb) {
-	v8::Isolate* isolate = v8::Isolate::GetCurrent();
-	v8::EscapableHandleScope scope(isolate);
+		if ((len == SQL_NULL_DATA && count == 0) || ret == SQL_NO_DATA) {
+			break;
+		}
 
-	Local<Object> objError = ODBC::GetSQLError(handleType, handle, message);
-  
-	Local<Value> args[1];
-	args[0] = objError;
+		if (!SQL_SUCCEEDED(ret)) {
+			rowSet->length = start;
 
-	v8::Local<v8::Function> f = v8::Local<v8::Function>::New(isolate, cb);
-	f->Call(isolate->GetCurrentContext()->Global(), 1, args);
+			return ret;
+		}
 
-	return Undefined(isolate);
-	//return scope.Close(Undefined());
+		size_t chunkLength = strlen(chunk);
+
+		RowSetWrite(rowSet, chunk, chunkLength);
+		length += chunkLength;
+		count += 1;
+
+		if (len == 0 || ret == SQL_SUCCESS) {
+			break;
+		}
+	} while (true);
+
+	if (count == 0) {
+		rowSet->length = start;
+		RowSetWriteTag(rowSet, ROWSET_NULL);
+	}
+	else {
+		memcpy(rowSet->data + start + 1, &length, sizeof(length));
+	}
+
+	return SQL_SUCCESS;
 }
 
 /*
- * GetSQLError
+ * RowSetGetCell
+ *
+ * Worker thread counterpart of GetColumnValue: reads one column of the
+ * current row into the rowset instead of creating a JS value.
  */
-Local<Object> ODBC::GetSQLError (SQLSMALLINT handleType, SQLHANDLE handle) {
-	v8::Isolate* isolate = v8::Isolate::GetCurrent();
-	v8::EscapableHandleScope scope(isolate);
+static SQLRETURN RowSetGetCell(SQLHSTMT hStmt, Column column, uint16_t* buffer, int bufferLength, RowSet* rowSet) {
+	SQLLEN len = 0;
+	SQLRETURN ret;
+
+	buffer[0] = '\0';
+
+	switch ((int) column.type) {
+		case SQL_INTEGER :
+		case SQL_SMALLINT :
+		case SQL_TINYINT : {
+			SQLINTEGER value = 0;
+
+			ODBC_COUNT_CALL(SQLGetData);
+			ret = SQLGetData(hStmt, column.index, SQL_C_SLONG, &value, sizeof(value), &len);
+			ODBCMetrics::Decoded(ret, len);
+
+			if (!SQL_SUCCEEDED(ret)) {
+				return ret;
+			}
+
+			if (len == SQL_NULL_DATA) {
+				RowSetWriteTag(rowSet, ROWSET_NULL);
+			}
+			else {
+				int32_t cell = (int32_t) value;
+
+				RowSetWriteTag(rowSet, ROWSET_INTEGER);
+				RowSetWrite(rowSet, &cell, sizeof(cell));
+			}
+		}
+		break;
+		case SQL_NUMERIC :
+		case SQL_DECIMAL :
+		case SQL_BIGINT :
+		case SQL_FLOAT :
+		case SQL_REAL :
+		case SQL_DOUBLE : {
+			double value = 0;
+
+			ODBC_COUNT_CALL(SQLGetData);
+			ret = SQLGetData(hStmt, column.index, SQL_C_DOUBLE, &value, sizeof(value), &len);
+			ODBCMetrics::Decoded(ret, len);
+
+			if (!SQL_SUCCEEDED(ret)) {
+				return ret;
+			}
+
+			if (len == SQL_NULL_DATA) {
+				RowSetWriteTag(rowSet, ROWSET_NULL);
+			}
+			else {
+				RowSetWriteTag(rowSet, ROWSET_NUMBER);
+				RowSetWrite(rowSet, &value, sizeof(value));
+			}
+		}
+		break;
+		case SQL_DATETIME :
+		case SQL_TIMESTAMP : {
+#ifdef _WIN32
+			struct tm timeInfo = {};
+
+			ODBC_COUNT_CALL(SQLGetData);
+			ret = SQLGetData(hStmt, column.index, SQL_C_CHAR, (char *) buffer, bufferLength, &len);
+			ODBCMetrics::Decoded(ret, len);
+
+			if (!SQL_SUCCEEDED(ret)) {
+				return ret;
+			}
+
+			if (len == SQL_NULL_DATA) {
+				RowSetWriteTag(rowSet, ROWSET_NULL);
+			}
+			else if (strptime((char *) buffer, "%Y-%m-%d %H:%M:%S", &timeInfo)) {
+				timeInfo.tm_isdst = -1;
+
+				double value = double(mktime(&timeInfo)) * 1000;
+
+				RowSetWriteTag(rowSet, ROWSET_DATE);
+				RowSetWrite(rowSet, &value, sizeof(value));
+			}
+			else {
+				uint32_t length = (uint32_t) strlen((char *) buffer);
+
+				RowSetWriteTag(rowSet, ROWSET_CHARS);
+				RowSetWrite(rowSet, &length, sizeof(length));
+				RowSetWrite(rowSet, buffer, length);
+			}
+#else
+			struct tm timeInfo = {};
+			SQL_TIMESTAMP_STRUCT odbcTime;
+
+			ODBC_COUNT_CALL(SQLGetData);
+			ret = SQLGetData(hStmt, column.index, SQL_C_TYPE_TIMESTAMP, &odbcTime, bufferLength, &len);
+			ODBCMetrics::Decoded(ret, len);
+
+			if (!SQL_SUCCEEDED(ret)) {
+				return ret;
+			}
+
+			if (len == SQL_NULL_DATA) {
+				RowSetWriteTag(rowSet, ROWSET_NULL);
+			}
+			else {
+				timeInfo.tm_year = odbcTime.year - 1900;
+				timeInfo.tm_mon = odbcTime.month - 1;
+				timeInfo.tm_mday = odbcTime.day;
+				timeInfo.tm_hour = odbcTime.hour;
+				timeInfo.tm_min = odbcTime.minute;
+				timeInfo.tm_sec = odbcTime.second;
+				timeInfo.tm_isdst = -1;
+#ifdef TIMEGM
+				double value = (double(timegm(&timeInfo)) * 1000) + (odbcTime.fraction / 1000000);
+#else
+				double value = (double(timelocal(&timeInfo)) * 1000) + (odbcTime.fraction / 1000000);
+#endif
+				RowSetWriteTag(rowSet, ROWSET_DATE);
+				RowSetWrite(rowSet, &value, sizeof(value));
+			}
+#endif
+		}
+		break;
+		case SQL_BIT : {
+			ODBC_COUNT_CALL(SQLGetData);
+			ret = SQLGetData(hStmt, column.index, SQL_C_CHAR, (char *) buffer, bufferLength, &len);
+			ODBCMetrics::Decoded(ret, len);
+
+			if (!SQL_SUCCEEDED(ret)) {
+				return ret;
+			}
+
+			if (len == SQL_NULL_DATA) {
+				RowSetWriteTag(rowSet, ROWSET_NULL);
+			}
+			else {
+				uint8_t value = (*((char *) buffer) == '0') ? 0 : 1;
+
+				RowSetWriteTag(rowSet, ROWSET_BOOLEAN);
+				RowSetWrite(rowSet, &value, sizeof(value));
+			}
+		}
+		break;
+		default : {
+			if (column.utf8) {
+				return RowSetGetUTF8Cell(hStmt, column, buffer, bufferLength, rowSet);
+			}
+
+			size_t start = rowSet->length;
+			uint32_t length = 0;
+			int count = 0;
+#ifdef UNICODE
+			size_t maxUnits = bufferLength / sizeof(uint16_t);
+#else
+			size_t maxUnits = bufferLength;
+#endif
+
+			//the length is patched in once all of the chunks have been read
+			RowSetWriteTag(rowSet, ROWSET_STRING);
+			RowSetWrite(rowSet, &length, sizeof(length));
+
+			if (rowSet->length % 2) {
+				RowSetWriteTag(rowSet, 0);
+			}
+
+			do {
+				ODBC_COUNT_CALL(SQLGetData);
+				ret = SQLGetData(hStmt, column.index, SQL_C_TCHAR, (char *) buffer, bufferLength, &len);
+				ODBCMetrics::Decoded(ret, len);
+
+				if (len == SQL_NULL_DATA && count == 0) {
+					break;
+				}
+
+				if (ret == SQL_NO_DATA) {
+					break;
+				}
+
+				if (!SQL_SUCCEEDED(ret)) {
+					rowSet->length = start;
+
+					return ret;
+				}
+
+				//same semantics as GetColumnValue: each chunk is NUL terminated
+				size_t units = 0;
+#ifdef UNICODE
+				while (units < maxUnits && buffer[units] != 0) {
+					units++;
+				}
+
+				RowSetWrite(rowSet, buffer, units * sizeof(uint16_t));
+#else
+				while (units < maxUnits && ((char *) buffer)[units] != 0) {
+					units++;
+				}
+
+				RowSetWrite(rowSet, buffer, units);
+#endif
+				length += units;
+				count += 1;
+
+				//SQL_SUCCESS means the driver returned everything that was
+				//left, so there is no need for another round trip
+				if (len == 0 || ret == SQL_SUCCESS) {
+					break;
+				}
+			} while (true);
+
+			if (count == 0) {
+				//same as GetColumnValue: nothing was returned at all
+				rowSet->length = start;
+				RowSetWriteTag(rowSet, ROWSET_NULL);
+			}
+			else {
+				memcpy(rowSet->data + start + 1, &length, sizeof(length));
+			}
+
+			ret = SQL_SUCCESS;
+		}
+	}
+
+	return ret;
+}
+
+/*
+ * FetchRowSet
+ *
+ * Fetch up to maxRows rows (all of them when maxRows <= 0) from hStmt into a
+ * new RowSet. This does not touch V8 and is meant to be called on a worker
+ * thread. When columns is NULL the result set is described here, with text
+ * in UTF-8 if utf8 is set, and the rowset owns the columns. rowSet->result
+ * is SQL_NO_DATA when the end of the result set was reached and SQL_ERROR if
+ * a fetch failed.
+ */
+RowSet* ODBC::FetchRowSet(SQLHSTMT hStmt, Column* columns, short colCount, uint16_t* buffer, int bufferLength, int maxRows, bool utf8) {
+	DEBUG_PRINTF("ODBC::FetchRowSet maxRows=%i\n", maxRows);
+
+	RowSet* rowSet = (RowSet *) calloc(1, sizeof(RowSet));
+
+	if (columns == NULL) {
+		columns = GetColumns(hStmt, &colCount, utf8);
+		rowSet->ownsColumns = true;
+	}
+
+	rowSet->columns = columns;
+	rowSet->colCount = colCount;
+	rowSet->affectedRows = -1;
+	rowSet->result = SQL_SUCCESS;
+
+	if (colCount == 0) {
+		//not a query; report how many rows were changed instead
+		ODBC_COUNT_CALL(SQLRowCount);
+		SQLRowCount(hStmt, &rowSet->affectedRows);
+		rowSet->result = SQL_NO_DATA;
+
+		return rowSet;
+	}
+
+	while (maxRows <= 0 || rowSet->rowCount < maxRows) {
+		ODBC_COUNT_CALL(SQLFetch);
+		SQLRETURN ret = SQLFetch(hStmt);
+		ODBCMetrics::Fetched(ret);
+
+		if (ret == SQL_NO_DATA || ret == SQL_ERROR || ret == SQL_INVALID_HANDLE) {
+			rowSet->result = (ret == SQL_NO_DATA) ? SQL_NO_DATA : SQL_ERROR;
+			break;
+		}
+
+		size_t rowStart = rowSet->length;
+
+		for (int i = 0; i < colCount; i++) {
+			ret = RowSetGetCell(hStmt, columns[i], buffer, bufferLength, rowSet);
+
+			if (!SQL_SUCCEEDED(ret)) {
+				break;
+			}
+		}
+
+		if (!SQL_SUCCEEDED(ret)) {
+			//drop the partial row; the diagnostics stay on hStmt
+			rowSet->length = rowStart;
+			rowSet->result = SQL_ERROR;
+			break;
+		}
+
+		rowSet->rowCount++;
+	}
+
+	return rowSet;
+}
+
+/*
+ * RowSetToArray
+ *
+ * Turn a RowSet into an array of objects or arrays, depending on fetchMode.
+ * Must be called on the event loop thread.
+ */
+Local<Array> ODBC::RowSetToArray(RowSet* rowSet, int fetchMode) {
+	v8::Isolate* isolate = v8::Isolate::GetCurrent();
+	v8::EscapableHandleScope scope(isolate);
+
+	Local<Array> rows = Array::New(isolate, rowSet->rowCount);
+	Local<String>* names = NULL;
+
+	if (fetchMode != FETCH_ARRAY) {
+		//create the keys once for the whole rowset instead of once per row
+		names = new Local<String>[rowSet->colCount];
+
+		for (int i = 0; i < rowSet->colCount; i++) {
+#ifdef UNICODE
+			names[i] = String::NewFromTwoByte(isolate, (uint16_t *) rowSet->columns[i].name);
+#else
+			names[i] = String::NewFromUtf8(isolate, (const char *) rowSet->columns[i].name);
+#endif
+		}
+	}
+
+	const char* cursor = rowSet->data;
+
+	for (int row = 0; row < rowSet->rowCount; row++) {
+		Local<Object> record;
+
+		if (fetchMode == FETCH_ARRAY) {
+			record = Array::New(isolate, rowSet->colCount);
+		}
+		else {
+			record = Object::New(isolate);
+		}
+
+		for (int i = 0; i < rowSet->colCount; i++) {
+			Local<Value> value;
+			uint8_t tag = *cursor++;
+
+			switch (tag) {
+				case ROWSET_INTEGER : {
+					int32_t cell;
+
+					memcpy(&cell, cursor, sizeof(cell));
+					cursor += sizeof(cell);
+					value = Integer::New(isolate, cell);
+				}
+				break;
+				case ROWSET_NUMBER :
+				case ROWSET_DATE : {
+					double cell;
+
+					memcpy(&cell, cursor, sizeof(cell));
+					cursor += sizeof(cell);
+
+					if (tag == ROWSET_DATE) {
+						value = Date::New(isolate, cell);
+					}
+					else {
+						value = Number::New(isolate, cell);
+					}
+				}
+				break;
+				case ROWSET_BOOLEAN :
+					value = BooleanObject::New(*cursor ? true : false);
+					cursor += 1;
+				break;
+				case ROWSET_STRING : {
+					uint32_t length;
+
+					memcpy(&length, cursor, sizeof(length));
+					cursor += sizeof(length);
+
+					if ((cursor - rowSet->data) % 2) {
+						cursor += 1;
+					}
+#ifdef UNICODE
+					if (rowSet->columns[i].intern) {
+						value = rowSet->columns[i].intern->Get(isolate, cursor, length * sizeof(uint16_t), false);
+					}
+					else {
+						value = ODBCText::NewString(isolate, (const uint16_t *) cursor, length);
+					}
+					cursor += length * sizeof(uint16_t);
+#else
+					value = String::NewFromUtf8(isolate, cursor, String::kNormalString, length);
+					cursor += length;
+#endif
+				}
+				break;
+				case ROWSET_CHARS : {
+					uint32_t length;
+
+					memcpy(&length, cursor, sizeof(length));
+					cursor += sizeof(length);
+
+					if (rowSet->columns[i].intern) {
+						value = rowSet->columns[i].intern->Get(isolate, cursor, length, true);
+					}
+					else {
+						value = String::NewFromUtf8(isolate, cursor, String::kNormalString, length);
+					}
+					cursor += length;
+				}
+				break;
+				default :
+					value = Null(isolate);
+			}
+
+			if (fetchMode == FETCH_ARRAY) {
+				record->Set(i, value);
+			}
+			else {
+				record->Set(names[i], value);
+			}
+		}
+
+		rows->Set(row, record);
+	}
+
+	delete [] names;
+
+	return scope.Escape(rows);
+}
+
+/*
+ * ArrayToRowSet
+ *
+ * The reverse of RowSetToArray: encode rows as returned by fetchAll() into a
+ * new RowSet which owns its columns. The column names come from the first
+ * row, and *fetchMode is set to FETCH_ARRAY when the rows are arrays.
+ * Returns NULL if the rows are not all objects.
+ */
+RowSet* ODBC::ArrayToRowSet(Local<Array> rows, int* fetchMode) {
+	v8::Isolate* isolate = v8::Isolate::GetCurrent();
+	v8::HandleScope scope(isolate);
+
+	RowSet* rowSet = (RowSet *) calloc(1, sizeof(RowSet));
+	Local<Array> names;
+
+	rowSet->ownsColumns = true;
+	rowSet->affectedRows = -1;
+	rowSet->result = SQL_NO_DATA;
+
+	*fetchMode = FETCH_OBJECT;
+
+	if (rows->Length() > 0 && rows->Get(0)->IsObject()) {
+		Local<Object> first = rows->Get(0)->ToObject();
+
+		if (first->IsArray()) {
+			*fetchMode = FETCH_ARRAY;
+			rowSet->colCount = (short) Local<Array>::Cast(first)->Length();
+		}
+		else {
+			names = first->GetOwnPropertyNames();
+			rowSet->colCount = (short) names->Length();
+		}
+	}
+
+	rowSet->columns = new Column[rowSet->colCount];
+
+	for (int i = 0; i < rowSet->colCount; i++) {
+		Local<String> name = (names.IsEmpty())
+			? Integer::New(isolate, i)->ToString()
+			: names->Get(i)->ToString();
+
+		rowSet->columns[i].index = i + 1;
+		rowSet->columns[i].type = SQL_UNKNOWN_TYPE;
+		rowSet->columns[i].utf8 = false;
+		rowSet->columns[i].intern = NULL;
+#ifdef UNICODE
+		rowSet->columns[i].len = name->Length();
+		rowSet->columns[i].name = new unsigned char[(name->Length() + 1) * sizeof(uint16_t)];
+		name->Write((uint16_t *) rowSet->columns[i].name);
+#else
+		rowSet->columns[i].len = name->Utf8Length();
+		rowSet->columns[i].name = new unsigned char[name->Utf8Length() + 1];
+		name->WriteUtf8((char *) rowSet->columns[i].name);
+#endif
+	}
+
+	for (uint32_t row = 0; row < rows->Length(); row++) {
+		if (!rows->Get(row)->IsObject()) {
+			FreeRowSet(rowSet);
+			return NULL;
+		}
+
+		Local<Object> record = rows->Get(row)->ToObject();
+
+		for (int i = 0; i < rowSet->colCount; i++) {
+			Local<Value> value = (names.IsEmpty()) ? record->Get(i) : record->Get(names->Get(i));
+
+			if (value->IsNull() || value->IsUndefined()) {
+				RowSetWriteTag(rowSet, ROWSET_NULL);
+			}
+			else if (value->IsInt32()) {
+				int32_t cell = value->Int32Value();
+
+				RowSetWriteTag(rowSet, ROWSET_INTEGER);
+				RowSetWrite(rowSet, &cell, sizeof(cell));
+			}
+			else if (value->IsNumber()) {
+				double cell = value->NumberValue();
+
+				RowSetWriteTag(rowSet, ROWSET_NUMBER);
+				RowSetWrite(rowSet, &cell, sizeof(cell));
+			}
+			else if (value->IsDate()) {
+				double cell = Local<Date>::Cast(value)->ValueOf();
+
+				RowSetWriteTag(rowSet, ROWSET_DATE);
+				RowSetWrite(rowSet, &cell, sizeof(cell));
+			}
+			else if (value->IsBoolean() || value->IsBooleanObject()) {
+				uint8_t cell = value->BooleanValue() ? 1 : 0;
+
+				if (value->IsBooleanObject()) {
+					cell = Local<BooleanObject>::Cast(value)->ValueOf() ? 1 : 0;
+				}
+
+				RowSetWriteTag(rowSet, ROWSET_BOOLEAN);
+				RowSetWrite(rowSet, &cell, sizeof(cell));
+			}
+			else {
+				Local<String> string = value->ToString();
+#ifdef UNICODE
+				uint32_t length = string->Length();
+#else
+				uint32_t length = string->Utf8Length();
+#endif
+
+				RowSetWriteTag(rowSet, ROWSET_STRING);
+				RowSetWrite(rowSet, &length, sizeof(length));
+
+				if (rowSet->length % 2) {
+					RowSetWriteTag(rowSet, 0);
+				}
+#ifdef UNICODE
+				char* cell = RowSetReserve(rowSet, length * sizeof(uint16_t));
+				string->Write((uint16_t *) cell, 0, length, String::NO_NULL_TERMINATION);
+#else
+				char* cell = RowSetReserve(rowSet, length);
+				string->WriteUtf8(cell, length, NULL, String::NO_NULL_TERMINATION);
+#endif
+			}
+		}
+
+		rowSet->rowCount++;
+	}
+
+	//the rowset is kept around, so do not hold on to the spare capacity
+	if (rowSet->capacity > rowSet->length && rowSet->length > 0) {
+		rowSet->data = (char *) realloc(rowSet->data, rowSet->length);
+		rowSet->capacity = rowSet->length;
+	}
+
+	return rowSet;
+}
+
+/*
+ * FreeRowSet
+ *
+ * Free a rowset and every rowset chained after it.
+ */
+void ODBC::FreeRowSet(RowSet* rowSet) {
+	while (rowSet) {
+		RowSet* next = rowSet->next;
+
+		if (rowSet->ownsColumns) {
+			FreeColumns(rowSet->columns, &rowSet->colCount);
+		}
+
+		free(rowSet->data);
+		free(rowSet);
+
+		rowSet = next;
+	}
+}
+
+/*
+ * GetParametersFromArray
+ *
+ * With utf8 strings are bound as UTF-8 SQL_C_CHAR instead of SQL_C_TCHAR.
+ */
+Parameter* ODBC::GetParametersFromArray (Local<Array> values, int *paramCount, bool utf8) {
+	DEBUG_PRINTF("ODBC::GetParametersFromArray\n");
+	*paramCount = values->Length();
+  
+	Parameter* params = NULL;
+  
+	if (*paramCount > 0) {
+		params = (Parameter *) malloc(*paramCount * sizeof(Parameter));
+	}
+  
+	for (int i = 0; i < *paramCount; i++) {
+		Local<Value> value = values->Get(i);
+    
+		params[i].ColumnSize       = 0;
+		params[i].StrLen_or_IndPtr = SQL_NULL_DATA;
+		params[i].BufferLength     = 0;
+		params[i].DecimalDigits    = 0;
+
+		DEBUG_PRINTF("ODBC::GetParametersFromArray - &param[%i].length = %p\n", i, (void *) &params[i].StrLen_or_IndPtr);
+
+		if (value->IsString() && utf8) {
+			Local<String> string = value->ToString();
+
+			params[i].ValueType         = SQL_C_CHAR;
+			params[i].ParameterType     = SQL_VARCHAR;
+			params[i].BufferLength      = string->Utf8Length() + 1;
+			params[i].ParameterValuePtr = malloc(params[i].BufferLength);
+			params[i].StrLen_or_IndPtr  = SQL_NTS;
+
+			string->WriteUtf8((char *) params[i].ParameterValuePtr);
+
+			DEBUG_PRINTF("ODBC::GetParametersFromArray - IsString() utf8: params[%i] buffer_length=%lld value=%s\n", i, (long long) params[i].BufferLength, (char*) params[i].ParameterValuePtr);
+		}
+		else if (value->IsString()) {
+			Local<String> string = value->ToString();
+			int length = string->Length();
+      
+			params[i].ValueType         = SQL_C_TCHAR;
+			params[i].ColumnSize        = 0; //SQL_SS_LENGTH_UNLIMITED 
+#ifdef UNICODE
+			params[i].ParameterType     = SQL_WVARCHAR;
+			params[i].BufferLength      = (length * sizeof(uint16_t)) + sizeof(uint16_t);
+#else
+			params[i].ParameterType     = SQL_VARCHAR;
+			params[i].BufferLength      = string->Utf8Length() + 1;
+#endif
+			params[i].ParameterValuePtr = malloc(params[i].BufferLength);
+			params[i].StrLen_or_IndPtr  = SQL_NTS;//params[i].BufferLength;
+
+#ifdef UNICODE
+			string->Write((uint16_t *) params[i].ParameterValuePtr);
+#else
+			string->WriteUtf8((char *) params[i].ParameterValuePtr);
+#endif
+
+			DEBUG_PRINTF("ODBC::GetParametersFromArray - IsString(): params[%i] c_type=%i type=%i buffer_length=%lld size=%lld length=%lld value=%s\n", i, params[i].ValueType, params[i].ParameterType,
+				(long long) params[i].BufferLength, (long long) params[i].ColumnSize, (long long) params[i].StrLen_or_IndPtr, 
+				(params[i].ValueType == SQL_C_CHAR) ? (char *) params[i].ParameterValuePtr : "");
+		}
+		else if (value->IsNull()) {
+			params[i].ValueType = SQL_C_DEFAULT;
+			params[i].ParameterType   = SQL_VARCHAR;
+			params[i].StrLen_or_IndPtr = SQL_NULL_DATA;
+
+			DEBUG_PRINTF("ODBC::GetParametersFromArray - IsNull(): params[%i] c_type=%i type=%i buffer_length=%lld size=%lld length=%lld\n",
+				i, params[i].ValueType, params[i].ParameterType,
+				(long long) params[i].BufferLength, (long long) params[i].ColumnSize, (long long) params[i].StrLen_or_IndPtr);
+		}
+		else if (value->IsInt32()) {
+			int64_t  *number = new int64_t(value->IntegerValue());
+			params[i].ValueType = SQL_C_SBIGINT;
+			params[i].ParameterType   = SQL_BIGINT;
+			params[i].ParameterValuePtr = number;
+			params[i].StrLen_or_IndPtr = 0;
+      
+			DEBUG_PRINTF("ODBC::GetParametersFromArray - IsInt32(): params[%i] c_type=%i type=%i buffer_length=%lld size=%lld length=%lld value=%lld\n", i, params[i].ValueType, params[i].ParameterType,
+				(long long) params[i].BufferLength, (long long) params[i].ColumnSize, (long long) params[i].StrLen_or_IndPtr,
+				(long long) *number);
+		}
+		else if (value->IsNumber()) {
+			double *number   = new double(value->NumberValue());
+      
+			params[i].ValueType         = SQL_C_DOUBLE;
+			params[i].ParameterType     = SQL_DECIMAL;
+			params[i].ParameterValuePtr = number;
+			params[i].BufferLength      = sizeof(double);
+			params[i].StrLen_or_IndPtr  = params[i].BufferLength;
+			params[i].DecimalDigits     = 7;
+			params[i].ColumnSize        = sizeof(double);
+
+			DEBUG_PRINTF("ODBC::GetParametersFromArray - IsNumber(): params[%i] c_type=%i type=%i buffer_length=%lld size=%lld length=%lld value=%f\n",
+				i, params[i].ValueType, params[i].ParameterType,
+				(long long) params[i].BufferLength, (long long) params[i].ColumnSize, (long long) params[i].StrLen_or_IndPtr,
+				*number);
+		}
+		else if (value->IsBoolean()) {
+			bool *boolean = new bool(value->BooleanValue());
+			params[i].ValueType         = SQL_C_BIT;
+			params[i].ParameterType     = SQL_BIT;
+			params[i].ParameterValuePtr = boolean;
+			params[i].StrLen_or_IndPtr  = 0;
+      
+			DEBUG_PRINTF("ODBC::GetParametersFromArray - IsBoolean(): params[%i] c_type=%i type=%i buffer_length=%lld size=%lld length=%lld\n",
+				i, params[i].ValueType, params[i].ParameterType,
+				(long long) params[i].BufferLength, (long long) params[i].ColumnSize, (long long) params[i].StrLen_or_IndPtr);
+		}
+	} 
+  
+	return params;
+}
+
+/*
+ * CopySQL
+ *
+ * Copy the text of a statement for the worker thread: UTF-16 for the wide
+ * functions, or UTF-8 for ODBCNarrow when utf8 is set. length is what the
+ * driver is told (code units), size the bytes allocated.
+ */
+void* ODBC::CopySQL(Local<String> sql, bool utf8, int* length, int* size) {
+	void* copy;
+
+#ifdef UNICODE
+	if (!utf8) {
+		*length = sql->Length();
+		*size = (*length * sizeof(uint16_t)) + sizeof(uint16_t);
+		copy = malloc(*size);
+		sql->Write((uint16_t *) copy);
+
+		return copy;
+	}
+#endif
+
+	*length = sql->Utf8Length();
+	*size = *length + 1;
+	copy = malloc(*size);
+	sql->WriteUtf8((char *) copy);
+
+	return copy;
+}
+
+/*
+ * QueueWork
+ *
+ * Run work_cb on the given executor worker, or on the libuv threadpool
+ * when the handle has no executor, and after_work_cb on the event loop.
+ */
+void ODBC::QueueWork(ODBCWorker* worker, uv_work_t* req, uv_work_cb work_cb, uv_after_work_cb after_work_cb) {
+	if (worker) {
+		worker->group->Dispatch(worker, req, work_cb, after_work_cb);
+	}
+	else {
+		uv_queue_work(ODBC::State()->loop, req, work_cb, after_work_cb);
+	}
+}
+
+/*
+ * PromiseCallback
+ *
+ * Used by the asynchronous methods when they are called without a
+ * callback: returns a function to use as the callback, which rejects
+ * *promise when it is called with an error and resolves it with its second
+ * argument otherwise. The promise is settled from the after work callback
+ * without any extra JS closure.
+ */
+
+static void Settle(const v8::FunctionCallbackInfo<v8::Value>& args) {
+	v8::Isolate* isolate = args.GetIsolate();
+
+	Local<Promise::Resolver> resolver = Local<Promise::Resolver>::Cast(args.Data());
+
+	if (args.Length() > 0 && !args[0]->IsNull() && !args[0]->IsUndefined()) {
+		resolver->Reject(args[0]);
+	}
+	else {
+		resolver->Resolve((args.Length() > 1) ? args[1] : Local<Value>::Cast(Undefined(isolate)));
+	}
+}
+
+static void SettlePromise(const v8::FunctionCallbackInfo<v8::Value>& args) {
+	v8::Isolate* isolate = args.GetIsolate();
+	v8::HandleScope scope(isolate);
+
+	Local<Object> resolver = Local<Object>::Cast(args.Data());
+
+	//we are usually called straight from the event loop; settling inside a
+	//callback scope lets node run the reactions and the nextTick queue when
+	//the outermost scope closes, as it does for any other callback
+#if NODE_VERSION_AT_LEAST(9, 6, 0)
+	node::CallbackScope callbackScope(isolate, resolver, node::async_context());
+
+	Settle(args);
+#else
+	Local<Value> argv[2] = {
+		(args.Length() > 0) ? args[0] : Local<Value>::Cast(Undefined(isolate)),
+		(args.Length() > 1) ? args[1] : Local<Value>::Cast(Undefined(isolate))
+	};
+
+	node::MakeCallback(isolate, resolver, Function::New(isolate, Settle, resolver), 2, argv);
+#endif
+}
+
+Local<Function> ODBC::PromiseCallback(v8::Isolate* isolate, Local<Promise>* promise) {
+	Local<Promise::Resolver> resolver = Promise::Resolver::New(isolate);
+
+	*promise = resolver->GetPromise();
+
+	return Function::New(isolate, SettlePromise, resolver);
+}
+
+/*
+ * CreatePromise
+ *
+ * createPromise() -> { promise, callback }
+ *
+ * Exposes PromiseCallback to lib/odbc.js, whose queued methods pass the
+ * callback down to the addon when they are called without one.
+ */
+
+void ODBC::CreatePromise(const v8::FunctionCallbackInfo<v8::Value>& args) {
+	v8::Isolate* isolate = args.GetIsolate();
+	v8::HandleScope scope(isolate);
+
+	Local<Promise> promise;
+	Local<Function> callback = ODBC::PromiseCallback(isolate, &promise);
+
+	Local<Object> obj = Object::New(isolate);
+	obj->Set(String::NewFromUtf8(isolate, "promise"), promise);
+	obj->Set(String::NewFromUtf8(isolate, "callback"), callback);
+
+	args.GetReturnValue().Set(obj);
+}
+
+/*
+ * CallbackSQLError
+ */
+
+Handle<Value> ODBC::CallbackSQLError(SQLSMALLINT handleType, SQLHANDLE handle, Persistent<Function, CopyablePersistentTraits<v8::Function>> cb) {
+	v8::Isolate* isolate = v8::Isolate::GetCurrent();
+	v8::EscapableHandleScope scope(isolate);
+
+	return CallbackSQLError(handleType, handle, (char *) "[node-odbc] SQL_ERROR", cb);
+	//return scope.Close(CallbackSQLError(handleType, handle, (char *) "[node-odbc] SQL_ERROR", cb));
+}
+
+Handle<Value> ODBC::CallbackSQLError(SQLSMALLINT handleType, SQLHANDLE handle, char* message, Persistent<Function, CopyablePersistentTraits<v8::Function>> cb) {
+	v8::Isolate* isolate = v8::Isolate::GetCurrent();
+	v8::EscapableHandleScope scope(isolate);
+
+	Local<Object> objError = ODBC::GetSQLError(handleType, handle, message);
+  
+	Local<Value> args[1];
+	args[0] = objError;
+
+	v8::Local<v8::Function> f = v8::Local<v8::Function>::New(isolate, cb);
+	f->Call(isolate->GetCurrentContext()->Global(), 1, args);
+
+	return Undefined(isolate);
+	//return scope.Close(Undefined());
+}
+
+/*
+ * GetSQLError
+ */
+Local<Object> ODBC::GetSQLError (SQLSMALLINT handleType, SQLHANDLE handle) {
+	v8::Isolate* isolate = v8::Isolate::GetCurrent();
+	v8::EscapableHandleScope scope(isolate);
 
 	return scope.Escape(GetSQLError(handleType, handle, (char *) "[node-odbc] SQL_ERROR"));
 }
@@ -784,6 +1866,7 @@ Local<Object> ODBC::GetSQLError (SQLSMALLINT handleType, SQLHANDLE handle, char*
 	char errorSQLState[14];
 	char errorMessage[ERROR_MESSAGE_BUFFER_BYTES];
 
+	ODBC_COUNT_CALL(SQLGetDiagField);
 	ret = SQLGetDiagField(handleType, handle, 0, SQL_DIAG_NUMBER, &statusRecCount, SQL_IS_INTEGER, &len);
 
 	// Windows seems to define SQLINTEGER as long int, unixodbc as just int... %i should cover both
@@ -792,6 +1875,7 @@ Local<Object> ODBC::GetSQLError (SQLSMALLINT handleType, SQLHANDLE handle, char*
 	for (i = 0; i < statusRecCount; i++) {
 		DEBUG_PRINTF("ODBC::GetSQLError : calling SQLGetDiagRec; i=%i, statusRecCount=%i\n", i, statusRecCount);
     
+		ODBC_COUNT_CALL(SQLGetDiagRec);
 		ret = SQLGetDiagRec(handleType, handle, i + 1, (SQLTCHAR *) errorSQLState, &native, (SQLTCHAR *) errorMessage, ERROR_MESSAGE_BUFFER_CHARS, &len);
     
 		DEBUG_PRINTF("ODBC::GetSQLError : after SQLGetDiagRec; i=%i\n", i);
@@ -799,6 +1883,8 @@ Local<Object> ODBC::GetSQLError (SQLSMALLINT handleType, SQLHANDLE handle, char*
 		if (SQL_SUCCEEDED(ret)) {
 			DEBUG_PRINTF("ODBC::GetSQLError : errorMessage=%s, errorSQLState=%s\n", errorMessage, errorSQLState);
 
+			ODBCMetrics::Error((SQLTCHAR *) errorSQLState);
+
 			objError->Set(String::NewFromUtf8(isolate, "error"), String::NewFromUtf8(isolate, message));
 #ifdef UNICODE
 			str = String::Concat(str, String::NewFromTwoByte(isolate, (uint16_t *) errorMessage));
@@ -844,13 +1930,15 @@ Local<Array> ODBC::GetAllRecordsSync (HENV hENV, HDBC hDBC, HSTMT hSTMT, uint16_
 	int errorCount = 0;
 	short colCount = 0;
   
-	Column* columns = GetColumns(hSTMT, &colCount);
+	Column* columns = GetColumns(hSTMT, &colCount, false);
   
 	Local<Array> rows = Array::New(isolate);
   
 	//loop through all records
 	while (true) {
+		ODBC_COUNT_CALL(SQLFetch);
 		SQLRETURN ret = SQLFetch(hSTMT);
+		ODBCMetrics::Fetched(ret);
     
 		//check to see if there was an error
 		if (ret == SQL_ERROR)  {
@@ -897,9 +1985,12 @@ void ODBC::LoadODBCLibrary(const v8::FunctionCallbackInfo<v8::Value>& args) {
 }
 #endif
 
-extern "C" void init (v8::Handle<Object> target) {
+extern "C" void init (v8::Handle<Object> target, v8::Handle<Value> module, v8::Handle<Context> context, void* priv) {
+	v8::Isolate* isolate = context->GetIsolate();
+
+	ODBC::CreateState(isolate);
+
 #ifdef dynodbc
-	v8::Isolate* isolate = v8::Isolate::GetCurrent();
 	target->Set(String::NewFromUtf8(isolate, "loadODBCLibrary"), FunctionTemplate::New(isolate, ODBC::LoadODBCLibrary)->GetFunction());
 #endif
   
@@ -907,6 +1998,17 @@ extern "C" void init (v8::Handle<Object> target) {
 	ODBCResult::Init(target);
 	ODBCConnection::Init(target);
 	ODBCStatement::Init(target);
+	ODBCExecutor::Init(target);
+	ODBCSharedPool::Init(target);
+	ODBCCache::Init(target);
+	ODBCStats::Init(target);
+	ODBCMetrics::Init(target);
+	ODBCSlowLog::Init(target);
+	ODBCTrace::Init(target);
+	ODBCText::Init(target);
 }
 
-NODE_MODULE(odbc_bindings, init)
+//test/microbench links these sources into a module of its own
+#ifndef ODBC_MICROBENCH
+NODE_MODULE_CONTEXT_AWARE(odbc_bindings, init)
+#endif
@@ -36,6 +36,8 @@
 using namespace v8;
 using namespace node;
 
+#include "odbc_trace.h"
+
 #define MAX_FIELD_SIZE 1024
 #define MAX_VALUE_SIZE 1048576
 
@@ -53,12 +55,18 @@ using namespace node;
 #define FETCH_OBJECT 4
 #define SQL_DESTROY 9999
 
+class ODBCIntern;
+class ODBCAggregate;
 
 typedef struct {
   unsigned char *name;
   unsigned int len;
   SQLLEN type;
   SQLUSMALLINT index;
+  //text is fetched as UTF-8 (SQL_C_CHAR) instead of SQL_C_TCHAR
+  bool utf8;
+  //shared strings of this column, see ODBCResult intern
+  ODBCIntern *intern;
 } Column;
 
 typedef struct {
@@ -71,14 +79,111 @@ typedef struct {
   SQLLEN       StrLen_or_IndPtr;
 } Parameter;
 
+//cell tags used in a RowSet
+#define ROWSET_NULL 0
+#define ROWSET_INTEGER 1
+#define ROWSET_NUMBER 2
+#define ROWSET_BOOLEAN 3
+#define ROWSET_DATE 4
+#define ROWSET_STRING 5
+#define ROWSET_CHARS 6
+
+//Rows fetched on a worker thread into one compact buffer so that the
+//values can be turned into JS objects later on the main thread. Each
+//cell is a one byte tag followed by its payload; strings carry a 32 bit
+//length in code units and are padded so that UCS2 data is 2-byte aligned.
+typedef struct RowSet {
+  Column *columns;
+  short colCount;
+  bool ownsColumns;
+  int rowCount;
+  SQLLEN affectedRows;
+  SQLRETURN result;
+  char *data;
+  size_t length;
+  size_t capacity;
+  struct RowSet *next;
+} RowSet;
+
+//Phases of a query, timed with uv_hrtime()
+#define TIMING_QUEUE 0
+#define TIMING_WAIT 1
+#define TIMING_EXECUTE 2
+#define TIMING_FETCH 3
+#define TIMING_MATERIALIZE 4
+#define TIMING_CALLBACK 5
+#define TIMING_TOTAL 6
+#define TIMING_PHASES 7
+
+//Nanoseconds spent in each phase of one query. mark is the end of the last
+//timed stage; the time until the next stage starts counts as waiting (for
+//a worker thread, for the event loop or for JS to ask for more).
+typedef struct {
+  uint64_t enqueued;
+  uint64_t mark;
+  uint64_t phases[TIMING_PHASES];
+  //added to the histograms of getStats() when finished; only query() is
+  bool histogram;
+} ODBCTiming;
+
+//log-linear buckets: 8 per power of two, so about 12% precision from 1us
+//to hours
+#define HISTOGRAM_SUB_BUCKETS 8
+#define HISTOGRAM_BUCKETS (62 * HISTOGRAM_SUB_BUCKETS)
+
+typedef struct {
+  uint64_t count;
+  uint64_t sum;
+  uint64_t min;
+  uint64_t max;
+  uint64_t buckets[HISTOGRAM_BUCKETS];
+} ODBCHistogram;
+
+struct ODBCWorker;
+class ODBCThreadGroup;
+class ODBCSharedPool;
+struct shared_pool_waiter;
+
+//Everything the binding keeps per isolate. The main thread and every
+//worker_thread that loads the addon get their own templates, property
+//names, event loop and keep-alive handle; only the ODBC mutex is shared
+//by the whole process.
+typedef struct ODBCState {
+  v8::Isolate* isolate;
+  uv_loop_t* loop;
+  uv_async_t async;
+  
+  Persistent<FunctionTemplate> odbcTemplate;
+  Persistent<FunctionTemplate> connectionTemplate;
+  Persistent<FunctionTemplate> statementTemplate;
+  Persistent<FunctionTemplate> resultTemplate;
+  Persistent<FunctionTemplate> executorTemplate;
+  
+  Persistent<String> optionSql;
+  Persistent<String> optionParams;
+  Persistent<String> optionNoResults;
+  Persistent<String> optionFetchMode;
+  
+  //executor thread groups created in this isolate
+  ODBCThreadGroup* groups;
+  
+  //shared pool acquire()s waiting on this loop
+  shared_pool_waiter* waiters;
+  
+  //per phase query latency in microseconds, see ODBCStats
+  ODBCHistogram histograms[TIMING_PHASES];
+} ODBCState;
+
 class ODBC : public node::ObjectWrap {
   public:
-    static Persistent<FunctionTemplate> constructor_template;
     static uv_mutex_t g_odbcMutex;
-    static uv_async_t g_async;
+    
+    static ODBCState* State();
+    static ODBCState* CreateState(v8::Isolate* isolate);
+    static void DestroyState(void* arg);
     
     static void Init(v8::Handle<Object> target);
-    static Column* GetColumns(SQLHSTMT hStmt, short* colCount);
+    static Column* GetColumns(SQLHSTMT hStmt, short* colCount, bool utf8);
     static void FreeColumns(Column* columns, short* colCount);
     static Handle<Value> GetColumnValue(SQLHSTMT hStmt, Column column, uint16_t* buffer, int bufferLength);
     static Local<Object> GetRecordTuple (SQLHSTMT hStmt, Column* columns, short* colCount, uint16_t* buffer, int bufferLength);
@@ -88,10 +193,18 @@ class ODBC : public node::ObjectWrap {
     static Local<Object> GetSQLError (SQLSMALLINT handleType, SQLHANDLE handle);
     static Local<Object> GetSQLError (SQLSMALLINT handleType, SQLHANDLE handle, char* message);
     static Local<Array>  GetAllRecordsSync (HENV hENV, HDBC hDBC, HSTMT hSTMT, uint16_t* buffer, int bufferLength);
+    static RowSet* FetchRowSet (SQLHSTMT hStmt, Column* columns, short colCount, uint16_t* buffer, int bufferLength, int maxRows, bool utf8);
+    static Local<Array> RowSetToArray (RowSet* rowSet, int fetchMode);
+    static RowSet* ArrayToRowSet (Local<Array> rows, int* fetchMode);
+    static void FreeRowSet (RowSet* rowSet);
 #ifdef dynodbc
 	static void LoadODBCLibrary(const v8::FunctionCallbackInfo<v8::Value>& info);
 #endif
-    static Parameter* GetParametersFromArray (Local<Array> values, int* paramCount);
+    static Parameter* GetParametersFromArray (Local<Array> values, int* paramCount, bool utf8);
+    static void* CopySQL (Local<String> sql, bool utf8, int* length, int* size);
+    static void QueueWork(ODBCWorker* worker, uv_work_t* req, uv_work_cb work_cb, uv_after_work_cb after_work_cb);
+    static Local<Function> PromiseCallback(v8::Isolate* isolate, Local<Promise>* promise);
+    static void CreatePromise(const v8::FunctionCallbackInfo<v8::Value>& args);
     
     void Free();
     
@@ -160,17 +273,14 @@ struct query_request {
     #define SQL_T(x) (x)
 #endif
 
-#ifdef DEBUG
-    #ifdef UNICODE
-        #define DEBUG_PRINTF(...) fwprintf(stdout, L##__VA_ARGS__)
-        #define DEBUG_TPRINTF(...) fwprintf(stdout, __VA_ARGS__)
-    #else
-        #define DEBUG_TPRINTF(...) fprintf(stdout, __VA_ARGS__)
-        #define DEBUG_PRINTF(...) fprintf(stdout, __VA_ARGS__)
-    #endif
+//debug output goes to the trace log (odbc_trace.h), switched on at runtime
+//with odbc.setTrace(); DEBUG_TPRINTF takes a SQL_T() format
+#define DEBUG_PRINTF(...) ODBC_TRACE(TRACE_DEBUG, __VA_ARGS__)
+
+#ifdef UNICODE
+    #define DEBUG_TPRINTF(...) ODBC_TRACE_W(TRACE_DEBUG, __VA_ARGS__)
 #else
-    #define DEBUG_PRINTF(...) (void)0
-    #define DEBUG_TPRINTF(...) (void)0
+    #define DEBUG_TPRINTF(...) ODBC_TRACE(TRACE_DEBUG, __VA_ARGS__)
 #endif
 
 #define REQ_ARGS(N)                                                     \
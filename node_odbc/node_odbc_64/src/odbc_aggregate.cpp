@@ -0,0 +1,966 @@
+/*
+  Copyright (c) 2013, Dan VerWeire <dverweire@gmail.com>
+
+  Permission to use, copy, modify, and/or distribute this software for any
+  purpose with or without fee is hereby granted, provided that the above
+  copyright notice and this permission notice appear in all copies.
+
+  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <v8.h>
+#include <node.h>
+#include <uv.h>
+
+#include "odbc.h"
+#include "odbc_aggregate.h"
+#include "odbc_hash.h"
+
+#define ODBC_TRACE_CATEGORY TRACE_FETCH
+
+using namespace v8;
+using namespace node;
+
+static const char* g_functions[] = { "count", "sum", "avg", "min", "max" };
+
+/*
+ * Spec parsing
+ */
+static char* CopyUTF8(Local<Value> value, uint32_t* length) {
+	String::Utf8Value utf8(value);
+	char* copy = (char *) malloc(utf8.length() + 1);
+
+	memcpy(copy, *utf8, utf8.length() + 1);
+
+	if (length) {
+		*length = utf8.length();
+	}
+
+	return copy;
+}
+
+static uint16_t* CopyWide(Local<Value> value, uint32_t* length) {
+	String::Value wide(value);
+	uint16_t* copy = (uint16_t *) malloc((wide.length() + 1) * sizeof(uint16_t));
+
+	memcpy(copy, *wide, (wide.length() + 1) * sizeof(uint16_t));
+
+	if (length) {
+		*length = wide.length();
+	}
+
+	return copy;
+}
+
+static bool ParseColumn(Local<Value> value, aggregate_column* column) {
+	column->index = -1;
+
+	if (!value->IsString()) {
+		return false;
+	}
+
+	column->name = CopyUTF8(value, NULL);
+#ifdef UNICODE
+	column->tname = CopyWide(value, NULL);
+#else
+	column->tname = CopyUTF8(value, NULL);
+#endif
+
+	return true;
+}
+
+static bool ParseValue(Local<Value> value, aggregate_value* out) {
+	if (value->IsString()) {
+		out->isText = true;
+		out->text = CopyUTF8(value, &out->textLength);
+		out->wide = CopyWide(value, &out->wideLength);
+	}
+	else if (value->IsNumber()) {
+		out->number = value->NumberValue();
+	}
+	else if (value->IsDate()) {
+		out->number = Local<Date>::Cast(value)->ValueOf();
+	}
+	else if (value->IsBoolean()) {
+		out->number = value->BooleanValue() ? 1 : 0;
+	}
+	else if (value->IsBooleanObject()) {
+		out->number = Local<BooleanObject>::Cast(value)->ValueOf() ? 1 : 0;
+	}
+	else {
+		return false;
+	}
+
+	return true;
+}
+
+static int ParseOperator(Local<Value> value) {
+	if (!value->IsString()) {
+		return -1;
+	}
+
+	String::Utf8Value op(value);
+
+	if (!strcmp(*op, "=") || !strcmp(*op, "==") || !strcmp(*op, "===")) {
+		return PREDICATE_EQ;
+	}
+	else if (!strcmp(*op, "!=") || !strcmp(*op, "<>") || !strcmp(*op, "!==")) {
+		return PREDICATE_NE;
+	}
+	else if (!strcmp(*op, "<")) {
+		return PREDICATE_LT;
+	}
+	else if (!strcmp(*op, "<=")) {
+		return PREDICATE_LE;
+	}
+	else if (!strcmp(*op, ">")) {
+		return PREDICATE_GT;
+	}
+	else if (!strcmp(*op, ">=")) {
+		return PREDICATE_GE;
+	}
+	else if (!strcmp(*op, "in")) {
+		return PREDICATE_IN;
+	}
+	else if (!strcmp(*op, "null")) {
+		return PREDICATE_NULL;
+	}
+	else if (!strcmp(*op, "notNull")) {
+		return PREDICATE_NOT_NULL;
+	}
+
+	return -1;
+}
+
+static bool ParsePredicate(Isolate* isolate, Local<Value> value, aggregate_predicate* predicate) {
+	if (!value->IsObject()) {
+		return false;
+	}
+
+	Local<Object> obj = value->ToObject();
+
+	predicate->op = ParseOperator(obj->Get(String::NewFromUtf8(isolate, "op")));
+
+	if (predicate->op < 0 || !ParseColumn(obj->Get(String::NewFromUtf8(isolate, "column")), &predicate->column)) {
+		return false;
+	}
+
+	if (predicate->op == PREDICATE_NULL || predicate->op == PREDICATE_NOT_NULL) {
+		return true;
+	}
+
+	Local<Value> constant = obj->Get(String::NewFromUtf8(isolate, "value"));
+
+	if (predicate->op == PREDICATE_IN) {
+		if (!constant->IsArray()) {
+			return false;
+		}
+
+		Local<Array> values = Local<Array>::Cast(constant);
+
+		predicate->values = (aggregate_value *) calloc(values->Length() + 1, sizeof(aggregate_value));
+
+		for (uint32_t i = 0; i < values->Length(); i++) {
+			predicate->valueCount++;
+
+			if (!ParseValue(values->Get(i), &predicate->values[i])) {
+				return false;
+			}
+		}
+
+		return true;
+	}
+
+	//same as JS: only null equals null
+	if (constant->IsNull() || constant->IsUndefined()) {
+		if (predicate->op == PREDICATE_EQ) {
+			predicate->op = PREDICATE_NULL;
+			return true;
+		}
+		else if (predicate->op == PREDICATE_NE) {
+			predicate->op = PREDICATE_NOT_NULL;
+			return true;
+		}
+
+		return false;
+	}
+
+	predicate->values = (aggregate_value *) calloc(1, sizeof(aggregate_value));
+	predicate->valueCount = 1;
+
+	return ParseValue(constant, &predicate->values[0]);
+}
+
+//{ as : { fn : column } }
+static bool ParseOutput(Isolate* isolate, Local<Value> as, Local<Value> value, aggregate_output* output) {
+	output->as = CopyUTF8(as, NULL);
+	output->column.index = -1;
+
+	if (!value->IsObject()) {
+		return false;
+	}
+
+	Local<Array> keys = value->ToObject()->GetOwnPropertyNames();
+
+	if (keys->Length() != 1) {
+		return false;
+	}
+
+	String::Utf8Value fn(keys->Get(0));
+
+	output->fn = -1;
+
+	for (int i = 0; i < (int) (sizeof(g_functions) / sizeof(g_functions[0])); i++) {
+		if (!strcmp(*fn, g_functions[i])) {
+			output->fn = i;
+		}
+	}
+
+	if (output->fn < 0) {
+		return false;
+	}
+
+	Local<Value> column = value->ToObject()->Get(keys->Get(0));
+
+	if (output->fn == AGGREGATE_COUNT && column->IsString() && column->ToString()->Length() == 1) {
+		String::Utf8Value star(column);
+
+		if (**star == '*') {
+			return true;
+		}
+	}
+
+	return ParseColumn(column, &output->column);
+}
+
+/*
+ * New
+ *
+ * aggregate({ where, groupBy, select, maxGroups }):
+ *
+ *   where     : [{ column, op, value }], all of which a row must match; op
+ *               is one of = != < <= > >= in null notNull
+ *   groupBy   : a column name or an array of them
+ *   select    : { as : { count|sum|avg|min|max : column } }, '*' counts
+ *               rows; defaults to { count : { count : '*' } }
+ *   maxGroups : fail once there are more groups than this
+ */
+ODBCAggregate* ODBCAggregate::New(v8::Isolate* isolate, Local<Object> spec, const char** error) {
+	ODBCAggregate* aggregate = new ODBCAggregate();
+
+	Local<Value> where = spec->Get(String::NewFromUtf8(isolate, "where"));
+	Local<Value> groupBy = spec->Get(String::NewFromUtf8(isolate, "groupBy"));
+	Local<Value> select = spec->Get(String::NewFromUtf8(isolate, "select"));
+	Local<Value> maxGroups = spec->Get(String::NewFromUtf8(isolate, "maxGroups"));
+
+	if (!where->IsUndefined() && !where->IsNull()) {
+		if (!where->IsArray()) {
+			*error = "ODBCResult::Aggregate(): where must be an Array of { column, op, value } objects.";
+			delete aggregate;
+			return NULL;
+		}
+
+		Local<Array> predicates = Local<Array>::Cast(where);
+
+		aggregate->m_predicates = (aggregate_predicate *) calloc(predicates->Length() + 1, sizeof(aggregate_predicate));
+
+		for (uint32_t i = 0; i < predicates->Length(); i++) {
+			aggregate->m_predicateCount++;
+
+			if (!ParsePredicate(isolate, predicates->Get(i), &aggregate->m_predicates[i])) {
+				*error = "ODBCResult::Aggregate(): where must be an Array of { column, op, value } objects.";
+				delete aggregate;
+				return NULL;
+			}
+		}
+	}
+
+	if (groupBy->IsString()) {
+		Local<Array> columns = Array::New(isolate, 1);
+
+		columns->Set(0, groupBy);
+		groupBy = columns;
+	}
+
+	if (!groupBy->IsUndefined() && !groupBy->IsNull()) {
+		if (!groupBy->IsArray()) {
+			*error = "ODBCResult::Aggregate(): groupBy must be a column name or an Array of them.";
+			delete aggregate;
+			return NULL;
+		}
+
+		Local<Array> columns = Local<Array>::Cast(groupBy);
+
+		aggregate->m_groupBy = (aggregate_column *) calloc(columns->Length() + 1, sizeof(aggregate_column));
+
+		for (uint32_t i = 0; i < columns->Length(); i++) {
+			aggregate->m_groupByCount++;
+
+			if (!ParseColumn(columns->Get(i), &aggregate->m_groupBy[i])) {
+				*error = "ODBCResult::Aggregate(): groupBy must be a column name or an Array of them.";
+				delete aggregate;
+				return NULL;
+			}
+		}
+	}
+
+	if (select->IsUndefined() || select->IsNull()) {
+		aggregate->m_outputs = (aggregate_output *) calloc(1, sizeof(aggregate_output));
+		aggregate->m_outputCount = 1;
+		aggregate->m_outputs[0].as = strdup("count");
+		aggregate->m_outputs[0].fn = AGGREGATE_COUNT;
+		aggregate->m_outputs[0].column.index = -1;
+	}
+	else if (!select->IsObject()) {
+		*error = "ODBCResult::Aggregate(): select must map names to { count|sum|avg|min|max : column } objects.";
+		delete aggregate;
+		return NULL;
+	}
+	else {
+		Local<Array> names = select->ToObject()->GetOwnPropertyNames();
+
+		aggregate->m_outputs = (aggregate_output *) calloc(names->Length() + 1, sizeof(aggregate_output));
+
+		for (uint32_t i = 0; i < names->Length(); i++) {
+			aggregate->m_outputCount++;
+
+			if (!ParseOutput(isolate, names->Get(i), select->ToObject()->Get(names->Get(i)), &aggregate->m_outputs[i])) {
+				*error = "ODBCResult::Aggregate(): select must map names to { count|sum|avg|min|max : column } objects.";
+				delete aggregate;
+				return NULL;
+			}
+		}
+	}
+
+	if (!maxGroups->IsUndefined()) {
+		if (!maxGroups->IsNumber() || maxGroups->NumberValue() < 1) {
+			*error = "ODBCResult::Aggregate(): maxGroups must be a positive Number.";
+			delete aggregate;
+			return NULL;
+		}
+
+		aggregate->m_maxGroups = (size_t) maxGroups->NumberValue();
+	}
+
+	return aggregate;
+}
+
+ODBCAggregate::ODBCAggregate() :
+	m_predicates(NULL),
+	m_predicateCount(0),
+	m_groupBy(NULL),
+	m_groupByCount(0),
+	m_outputs(NULL),
+	m_outputCount(0),
+	m_cells(NULL),
+	m_colCount(0),
+	m_key(NULL),
+	m_keyLength(0),
+	m_keyCapacity(0),
+	m_bucketCount(AGGREGATE_INITIAL_BUCKETS),
+	m_head(NULL),
+	m_tail(NULL),
+	m_groupCount(0),
+	m_maxGroups(AGGREGATE_MAX_GROUPS),
+	m_rows(0),
+	m_matched(0) {
+	m_buckets = (aggregate_group **) calloc(m_bucketCount, sizeof(aggregate_group *));
+	memset(&m_groupRows, 0, sizeof(m_groupRows));
+	m_groupRows.affectedRows = -1;
+	m_error[0] = '\0';
+}
+
+static void FreeColumn(aggregate_column* column) {
+	free(column->name);
+	free(column->tname);
+}
+
+ODBCAggregate::~ODBCAggregate() {
+	for (int i = 0; i < m_predicateCount; i++) {
+		FreeColumn(&m_predicates[i].column);
+
+		for (int j = 0; j < m_predicates[i].valueCount; j++) {
+			free(m_predicates[i].values[j].text);
+			free(m_predicates[i].values[j].wide);
+		}
+
+		free(m_predicates[i].values);
+	}
+
+	for (int i = 0; i < m_groupByCount; i++) {
+		FreeColumn(&m_groupBy[i]);
+	}
+
+	for (int i = 0; i < m_outputCount; i++) {
+		free(m_outputs[i].as);
+		FreeColumn(&m_outputs[i].column);
+	}
+
+	aggregate_group* group = m_head;
+
+	while (group) {
+		aggregate_group* next = group->next;
+
+		free(group->key);
+		free(group->states);
+		free(group);
+
+		group = next;
+	}
+
+	free(m_predicates);
+	free(m_groupBy);
+	free(m_outputs);
+	free(m_cells);
+	free(m_key);
+	free(m_buckets);
+
+	//the names belong to the columns of the result
+	delete [] m_groupRows.columns;
+	free(m_groupRows.data);
+}
+
+/*
+ * Bind
+ */
+static bool SameName(const void* tname, const unsigned char* name) {
+#ifdef UNICODE
+	const uint16_t* a = (const uint16_t *) tname;
+	const uint16_t* b = (const uint16_t *) name;
+#else
+	const char* a = (const char *) tname;
+	const char* b = (const char *) name;
+#endif
+
+	while (*a && *a == *b) {
+		a++;
+		b++;
+	}
+
+	return *a == *b;
+}
+
+//types which RowSetGetCell stores as numbers; dates only for min and max
+static bool IsNumericType(SQLLEN type, bool dates) {
+	switch ((int) type) {
+		case SQL_INTEGER :
+		case SQL_SMALLINT :
+		case SQL_TINYINT :
+		case SQL_NUMERIC :
+		case SQL_DECIMAL :
+		case SQL_BIGINT :
+		case SQL_FLOAT :
+		case SQL_REAL :
+		case SQL_DOUBLE :
+		case SQL_BIT :
+			return true;
+		case SQL_DATETIME :
+		case SQL_TIMESTAMP :
+			return dates;
+	}
+
+	return false;
+}
+
+static bool BindColumn(aggregate_column* column, Column* columns, short colCount, char* error, size_t errorLength) {
+	for (int i = 0; i < colCount; i++) {
+		if (SameName(column->tname, columns[i].name)) {
+			column->index = i;
+			return true;
+		}
+	}
+
+	snprintf(error, errorLength, "[node-odbc] aggregate(): the result set has no column %s", column->name);
+
+	return false;
+}
+
+bool ODBCAggregate::Bind(Column* columns, short colCount) {
+	for (int i = 0; i < m_predicateCount; i++) {
+		if (!BindColumn(&m_predicates[i].column, columns, colCount, m_error, sizeof(m_error))) {
+			return false;
+		}
+	}
+
+	for (int i = 0; i < m_groupByCount; i++) {
+		if (!BindColumn(&m_groupBy[i], columns, colCount, m_error, sizeof(m_error))) {
+			return false;
+		}
+	}
+
+	for (int i = 0; i < m_outputCount; i++) {
+		aggregate_output* output = &m_outputs[i];
+
+		//count('*')
+		if (!output->column.tname) {
+			continue;
+		}
+
+		if (!BindColumn(&output->column, columns, colCount, m_error, sizeof(m_error))) {
+			return false;
+		}
+
+		if (output->fn != AGGREGATE_COUNT
+			&& !IsNumericType(columns[output->column.index].type, output->fn == AGGREGATE_MIN || output->fn == AGGREGATE_MAX)) {
+			snprintf(m_error, sizeof(m_error), "[node-odbc] aggregate(): %s of column %s, which is not numeric", g_functions[output->fn], output->column.name);
+			return false;
+		}
+	}
+
+	m_cells = (aggregate_cell *) calloc(colCount + 1, sizeof(aggregate_cell));
+	m_colCount = colCount;
+
+	m_groupRows.columns = new Column[m_groupByCount];
+	m_groupRows.colCount = m_groupByCount;
+
+	for (int i = 0; i < m_groupByCount; i++) {
+		m_groupRows.columns[i] = columns[m_groupBy[i].index];
+		m_groupRows.columns[i].intern = NULL;
+	}
+
+	//without group by there is exactly one group, even for no rows
+	if (m_groupByCount == 0) {
+		m_keyLength = 0;
+		Group(ODBCHash(m_key, 0));
+	}
+
+	return true;
+}
+
+/*
+ * Add
+ */
+//next cell of a RowSet, laid out as RowSetGetCell writes it
+static const char* ReadCell(const char* base, const char* cursor, aggregate_cell* cell) {
+	cell->tag = *cursor++;
+
+	switch (cell->tag) {
+		case ROWSET_INTEGER : {
+			int32_t value;
+
+			memcpy(&value, cursor, sizeof(value));
+			cursor += sizeof(value);
+			cell->number = value;
+		}
+		break;
+		case ROWSET_NUMBER :
+		case ROWSET_DATE :
+			memcpy(&cell->number, cursor, sizeof(cell->number));
+			cursor += sizeof(cell->number);
+		break;
+		case ROWSET_BOOLEAN :
+			cell->number = *cursor ? 1 : 0;
+			cursor += 1;
+		break;
+		case ROWSET_STRING : {
+			uint32_t length;
+
+			memcpy(&length, cursor, sizeof(length));
+			cursor += sizeof(length);
+
+			if ((cursor - base) % 2) {
+				cursor += 1;
+			}
+#ifdef UNICODE
+			cell->length = length * sizeof(uint16_t);
+#else
+			cell->length = length;
+#endif
+			cell->data = cursor;
+			cursor += cell->length;
+		}
+		break;
+		case ROWSET_CHARS :
+			memcpy(&cell->length, cursor, sizeof(cell->length));
+			cursor += sizeof(cell->length);
+			cell->data = cursor;
+			cursor += cell->length;
+		break;
+	}
+
+	return cursor;
+}
+
+static void GroupWrite(RowSet* rowSet, const void* data, size_t length) {
+	if (rowSet->length + length > rowSet->capacity) {
+		size_t capacity = rowSet->capacity ? rowSet->capacity : 4096;
+
+		while (capacity < rowSet->length + length) {
+			capacity *= 2;
+		}
+
+		rowSet->data = (char *) realloc(rowSet->data, capacity);
+		rowSet->capacity = capacity;
+	}
+
+	memcpy(rowSet->data + rowSet->length, data, length);
+	rowSet->length += length;
+}
+
+//the reverse of ReadCell, for the group by values of a new group
+static void WriteCell(RowSet* rowSet, aggregate_cell* cell) {
+	GroupWrite(rowSet, &cell->tag, sizeof(cell->tag));
+
+	switch (cell->tag) {
+		case ROWSET_INTEGER : {
+			int32_t value = (int32_t) cell->number;
+
+			GroupWrite(rowSet, &value, sizeof(value));
+		}
+		break;
+		case ROWSET_NUMBER :
+		case ROWSET_DATE :
+			GroupWrite(rowSet, &cell->number, sizeof(cell->number));
+		break;
+		case ROWSET_BOOLEAN : {
+			uint8_t value = cell->number ? 1 : 0;
+
+			GroupWrite(rowSet, &value, sizeof(value));
+		}
+		break;
+		case ROWSET_STRING : {
+#ifdef UNICODE
+			uint32_t length = cell->length / sizeof(uint16_t);
+#else
+			uint32_t length = cell->length;
+#endif
+			uint8_t pad = 0;
+
+			GroupWrite(rowSet, &length, sizeof(length));
+
+			if (rowSet->length % 2) {
+				GroupWrite(rowSet, &pad, sizeof(pad));
+			}
+
+			GroupWrite(rowSet, cell->data, cell->length);
+		}
+		break;
+		case ROWSET_CHARS :
+			GroupWrite(rowSet, &cell->length, sizeof(cell->length));
+			GroupWrite(rowSet, cell->data, cell->length);
+		break;
+	}
+}
+
+static int CompareBytes(const char* a, uint32_t aLength, const char* b, uint32_t bLength) {
+	int result = memcmp(a, b, (aLength < bLength) ? aLength : bLength);
+
+	if (result) {
+		return result;
+	}
+
+	return (aLength < bLength) ? -1 : (aLength > bLength) ? 1 : 0;
+}
+
+#ifdef UNICODE
+static int CompareUnits(const uint16_t* a, uint32_t aLength, const uint16_t* b, uint32_t bLength) {
+	uint32_t length = (aLength < bLength) ? aLength : bLength;
+
+	for (uint32_t i = 0; i < length; i++) {
+		if (a[i] != b[i]) {
+			return (a[i] < b[i]) ? -1 : 1;
+		}
+	}
+
+	return (aLength < bLength) ? -1 : (aLength > bLength) ? 1 : 0;
+}
+#endif
+
+//false if the cell and the value cannot be compared, like text and numbers
+static bool Compare(aggregate_cell* cell, aggregate_value* value, int* result) {
+	switch (cell->tag) {
+		case ROWSET_INTEGER :
+		case ROWSET_NUMBER :
+		case ROWSET_DATE :
+		case ROWSET_BOOLEAN :
+			if (value->isText) {
+				return false;
+			}
+
+			*result = (cell->number < value->number) ? -1 : (cell->number > value->number) ? 1 : 0;
+
+			return cell->number == cell->number && value->number == value->number;
+#ifdef UNICODE
+		case ROWSET_STRING :
+			if (!value->isText) {
+				return false;
+			}
+
+			*result = CompareUnits((const uint16_t *) cell->data, cell->length / sizeof(uint16_t), value->wide, value->wideLength);
+
+			return true;
+#else
+		case ROWSET_STRING :
+#endif
+		case ROWSET_CHARS :
+			if (!value->isText) {
+				return false;
+			}
+
+			*result = CompareBytes(cell->data, cell->length, value->text, value->textLength);
+
+			return true;
+	}
+
+	return false;
+}
+
+bool ODBCAggregate::Matches(aggregate_predicate* predicate) {
+	aggregate_cell* cell = &m_cells[predicate->column.index];
+	int result = 0;
+
+	if (predicate->op == PREDICATE_NULL) {
+		return cell->tag == ROWSET_NULL;
+	}
+	else if (predicate->op == PREDICATE_NOT_NULL) {
+		return cell->tag != ROWSET_NULL;
+	}
+	else if (cell->tag == ROWSET_NULL) {
+		return false;
+	}
+	else if (predicate->op == PREDICATE_IN) {
+		for (int i = 0; i < predicate->valueCount; i++) {
+			if (Compare(cell, &predicate->values[i], &result) && result == 0) {
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	if (!Compare(cell, &predicate->values[0], &result)) {
+		return false;
+	}
+
+	switch (predicate->op) {
+		case PREDICATE_EQ : return result == 0;
+		case PREDICATE_NE : return result != 0;
+		case PREDICATE_LT : return result < 0;
+		case PREDICATE_LE : return result <= 0;
+		case PREDICATE_GT : return result > 0;
+		case PREDICATE_GE : return result >= 0;
+	}
+
+	return false;
+}
+
+static void AppendKey(char** key, size_t* keyLength, size_t* keyCapacity, const void* data, size_t length) {
+	if (*keyLength + length > *keyCapacity) {
+		*keyCapacity = (*keyLength + length) * 2;
+		*key = (char *) realloc(*key, *keyCapacity);
+	}
+
+	memcpy(*key + *keyLength, data, length);
+	*keyLength += length;
+}
+
+aggregate_group* ODBCAggregate::Group(uint32_t hash) {
+	for (aggregate_group* group = m_buckets[hash % m_bucketCount]; group; group = group->chain) {
+		if (group->hash == hash && group->keyLength == m_keyLength && !memcmp(group->key, m_key, m_keyLength)) {
+			return group;
+		}
+	}
+
+	if (m_groupCount >= m_maxGroups) {
+		snprintf(m_error, sizeof(m_error), "[node-odbc] aggregate(): more than %lu groups", (unsigned long) m_maxGroups);
+		return NULL;
+	}
+
+	aggregate_group* group = (aggregate_group *) calloc(1, sizeof(aggregate_group));
+
+	group->hash = hash;
+	group->key = (char *) malloc(m_keyLength + 1);
+	group->keyLength = m_keyLength;
+	group->states = (aggregate_state *) calloc(m_outputCount + 1, sizeof(aggregate_state));
+
+	if (m_keyLength) {
+		memcpy(group->key, m_key, m_keyLength);
+	}
+
+	group->chain = m_buckets[hash % m_bucketCount];
+	m_buckets[hash % m_bucketCount] = group;
+
+	if (m_tail) {
+		m_tail->next = group;
+	}
+	else {
+		m_head = group;
+	}
+
+	m_tail = group;
+	m_groupCount++;
+
+	//its group by values, in the layout RowSetToArray reads
+	for (int i = 0; i < m_groupByCount; i++) {
+		WriteCell(&m_groupRows, &m_cells[m_groupBy[i].index]);
+	}
+
+	m_groupRows.rowCount++;
+
+	if (m_groupCount > m_bucketCount * 2) {
+		Grow();
+	}
+
+	return group;
+}
+
+void ODBCAggregate::Grow() {
+	size_t bucketCount = m_bucketCount * 4;
+	aggregate_group** buckets = (aggregate_group **) calloc(bucketCount, sizeof(aggregate_group *));
+
+	for (aggregate_group* group = m_head; group; group = group->next) {
+		group->chain = buckets[group->hash % bucketCount];
+		buckets[group->hash % bucketCount] = group;
+	}
+
+	free(m_buckets);
+	m_buckets = buckets;
+	m_bucketCount = bucketCount;
+}
+
+static void Accumulate(aggregate_state* state, int fn, aggregate_cell* cell) {
+	if (fn == AGGREGATE_COUNT) {
+		if (!cell || cell->tag != ROWSET_NULL) {
+			state->count++;
+		}
+
+		return;
+	}
+
+	//nulls and, on Windows, timestamps which could not be parsed
+	if (cell->tag != ROWSET_INTEGER && cell->tag != ROWSET_NUMBER && cell->tag != ROWSET_DATE && cell->tag != ROWSET_BOOLEAN) {
+		return;
+	}
+
+	if (state->count == 0) {
+		state->value = cell->number;
+		state->tag = cell->tag;
+	}
+	else if (fn == AGGREGATE_SUM || fn == AGGREGATE_AVG) {
+		state->value += cell->number;
+	}
+	else if ((fn == AGGREGATE_MIN) ? (cell->number < state->value) : (cell->number > state->value)) {
+		state->value = cell->number;
+	}
+
+	state->count++;
+}
+
+bool ODBCAggregate::Add(RowSet* rowSet) {
+	const char* cursor = rowSet->data;
+
+	for (int row = 0; row < rowSet->rowCount; row++) {
+		bool matches = true;
+
+		for (int i = 0; i < m_colCount; i++) {
+			cursor = ReadCell(rowSet->data, cursor, &m_cells[i]);
+		}
+
+		m_rows++;
+
+		for (int i = 0; i < m_predicateCount && matches; i++) {
+			matches = Matches(&m_predicates[i]);
+		}
+
+		if (!matches) {
+			continue;
+		}
+
+		m_matched++;
+		m_keyLength = 0;
+
+		for (int i = 0; i < m_groupByCount; i++) {
+			aggregate_cell* cell = &m_cells[m_groupBy[i].index];
+
+			AppendKey(&m_key, &m_keyLength, &m_keyCapacity, &cell->tag, sizeof(cell->tag));
+
+			if (cell->tag == ROWSET_STRING || cell->tag == ROWSET_CHARS) {
+				AppendKey(&m_key, &m_keyLength, &m_keyCapacity, &cell->length, sizeof(cell->length));
+				AppendKey(&m_key, &m_keyLength, &m_keyCapacity, cell->data, cell->length);
+			}
+			else if (cell->tag != ROWSET_NULL) {
+				AppendKey(&m_key, &m_keyLength, &m_keyCapacity, &cell->number, sizeof(cell->number));
+			}
+		}
+
+		aggregate_group* group = Group(ODBCHash(m_key, m_keyLength));
+
+		if (!group) {
+			return false;
+		}
+
+		for (int i = 0; i < m_outputCount; i++) {
+			int index = m_outputs[i].column.index;
+
+			Accumulate(&group->states[i], m_outputs[i].fn, (index < 0) ? NULL : &m_cells[index]);
+		}
+	}
+
+	return true;
+}
+
+/*
+ * ToArray
+ */
+static Local<Value> StateValue(v8::Isolate* isolate, int fn, aggregate_state* state) {
+	if (fn == AGGREGATE_COUNT) {
+		return Number::New(isolate, (double) state->count);
+	}
+	else if (state->count == 0) {
+		return Null(isolate);
+	}
+	else if (fn == AGGREGATE_AVG) {
+		return Number::New(isolate, state->value / state->count);
+	}
+	else if (state->tag == ROWSET_DATE && fn != AGGREGATE_SUM) {
+		return Date::New(isolate, state->value);
+	}
+
+	return Number::New(isolate, state->value);
+}
+
+Local<Array> ODBCAggregate::ToArray(v8::Isolate* isolate) {
+	v8::EscapableHandleScope scope(isolate);
+
+	Local<Array> rows = ODBC::RowSetToArray(&m_groupRows, FETCH_OBJECT);
+	Local<String>* names = new Local<String>[m_outputCount + 1];
+	uint32_t row = 0;
+
+	for (int i = 0; i < m_outputCount; i++) {
+		names[i] = String::NewFromUtf8(isolate, m_outputs[i].as);
+	}
+
+	for (aggregate_group* group = m_head; group; group = group->next, row++) {
+		Local<Object> record = rows->Get(row)->ToObject();
+
+		for (int i = 0; i < m_outputCount; i++) {
+			record->Set(names[i], StateValue(isolate, m_outputs[i].fn, &group->states[i]));
+		}
+	}
+
+	delete [] names;
+
+	return scope.Escape(rows);
+}
+
+Local<Object> ODBCAggregate::Info(v8::Isolate* isolate) {
+	v8::EscapableHandleScope scope(isolate);
+
+	Local<Object> info = Object::New(isolate);
+
+	info->Set(String::NewFromUtf8(isolate, "rows"), Number::New(isolate, (double) m_rows));
+	info->Set(String::NewFromUtf8(isolate, "matched"), Number::New(isolate, (double) m_matched));
+	info->Set(String::NewFromUtf8(isolate, "groups"), Number::New(isolate, (double) m_groupCount));
+
+	return scope.Escape(info);
+}
@@ -0,0 +1,167 @@
+/*
+  Copyright (c) 2013, Dan VerWeire <dverweire@gmail.com>
+
+  Permission to use, copy, modify, and/or distribute this software for any
+  purpose with or without fee is hereby granted, provided that the above
+  copyright notice and this permission notice appear in all copies.
+
+  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+
+#ifndef _SRC_ODBC_AGGREGATE_H
+#define _SRC_ODBC_AGGREGATE_H
+
+//rows read per FetchRowSet() while aggregating
+#define AGGREGATE_BATCH_ROWS 1024
+#define AGGREGATE_INITIAL_BUCKETS 256
+//default for the maxGroups option
+#define AGGREGATE_MAX_GROUPS 1000000
+
+//functions of select
+#define AGGREGATE_COUNT 0
+#define AGGREGATE_SUM 1
+#define AGGREGATE_AVG 2
+#define AGGREGATE_MIN 3
+#define AGGREGATE_MAX 4
+
+//operators of where
+#define PREDICATE_EQ 0
+#define PREDICATE_NE 1
+#define PREDICATE_LT 2
+#define PREDICATE_LE 3
+#define PREDICATE_GT 4
+#define PREDICATE_GE 5
+#define PREDICATE_IN 6
+#define PREDICATE_NULL 7
+#define PREDICATE_NOT_NULL 8
+
+//A column named in the spec. index is set by Bind(), and is -1 for the
+//'*' of count.
+typedef struct {
+  //UTF-8, for error messages
+  char *name;
+  //the name as GetColumns() stores it (UTF-16 with UNICODE)
+  void *tname;
+  int index;
+} aggregate_column;
+
+//A constant of a predicate, kept in every form a cell may be compared in
+typedef struct {
+  bool isText;
+  double number;
+  char *text;
+  uint32_t textLength;
+  uint16_t *wide;
+  uint32_t wideLength;
+} aggregate_value;
+
+typedef struct {
+  aggregate_column column;
+  int op;
+  aggregate_value *values;
+  int valueCount;
+} aggregate_predicate;
+
+typedef struct {
+  //property of the output rows, UTF-8
+  char *as;
+  int fn;
+  aggregate_column column;
+} aggregate_output;
+
+//running value of one output in one group
+typedef struct {
+  double value;
+  uint64_t count;
+  //ROWSET_ tag of the values, so that min and max of dates stay dates
+  uint8_t tag;
+} aggregate_state;
+
+typedef struct aggregate_group {
+  uint32_t hash;
+  char *key;
+  size_t keyLength;
+  aggregate_state *states;
+  //next group in the same hash bucket
+  struct aggregate_group *chain;
+  //next group in the order they were first seen
+  struct aggregate_group *next;
+} aggregate_group;
+
+//One cell of the row being folded, pointing into its RowSet
+typedef struct {
+  uint8_t tag;
+  double number;
+  const char *data;
+  //bytes of data
+  uint32_t length;
+} aggregate_cell;
+
+//result.aggregate(spec): filters, groups and aggregates the rows of a
+//result set as they are fetched on the worker thread, so that only one
+//object per group is ever created in V8. New() and ToArray() run on the
+//main thread, Bind() and Add() on the worker.
+class ODBCAggregate {
+  public:
+    //NULL with *error set if spec is not valid
+    static ODBCAggregate* New(v8::Isolate* isolate, v8::Local<v8::Object> spec, const char** error);
+    ~ODBCAggregate();
+
+    //resolve the column names against the result set
+    bool Bind(Column* columns, short colCount);
+    //fold the rows of rowSet into the groups
+    bool Add(RowSet* rowSet);
+
+    //one object per group: its group by values followed by the outputs.
+    //Uses the names of the bound columns, so it must be called before they
+    //are freed.
+    v8::Local<v8::Array> ToArray(v8::Isolate* isolate);
+    //{ rows, matched, groups }
+    v8::Local<v8::Object> Info(v8::Isolate* isolate);
+
+    //message of the last failed Bind() or Add()
+    const char* Error() { return m_error[0] ? m_error : NULL; }
+
+  protected:
+    ODBCAggregate();
+
+    bool Matches(aggregate_predicate* predicate);
+    aggregate_group* Group(uint32_t hash);
+    void Grow();
+
+    aggregate_predicate *m_predicates;
+    int m_predicateCount;
+    aggregate_column *m_groupBy;
+    int m_groupByCount;
+    aggregate_output *m_outputs;
+    int m_outputCount;
+
+    aggregate_cell *m_cells;
+    short m_colCount;
+    //key of the current row
+    char *m_key;
+    size_t m_keyLength;
+    size_t m_keyCapacity;
+
+    aggregate_group **m_buckets;
+    size_t m_bucketCount;
+    aggregate_group *m_head;
+    aggregate_group *m_tail;
+    size_t m_groupCount;
+    size_t m_maxGroups;
+    //the group by values of every group, one row per group
+    RowSet m_groupRows;
+
+    uint64_t m_rows;
+    uint64_t m_matched;
+    char m_error[256];
+};
+
+#endif
@@ -0,0 +1,60 @@
+/*
+  Copyright (c) 2013, Dan VerWeire <dverweire@gmail.com>
+
+  Permission to use, copy, modify, and/or distribute this software for any
+  purpose with or without fee is hereby granted, provided that the above
+  copyright notice and this permission notice appear in all copies.
+
+  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+#ifndef _SRC_ODBC_ATOMIC_H
+#define _SRC_ODBC_ATOMIC_H
+
+//Minimal set of atomic operations used by the executor queues and the
+//runtime counters. The compilers we build with (gcc/clang on unix, msvc on
+//windows) all have intrinsics for these, so there is no need for a library.
+
+#ifdef _WIN32
+    #include <windows.h>
+
+    #define ODBC_ATOMIC_INC(ptr) InterlockedIncrement((volatile LONG *)(ptr))
+    #define ODBC_ATOMIC_DEC(ptr) InterlockedDecrement((volatile LONG *)(ptr))
+    #define ODBC_ATOMIC_ADD(ptr, val) (InterlockedExchangeAdd((volatile LONG *)(ptr), (LONG)(val)) + (LONG)(val))
+    #define ODBC_ATOMIC_ADD64(ptr, val) (InterlockedExchangeAdd64((volatile LONGLONG *)(ptr), (LONGLONG)(val)) + (LONGLONG)(val))
+    #define ODBC_ATOMIC_LOAD64(ptr) InterlockedCompareExchange64((volatile LONGLONG *)(ptr), 0, 0)
+    #define ODBC_ATOMIC_STORE64(ptr, val) InterlockedExchange64((volatile LONGLONG *)(ptr), (LONGLONG)(val))
+    #define ODBC_ATOMIC_LOAD(ptr) (*(volatile LONG *)(ptr))
+    #define ODBC_ATOMIC_STORE(ptr, val) InterlockedExchange((volatile LONG *)(ptr), (LONG)(val))
+    #define ODBC_ATOMIC_FENCE() MemoryBarrier()
+    #define ODBC_ATOMIC_XCHG_PTR(ptr, val) InterlockedExchangePointer((PVOID volatile *)(ptr), (PVOID)(val))
+    #define ODBC_ATOMIC_LOAD_PTR(ptr) InterlockedCompareExchangePointer((PVOID volatile *)(ptr), NULL, NULL)
+    #define ODBC_ATOMIC_STORE_PTR(ptr, val) InterlockedExchangePointer((PVOID volatile *)(ptr), (PVOID)(val))
+    #define ODBC_CPU_RELAX() YieldProcessor()
+#else
+    #define ODBC_ATOMIC_INC(ptr) __atomic_add_fetch((ptr), 1, __ATOMIC_ACQ_REL)
+    #define ODBC_ATOMIC_DEC(ptr) __atomic_sub_fetch((ptr), 1, __ATOMIC_ACQ_REL)
+    #define ODBC_ATOMIC_ADD(ptr, val) __atomic_add_fetch((ptr), (val), __ATOMIC_ACQ_REL)
+    #define ODBC_ATOMIC_ADD64(ptr, val) __atomic_add_fetch((ptr), (val), __ATOMIC_RELAXED)
+    #define ODBC_ATOMIC_LOAD64(ptr) __atomic_load_n((ptr), __ATOMIC_ACQUIRE)
+    #define ODBC_ATOMIC_STORE64(ptr, val) __atomic_store_n((ptr), (val), __ATOMIC_RELEASE)
+    #define ODBC_ATOMIC_LOAD(ptr) __atomic_load_n((ptr), __ATOMIC_RELAXED)
+    #define ODBC_ATOMIC_STORE(ptr, val) __atomic_store_n((ptr), (val), __ATOMIC_RELAXED)
+    #define ODBC_ATOMIC_FENCE() __atomic_thread_fence(__ATOMIC_SEQ_CST)
+    #define ODBC_ATOMIC_XCHG_PTR(ptr, val) __atomic_exchange_n((ptr), (val), __ATOMIC_ACQ_REL)
+    #define ODBC_ATOMIC_LOAD_PTR(ptr) __atomic_load_n((ptr), __ATOMIC_ACQUIRE)
+    #define ODBC_ATOMIC_STORE_PTR(ptr, val) __atomic_store_n((ptr), (val), __ATOMIC_RELEASE)
+    #if defined(__i386__) || defined(__x86_64__)
+        #define ODBC_CPU_RELAX() __asm__ __volatile__("pause")
+    #else
+        #define ODBC_CPU_RELAX() __asm__ __volatile__("" ::: "memory")
+    #endif
+#endif
+
+#endif
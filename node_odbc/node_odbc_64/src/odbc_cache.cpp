@@ -0,0 +1,456 @@
+/*
+  Copyright (c) 2013, Dan VerWeire <dverweire@gmail.com>
+
+  Permission to use, copy, modify, and/or distribute this software for any
+  purpose with or without fee is hereby granted, provided that the above
+  copyright notice and this permission notice appear in all copies.
+
+  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+#include <string.h>
+#include <v8.h>
+#include <node.h>
+#include <node_version.h>
+#include <uv.h>
+
+#include "odbc.h"
+#include "odbc_cache.h"
+
+#define ODBC_TRACE_CATEGORY TRACE_CACHE
+
+using namespace v8;
+using namespace node;
+
+//FNV-1a
+static uint32_t HashKey(const char* key) {
+	uint32_t hash = 2166136261u;
+
+	while (*key) {
+		hash ^= (uint8_t) *key++;
+		hash *= 16777619u;
+	}
+
+	return hash;
+}
+
+static void FreeEntry(cache_entry* entry) {
+	for (int i = 0; i < entry->tagCount; i++) {
+		free(entry->tags[i]);
+	}
+
+	free(entry->tags);
+	free(entry->key);
+
+	ODBC::FreeRowSet(entry->rowSet);
+
+	free(entry);
+}
+
+void ODBCCache::Init(v8::Handle<Object> target) {
+	DEBUG_PRINTF("ODBCCache::Init\n");
+	v8::Isolate* isolate = v8::Isolate::GetCurrent();
+	v8::EscapableHandleScope scope(isolate);
+
+	Local<FunctionTemplate> t = FunctionTemplate::New(isolate, ODBCCache::New);
+
+	t->SetClassName(String::NewFromUtf8(isolate, "ODBCCache", String::kInternalizedString));
+
+	// Reserve space for one Handle<Value>
+	Local<ObjectTemplate> instance_template = t->InstanceTemplate();
+	instance_template->SetInternalFieldCount(1);
+
+	// Prototype Methods
+	NODE_SET_PROTOTYPE_METHOD(t, "get", Get);
+	NODE_SET_PROTOTYPE_METHOD(t, "set", Set);
+	NODE_SET_PROTOTYPE_METHOD(t, "invalidate", Invalidate);
+	NODE_SET_PROTOTYPE_METHOD(t, "clear", Clear);
+	NODE_SET_PROTOTYPE_METHOD(t, "stats", Stats);
+
+	// Attach the Cache Constructor to the target object
+	target->Set(v8::String::NewFromUtf8(isolate, "ODBCCache", String::kInternalizedString), t->GetFunction());
+}
+
+ODBCCache::ODBCCache(size_t maxBytes, uint64_t ttl):
+	ObjectWrap(),
+	m_bucketCount(CACHE_INITIAL_BUCKETS),
+	m_count(0),
+	m_head(NULL),
+	m_tail(NULL),
+	m_bytes(0),
+	m_maxBytes(maxBytes),
+	m_ttl(ttl),
+	m_hits(0),
+	m_misses(0),
+	m_expired(0),
+	m_evictions(0),
+	m_invalidations(0) {
+	m_buckets = (cache_entry **) calloc(m_bucketCount, sizeof(cache_entry *));
+}
+
+ODBCCache::~ODBCCache() {
+	DEBUG_PRINTF("ODBCCache::~ODBCCache\n");
+
+	while (m_head) {
+		Remove(m_head);
+	}
+
+	free(m_buckets);
+}
+
+/*
+ * New
+ *
+ * new ODBCCache([maxBytes], [ttl])
+ */
+void ODBCCache::New(const v8::FunctionCallbackInfo<v8::Value>& args) {
+	DEBUG_PRINTF("ODBCCache::New\n");
+	v8::Isolate* isolate = args.GetIsolate();
+	v8::EscapableHandleScope scope(isolate);
+
+	double maxBytes = CACHE_DEFAULT_MAX_BYTES;
+	double ttl = CACHE_DEFAULT_TTL;
+
+	if (args.Length() > 0 && !args[0]->IsUndefined()) {
+		if (!args[0]->IsNumber() || args[0]->NumberValue() <= 0) {
+			isolate->ThrowException(Exception::TypeError(String::NewFromUtf8(isolate, "ODBCCache(): Argument 0 must be a positive Number")));
+			throw Exception::TypeError(String::NewFromUtf8(isolate, "ODBCCache(): Argument 0 must be a positive Number"));
+		}
+
+		maxBytes = args[0]->NumberValue();
+	}
+
+	if (args.Length() > 1 && !args[1]->IsUndefined()) {
+		if (!args[1]->IsNumber() || args[1]->NumberValue() < 0) {
+			isolate->ThrowException(Exception::TypeError(String::NewFromUtf8(isolate, "ODBCCache(): Argument 1 must be a Number")));
+			throw Exception::TypeError(String::NewFromUtf8(isolate, "ODBCCache(): Argument 1 must be a Number"));
+		}
+
+		ttl = args[1]->NumberValue();
+	}
+
+	ODBCCache* cache = new ODBCCache((size_t) maxBytes, (uint64_t) ttl);
+
+	cache->Wrap(args.Holder());
+
+	args.GetReturnValue().Set(args.Holder());
+}
+
+cache_entry* ODBCCache::Find(const char* key, uint32_t hash) {
+	for (cache_entry* entry = m_buckets[hash % m_bucketCount]; entry; entry = entry->chain) {
+		if (entry->hash == hash && strcmp(entry->key, key) == 0) {
+			return entry;
+		}
+	}
+
+	return NULL;
+}
+
+void ODBCCache::Insert(cache_entry* entry) {
+	if (m_count >= m_bucketCount * 2) {
+		Grow();
+	}
+
+	cache_entry** bucket = &m_buckets[entry->hash % m_bucketCount];
+
+	entry->chain = *bucket;
+	*bucket = entry;
+
+	entry->prev = NULL;
+	entry->next = m_head;
+
+	if (m_head) {
+		m_head->prev = entry;
+	}
+
+	m_head = entry;
+
+	if (!m_tail) {
+		m_tail = entry;
+	}
+
+	m_count++;
+	m_bytes += entry->bytes;
+}
+
+void ODBCCache::Remove(cache_entry* entry) {
+	for (cache_entry** link = &m_buckets[entry->hash % m_bucketCount]; *link; link = &(*link)->chain) {
+		if (*link == entry) {
+			*link = entry->chain;
+			break;
+		}
+	}
+
+	if (entry->prev) {
+		entry->prev->next = entry->next;
+	}
+	else {
+		m_head = entry->next;
+	}
+
+	if (entry->next) {
+		entry->next->prev = entry->prev;
+	}
+	else {
+		m_tail = entry->prev;
+	}
+
+	m_count--;
+	m_bytes -= entry->bytes;
+
+	FreeEntry(entry);
+}
+
+//move an entry to the front of the LRU list
+void ODBCCache::Touch(cache_entry* entry) {
+	if (entry == m_head) {
+		return;
+	}
+
+	entry->prev->next = entry->next;
+
+	if (entry->next) {
+		entry->next->prev = entry->prev;
+	}
+	else {
+		m_tail = entry->prev;
+	}
+
+	entry->prev = NULL;
+	entry->next = m_head;
+	m_head->prev = entry;
+	m_head = entry;
+}
+
+void ODBCCache::Grow() {
+	size_t bucketCount = m_bucketCount * 2;
+	cache_entry** buckets = (cache_entry **) calloc(bucketCount, sizeof(cache_entry *));
+
+	for (size_t i = 0; i < m_bucketCount; i++) {
+		cache_entry* entry = m_buckets[i];
+
+		while (entry) {
+			cache_entry* chain = entry->chain;
+
+			entry->chain = buckets[entry->hash % bucketCount];
+			buckets[entry->hash % bucketCount] = entry;
+
+			entry = chain;
+		}
+	}
+
+	free(m_buckets);
+
+	m_buckets = buckets;
+	m_bucketCount = bucketCount;
+}
+
+/*
+ * Get
+ *
+ * get(key) -> rows or undefined
+ */
+void ODBCCache::Get(const v8::FunctionCallbackInfo<v8::Value>& args) {
+	v8::Isolate* isolate = args.GetIsolate();
+	v8::EscapableHandleScope scope(isolate);
+
+	ODBCCache* cache = ObjectWrap::Unwrap<ODBCCache>(args.Holder());
+
+	if (args.Length() <= (0) || !args[0]->IsString()) {
+		isolate->ThrowException(Exception::TypeError(String::NewFromUtf8(isolate, "ODBCCache::Get(): Argument 0 must be a String")));
+		throw Exception::TypeError(String::NewFromUtf8(isolate, "ODBCCache::Get(): Argument 0 must be a String"));
+	}
+
+	String::Utf8Value key(args[0]->ToString());
+	cache_entry* entry = cache->Find(*key, HashKey(*key));
+
+	if (entry && entry->expires && uv_now(ODBC::State()->loop) >= entry->expires) {
+		cache->m_expired++;
+		cache->Remove(entry);
+		entry = NULL;
+	}
+
+	if (!entry) {
+		cache->m_misses++;
+
+		args.GetReturnValue().SetUndefined();
+		return;
+	}
+
+	cache->m_hits++;
+	cache->Touch(entry);
+
+	args.GetReturnValue().Set(ODBC::RowSetToArray(entry->rowSet, entry->fetchMode));
+}
+
+/*
+ * Set
+ *
+ * set(key, rows, [ttl], [tags]) -> true if the rows were cached
+ *
+ * A ttl of 0 keeps the rows until they are evicted or invalidated.
+ */
+void ODBCCache::Set(const v8::FunctionCallbackInfo<v8::Value>& args) {
+	v8::Isolate* isolate = args.GetIsolate();
+	v8::EscapableHandleScope scope(isolate);
+
+	ODBCCache* cache = ObjectWrap::Unwrap<ODBCCache>(args.Holder());
+
+	if (args.Length() < 2 || !args[0]->IsString() || !args[1]->IsArray()) {
+		isolate->ThrowException(Exception::TypeError(String::NewFromUtf8(isolate, "ODBCCache::Set(): Requires a String and an Array")));
+		throw Exception::TypeError(String::NewFromUtf8(isolate, "ODBCCache::Set(): Requires a String and an Array"));
+	}
+
+	String::Utf8Value key(args[0]->ToString());
+	uint64_t ttl = cache->m_ttl;
+
+	if (args.Length() > 2 && args[2]->IsNumber() && args[2]->NumberValue() >= 0) {
+		ttl = (uint64_t) args[2]->NumberValue();
+	}
+
+	int fetchMode;
+	RowSet* rowSet = ODBC::ArrayToRowSet(Local<Array>::Cast(args[1]), &fetchMode);
+
+	if (!rowSet) {
+		args.GetReturnValue().Set(False(isolate));
+		return;
+	}
+
+	cache_entry* entry = (cache_entry *) calloc(1, sizeof(cache_entry));
+
+	entry->key = strdup(*key);
+	entry->hash = HashKey(*key);
+	entry->rowSet = rowSet;
+	entry->fetchMode = fetchMode;
+	entry->expires = (ttl) ? uv_now(ODBC::State()->loop) + ttl : 0;
+	entry->bytes = sizeof(cache_entry) + key.length() + rowSet->capacity + (rowSet->colCount * sizeof(Column));
+
+	for (int i = 0; i < rowSet->colCount; i++) {
+		entry->bytes += rowSet->columns[i].len + 1;
+	}
+
+	if (args.Length() > 3 && args[3]->IsArray()) {
+		Local<Array> tags = Local<Array>::Cast(args[3]);
+
+		entry->tagCount = tags->Length();
+		entry->tags = (char **) calloc(entry->tagCount, sizeof(char *));
+
+		for (int i = 0; i < entry->tagCount; i++) {
+			String::Utf8Value tag(tags->Get(i)->ToString());
+
+			entry->tags[i] = strdup(*tag);
+			entry->bytes += tag.length() + 1 + sizeof(char *);
+		}
+	}
+
+	cache_entry* previous = cache->Find(entry->key, entry->hash);
+
+	if (previous) {
+		cache->Remove(previous);
+	}
+
+	if (entry->bytes > cache->m_maxBytes) {
+		FreeEntry(entry);
+
+		args.GetReturnValue().Set(False(isolate));
+		return;
+	}
+
+	cache->Insert(entry);
+
+	while (cache->m_bytes > cache->m_maxBytes && cache->m_tail != entry) {
+		cache->m_evictions++;
+		cache->Remove(cache->m_tail);
+	}
+
+	args.GetReturnValue().Set(True(isolate));
+}
+
+/*
+ * Invalidate
+ *
+ * invalidate(tag) -> number of entries dropped
+ */
+void ODBCCache::Invalidate(const v8::FunctionCallbackInfo<v8::Value>& args) {
+	v8::Isolate* isolate = args.GetIsolate();
+	v8::EscapableHandleScope scope(isolate);
+
+	ODBCCache* cache = ObjectWrap::Unwrap<ODBCCache>(args.Holder());
+
+	if (args.Length() <= (0) || !args[0]->IsString()) {
+		isolate->ThrowException(Exception::TypeError(String::NewFromUtf8(isolate, "ODBCCache::Invalidate(): Argument 0 must be a String")));
+		throw Exception::TypeError(String::NewFromUtf8(isolate, "ODBCCache::Invalidate(): Argument 0 must be a String"));
+	}
+
+	String::Utf8Value tag(args[0]->ToString());
+	int count = 0;
+	cache_entry* entry = cache->m_head;
+
+	while (entry) {
+		cache_entry* next = entry->next;
+
+		for (int i = 0; i < entry->tagCount; i++) {
+			if (strcmp(entry->tags[i], *tag) == 0) {
+				cache->Remove(entry);
+				count++;
+				break;
+			}
+		}
+
+		entry = next;
+	}
+
+	cache->m_invalidations += count;
+
+	args.GetReturnValue().Set(Integer::New(isolate, count));
+}
+
+/*
+ * Clear
+ */
+void ODBCCache::Clear(const v8::FunctionCallbackInfo<v8::Value>& args) {
+	v8::Isolate* isolate = args.GetIsolate();
+	v8::EscapableHandleScope scope(isolate);
+
+	ODBCCache* cache = ObjectWrap::Unwrap<ODBCCache>(args.Holder());
+
+	while (cache->m_head) {
+		cache->m_invalidations++;
+		cache->Remove(cache->m_head);
+	}
+
+	args.GetReturnValue().SetUndefined();
+}
+
+/*
+ * Stats
+ *
+ * stats() -> { entries, bytes, maxBytes, hits, misses, hitRatio, expired,
+ *   evictions, invalidations }
+ */
+void ODBCCache::Stats(const v8::FunctionCallbackInfo<v8::Value>& args) {
+	v8::Isolate* isolate = args.GetIsolate();
+	v8::EscapableHandleScope scope(isolate);
+
+	ODBCCache* cache = ObjectWrap::Unwrap<ODBCCache>(args.Holder());
+	Local<Object> stats = Object::New(isolate);
+	uint64_t lookups = cache->m_hits + cache->m_misses;
+
+	stats->Set(String::NewFromUtf8(isolate, "entries"), Number::New(isolate, (double) cache->m_count));
+	stats->Set(String::NewFromUtf8(isolate, "bytes"), Number::New(isolate, (double) cache->m_bytes));
+	stats->Set(String::NewFromUtf8(isolate, "maxBytes"), Number::New(isolate, (double) cache->m_maxBytes));
+	stats->Set(String::NewFromUtf8(isolate, "hits"), Number::New(isolate, (double) cache->m_hits));
+	stats->Set(String::NewFromUtf8(isolate, "misses"), Number::New(isolate, (double) cache->m_misses));
+	stats->Set(String::NewFromUtf8(isolate, "hitRatio"), Number::New(isolate, (lookups) ? (double) cache->m_hits / lookups : 0));
+	stats->Set(String::NewFromUtf8(isolate, "expired"), Number::New(isolate, (double) cache->m_expired));
+	stats->Set(String::NewFromUtf8(isolate, "evictions"), Number::New(isolate, (double) cache->m_evictions));
+	stats->Set(String::NewFromUtf8(isolate, "invalidations"), Number::New(isolate, (double) cache->m_invalidations));
+
+	args.GetReturnValue().Set(stats);
+}
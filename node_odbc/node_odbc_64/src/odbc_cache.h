@@ -0,0 +1,83 @@
+/*
+  Copyright (c) 2013, Dan VerWeire <dverweire@gmail.com>
+
+  Permission to use, copy, modify, and/or distribute this software for any
+  purpose with or without fee is hereby granted, provided that the above
+  copyright notice and this permission notice appear in all copies.
+
+  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+#ifndef _SRC_ODBC_CACHE_H
+#define _SRC_ODBC_CACHE_H
+
+#define CACHE_DEFAULT_MAX_BYTES (16 * 1024 * 1024)
+#define CACHE_DEFAULT_TTL 60000
+#define CACHE_INITIAL_BUCKETS 256
+
+//One cached result: the rows are kept as a RowSet, outside of the V8 heap,
+//and only turned back into JS values on a hit.
+typedef struct cache_entry {
+  char *key;
+  uint32_t hash;
+  RowSet *rowSet;
+  int fetchMode;
+  char **tags;
+  int tagCount;
+  uint64_t expires;
+  size_t bytes;
+  //next entry in the same hash bucket
+  struct cache_entry *chain;
+  //least recently used list, most recent first
+  struct cache_entry *prev;
+  struct cache_entry *next;
+} cache_entry;
+
+class ODBCCache : public node::ObjectWrap {
+  public:
+    static void Init(v8::Handle<Object> target);
+
+  protected:
+    ODBCCache(size_t maxBytes, uint64_t ttl);
+    ~ODBCCache();
+
+    //constructor
+	static void New(const v8::FunctionCallbackInfo<v8::Value>& info);
+
+    //sync methods
+	static void Get(const v8::FunctionCallbackInfo<v8::Value>& info);
+	static void Set(const v8::FunctionCallbackInfo<v8::Value>& info);
+	static void Invalidate(const v8::FunctionCallbackInfo<v8::Value>& info);
+	static void Clear(const v8::FunctionCallbackInfo<v8::Value>& info);
+	static void Stats(const v8::FunctionCallbackInfo<v8::Value>& info);
+
+    cache_entry* Find(const char* key, uint32_t hash);
+    void Insert(cache_entry* entry);
+    void Remove(cache_entry* entry);
+    void Touch(cache_entry* entry);
+    void Grow();
+
+    cache_entry **m_buckets;
+    size_t m_bucketCount;
+    size_t m_count;
+    cache_entry *m_head;
+    cache_entry *m_tail;
+
+    size_t m_bytes;
+    size_t m_maxBytes;
+    uint64_t m_ttl;
+
+    uint64_t m_hits;
+    uint64_t m_misses;
+    uint64_t m_expired;
+    uint64_t m_evictions;
+    uint64_t m_invalidations;
+};
+
+#endif
@@ -25,15 +25,52 @@
 #include "odbc.h"
 #include "odbc_connection.h"
 #include "odbc_result.h"
+#include "odbc_stats.h"
 #include "odbc_statement.h"
+#include "odbc_executor.h"
+#include "odbc_shared_pool.h"
+#include "odbc_metrics.h"
+#include "odbc_slowlog.h"
+#include "odbc_probes.h"
+#include "odbc_narrow.h"
+
+#define ODBC_TRACE_CATEGORY TRACE_CONNECTION
 
 using namespace v8;
 using namespace node;
 
-Persistent<FunctionTemplate> ODBCConnection::constructor_template;
-Persistent<String> ODBCConnection::OPTION_SQL(v8::Isolate::GetCurrent(), String::NewFromUtf8(v8::Isolate::GetCurrent(), "sql"));
-Persistent<String> ODBCConnection::OPTION_PARAMS(v8::Isolate::GetCurrent(), String::NewFromUtf8(v8::Isolate::GetCurrent(), "params"));
-Persistent<String> ODBCConnection::OPTION_NORESULTS(v8::Isolate::GetCurrent(), String::NewFromUtf8(v8::Isolate::GetCurrent(), "noResults"));
+//ids of the connections of every isolate
+static int g_nextConnectionId = 0;
+
+
+/*
+ * FreeParameters
+ */
+static void FreeParameters(Parameter* params, int paramCount) {
+	for (int i = 0; i < paramCount; i++) {
+		Parameter prm = params[i];
+
+		if (prm.ParameterValuePtr != NULL) {
+			switch (prm.ValueType) {
+				case SQL_C_WCHAR:
+				case SQL_C_CHAR:
+					free(prm.ParameterValuePtr);
+					break;
+				case SQL_C_SBIGINT:
+					delete (int64_t *)prm.ParameterValuePtr;
+					break;
+				case SQL_C_DOUBLE:
+					delete (double *)prm.ParameterValuePtr;
+					break;
+				case SQL_C_BIT:
+					delete (bool *)prm.ParameterValuePtr;
+					break;
+			}
+		}
+	}
+
+	free(params);
+}
 
 void ODBCConnection::Init(v8::Handle<Object> target) {
 	DEBUG_PRINTF("ODBCConnection::Init\n");
@@ -43,7 +80,7 @@ void ODBCConnection::Init(v8::Handle<Object> target) {
 	Local<FunctionTemplate> t = FunctionTemplate::New(isolate, ODBCConnection::New);
 
 	// Constructor Template
-	constructor_template.Reset(isolate, t);
+	ODBC::State()->connectionTemplate.Reset(isolate, t);
 	t->SetClassName(String::NewFromUtf8(isolate, "ODBCConnection", String::kInternalizedString));
 
 	// Reserve space for one Handle<Value>
@@ -53,8 +90,10 @@ void ODBCConnection::Init(v8::Handle<Object> target) {
 	// Properties
 	//instance_template->SetAccessor(String::New("mode"), ModeGetter, ModeSetter);
 	instance_template->SetAccessor(String::NewFromUtf8(isolate, "connected"), ConnectedGetter);
+	instance_template->SetAccessor(String::NewFromUtf8(isolate, "id"), IdGetter);
 	instance_template->SetAccessor(String::NewFromUtf8(isolate, "connectTimeout"), ConnectTimeoutGetter, (AccessorSetterCallback)ConnectTimeoutSetter);
 	instance_template->SetAccessor(String::NewFromUtf8(isolate, "loginTimeout"), LoginTimeoutGetter, (AccessorSetterCallback)LoginTimeoutSetter);
+	instance_template->SetAccessor(String::NewFromUtf8(isolate, "encoding"), EncodingGetter, (AccessorSetterCallback)EncodingSetter);
   
 	// Prototype Methods
 	NODE_SET_PROTOTYPE_METHOD(t, "open", Open);
@@ -65,6 +104,8 @@ void ODBCConnection::Init(v8::Handle<Object> target) {
 	NODE_SET_PROTOTYPE_METHOD(t, "createStatementSync", CreateStatementSync);
 	NODE_SET_PROTOTYPE_METHOD(t, "query", Query);
 	NODE_SET_PROTOTYPE_METHOD(t, "querySync", QuerySync);
+	NODE_SET_PROTOTYPE_METHOD(t, "pipeline", Pipeline);
+	NODE_SET_PROTOTYPE_METHOD(t, "queryMulti", QueryMulti);
   
 	NODE_SET_PROTOTYPE_METHOD(t, "beginTransaction", BeginTransaction);
 	NODE_SET_PROTOTYPE_METHOD(t, "beginTransactionSync", BeginTransactionSync);
@@ -74,22 +115,57 @@ void ODBCConnection::Init(v8::Handle<Object> target) {
 	NODE_SET_PROTOTYPE_METHOD(t, "columns", Columns);
 	NODE_SET_PROTOTYPE_METHOD(t, "tables", Tables);
   
+	NODE_SET_PROTOTYPE_METHOD(t, "setExecutor", SetExecutor);
+  
 	// Attach the Database Constructor to the target object
 	target->Set(v8::String::NewFromUtf8(isolate, "ODBCConnection", String::kInternalizedString), t->GetFunction());
 }
 
 ODBCConnection::~ODBCConnection() {
 	DEBUG_PRINTF("ODBCConnection::~ODBCConnection\n");
-	this->Free();
+	this->FreeLater();
+  
+	ODBCThreadGroup::Release(m_worker);
+
+	uv_mutex_destroy(&m_pipelineLock);
+	free(m_pipelineBuffer);
+}
+
+/*
+ * FreeLater
+ *
+ * Free() on the event loop thread: a connection borrowed from a shared pool
+ * is rolled back and handed back on the threadpool instead.
+ */
+void ODBCConnection::FreeLater() {
+	if (m_sharedPool && m_hDBC) {
+		ODBCSharedPool::ReleaseLater(m_sharedPool, m_hDBC);
+		m_hDBC = NULL;
+	}
+
+	Free();
 }
 
 void ODBCConnection::Free() {
 	DEBUG_PRINTF("ODBCConnection::Free\n");
+	if (m_sharedPool) {
+		//hand the connection back instead of disconnecting it
+		if (m_hDBC) {
+			ODBCSharedPool::Release(m_sharedPool, m_hDBC);
+			m_hDBC = NULL;
+		}
+
+		return;
+	}
+
 	if (m_hDBC) {
 		uv_mutex_lock(&ODBC::g_odbcMutex);
     
 		if (m_hDBC) {
+			ODBC_COUNT_CALL(SQLDisconnect);
 			SQLDisconnect(m_hDBC);
+			ODBC_COUNT_CALL(SQLFreeHandle);
+			ODBCMetrics::Handle(SQL_HANDLE_DBC, m_hDBC, -1);
 			SQLFreeHandle(SQL_HANDLE_DBC, m_hDBC);
 			m_hDBC = NULL;
 		}
@@ -125,15 +201,39 @@ void ODBCConnection::New(const v8::FunctionCallbackInfo<v8::Value>& args) {
 	ODBCConnection* conn = new ODBCConnection(hENV, hDBC);
   
 	conn->Wrap(args.Holder());
+
+	conn->m_id = ODBC_ATOMIC_INC(&g_nextConnectionId);
   
 	//set default connectTimeout to 0 seconds
 	conn->connectTimeout = 0;
 	//set default loginTimeout to 5 seconds
 	conn->loginTimeout = 5;
 
+	//a connection from a shared pool arrives already connected
+	if (args.Length() > 3 && args[2]->IsExternal()) {
+		conn->m_sharedPool = static_cast<ODBCSharedPool*>(Local<External>::Cast(args[2])->Value());
+		conn->canHaveMoreResults = (SQLUSMALLINT) args[3]->Int32Value();
+		conn->connected = true;
+
+#if NODE_VERSION_AT_LEAST(0, 7, 9)
+		uv_ref((uv_handle_t *)&ODBC::State()->async);
+#else
+		uv_ref(uv_default_loop());
+#endif
+	}
+
 	args.GetReturnValue().Set(args.Holder());
 }
 
+void ODBCConnection::IdGetter(Local<String> property, const PropertyCallbackInfo<Value>& info) {
+	v8::Isolate* isolate = info.GetIsolate();
+	v8::EscapableHandleScope scope(isolate);
+
+	ODBCConnection *obj = ObjectWrap::Unwrap<ODBCConnection>(info.Holder());
+
+	info.GetReturnValue().Set(Integer::New(isolate, obj->m_id));
+}
+
 void ODBCConnection::ConnectedGetter(Local<String> property, const PropertyCallbackInfo<Value>& info) {
 	v8::Isolate* isolate = info.GetIsolate();
 	v8::EscapableHandleScope scope(isolate);
@@ -183,6 +283,41 @@ void ODBCConnection::LoginTimeoutSetter(Local<String> property, Local<Value> val
 	}
 }
 
+void ODBCConnection::EncodingGetter(Local<String> property, const PropertyCallbackInfo<Value>& info) {
+	v8::Isolate* isolate = info.GetIsolate();
+	v8::EscapableHandleScope scope(isolate);
+
+	ODBCConnection *obj = ObjectWrap::Unwrap<ODBCConnection>(info.Holder());
+
+	info.GetReturnValue().Set(String::NewFromUtf8(isolate, obj->m_utf8 ? "utf8" : "utf16"));
+}
+
+/*
+ * EncodingSetter
+ *
+ * 'utf8' sends SQL and string parameters and fetches text columns as
+ * UTF-8 through the ANSI functions; 'utf16' (the default) uses the wide
+ * functions. Statements and results take the encoding of the connection
+ * when they are created.
+ */
+void ODBCConnection::EncodingSetter(Local<String> property, Local<Value> value, const PropertyCallbackInfo<Value>& info) {
+	v8::Isolate* isolate = info.GetIsolate();
+	v8::EscapableHandleScope scope(isolate);
+
+	ODBCConnection *obj = ObjectWrap::Unwrap<ODBCConnection>(info.Holder());
+	String::Utf8Value encoding(value);
+
+	if (value->IsString() && (strcmp(*encoding, "utf8") == 0 || strcmp(*encoding, "utf-8") == 0)) {
+		obj->m_utf8 = true;
+	}
+	else if (value->IsString() && (strcmp(*encoding, "utf16") == 0 || strcmp(*encoding, "utf-16") == 0)) {
+		obj->m_utf8 = false;
+	}
+	else {
+		isolate->ThrowException(Exception::TypeError(String::NewFromUtf8(isolate, "encoding must be 'utf8' or 'utf16'")));
+	}
+}
+
 /*
  * Open
  * 
@@ -199,11 +334,20 @@ void ODBCConnection::Open(const v8::FunctionCallbackInfo<v8::Value>& args) {
 
 	Local<String> connection(args[0]->ToString());
 
-	if (args.Length() <= (1) || !args[1]->IsFunction()) {
+	Local<Function> cb;
+	Local<Promise> promise;
+
+	//open() without a callback returns a promise
+	if (args.Length() <= (1) || args[1]->IsUndefined()) {
+		cb = ODBC::PromiseCallback(isolate, &promise);
+	}
+	else if (!args[1]->IsFunction()) {
 		isolate->ThrowException(Exception::TypeError(String::NewFromUtf8(isolate, "Argument 1 must be a function")));
 		throw Exception::TypeError(String::NewFromUtf8(isolate, "Argument 1 must be a function"));
 	}
-	Local<Function> cb = Local<Function>::Cast(args[1]);
+	else {
+		cb = Local<Function>::Cast(args[1]);
+	}
 
 	//get reference to the connection object
 	ODBCConnection* conn = ObjectWrap::Unwrap<ODBCConnection>(args.Holder());
@@ -232,11 +376,16 @@ void ODBCConnection::Open(const v8::FunctionCallbackInfo<v8::Value>& args) {
 	work_req->data = data;
 
 	//queue the work
-	uv_queue_work(uv_default_loop(), work_req, UV_Open, (uv_after_work_cb)UV_AfterOpen);
+	ODBC::QueueWork(conn->m_worker, work_req, UV_Open, (uv_after_work_cb)UV_AfterOpen);
 
 	conn->Ref();
 
-	args.GetReturnValue().Set(args.Holder());
+	if (!promise.IsEmpty()) {
+		args.GetReturnValue().Set(promise);
+	}
+	else {
+		args.GetReturnValue().Set(args.Holder());
+	}
 }
 
 void ODBCConnection::UV_Open(uv_work_t* req) {
@@ -246,34 +395,48 @@ void ODBCConnection::UV_Open(uv_work_t* req) {
 	ODBCConnection* self = data->conn->self();
 
 	DEBUG_PRINTF("ODBCConnection::UV_Open : connectTimeout=%i, loginTimeout = %i\n", *&(self->connectTimeout), *&(self->loginTimeout));
+
+	uint64_t start = ODBC_PROBE_ENABLED(open__done) ? uv_hrtime() : 0;
+
+	ODBC_PROBE1(open__start, self->m_id);
   
 	uv_mutex_lock(&ODBC::g_odbcMutex); 
   
 	if (self->connectTimeout > 0) {
 		//NOTE: SQLSetConnectAttr requires the thread to be locked
 		//ConnectionHandle, Attribute, ValuePtr,StringLength
+		ODBC_COUNT_CALL(SQLSetConnectAttr);
 		SQLSetConnectAttr(self->m_hDBC, SQL_ATTR_CONNECTION_TIMEOUT, (SQLPOINTER) size_t(self->connectTimeout), SQL_IS_UINTEGER);
 	}
   
 	if (self->loginTimeout > 0) {
 		//NOTE: SQLSetConnectAttr requires the thread to be locked
 		//ConnectionHandle, Attribute, ValuePtr,StringLength
+		ODBC_COUNT_CALL(SQLSetConnectAttr);
 		SQLSetConnectAttr(self->m_hDBC, SQL_ATTR_LOGIN_TIMEOUT, (SQLPOINTER) size_t(self->loginTimeout), SQL_IS_UINTEGER);
 	}
   
 	//Attempt to connect
 	//NOTE: SQLDriverConnect requires the thread to be locked
 	//ConnectionHandle, WindowHandle, InConnectionString, StringLength1, OutConnectionString, BufferLength - in characters, StringLength2Ptr, DriverCompletion
+	ODBC_COUNT_CALL(SQLDriverConnect);
 	int ret = SQLDriverConnect(self->m_hDBC, NULL, (SQLTCHAR*) data->connection, data->connectionLength, NULL, 0, NULL, SQL_DRIVER_NOPROMPT);
+
+	if (ODBC_PROBE_ENABLED(open__done)) {
+		ODBC_PROBE3(open__done, self->m_id, ret, uv_hrtime() - start);
+	}
   
 	if (SQL_SUCCEEDED(ret)) {
 		HSTMT hStmt;
     
 		//allocate a temporary statment
+		ODBC_COUNT_CALL(SQLAllocHandle);
 		ret = SQLAllocHandle(SQL_HANDLE_STMT, self->m_hDBC, &hStmt);
+		ODBCMetrics::Handle(SQL_HANDLE_STMT, hStmt, 1);
     
 		//try to determine if the driver can handle
 		//multiple recordsets
+		ODBC_COUNT_CALL(SQLGetFunctions);
 		ret = SQLGetFunctions(self->m_hDBC, SQL_API_SQLMORERESULTS, &(self->canHaveMoreResults));
 
 		if (!SQL_SUCCEEDED(ret)) {
@@ -281,6 +444,8 @@ void ODBCConnection::UV_Open(uv_work_t* req) {
 		}
     
 		//free the handle
+		ODBC_COUNT_CALL(SQLFreeHandle);
+		ODBCMetrics::Handle(SQL_HANDLE_STMT, hStmt, -1);
 		ret = SQLFreeHandle( SQL_HANDLE_STMT, hStmt);
 	}
 
@@ -310,7 +475,7 @@ void ODBCConnection::UV_AfterOpen(uv_work_t* req, int status) {
 		data->conn->self()->connected = true;
 		//only uv_ref if the connection was successful
 #if NODE_VERSION_AT_LEAST(0, 7, 9)
-		uv_ref((uv_handle_t *)&ODBC::g_async);
+		uv_ref((uv_handle_t *)&ODBC::State()->async);
 #else
 		uv_ref(uv_default_loop());
 #endif
@@ -367,25 +532,36 @@ void ODBCConnection::OpenSync(const v8::FunctionCallbackInfo<v8::Value>& args) {
 	connection->WriteUtf8(connectionString);
 #endif
   
+	uint64_t start = ODBC_PROBE_ENABLED(open__done) ? uv_hrtime() : 0;
+
+	ODBC_PROBE1(open__start, conn->m_id);
+
 	uv_mutex_lock(&ODBC::g_odbcMutex);
   
 	if (conn->connectTimeout > 0) {
 		//NOTE: SQLSetConnectAttr requires the thread to be locked
 		//ConnectionHandle, Attribute, ValuePtr, StringLength
+		ODBC_COUNT_CALL(SQLSetConnectAttr);
 		SQLSetConnectAttr(conn->m_hDBC, SQL_ATTR_CONNECTION_TIMEOUT, (SQLPOINTER) size_t(conn->connectTimeout), SQL_IS_UINTEGER);
 	}
 
 	if (conn->loginTimeout > 0) {
 		//NOTE: SQLSetConnectAttr requires the thread to be locked
 		//ConnectionHandle, Attribute, ValuePtr, StringLength
+		ODBC_COUNT_CALL(SQLSetConnectAttr);
 		SQLSetConnectAttr(conn->m_hDBC, SQL_ATTR_LOGIN_TIMEOUT, (SQLPOINTER) size_t(conn->loginTimeout), SQL_IS_UINTEGER);
 	}
   
 	//Attempt to connect
 	//NOTE: SQLDriverConnect requires the thread to be locked
 	//ConnectionHandle, WindowHandle, InConnectionString, StringLength1, OutConnectionString, BufferLength - in characters, StringLength2Ptr, DriverCompletion
+	ODBC_COUNT_CALL(SQLDriverConnect);
 	ret = SQLDriverConnect(conn->m_hDBC, NULL, (SQLTCHAR*) connectionString, connectionLength, NULL, 0, NULL, SQL_DRIVER_NOPROMPT);
 
+	if (ODBC_PROBE_ENABLED(open__done)) {
+		ODBC_PROBE3(open__done, conn->m_id, ret, uv_hrtime() - start);
+	}
+
 	if (!SQL_SUCCEEDED(ret)) {
 		err = true;
 		objError = ODBC::GetSQLError(SQL_HANDLE_DBC, conn->self()->m_hDBC);
@@ -394,10 +570,13 @@ void ODBCConnection::OpenSync(const v8::FunctionCallbackInfo<v8::Value>& args) {
 		HSTMT hStmt;
     
 		//allocate a temporary statment
+		ODBC_COUNT_CALL(SQLAllocHandle);
 		ret = SQLAllocHandle(SQL_HANDLE_STMT, conn->m_hDBC, &hStmt);
+		ODBCMetrics::Handle(SQL_HANDLE_STMT, hStmt, 1);
     
 		//try to determine if the driver can handle
 		//multiple recordsets
+		ODBC_COUNT_CALL(SQLGetFunctions);
 		ret = SQLGetFunctions(conn->m_hDBC, SQL_API_SQLMORERESULTS, &(conn->canHaveMoreResults));
 
 		if (!SQL_SUCCEEDED(ret)) {
@@ -405,13 +584,15 @@ void ODBCConnection::OpenSync(const v8::FunctionCallbackInfo<v8::Value>& args) {
 		}
   
 		//free the handle
+		ODBC_COUNT_CALL(SQLFreeHandle);
+		ODBCMetrics::Handle(SQL_HANDLE_STMT, hStmt, -1);
 		ret = SQLFreeHandle( SQL_HANDLE_STMT, hStmt);
     
 		conn->self()->connected = true;
     
 		//only uv_ref if the connection was successful
 #if NODE_VERSION_AT_LEAST(0, 7, 9)
-		uv_ref((uv_handle_t *)&ODBC::g_async);
+		uv_ref((uv_handle_t *)&ODBC::State()->async);
 #else
 		uv_ref(uv_default_loop());
 #endif
@@ -459,7 +640,7 @@ void ODBCConnection::Close(const v8::FunctionCallbackInfo<v8::Value>& args) {
 
 	work_req->data = data;
   
-	uv_queue_work(uv_default_loop(), work_req, UV_Close, (uv_after_work_cb)UV_AfterClose);
+	ODBC::QueueWork(conn->m_worker, work_req, UV_Close, (uv_after_work_cb)UV_AfterClose);
 
 	conn->Ref();
 
@@ -500,7 +681,7 @@ void ODBCConnection::UV_AfterClose(uv_work_t* req, int status) {
     
 		//only unref if the connection was closed
 #if NODE_VERSION_AT_LEAST(0, 7, 9)
-		uv_unref((uv_handle_t *)&ODBC::g_async);
+		uv_unref((uv_handle_t *)&ODBC::State()->async);
 #else
 		uv_unref(uv_default_loop());
 #endif
@@ -536,12 +717,12 @@ void ODBCConnection::CloseSync(const v8::FunctionCallbackInfo<v8::Value>& args)
 	//TODO: check to see if there are any open statements
 	//on this connection
   
-	conn->Free();
+	conn->FreeLater();
   
 	conn->connected = false;
 
 #if NODE_VERSION_AT_LEAST(0, 7, 9)
-	uv_unref((uv_handle_t *)&ODBC::g_async);
+	uv_unref((uv_handle_t *)&ODBC::State()->async);
 #else
 	uv_unref(uv_default_loop());
 #endif
@@ -563,17 +744,22 @@ void ODBCConnection::CreateStatementSync(const v8::FunctionCallbackInfo<v8::Valu
 
 	uv_mutex_lock(&ODBC::g_odbcMutex);
   
+	ODBC_COUNT_CALL(SQLAllocHandle);
 	SQLAllocHandle(SQL_HANDLE_STMT, conn->m_hDBC, &hSTMT);
+	ODBCMetrics::Handle(SQL_HANDLE_STMT, hSTMT, 1);
   
 	uv_mutex_unlock(&ODBC::g_odbcMutex);
   
-	Local<Value> params[3];
+	Local<Value> params[4];
 	params[0] = External::New(isolate, conn->m_hENV);
 	params[1] = External::New(isolate, conn->m_hDBC);
 	params[2] = External::New(isolate, hSTMT);
+	params[3] = External::New(isolate, conn->m_worker);
   
-	v8::Local<v8::FunctionTemplate> ft = v8::Local<v8::FunctionTemplate>::New(isolate, ODBCConnection::constructor_template);
-	Local<Object> js_result = ft->GetFunction()->NewInstance(3, params);
+	v8::Local<v8::FunctionTemplate> ft = v8::Local<v8::FunctionTemplate>::New(isolate, ODBC::State()->statementTemplate);
+	Local<Object> js_result = ft->GetFunction()->NewInstance(4, params);
+	ObjectWrap::Unwrap<ODBCStatement>(js_result)->SetUTF8(conn->m_utf8);
+	ObjectWrap::Unwrap<ODBCStatement>(js_result)->SetConnectionId(conn->m_id);
 
 	args.GetReturnValue().Set(js_result);
 }
@@ -607,7 +793,7 @@ void ODBCConnection::CreateStatement(const v8::FunctionCallbackInfo<v8::Value>&
 
 	work_req->data = data;
   
-	uv_queue_work(uv_default_loop(), work_req, UV_CreateStatement, (uv_after_work_cb)UV_AfterCreateStatement);
+	ODBC::QueueWork(conn->m_worker, work_req, UV_CreateStatement, (uv_after_work_cb)UV_AfterCreateStatement);
 
 	conn->Ref();
 
@@ -620,16 +806,18 @@ void ODBCConnection::UV_CreateStatement(uv_work_t* req) {
 	//get our work data
 	create_statement_work_data* data = (create_statement_work_data *)(req->data);
 
-	DEBUG_PRINTF("ODBCConnection::UV_CreateStatement m_hDBC=%X m_hDBC=%X m_hSTMT=%X\n", data->conn->m_hENV, data->conn->m_hDBC, data->hSTMT);
+	DEBUG_PRINTF("ODBCConnection::UV_CreateStatement m_hDBC=%p m_hDBC=%p m_hSTMT=%p\n", data->conn->m_hENV, data->conn->m_hDBC, data->hSTMT);
   
 	uv_mutex_lock(&ODBC::g_odbcMutex);
   
 	//allocate a new statment handle
+	ODBC_COUNT_CALL(SQLAllocHandle);
 	SQLAllocHandle( SQL_HANDLE_STMT, data->conn->m_hDBC, &data->hSTMT);
+	ODBCMetrics::Handle(SQL_HANDLE_STMT, data->hSTMT, 1);
 
 	uv_mutex_unlock(&ODBC::g_odbcMutex);
   
-	DEBUG_PRINTF("ODBCConnection::UV_CreateStatement m_hDBC=%X m_hDBC=%X m_hSTMT=%X\n",	data->conn->m_hENV,	data->conn->m_hDBC,	data->hSTMT);
+	DEBUG_PRINTF("ODBCConnection::UV_CreateStatement m_hDBC=%p m_hDBC=%p m_hSTMT=%p\n",	data->conn->m_hENV,	data->conn->m_hDBC,	data->hSTMT);
 }
 
 void ODBCConnection::UV_AfterCreateStatement(uv_work_t* req, int status) {
@@ -639,15 +827,18 @@ void ODBCConnection::UV_AfterCreateStatement(uv_work_t* req, int status) {
 
 	create_statement_work_data* data = (create_statement_work_data *)(req->data);
 
-	DEBUG_PRINTF("ODBCConnection::UV_AfterCreateStatement m_hDBC=%X m_hDBC=%X hSTMT=%X\n", data->conn->m_hENV, data->conn->m_hDBC, data->hSTMT);
+	DEBUG_PRINTF("ODBCConnection::UV_AfterCreateStatement m_hDBC=%p m_hDBC=%p hSTMT=%p\n", data->conn->m_hENV, data->conn->m_hDBC, data->hSTMT);
   
-	Local<Value> args[3];
+	Local<Value> args[4];
 	args[0] = External::New(isolate, data->conn->m_hENV);
 	args[1] = External::New(isolate, data->conn->m_hDBC);
 	args[2] = External::New(isolate, data->hSTMT);
+	args[3] = External::New(isolate, data->conn->m_worker);
   
-	v8::Local<v8::FunctionTemplate> ft = v8::Local<v8::FunctionTemplate>::New(isolate, ODBCConnection::constructor_template);
-	Local<Object> js_result = ft->GetFunction()->NewInstance(3, args);
+	v8::Local<v8::FunctionTemplate> ft = v8::Local<v8::FunctionTemplate>::New(isolate, ODBC::State()->statementTemplate);
+	Local<Object> js_result = ft->GetFunction()->NewInstance(4, args);
+	ObjectWrap::Unwrap<ODBCStatement>(js_result)->SetUTF8(data->conn->m_utf8);
+	ObjectWrap::Unwrap<ODBCStatement>(js_result)->SetConnectionId(data->conn->m_id);
 
 	args[0] = Local<Value>::New(isolate, Null(isolate));
 	args[1] = Local<Object>::New(isolate, js_result);
@@ -680,17 +871,35 @@ void ODBCConnection::Query(const v8::FunctionCallbackInfo<v8::Value>& args) {
 	v8::EscapableHandleScope scope(isolate);
 
 	Local<Function> cb;
+	Local<Promise> promise;
   
 	Local<String> sql;
   
+	//without a callback the query returns a promise; argc counts that
+	//callback as if it had been passed
+	int argc = args.Length();
+
+	if (argc == 1 || (argc == 2 && args[1]->IsArray())) {
+		cb = ODBC::PromiseCallback(isolate, &promise);
+		argc++;
+	}
+
 	ODBCConnection* conn = ObjectWrap::Unwrap<ODBCConnection>(args.Holder());
   
 	uv_work_t* work_req = (uv_work_t *) (calloc(1, sizeof(uv_work_t)));
   
 	query_work_data* data = (query_work_data *) calloc(1, sizeof(query_work_data));
 
+	//the SQL and parameters are encoded now, so the worker must not look at
+	//conn->m_utf8, which JS may change while the query is queued
+	data->utf8 = conn->m_utf8;
+
+	uint64_t enqueued = 0;
+	double slowThreshold = -1;
+	Local<Array> params;
+
 	//Check arguments for different variations of calling this function
-	if (args.Length() == 3) {
+	if (argc == 3) {
 		//handle Query("sql string", [params], function cb () {});
     
 		if ( !args[0]->IsString() ) {
@@ -701,28 +910,31 @@ void ODBCConnection::Query(const v8::FunctionCallbackInfo<v8::Value>& args) {
 			isolate->ThrowException(Exception::TypeError(String::NewFromUtf8(isolate, "Argument 1 must be an Array.")));
 			throw Exception::TypeError(String::NewFromUtf8(isolate, "Argument 1 must be a an Array"));
 		}
-		else if ( !args[2]->IsFunction() ) {
+		else if ( cb.IsEmpty() && !args[2]->IsFunction() ) {
 			isolate->ThrowException(Exception::TypeError(String::NewFromUtf8(isolate, "Argument 2 must be a Function.")));
 			throw Exception::TypeError(String::NewFromUtf8(isolate, "Argument 2 must be a Function"));
 		}
 
 		sql = args[0]->ToString();
     
-		data->params = ODBC::GetParametersFromArray(
-		Local<Array>::Cast(args[1]),
-		&data->paramCount);
+		params = Local<Array>::Cast(args[1]);
+		data->params = ODBC::GetParametersFromArray(params, &data->paramCount, data->utf8);
     
-		cb = Local<Function>::Cast(args[2]);
+		if (cb.IsEmpty()) {
+			cb = Local<Function>::Cast(args[2]);
+		}
 	}
-	else if (args.Length() == 2 ) {
+	else if (argc == 2 ) {
 		//handle either Query("sql", cb) or Query({ settings }, cb)
     
-		if (!args[1]->IsFunction()) {
+		if (cb.IsEmpty() && !args[1]->IsFunction()) {
 			isolate->ThrowException(Exception::TypeError(String::NewFromUtf8(isolate, "ODBCConnection::Query(): Argument 1 must be a Function.")));
 			throw Exception::TypeError(String::NewFromUtf8(isolate, "ODBCConnection::Query(): Argument 1 must be a Function."));
 		}
     
-		cb = Local<Function>::Cast(args[1]);
+		if (cb.IsEmpty()) {
+			cb = Local<Function>::Cast(args[1]);
+		}
     
 		if (args[0]->IsString()) {
 			//handle Query("sql", function cb () {})
@@ -737,9 +949,9 @@ void ODBCConnection::Query(const v8::FunctionCallbackInfo<v8::Value>& args) {
       
 			Local<Object> obj = args[0]->ToObject();
 
-			v8::Local<v8::String> optionSql = v8::Local<v8::String>::New(isolate, OPTION_SQL);
-			v8::Local<v8::String> optionParams = v8::Local<v8::String>::New(isolate, OPTION_PARAMS);
-			v8::Local<v8::String> optionNoResults = v8::Local<v8::String>::New(isolate, OPTION_NORESULTS);
+			v8::Local<v8::String> optionSql = v8::Local<v8::String>::New(isolate, ODBC::State()->optionSql);
+			v8::Local<v8::String> optionParams = v8::Local<v8::String>::New(isolate, ODBC::State()->optionParams);
+			v8::Local<v8::String> optionNoResults = v8::Local<v8::String>::New(isolate, ODBC::State()->optionNoResults);
 
 			if (obj->Has(optionSql) && obj->Get(optionSql)->IsString()) {
 				sql = obj->Get(optionSql)->ToString();
@@ -748,7 +960,8 @@ void ODBCConnection::Query(const v8::FunctionCallbackInfo<v8::Value>& args) {
 				sql = String::NewFromUtf8(isolate, "");
 			}
 			if (obj->Has(optionParams) && obj->Get(optionParams)->IsArray()) {
-				data->params = ODBC::GetParametersFromArray(Local<Array>::Cast(obj->Get(optionParams)), &data->paramCount);
+				params = Local<Array>::Cast(obj->Get(optionParams));
+				data->params = ODBC::GetParametersFromArray(params, &data->paramCount, data->utf8);
 			}
 			else {
 				data->paramCount = 0;
@@ -760,6 +973,21 @@ void ODBCConnection::Query(const v8::FunctionCallbackInfo<v8::Value>& args) {
 			else {
 				data->noResultObject = false;
 			}
+
+			//the time at which the query entered the JS queue, in
+			//process.hrtime() nanoseconds, so that queueing is timed too
+			Local<Value> queued = obj->Get(String::NewFromUtf8(isolate, "queued"));
+
+			if (queued->IsNumber()) {
+				enqueued = (uint64_t) queued->NumberValue();
+			}
+
+			//overrides the threshold of the slow query log
+			Local<Value> threshold = obj->Get(String::NewFromUtf8(isolate, "slowThreshold"));
+
+			if (threshold->IsNumber()) {
+				slowThreshold = threshold->NumberValue();
+			}
 		}
 		else {
 			isolate->ThrowException(Exception::TypeError(String::NewFromUtf8(isolate, "ODBCConnection::Query(): Argument 0 must be a String or an Object.")));
@@ -774,28 +1002,27 @@ void ODBCConnection::Query(const v8::FunctionCallbackInfo<v8::Value>& args) {
 
 	v8::Persistent<v8::Function, CopyablePersistentTraits<v8::Function>> persistent(isolate, cb);
 	data->cb = persistent;
-	data->sqlLen = sql->Length();
-
-#ifdef UNICODE
-	data->sqlSize = (data->sqlLen * sizeof(uint16_t)) + sizeof(uint16_t);
-	data->sql = (uint16_t *) malloc(data->sqlSize);
-	sql->Write((uint16_t *) data->sql);
-#else
-	data->sqlSize = sql->Utf8Length() + 1;
-	data->sql = (char *) malloc(data->sqlSize);
-	sql->WriteUtf8((char *) data->sql);
-#endif
+	data->sql = ODBC::CopySQL(sql, data->utf8, &data->sqlLen, &data->sqlSize);
 
 	DEBUG_PRINTF("ODBCConnection::Query : sqlLen=%i, sqlSize=%i, sql=%s\n", data->sqlLen, data->sqlSize, (char*) data->sql);
   
 	data->conn = conn;
 	work_req->data = data;
+
+	ODBCStats::Begin(&data->timing, enqueued);
+	data->timing.histogram = true;
+	data->slowQuery = ODBCSlowLog::Capture(sql, params, conn->m_id, slowThreshold);
   
-	uv_queue_work(uv_default_loop(), work_req, UV_Query, (uv_after_work_cb)UV_AfterQuery);
+	ODBC::QueueWork(conn->m_worker, work_req, UV_Query, (uv_after_work_cb)UV_AfterQuery);
 
 	conn->Ref();
 
-	args.GetReturnValue().SetUndefined();
+	if (!promise.IsEmpty()) {
+		args.GetReturnValue().Set(promise);
+	}
+	else {
+		args.GetReturnValue().SetUndefined();
+	}
 }
 
 void ODBCConnection::UV_Query(uv_work_t* req) {
@@ -805,11 +1032,22 @@ void ODBCConnection::UV_Query(uv_work_t* req) {
   
 	Parameter prm;
 	SQLRETURN ret;
+
+	uint64_t start = ODBCStats::Start(&data->timing);
+	uint32_t sqlHash = 0;
+
+	if (ODBC_PROBE_ENABLED(query__start) || ODBC_PROBE_ENABLED(query__done)) {
+		sqlHash = ODBCHash(data->sql, data->sqlSize - (data->utf8 ? 1 : sizeof(SQLTCHAR)));
+	}
+
+	ODBC_PROBE2(query__start, data->conn->m_id, sqlHash);
   
 	uv_mutex_lock(&ODBC::g_odbcMutex);
 
 	//allocate a new statment handle
+	ODBC_COUNT_CALL(SQLAllocHandle);
 	SQLAllocHandle( SQL_HANDLE_STMT, data->conn->m_hDBC, &data->hSTMT);
+	ODBCMetrics::Handle(SQL_HANDLE_STMT, data->hSTMT, 1);
 
 	uv_mutex_unlock(&ODBC::g_odbcMutex);
 
@@ -818,19 +1056,32 @@ void ODBCConnection::UV_Query(uv_work_t* req) {
 	if (data->paramCount) {
 		for (int i = 0; i < data->paramCount; i++) {
 			prm = data->params[i];
-			DEBUG_TPRINTF(SQL_T("ODBCConnection::UV_Query - param[%i]: ValueType=%i type=%i BufferLength=%i size=%i length=%i &length=%X\n"), i, prm.ValueType, prm.ParameterType, prm.BufferLength, prm.ColumnSize, prm.StrLen_or_IndPtr, &data->params[i].StrLen_or_IndPtr);
+			DEBUG_TPRINTF(SQL_T("ODBCConnection::UV_Query - param[%i]: ValueType=%i type=%i BufferLength=%lld size=%lld length=%lld &length=%p\n"), i, prm.ValueType, prm.ParameterType, (long long) prm.BufferLength, (long long) prm.ColumnSize, (long long) prm.StrLen_or_IndPtr, (void *) &data->params[i].StrLen_or_IndPtr);
 			//StatementHandle, ParameterNumber, InputOutputType, ...
+			ODBC_COUNT_CALL(SQLBindParameter);
 			ret = SQLBindParameter(data->hSTMT, i + 1, SQL_PARAM_INPUT, prm.ValueType, prm.ParameterType, prm.ColumnSize, prm.DecimalDigits, prm.ParameterValuePtr, prm.BufferLength, &data->params[i].StrLen_or_IndPtr);
 	
 			if (ret == SQL_ERROR) {
 				data->result = ret;
+				ODBCStats::End(&data->timing, TIMING_EXECUTE, start);
+				ODBC_PROBE5(query__done, data->conn->m_id, sqlHash, data->hSTMT, ret, data->timing.phases[TIMING_EXECUTE]);
 				return;
 			}
 		}
 	}
 
 	// execute the query directly
-	ret = SQLExecDirect(data->hSTMT, (SQLTCHAR *)data->sql, data->sqlLen);
+	ODBC_COUNT_CALL(SQLExecDirect);
+	if (data->utf8) {
+		ret = ODBCNarrow::ExecDirect(data->hSTMT, (SQLCHAR *) data->sql, data->sqlLen);
+	}
+	else {
+		ret = SQLExecDirect(data->hSTMT, (SQLTCHAR *) data->sql, data->sqlLen);
+	}
+
+	ODBCStats::End(&data->timing, TIMING_EXECUTE, start);
+
+	ODBC_PROBE5(query__done, data->conn->m_id, sqlHash, data->hSTMT, ret, data->timing.phases[TIMING_EXECUTE]);
 
 	// this will be checked later in UV_AfterQuery
 	data->result = ret;
@@ -853,8 +1104,23 @@ void ODBCConnection::UV_AfterQuery(uv_work_t* req, int status) {
 		//this means we should release the handle now and call back
 		//with True()
     
+		if (data->slowQuery) {
+			SQLLEN rowCount = 0;
+
+			ODBC_COUNT_CALL(SQLRowCount);
+			if (!SQL_SUCCEEDED(SQLRowCount(data->hSTMT, &rowCount))) {
+				rowCount = 0;
+			}
+
+			ODBCStats::Stop(&data->timing);
+			ODBCSlowLog::Record(data->slowQuery, &data->timing, rowCount);
+			data->slowQuery = NULL;
+		}
+
 		uv_mutex_lock(&ODBC::g_odbcMutex);
     
+		ODBC_COUNT_CALL(SQLFreeHandle);
+		ODBCMetrics::Handle(SQL_HANDLE_STMT, data->hSTMT, -1);
 		SQLFreeHandle(SQL_HANDLE_STMT, data->hSTMT);
    
 		uv_mutex_unlock(&ODBC::g_odbcMutex);
@@ -867,16 +1133,34 @@ void ODBCConnection::UV_AfterQuery(uv_work_t* req, int status) {
 		f->Call(isolate->GetCurrentContext()->Global(), 2, args);
 	}
 	else {
-		Local<Value> args[4];
+		Local<Value> args[7];
 		bool* canFreeHandle = new bool(true);
+		int argc = 5;
     
 		args[0] = External::New(isolate, data->conn->m_hENV);
 		args[1] = External::New(isolate, data->conn->m_hDBC);
 		args[2] = External::New(isolate, data->hSTMT);
 		args[3] = External::New(isolate, canFreeHandle);
+		args[4] = External::New(isolate, data->conn->m_worker);
+
+		//only Query() times its phases; the catalog functions share this
+		//callback with an empty timing
+		if (data->timing.enqueued) {
+			ODBCStats::Start(&data->timing);
+			args[5] = External::New(isolate, &data->timing);
+			argc = 6;
+		}
+
+		//the result logs the query once it has been fetched
+		if (data->slowQuery) {
+			args[6] = External::New(isolate, data->slowQuery);
+			argc = 7;
+			data->slowQuery = NULL;
+		}
     
-		v8::Local<v8::FunctionTemplate> ft = v8::Local<v8::FunctionTemplate>::New(isolate, ODBCResult::constructor_template);
-		Local<Object> js_result = ft->GetFunction()->NewInstance(4, args);
+		v8::Local<v8::FunctionTemplate> ft = v8::Local<v8::FunctionTemplate>::New(isolate, ODBC::State()->resultTemplate);
+		Local<Object> js_result = ft->GetFunction()->NewInstance(argc, args);
+		ObjectWrap::Unwrap<ODBCResult>(js_result)->SetUTF8(data->utf8);
 
 		// Check now to see if there was an error (as there may be further result sets)
 		if (data->result == SQL_ERROR) {
@@ -899,32 +1183,11 @@ void ODBCConnection::UV_AfterQuery(uv_work_t* req, int status) {
   
 	data->cb.Reset();
 
+	//catalog functions are not logged
+	ODBCSlowLog::FreeInfo(data->slowQuery);
+
 	if (data->paramCount) {
-		Parameter prm;
-		// free parameters
-		for (int i = 0; i < data->paramCount; i++) {
-			if (prm = data->params[i], prm.ParameterValuePtr != NULL) {
-				switch (prm.ValueType) {
-					case SQL_C_WCHAR:
-						free(prm.ParameterValuePtr);
-						break; 
-					case SQL_C_CHAR:
-						free(prm.ParameterValuePtr);
-						break; 
-					case SQL_C_LONG:
-						delete (int64_t *)prm.ParameterValuePtr;
-						break;
-					case SQL_C_DOUBLE:
-						delete (double *)prm.ParameterValuePtr;
-						break;
-					case SQL_C_BIT:
-						delete (bool *)prm.ParameterValuePtr;
-						break;
-				}
-			}
-		}
-    
-		free(data->params);
+		FreeParameters(data->params, data->paramCount);
 	}
   
 	free(data->sql);
@@ -939,22 +1202,521 @@ void ODBCConnection::UV_AfterQuery(uv_work_t* req, int status) {
 
 
 /*
- * QuerySync
+ * NewPipelineCommand
+ *
+ * Build a pipeline command from "sql" or { sql, params, noResults,
+ * fetchMode }, in UTF-8 when utf8 is set. Returns NULL if options is
+ * neither.
  */
-void ODBCConnection::QuerySync(const v8::FunctionCallbackInfo<v8::Value>& args) {
-	DEBUG_PRINTF("ODBCConnection::QuerySync\n");
+static pipeline_command* NewPipelineCommand(v8::Isolate* isolate, Local<Value> options, bool utf8) {
+	Local<String> sql;
+	int sqlSize;
+
+	pipeline_command* command = (pipeline_command *) calloc(1, sizeof(pipeline_command));
+
+	command->fetchMode = FETCH_OBJECT;
+	command->utf8 = utf8;
+
+	if (options->IsString()) {
+		sql = options->ToString();
+	}
+	else if (options->IsObject()) {
+		Local<Object> obj = options->ToObject();
+
+		v8::Local<v8::String> optionSql = v8::Local<v8::String>::New(isolate, ODBC::State()->optionSql);
+		v8::Local<v8::String> optionParams = v8::Local<v8::String>::New(isolate, ODBC::State()->optionParams);
+		v8::Local<v8::String> optionNoResults = v8::Local<v8::String>::New(isolate, ODBC::State()->optionNoResults);
+		v8::Local<v8::String> optionFetchMode = v8::Local<v8::String>::New(isolate, ODBC::State()->optionFetchMode);
+
+		if (obj->Has(optionSql) && obj->Get(optionSql)->IsString()) {
+			sql = obj->Get(optionSql)->ToString();
+		}
+		else {
+			sql = String::NewFromUtf8(isolate, "");
+		}
+
+		if (obj->Has(optionParams) && obj->Get(optionParams)->IsArray()) {
+			command->params = ODBC::GetParametersFromArray(Local<Array>::Cast(obj->Get(optionParams)), &command->paramCount, utf8);
+		}
+
+		if (obj->Has(optionNoResults) && obj->Get(optionNoResults)->IsBoolean()) {
+			command->noResultObject = obj->Get(optionNoResults)->ToBoolean()->Value();
+		}
+
+		if (obj->Has(optionFetchMode) && obj->Get(optionFetchMode)->IsInt32()) {
+			command->fetchMode = obj->Get(optionFetchMode)->Int32Value();
+		}
+	}
+	else {
+		free(command);
+
+		return NULL;
+	}
+
+	command->sql = ODBC::CopySQL(sql, utf8, &command->sqlLen, &sqlSize);
+
+	DEBUG_PRINTF("NewPipelineCommand : sqlLen=%i, sql=%s\n", command->sqlLen, (char*) command->sql);
+
+	return command;
+}
+
+/*
+ * Pipeline
+ *
+ * Queue a command on the connection's pipeline. Commands that are queued
+ * while a previous one is still running are picked up by the same worker
+ * hop, back to back, and their callbacks are all invoked from a single
+ * completion. Each command is executed, all of its result sets are fetched
+ * on the worker and the statement is freed before the next one starts.
+ *
+ *   conn.pipeline("sql" | { sql, params, noResults, fetchMode }, cb)
+ *
+ * cb(err, resultSets) is called with one array of rows per result set.
+ */
+void ODBCConnection::Pipeline(const v8::FunctionCallbackInfo<v8::Value>& args) {
+	DEBUG_PRINTF("ODBCConnection::Pipeline\n");
   
 	v8::Isolate* isolate = args.GetIsolate();
 	v8::EscapableHandleScope scope(isolate);
 
+	ODBCConnection* conn = ObjectWrap::Unwrap<ODBCConnection>(args.Holder());
+
+	if (args.Length() != 2 || !args[1]->IsFunction()) {
+		isolate->ThrowException(Exception::TypeError(String::NewFromUtf8(isolate, "ODBCConnection::Pipeline(): Argument 1 must be a Function.")));
+		throw Exception::TypeError(String::NewFromUtf8(isolate, "ODBCConnection::Pipeline(): Argument 1 must be a Function."));
+	}
+
+	pipeline_command* command = NewPipelineCommand(isolate, args[0], conn->m_utf8);
+
+	if (!command) {
+		isolate->ThrowException(Exception::TypeError(String::NewFromUtf8(isolate, "ODBCConnection::Pipeline(): Argument 0 must be a String or an Object.")));
+		throw Exception::TypeError(String::NewFromUtf8(isolate, "ODBCConnection::Pipeline(): Argument 0 must be a String or an Object."));
+	}
+
+	v8::Persistent<v8::Function, CopyablePersistentTraits<v8::Function>> persistent(isolate, Local<Function>::Cast(args[1]));
+	command->cb = persistent;
+
+	QueueCommand(conn, command);
+
+	args.GetReturnValue().SetUndefined();
+}
+
+/*
+ * QueryMulti
+ *
+ * Execute a batch and collect every result set it produces on the worker
+ * thread, walking them with SQLMoreResults there instead of on the event
+ * loop.
+ *
+ *   conn.queryMulti("sql", [params], cb)
+ *   conn.queryMulti({ sql, params, fetchMode }, cb)
+ *
+ * cb(err, [{ columns, rows, rowCount }, ...])
+ */
+void ODBCConnection::QueryMulti(const v8::FunctionCallbackInfo<v8::Value>& args) {
+	DEBUG_PRINTF("ODBCConnection::QueryMulti\n");
+  
+	v8::Isolate* isolate = args.GetIsolate();
+	v8::EscapableHandleScope scope(isolate);
+
+	ODBCConnection* conn = ObjectWrap::Unwrap<ODBCConnection>(args.Holder());
+	pipeline_command* command = NULL;
+	Local<Function> cb;
+
+	if (args.Length() == 3) {
+		if (!args[0]->IsString()) {
+			isolate->ThrowException(Exception::TypeError(String::NewFromUtf8(isolate, "ODBCConnection::QueryMulti(): Argument 0 must be a String.")));
+			throw Exception::TypeError(String::NewFromUtf8(isolate, "ODBCConnection::QueryMulti(): Argument 0 must be a String."));
+		}
+		else if (!args[1]->IsArray()) {
+			isolate->ThrowException(Exception::TypeError(String::NewFromUtf8(isolate, "ODBCConnection::QueryMulti(): Argument 1 must be an Array.")));
+			throw Exception::TypeError(String::NewFromUtf8(isolate, "ODBCConnection::QueryMulti(): Argument 1 must be an Array."));
+		}
+		else if (!args[2]->IsFunction()) {
+			isolate->ThrowException(Exception::TypeError(String::NewFromUtf8(isolate, "ODBCConnection::QueryMulti(): Argument 2 must be a Function.")));
+			throw Exception::TypeError(String::NewFromUtf8(isolate, "ODBCConnection::QueryMulti(): Argument 2 must be a Function."));
+		}
+
+		command = NewPipelineCommand(isolate, args[0], conn->m_utf8);
+		command->params = ODBC::GetParametersFromArray(Local<Array>::Cast(args[1]), &command->paramCount, conn->m_utf8);
+		cb = Local<Function>::Cast(args[2]);
+	}
+	else if (args.Length() == 2) {
+		if (!args[1]->IsFunction()) {
+			isolate->ThrowException(Exception::TypeError(String::NewFromUtf8(isolate, "ODBCConnection::QueryMulti(): Argument 1 must be a Function.")));
+			throw Exception::TypeError(String::NewFromUtf8(isolate, "ODBCConnection::QueryMulti(): Argument 1 must be a Function."));
+		}
+
+		command = NewPipelineCommand(isolate, args[0], conn->m_utf8);
+
+		if (!command) {
+			isolate->ThrowException(Exception::TypeError(String::NewFromUtf8(isolate, "ODBCConnection::QueryMulti(): Argument 0 must be a String or an Object.")));
+			throw Exception::TypeError(String::NewFromUtf8(isolate, "ODBCConnection::QueryMulti(): Argument 0 must be a String or an Object."));
+		}
+
+		cb = Local<Function>::Cast(args[1]);
+	}
+	else {
+		isolate->ThrowException(Exception::TypeError(String::NewFromUtf8(isolate, "ODBCConnection::QueryMulti(): Requires either 2 or 3 Arguments.")));
+		throw Exception::TypeError(String::NewFromUtf8(isolate, "ODBCConnection::QueryMulti(): Requires either 2 or 3 Arguments."));
+	}
+
+	v8::Persistent<v8::Function, CopyablePersistentTraits<v8::Function>> persistent(isolate, cb);
+	command->cb = persistent;
+	command->describe = true;
+	command->noResultObject = false;
+
+	QueueCommand(conn, command);
+
+	args.GetReturnValue().SetUndefined();
+}
+
+/*
+ * QueueCommand
+ *
+ * Append a command to the pipeline and start a worker hop unless one is
+ * already draining it.
+ */
+void ODBCConnection::QueueCommand(ODBCConnection* conn, pipeline_command* command) {
+	bool start = false;
+
+	uv_mutex_lock(&conn->m_pipelineLock);
+
+	if (conn->m_pipelineTail) {
+		conn->m_pipelineTail->next = command;
+	}
+	else {
+		conn->m_pipelineHead = command;
+	}
+
+	conn->m_pipelineTail = command;
+
+	if (!conn->m_pipelineBusy) {
+		//nobody is draining the queue right now; start a worker hop
+		conn->m_pipelineBusy = true;
+		start = true;
+	}
+
+	uv_mutex_unlock(&conn->m_pipelineLock);
+
+	if (start) {
+		StartPipeline(conn);
+	}
+}
+
+/*
+ * StartPipeline
+ *
+ * Queue a worker hop to drain the pipeline, which the caller has marked
+ * busy.
+ */
+void ODBCConnection::StartPipeline(ODBCConnection* conn) {
+	uv_work_t* work_req = (uv_work_t *) (calloc(1, sizeof(uv_work_t)));
+	pipeline_work_data* data = (pipeline_work_data *) calloc(1, sizeof(pipeline_work_data));
+
+	data->conn = conn;
+	work_req->data = data;
+
+	ODBC::QueueWork(conn->m_worker, work_req, UV_Pipeline, (uv_after_work_cb)UV_AfterPipeline);
+
+	conn->Ref();
+}
+
+/*
+ * UV_Pipeline
+ *
+ * Run up to PIPELINE_MAX_PER_HOP queued commands. When more are waiting the
+ * pipeline stays busy and UV_AfterPipeline() queues the next hop before it
+ * calls back the commands of this one, so that a steady stream of queries
+ * does not hold every callback back.
+ */
+void ODBCConnection::UV_Pipeline(uv_work_t* req) {
+	DEBUG_PRINTF("ODBCConnection::UV_Pipeline\n");
+  
+	pipeline_work_data* data = (pipeline_work_data *)(req->data);
+	ODBCConnection* conn = data->conn;
+	int count = 0;
+
+	if (!conn->m_pipelineBuffer) {
+		conn->m_pipelineBuffer = (uint16_t *) malloc(MAX_VALUE_SIZE);
+	}
+
+	while (true) {
+		uv_mutex_lock(&conn->m_pipelineLock);
+
+		pipeline_command* command = conn->m_pipelineHead;
+
+		if (command && count == PIPELINE_MAX_PER_HOP) {
+			//leave the rest for the next hop; the pipeline stays busy
+			data->more = true;
+			command = NULL;
+		}
+		else if (command) {
+			conn->m_pipelineHead = command->next;
+
+			if (!conn->m_pipelineHead) {
+				conn->m_pipelineTail = NULL;
+			}
+		}
+		else {
+			//let the next Pipeline() call start a new hop
+			conn->m_pipelineBusy = false;
+		}
+
+		uv_mutex_unlock(&conn->m_pipelineLock);
+
+		if (!command) {
+			break;
+		}
+
+		command->next = NULL;
+		count++;
+
+		RunPipelineCommand(conn, command);
+
+		if (data->doneTail) {
+			data->doneTail->next = command;
+		}
+		else {
+			data->done = command;
+		}
+
+		data->doneTail = command;
+	}
+}
+
+/*
+ * RunPipelineCommand
+ *
+ * Execute one command and fetch every result set it produces. Runs on the
+ * worker thread. On error the statement handle is kept so that the
+ * diagnostics can be read on the event loop thread.
+ */
+void ODBCConnection::RunPipelineCommand(ODBCConnection* conn, pipeline_command* command) {
+	Parameter prm;
+	SQLRETURN ret;
+	RowSet* last = NULL;
+
+	uv_mutex_lock(&ODBC::g_odbcMutex);
+
+	ODBC_COUNT_CALL(SQLAllocHandle);
+	ret = SQLAllocHandle(SQL_HANDLE_STMT, conn->m_hDBC, &command->hSTMT);
+
+	if (SQL_SUCCEEDED(ret)) {
+		ODBCMetrics::Handle(SQL_HANDLE_STMT, command->hSTMT, 1);
+	}
+	else {
+		//the diagnostics are on the connection (see UV_AfterPipeline)
+		command->hSTMT = NULL;
+	}
+
+	uv_mutex_unlock(&ODBC::g_odbcMutex);
+
+	if (!command->hSTMT) {
+		command->result = SQL_ERROR;
+		return;
+	}
+
+	for (int i = 0; i < command->paramCount; i++) {
+		prm = command->params[i];
+
+		ODBC_COUNT_CALL(SQLBindParameter);
+		ret = SQLBindParameter(command->hSTMT, i + 1, SQL_PARAM_INPUT, prm.ValueType, prm.ParameterType, prm.ColumnSize, prm.DecimalDigits, prm.ParameterValuePtr, prm.BufferLength, &command->params[i].StrLen_or_IndPtr);
+
+		if (!SQL_SUCCEEDED(ret)) {
+			command->result = SQL_ERROR;
+			return;
+		}
+	}
+
+	ODBC_COUNT_CALL(SQLExecDirect);
+	if (command->utf8) {
+		ret = ODBCNarrow::ExecDirect(command->hSTMT, (SQLCHAR *) command->sql, command->sqlLen);
+	}
+	else {
+		ret = SQLExecDirect(command->hSTMT, (SQLTCHAR *) command->sql, command->sqlLen);
+	}
+
+	//SQL_NO_DATA is an update or delete which matched no rows
+	if (!SQL_SUCCEEDED(ret) && ret != SQL_NO_DATA) {
+		command->result = SQL_ERROR;
+		return;
+	}
+
+	if (!command->noResultObject) {
+		while (true) {
+			RowSet* rowSet = ODBC::FetchRowSet(command->hSTMT, NULL, 0, conn->m_pipelineBuffer, MAX_VALUE_SIZE - 1, 0, command->utf8);
+
+			if (last) {
+				last->next = rowSet;
+			}
+			else {
+				command->rowSets = rowSet;
+			}
+
+			last = rowSet;
+
+			if (rowSet->result == SQL_ERROR) {
+				command->result = SQL_ERROR;
+				return;
+			}
+
+			if (!conn->canHaveMoreResults) {
+				break;
+			}
+
+			ODBC_COUNT_CALL(SQLMoreResults);
+			ret = SQLMoreResults(command->hSTMT);
+
+			if (ret == SQL_NO_DATA) {
+				break;
+			}
+
+			if (!SQL_SUCCEEDED(ret)) {
+				command->result = SQL_ERROR;
+				return;
+			}
+		}
+	}
+
+	command->result = SQL_SUCCESS;
+
+	uv_mutex_lock(&ODBC::g_odbcMutex);
+
+	ODBC_COUNT_CALL(SQLFreeHandle);
+	ODBCMetrics::Handle(SQL_HANDLE_STMT, command->hSTMT, -1);
+	SQLFreeHandle(SQL_HANDLE_STMT, command->hSTMT);
+	command->hSTMT = NULL;
+
+	uv_mutex_unlock(&ODBC::g_odbcMutex);
+}
+
+/*
+ * DescribeRowSet
+ *
+ * { columns : [{ name, type }], rows : [...], rowCount } for queryMulti. For
+ * statements without a result set rowCount is the number of affected rows.
+ */
+static Local<Object> DescribeRowSet(RowSet* rowSet, int fetchMode) {
+	v8::Isolate* isolate = v8::Isolate::GetCurrent();
+	v8::EscapableHandleScope scope(isolate);
+
+	Local<Object> set = Object::New(isolate);
+	Local<Array> columns = Array::New(isolate, rowSet->colCount);
+
+	for (int i = 0; i < rowSet->colCount; i++) {
+		Local<Object> column = Object::New(isolate);
+
 #ifdef UNICODE
-	String::Value* sql;
+		column->Set(String::NewFromUtf8(isolate, "name"), String::NewFromTwoByte(isolate, (uint16_t *) rowSet->columns[i].name));
 #else
-	String::Utf8Value* sql;
+		column->Set(String::NewFromUtf8(isolate, "name"), String::NewFromUtf8(isolate, (const char *) rowSet->columns[i].name));
 #endif
+		column->Set(String::NewFromUtf8(isolate, "type"), Integer::New(isolate, rowSet->columns[i].type));
+
+		columns->Set(i, column);
+	}
+
+	set->Set(String::NewFromUtf8(isolate, "columns"), columns);
+	set->Set(String::NewFromUtf8(isolate, "rows"), ODBC::RowSetToArray(rowSet, fetchMode));
+	set->Set(String::NewFromUtf8(isolate, "rowCount"), Number::New(isolate, (double) ((rowSet->colCount) ? rowSet->rowCount : rowSet->affectedRows)));
+
+	return scope.Escape(set);
+}
+
+void ODBCConnection::UV_AfterPipeline(uv_work_t* req, int status) {
+	DEBUG_PRINTF("ODBCConnection::UV_AfterPipeline\n");
+  
+	v8::Isolate* isolate = v8::Isolate::GetCurrent();
+	v8::EscapableHandleScope scope(isolate);
+
+	pipeline_work_data* data = (pipeline_work_data *)(req->data);
+	pipeline_command* command = data->done;
+
+	if (data->more) {
+		//the worker goes on with the rest while we call this batch back
+		StartPipeline(data->conn);
+	}
+
+	while (command) {
+		pipeline_command* next = command->next;
+
+		TryCatch try_catch;
+
+		Local<Value> args[2];
+		Local<Array> sets = Array::New(isolate);
+		int count = 0;
+
+		for (RowSet* rowSet = command->rowSets; rowSet; rowSet = rowSet->next) {
+			if (command->describe) {
+				sets->Set(count++, DescribeRowSet(rowSet, command->fetchMode));
+			}
+			else {
+				sets->Set(count++, ODBC::RowSetToArray(rowSet, command->fetchMode));
+			}
+		}
+
+		if (command->result == SQL_ERROR && !command->hSTMT) {
+			args[0] = ODBC::GetSQLError(SQL_HANDLE_DBC, data->conn->m_hDBC, (char *) "[node-odbc] Error in ODBCConnection::Pipeline");
+		}
+		else if (command->result == SQL_ERROR) {
+			args[0] = ODBC::GetSQLError(SQL_HANDLE_STMT, command->hSTMT, (char *) "[node-odbc] Error in ODBCConnection::Pipeline");
+		}
+		else {
+			args[0] = Local<Value>::New(isolate, Null(isolate));
+		}
+
+		args[1] = sets;
+
+		if (command->hSTMT) {
+			uv_mutex_lock(&ODBC::g_odbcMutex);
+
+			ODBC_COUNT_CALL(SQLFreeHandle);
+			ODBCMetrics::Handle(SQL_HANDLE_STMT, command->hSTMT, -1);
+			SQLFreeHandle(SQL_HANDLE_STMT, command->hSTMT);
+
+			uv_mutex_unlock(&ODBC::g_odbcMutex);
+		}
+
+		v8::Local<v8::Function> f = v8::Local<v8::Function>::New(isolate, command->cb);
+		f->Call(isolate->GetCurrentContext()->Global(), 2, args);
+
+		if (try_catch.HasCaught()) {
+			FatalException(try_catch);
+		}
+
+		command->cb.Reset();
+
+		ODBC::FreeRowSet(command->rowSets);
+		FreeParameters(command->params, command->paramCount);
+		free(command->sql);
+		free(command);
+
+		command = next;
+	}
+
+	data->conn->Unref();
+
+	free(data);
+	free(req);
+}
+
+/*
+ * QuerySync
+ */
+void ODBCConnection::QuerySync(const v8::FunctionCallbackInfo<v8::Value>& args) {
+	DEBUG_PRINTF("ODBCConnection::QuerySync\n");
+  
+	v8::Isolate* isolate = args.GetIsolate();
+	v8::EscapableHandleScope scope(isolate);
+
+	Local<String> sqlString;
+	void* sql;
+	int sqlLen;
+	int sqlSize;
 	ODBCConnection* conn = ObjectWrap::Unwrap<ODBCConnection>(args.Holder());
   
-	Parameter* params = new Parameter[0];
+	Parameter* params = NULL;
 	Parameter prm;
 	SQLRETURN ret;
 	HSTMT hSTMT;
@@ -973,23 +1735,15 @@ void ODBCConnection::QuerySync(const v8::FunctionCallbackInfo<v8::Value>& args)
 			throw Exception::TypeError(String::NewFromUtf8(isolate, "ODBCConnection::Query(): Argument 1 must be a an Array."));
 		}
 
-#ifdef UNICODE
-		sql = new String::Value(args[0]->ToString());
-#else
-		sql = new String::Utf8Value(args[0]->ToString());
-#endif
-		params = ODBC::GetParametersFromArray(Local<Array>::Cast(args[1]), &paramCount);
+		sqlString = args[0]->ToString();
+		params = ODBC::GetParametersFromArray(Local<Array>::Cast(args[1]), &paramCount, conn->m_utf8);
 	}
 	else if (args.Length() == 1 ) {
 		//handle either QuerySync("sql") or QuerySync({ settings })
 
 		if (args[0]->IsString()) {
 			//handle Query("sql")
-#ifdef UNICODE
-			sql = new String::Value(args[0]->ToString());
-#else
-			sql = new String::Utf8Value(args[0]->ToString());
-#endif
+			sqlString = args[0]->ToString();
 			paramCount = 0;
 		}
 		else if (args[0]->IsObject()) {
@@ -1000,27 +1754,19 @@ void ODBCConnection::QuerySync(const v8::FunctionCallbackInfo<v8::Value>& args)
       
 			Local<Object> obj = args[0]->ToObject();
       
-			v8::Local<v8::String> optionSql = v8::Local<v8::String>::New(isolate, OPTION_SQL);
-			v8::Local<v8::String> optionParams = v8::Local<v8::String>::New(isolate, OPTION_PARAMS);
-			v8::Local<v8::String> optionNoResults = v8::Local<v8::String>::New(isolate, OPTION_NORESULTS);
+			v8::Local<v8::String> optionSql = v8::Local<v8::String>::New(isolate, ODBC::State()->optionSql);
+			v8::Local<v8::String> optionParams = v8::Local<v8::String>::New(isolate, ODBC::State()->optionParams);
+			v8::Local<v8::String> optionNoResults = v8::Local<v8::String>::New(isolate, ODBC::State()->optionNoResults);
 
 			if (obj->Has(optionSql) && obj->Get(optionSql)->IsString()) {
-#ifdef UNICODE
-				sql = new String::Value(obj->Get(optionSql)->ToString());
-#else
-				sql = new String::Utf8Value(obj->Get(optionSql)->ToString());
-#endif
+				sqlString = obj->Get(optionSql)->ToString();
 			}
 			else {
-#ifdef UNICODE
-				sql = new String::Value(String::NewFromUtf8(isolate, ""));
-#else
-				sql = new String::Utf8Value(String::NewFromUtf8(isolate, ""));
-#endif
+				sqlString = String::NewFromUtf8(isolate, "");
 			}
       
 			if (obj->Has(optionParams) && obj->Get(optionParams)->IsArray()) {
-				params = ODBC::GetParametersFromArray(Local<Array>::Cast(obj->Get(optionParams)), &paramCount);
+				params = ODBC::GetParametersFromArray(Local<Array>::Cast(obj->Get(optionParams)), &paramCount, conn->m_utf8);
 			}
 			else {
 				paramCount = 0;
@@ -1041,10 +1787,23 @@ void ODBCConnection::QuerySync(const v8::FunctionCallbackInfo<v8::Value>& args)
 	}
 	//Done checking arguments
 
+	sql = ODBC::CopySQL(sqlString, conn->m_utf8, &sqlLen, &sqlSize);
+
+	uint64_t start = ODBC_PROBE_ENABLED(query__done) ? uv_hrtime() : 0;
+	uint32_t sqlHash = 0;
+
+	if (ODBC_PROBE_ENABLED(query__start) || ODBC_PROBE_ENABLED(query__done)) {
+		sqlHash = ODBCHash(sql, sqlSize - (conn->m_utf8 ? 1 : sizeof(SQLTCHAR)));
+	}
+
+	ODBC_PROBE2(query__start, conn->m_id, sqlHash);
+
 	uv_mutex_lock(&ODBC::g_odbcMutex);
 
 	//allocate a new statment handle
+	ODBC_COUNT_CALL(SQLAllocHandle);
 	ret = SQLAllocHandle( SQL_HANDLE_STMT, conn->m_hDBC, &hSTMT);
+	ODBCMetrics::Handle(SQL_HANDLE_STMT, hSTMT, 1);
 
 	uv_mutex_unlock(&ODBC::g_odbcMutex);
 
@@ -1054,8 +1813,9 @@ void ODBCConnection::QuerySync(const v8::FunctionCallbackInfo<v8::Value>& args)
 		if (paramCount) {
 			for (int i = 0; i < paramCount; i++) {
 				prm = params[i];
-				DEBUG_PRINTF("ODBCConnection::UV_Query - param[%i]: ValueType=%i type=%i BufferLength=%i size=%i length=%i &length=%X\n", i, prm.ValueType, prm.ParameterType, prm.BufferLength, prm.ColumnSize, prm.StrLen_or_IndPtr, &params[i].StrLen_or_IndPtr);
+				DEBUG_PRINTF("ODBCConnection::UV_Query - param[%i]: ValueType=%i type=%i BufferLength=%lld size=%lld length=%lld &length=%p\n", i, prm.ValueType, prm.ParameterType, (long long) prm.BufferLength, (long long) prm.ColumnSize, (long long) prm.StrLen_or_IndPtr, (void *) &params[i].StrLen_or_IndPtr);
 				//StatementHandle, ParameterNumber, InputOutputType
+				ODBC_COUNT_CALL(SQLBindParameter);
 				ret = SQLBindParameter(hSTMT, i + 1, SQL_PARAM_INPUT, prm.ValueType, prm.ParameterType, prm.ColumnSize, prm.DecimalDigits, prm.ParameterValuePtr, prm.BufferLength, &params[i].StrLen_or_IndPtr);
         
 				if (ret == SQL_ERROR) {
@@ -1065,36 +1825,23 @@ void ODBCConnection::QuerySync(const v8::FunctionCallbackInfo<v8::Value>& args)
 		}
 
 		if (SQL_SUCCEEDED(ret)) {
-			ret = SQLExecDirect(hSTMT, (SQLTCHAR *) **sql, sql->length());
-		}
-    
-		// free parameters
-		for (int i = 0; i < paramCount; i++) {
-			if (prm = params[i], prm.ParameterValuePtr != NULL) {
-				switch (prm.ValueType) {
-					case SQL_C_WCHAR:
-						free(prm.ParameterValuePtr); 
-						break;
-					case SQL_C_CHAR:
-						free(prm.ParameterValuePtr);
-						break; 
-					case SQL_C_LONG:
-						delete (int64_t *)prm.ParameterValuePtr;
-						break;
-					case SQL_C_DOUBLE:
-						delete (double  *)prm.ParameterValuePtr;
-						break;
-					case SQL_C_BIT:
-						delete (bool    *)prm.ParameterValuePtr;
-						break;
-				}
+			ODBC_COUNT_CALL(SQLExecDirect);
+			if (conn->m_utf8) {
+				ret = ODBCNarrow::ExecDirect(hSTMT, (SQLCHAR *) sql, sqlLen);
+			}
+			else {
+				ret = SQLExecDirect(hSTMT, (SQLTCHAR *) sql, sqlLen);
 			}
 		}
-    
-		free(params);
 	}
+
+	if (ODBC_PROBE_ENABLED(query__done)) {
+		ODBC_PROBE5(query__done, conn->m_id, sqlHash, hSTMT, ret, uv_hrtime() - start);
+	}
+
+	FreeParameters(params, paramCount);
   
-	delete sql;
+	free(sql);
   
 	//check to see if there was an error during execution
 	if (ret == SQL_ERROR) {
@@ -1107,6 +1854,8 @@ void ODBCConnection::QuerySync(const v8::FunctionCallbackInfo<v8::Value>& args)
 		//we must destroy the STMT ourselves.
 		uv_mutex_lock(&ODBC::g_odbcMutex);
     
+		ODBC_COUNT_CALL(SQLFreeHandle);
+		ODBCMetrics::Handle(SQL_HANDLE_STMT, hSTMT, -1);
 		SQLFreeHandle(SQL_HANDLE_STMT, hSTMT);
    
 		uv_mutex_unlock(&ODBC::g_odbcMutex);
@@ -1114,16 +1863,18 @@ void ODBCConnection::QuerySync(const v8::FunctionCallbackInfo<v8::Value>& args)
 		args.GetReturnValue().Set(True(isolate));
 	}
 	else {
-		Local<Value> args1[4];
+		Local<Value> args1[5];
 		bool* canFreeHandle = new bool(true);
     
 		args1[0] = External::New(isolate, conn->m_hENV);
 		args1[1] = External::New(isolate, conn->m_hDBC);
 		args1[2] = External::New(isolate, hSTMT);
 		args1[3] = External::New(isolate, canFreeHandle);
+		args1[4] = External::New(isolate, conn->m_worker);
     
-		v8::Local<v8::FunctionTemplate> ft = v8::Local<v8::FunctionTemplate>::New(isolate, ODBCResult::constructor_template);
-		Local<Object> js_result = ft->GetFunction()->NewInstance(4, args1);
+		v8::Local<v8::FunctionTemplate> ft = v8::Local<v8::FunctionTemplate>::New(isolate, ODBC::State()->resultTemplate);
+		Local<Object> js_result = ft->GetFunction()->NewInstance(5, args1);
+		ObjectWrap::Unwrap<ODBCResult>(js_result)->SetUTF8(conn->m_utf8);
 		args.GetReturnValue().Set(js_result);
 	}
 }
@@ -1224,7 +1975,7 @@ void ODBCConnection::Tables(const v8::FunctionCallbackInfo<v8::Value>& args) {
 	data->conn = conn;
 	work_req->data = data;
   
-	uv_queue_work(uv_default_loop(), work_req, UV_Tables, (uv_after_work_cb) UV_AfterQuery);
+	ODBC::QueueWork(conn->m_worker, work_req, UV_Tables, (uv_after_work_cb) UV_AfterQuery);
 
 	conn->Ref();
 
@@ -1236,10 +1987,13 @@ void ODBCConnection::UV_Tables(uv_work_t* req) {
   
 	uv_mutex_lock(&ODBC::g_odbcMutex);
   
+	ODBC_COUNT_CALL(SQLAllocHandle);
 	SQLAllocHandle(SQL_HANDLE_STMT, data->conn->m_hDBC, &data->hSTMT );
+	ODBCMetrics::Handle(SQL_HANDLE_STMT, data->hSTMT, 1);
   
 	uv_mutex_unlock(&ODBC::g_odbcMutex);
   
+	ODBC_COUNT_CALL(SQLTables);
 	SQLRETURN ret = SQLTables(data->hSTMT, (SQLTCHAR *) data->catalog, SQL_NTS, (SQLTCHAR *) data->schema, SQL_NTS, (SQLTCHAR *) data->table, SQL_NTS, (SQLTCHAR *) data->type, SQL_NTS);
   
 	// this will be checked later in UV_AfterQuery
@@ -1342,7 +2096,7 @@ void ODBCConnection::Columns(const v8::FunctionCallbackInfo<v8::Value>& args) {
 	data->conn = conn;
 	work_req->data = data;
   
-	uv_queue_work(uv_default_loop(), work_req, UV_Columns, (uv_after_work_cb)UV_AfterQuery);
+	ODBC::QueueWork(conn->m_worker, work_req, UV_Columns, (uv_after_work_cb)UV_AfterQuery);
   
 	conn->Ref();
 
@@ -1354,16 +2108,51 @@ void ODBCConnection::UV_Columns(uv_work_t* req) {
   
 	uv_mutex_lock(&ODBC::g_odbcMutex);
   
+	ODBC_COUNT_CALL(SQLAllocHandle);
 	SQLAllocHandle(SQL_HANDLE_STMT, data->conn->m_hDBC, &data->hSTMT );
+	ODBCMetrics::Handle(SQL_HANDLE_STMT, data->hSTMT, 1);
   
 	uv_mutex_unlock(&ODBC::g_odbcMutex);
   
+	ODBC_COUNT_CALL(SQLColumns);
 	SQLRETURN ret = SQLColumns(data->hSTMT, (SQLTCHAR *) data->catalog, SQL_NTS, (SQLTCHAR *) data->schema, SQL_NTS, (SQLTCHAR *) data->table, SQL_NTS, (SQLTCHAR *) data->column, SQL_NTS);
   
 	// this will be checked later in UV_AfterQuery
 	data->result = ret;
 }
 
+/*
+ * SetExecutor
+ * 
+ * Pin this connection to one of the threads of an ODBCExecutor, or pass
+ * null to go back to the libuv threadpool. Statements and results created
+ * afterwards inherit the worker.
+ */
+void ODBCConnection::SetExecutor(const v8::FunctionCallbackInfo<v8::Value>& args) {
+	DEBUG_PRINTF("ODBCConnection::SetExecutor\n");
+	v8::Isolate* isolate = args.GetIsolate();
+	v8::EscapableHandleScope scope(isolate);
+
+	ODBCConnection* conn = ObjectWrap::Unwrap<ODBCConnection>(args.Holder());
+	ODBCWorker* worker = NULL;
+
+	if (args.Length() > 0 && !args[0]->IsNull() && !args[0]->IsUndefined()) {
+		if (!ODBCExecutor::HasInstance(args[0])) {
+			isolate->ThrowException(Exception::TypeError(String::NewFromUtf8(isolate, "ODBCConnection::SetExecutor(): Argument 0 must be an ODBCExecutor or null")));
+			throw Exception::TypeError(String::NewFromUtf8(isolate, "ODBCConnection::SetExecutor(): Argument 0 must be an ODBCExecutor or null"));
+		}
+
+		ODBCExecutor* executor = ObjectWrap::Unwrap<ODBCExecutor>(args[0]->ToObject());
+
+		worker = ODBCThreadGroup::Acquire(executor->Group()->NextWorker());
+	}
+
+	ODBCThreadGroup::Release(conn->m_worker);
+	conn->m_worker = worker;
+
+	args.GetReturnValue().Set(True(isolate));
+}
+
 /*
  * BeginTransactionSync
  * 
@@ -1378,6 +2167,7 @@ void ODBCConnection::BeginTransactionSync(const v8::FunctionCallbackInfo<v8::Val
 	SQLRETURN ret;
 
 	//set the connection manual commits
+	ODBC_COUNT_CALL(SQLSetConnectAttr);
 	ret = SQLSetConnectAttr(conn->m_hDBC, SQL_ATTR_AUTOCOMMIT, (SQLPOINTER) SQL_AUTOCOMMIT_OFF, SQL_NTS);
   
 	if (!SQL_SUCCEEDED(ret)) {
@@ -1422,7 +2212,7 @@ void ODBCConnection::BeginTransaction(const v8::FunctionCallbackInfo<v8::Value>&
 	data->conn = conn;
 	work_req->data = data;
   
-	uv_queue_work(uv_default_loop(), work_req, UV_BeginTransaction, (uv_after_work_cb)UV_AfterBeginTransaction);
+	ODBC::QueueWork(conn->m_worker, work_req, UV_BeginTransaction, (uv_after_work_cb)UV_AfterBeginTransaction);
 
 	args.GetReturnValue().SetUndefined();
 }
@@ -1437,6 +2227,7 @@ void ODBCConnection::UV_BeginTransaction(uv_work_t* req) {
 	query_work_data* data = (query_work_data *)(req->data);
   
 	//set the connection manual commits
+	ODBC_COUNT_CALL(SQLSetConnectAttr);
 	data->result = SQLSetConnectAttr(data->conn->self()->m_hDBC, SQL_ATTR_AUTOCOMMIT, (SQLPOINTER) SQL_AUTOCOMMIT_OFF, SQL_NTS);
 }
 
@@ -1499,6 +2290,7 @@ void ODBCConnection::EndTransactionSync(const v8::FunctionCallbackInfo<v8::Value
 	SQLSMALLINT completionType = (rollback->Value()) ? SQL_ROLLBACK : SQL_COMMIT;
   
 	//Call SQLEndTran
+	ODBC_COUNT_CALL(SQLEndTran);
 	ret = SQLEndTran(SQL_HANDLE_DBC, conn->m_hDBC, completionType);
   
 	//check how the transaction went
@@ -1508,6 +2300,7 @@ void ODBCConnection::EndTransactionSync(const v8::FunctionCallbackInfo<v8::Value
 	}
   
 	//Reset the connection back to autocommit
+	ODBC_COUNT_CALL(SQLSetConnectAttr);
 	ret = SQLSetConnectAttr(conn->m_hDBC, SQL_ATTR_AUTOCOMMIT, (SQLPOINTER) SQL_AUTOCOMMIT_ON, SQL_NTS);
   
 	//check how setting the connection attr went
@@ -1571,7 +2364,7 @@ void ODBCConnection::EndTransaction(const v8::FunctionCallbackInfo<v8::Value>& a
 	data->conn = conn;
 	work_req->data = data;
   
-	uv_queue_work(uv_default_loop(), work_req, UV_EndTransaction, (uv_after_work_cb)UV_AfterEndTransaction);
+	ODBC::QueueWork(conn->m_worker, work_req, UV_EndTransaction, (uv_after_work_cb)UV_AfterEndTransaction);
 
 	args.GetReturnValue().SetUndefined();
 }
@@ -1588,6 +2381,7 @@ void ODBCConnection::UV_EndTransaction(uv_work_t* req) {
 	bool err = false;
   
 	//Call SQLEndTran
+	ODBC_COUNT_CALL(SQLEndTran);
 	SQLRETURN ret = SQLEndTran(SQL_HANDLE_DBC, data->conn->m_hDBC, data->completionType);
   
 	data->result = ret;
@@ -1597,6 +2391,7 @@ void ODBCConnection::UV_EndTransaction(uv_work_t* req) {
 	}
   
 	//Reset the connection back to autocommit
+	ODBC_COUNT_CALL(SQLSetConnectAttr);
 	ret = SQLSetConnectAttr(data->conn->m_hDBC, SQL_ATTR_AUTOCOMMIT, (SQLPOINTER) SQL_AUTOCOMMIT_ON, SQL_NTS);
   
 	if (!SQL_SUCCEEDED(ret) && !err) {
@@ -18,16 +18,18 @@
 #ifndef _SRC_ODBC_CONNECTION_H
 #define _SRC_ODBC_CONNECTION_H
 
+//commands a pipeline worker hop runs before it hands their callbacks to
+//the event loop and queues another hop for the rest
+#define PIPELINE_MAX_PER_HOP 32
+
+struct pipeline_command;
+
 class ODBCConnection : public node::ObjectWrap {
   public:
-   static Persistent<String> OPTION_SQL;
-   static Persistent<String> OPTION_PARAMS;
-   static Persistent<String> OPTION_NORESULTS;
-   static Persistent<FunctionTemplate> constructor_template;
-   
    static void Init(v8::Handle<Object> target);
    
    void Free();
+   void FreeLater();
    
   protected:
     ODBCConnection() {};
@@ -35,7 +37,16 @@ class ODBCConnection : public node::ObjectWrap {
     explicit ODBCConnection(HENV hENV, HDBC hDBC): 
       ObjectWrap(),
       m_hENV(hENV),
-      m_hDBC(hDBC) {};
+      m_hDBC(hDBC),
+      m_worker(NULL),
+      m_sharedPool(NULL),
+      m_utf8(false),
+      m_pipelineHead(NULL),
+      m_pipelineTail(NULL),
+      m_pipelineBusy(false),
+      m_pipelineBuffer(NULL) {
+        uv_mutex_init(&m_pipelineLock);
+      };
      
     ~ODBCConnection();
 
@@ -44,10 +55,13 @@ class ODBCConnection : public node::ObjectWrap {
 
     //Property Getter/Setters
 	static void ConnectedGetter(Local<String> property, const PropertyCallbackInfo<Value>& info);
+	static void IdGetter(Local<String> property, const PropertyCallbackInfo<Value>& info);
 	static void ConnectTimeoutGetter(Local<String> property, const PropertyCallbackInfo<Value>& info);
 	static void ConnectTimeoutSetter(Local<String> property, Local<Value> value, const PropertyCallbackInfo<Value>& info);
 	static void LoginTimeoutGetter(Local<String> property, const PropertyCallbackInfo<Value>& info);
 	static void LoginTimeoutSetter(Local<String> property, Local<Value> value, const PropertyCallbackInfo<Value>& info);
+	static void EncodingGetter(Local<String> property, const PropertyCallbackInfo<Value>& info);
+	static void EncodingSetter(Local<String> property, Local<Value> value, const PropertyCallbackInfo<Value>& info);
 
     //async methods
 	static void BeginTransaction(const v8::FunctionCallbackInfo<v8::Value>& info);
@@ -74,6 +88,14 @@ class ODBCConnection : public node::ObjectWrap {
     static void UV_Query(uv_work_t* req);
     static void UV_AfterQuery(uv_work_t* req, int status);
 
+	static void Pipeline(const v8::FunctionCallbackInfo<v8::Value>& info);
+    static void UV_Pipeline(uv_work_t* req);
+    static void UV_AfterPipeline(uv_work_t* req, int status);
+	static void QueryMulti(const v8::FunctionCallbackInfo<v8::Value>& info);
+    static void QueueCommand(ODBCConnection* conn, pipeline_command* command);
+    static void StartPipeline(ODBCConnection* conn);
+    static void RunPipelineCommand(ODBCConnection* conn, pipeline_command* command);
+
 	static void Columns(const v8::FunctionCallbackInfo<v8::Value>& info);
     static void UV_Columns(uv_work_t* req);
     
@@ -87,6 +109,7 @@ class ODBCConnection : public node::ObjectWrap {
 	static void QuerySync(const v8::FunctionCallbackInfo<v8::Value>& info);
 	static void BeginTransactionSync(const v8::FunctionCallbackInfo<v8::Value>& info);
 	static void EndTransactionSync(const v8::FunctionCallbackInfo<v8::Value>& info);
+	static void SetExecutor(const v8::FunctionCallbackInfo<v8::Value>& info);
     
     struct Fetch_Request {
 		Persistent<Function, CopyablePersistentTraits<v8::Function>> callback;
@@ -99,11 +122,26 @@ class ODBCConnection : public node::ObjectWrap {
   protected:
     HENV m_hENV;
     HDBC m_hDBC;
+    //process wide id, used in the slow query log
+    int m_id;
     SQLUSMALLINT canHaveMoreResults;
     bool connected;
     int statements;
     SQLUINTEGER connectTimeout;
     SQLUINTEGER loginTimeout;
+    ODBCWorker *m_worker;
+    //set when the HDBC was borrowed from an ODBCSharedPool
+    ODBCSharedPool *m_sharedPool;
+    //encoding 'utf8': SQL, string parameters and text columns go through
+    //the ANSI functions and SQL_C_CHAR as UTF-8 (see ODBCNarrow)
+    bool m_utf8;
+
+    //commands waiting for the pipeline worker; guarded by m_pipelineLock
+    uv_mutex_t m_pipelineLock;
+    pipeline_command *m_pipelineHead;
+    pipeline_command *m_pipelineTail;
+    bool m_pipelineBusy;
+    uint16_t *m_pipelineBuffer;
 };
 
 struct create_statement_work_data {
@@ -132,8 +170,41 @@ struct query_work_data {
   
   int sqlLen;
   int sqlSize;
+  //encoding of sql and params, taken from the connection by Query()
+  bool utf8;
   
   int result;
+
+  ODBCTiming timing;
+  struct slow_query_info *slowQuery;
+};
+
+struct pipeline_command {
+  pipeline_command *next;
+	Persistent<Function, CopyablePersistentTraits<v8::Function>> cb;
+  HSTMT hSTMT;
+  
+  Parameter *params;
+  int paramCount;
+  bool noResultObject;
+  bool describe;
+  int fetchMode;
+  
+  void *sql;
+  int sqlLen;
+  //sql and params are UTF-8 (see NewPipelineCommand)
+  bool utf8;
+  
+  RowSet *rowSets;
+  int result;
+};
+
+struct pipeline_work_data {
+  ODBCConnection *conn;
+  pipeline_command *done;
+  pipeline_command *doneTail;
+  //the hop stopped at PIPELINE_MAX_PER_HOP with commands still queued
+  bool more;
 };
 
 struct open_connection_work_data {
@@ -0,0 +1,386 @@
+/*
+  Copyright (c) 2013, Dan VerWeire <dverweire@gmail.com>
+
+  Permission to use, copy, modify, and/or distribute this software for any
+  purpose with or without fee is hereby granted, provided that the above
+  copyright notice and this permission notice appear in all copies.
+
+  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+#include <string.h>
+#include <v8.h>
+#include <node.h>
+#include <node_version.h>
+#include <uv.h>
+
+#include "odbc.h"
+#include "odbc_executor.h"
+
+#define ODBC_TRACE_CATEGORY TRACE_EXECUTOR
+
+using namespace v8;
+using namespace node;
+
+
+/*
+ * ODBCTaskQueue
+ */
+ODBCTaskQueue::ODBCTaskQueue() {
+	m_stub.next = NULL;
+	m_head = &m_stub;
+	m_tail = &m_stub;
+}
+
+void ODBCTaskQueue::Push(executor_task* task) {
+	task->next = NULL;
+
+	//swing the head to the new node; the previous head is ours to link
+	executor_task* prev = (executor_task *) ODBC_ATOMIC_XCHG_PTR(&m_head, task);
+
+	ODBC_ATOMIC_STORE_PTR(&prev->next, task);
+}
+
+executor_task* ODBCTaskQueue::Pop() {
+	executor_task* tail = m_tail;
+	executor_task* next = (executor_task *) ODBC_ATOMIC_LOAD_PTR(&tail->next);
+
+	if (tail == &m_stub) {
+		if (next == NULL) {
+			//empty
+			return NULL;
+		}
+
+		m_tail = next;
+		tail = next;
+		next = (executor_task *) ODBC_ATOMIC_LOAD_PTR(&next->next);
+	}
+
+	if (next) {
+		m_tail = next;
+		return tail;
+	}
+
+	executor_task* head = (executor_task *) ODBC_ATOMIC_LOAD_PTR(&m_head);
+
+	if (tail != head) {
+		//a producer has swung the head but not linked its node yet
+		return NULL;
+	}
+
+	//tail is the last real node; put the stub behind it so it can be taken
+	Push(&m_stub);
+
+	next = (executor_task *) ODBC_ATOMIC_LOAD_PTR(&tail->next);
+
+	if (next) {
+		m_tail = next;
+		return tail;
+	}
+
+	return NULL;
+}
+
+/*
+ * ODBCThreadGroup
+ */
+ODBCThreadGroup* ODBCThreadGroup::Create(ODBCState* state, int threadCount) {
+	DEBUG_PRINTF("ODBCThreadGroup::Create threadCount=%i\n", threadCount);
+
+	ODBCThreadGroup* group = new ODBCThreadGroup();
+
+	group->m_state = state;
+	group->m_shutdown = false;
+	group->m_closed = false;
+	group->m_threadCount = 0;
+	group->m_nextWorker = 0;
+	group->m_refs = 1;
+	group->m_pending = 0;
+	group->m_workers = new ODBCWorker[threadCount];
+
+	uv_async_init(state->loop, &group->m_async, (uv_async_cb) ODBCThreadGroup::CompletionCallback);
+	group->m_async.data = group;
+
+	group->m_next = state->groups;
+	state->groups = group;
+
+	//only keep the loop alive while there is work in flight
+	uv_unref((uv_handle_t *) &group->m_async);
+
+	for (int i = 0; i < threadCount; i++) {
+		ODBCWorker* worker = &group->m_workers[i];
+
+		worker->group = group;
+		uv_sem_init(&worker->ready, 0);
+
+		if (uv_thread_create(&worker->thread, ODBCThreadGroup::WorkerMain, worker) != 0) {
+			uv_sem_destroy(&worker->ready);
+			break;
+		}
+
+		group->m_threadCount++;
+	}
+
+	if (group->m_threadCount != threadCount) {
+		//could not start all of the threads; tear down the ones we have
+		group->Release();
+
+		return NULL;
+	}
+
+	return group;
+}
+
+ODBCWorker* ODBCThreadGroup::Acquire(ODBCWorker* worker) {
+	if (worker) {
+		worker->group->Retain();
+	}
+
+	return worker;
+}
+
+void ODBCThreadGroup::Release(ODBCWorker* worker) {
+	if (worker) {
+		worker->group->Release();
+	}
+}
+
+ODBCWorker* ODBCThreadGroup::NextWorker() {
+	return &m_workers[m_nextWorker++ % m_threadCount];
+}
+
+void ODBCThreadGroup::Retain() {
+	m_refs++;
+}
+
+void ODBCThreadGroup::Release() {
+	if (--m_refs == 0) {
+		if (!m_shutdown) {
+			Shutdown();
+		}
+		else if (m_closed) {
+			//stopped with the environment while still referenced
+			delete [] m_workers;
+			delete this;
+		}
+	}
+}
+
+/*
+ * ShutdownAll
+ *
+ * Stop every group created in an isolate whose environment is going away.
+ * Objects which still reference a group keep its memory alive.
+ */
+void ODBCThreadGroup::ShutdownAll(ODBCState* state) {
+	while (state->groups) {
+		state->groups->Shutdown();
+	}
+}
+
+void ODBCThreadGroup::Dispatch(ODBCWorker* worker, uv_work_t* req, uv_work_cb work_cb, uv_after_work_cb after_work_cb) {
+	executor_task* task = (executor_task *) malloc(sizeof(executor_task));
+
+	task->req = req;
+	task->work_cb = work_cb;
+	task->after_work_cb = after_work_cb;
+
+	//work in flight keeps the group and the loop alive
+	Retain();
+
+	if (m_pending++ == 0) {
+		uv_ref((uv_handle_t *) &m_async);
+	}
+
+	worker->queue.Push(task);
+	uv_sem_post(&worker->ready);
+}
+
+void ODBCThreadGroup::WorkerMain(void* arg) {
+	ODBCWorker* worker = (ODBCWorker *) arg;
+	ODBCThreadGroup* group = worker->group;
+
+	while (true) {
+		uv_sem_wait(&worker->ready);
+
+		executor_task* task;
+
+		//the semaphore says there is a task; a NULL here only means the
+		//producer has not finished linking it yet
+		while ((task = worker->queue.Pop()) == NULL) {
+			ODBC_CPU_RELAX();
+		}
+
+		if (task->req == NULL) {
+			//shutdown sentinel
+			free(task);
+			break;
+		}
+
+		task->work_cb(task->req);
+
+		group->m_completions.Push(task);
+		uv_async_send(&group->m_async);
+	}
+}
+
+void ODBCThreadGroup::CompletionCallback(uv_async_t* handle, int status) {
+	ODBCThreadGroup* group = (ODBCThreadGroup *) handle->data;
+	executor_task* task;
+
+	//hold the group while we drain; an after callback may drop the last
+	//reference held by a result or connection
+	group->Retain();
+
+	while ((task = group->m_completions.Pop()) != NULL) {
+		uv_work_t* req = task->req;
+		uv_after_work_cb after_work_cb = task->after_work_cb;
+
+		free(task);
+
+		if (--group->m_pending == 0) {
+			uv_unref((uv_handle_t *) &group->m_async);
+		}
+
+		after_work_cb(req, 0);
+
+		group->Release();
+	}
+
+	group->Release();
+}
+
+void ODBCThreadGroup::Shutdown() {
+	DEBUG_PRINTF("ODBCThreadGroup::Shutdown threadCount=%i\n", m_threadCount);
+
+	m_shutdown = true;
+
+	for (ODBCThreadGroup** link = &m_state->groups; *link; link = &(*link)->m_next) {
+		if (*link == this) {
+			*link = m_next;
+			break;
+		}
+	}
+
+	for (int i = 0; i < m_threadCount; i++) {
+		ODBCWorker* worker = &m_workers[i];
+		executor_task* task = (executor_task *) calloc(1, sizeof(executor_task));
+
+		worker->queue.Push(task);
+		uv_sem_post(&worker->ready);
+	}
+
+	for (int i = 0; i < m_threadCount; i++) {
+		uv_thread_join(&m_workers[i].thread);
+		uv_sem_destroy(&m_workers[i].ready);
+	}
+
+	uv_close((uv_handle_t *) &m_async, ODBCThreadGroup::CloseCallback);
+}
+
+void ODBCThreadGroup::CloseCallback(uv_handle_t* handle) {
+	ODBCThreadGroup* group = (ODBCThreadGroup *) handle->data;
+
+	group->m_closed = true;
+
+	if (group->m_refs <= 0) {
+		delete [] group->m_workers;
+		delete group;
+	}
+}
+
+/*
+ * ODBCExecutor
+ */
+void ODBCExecutor::Init(v8::Handle<Object> target) {
+	DEBUG_PRINTF("ODBCExecutor::Init\n");
+	v8::Isolate* isolate = v8::Isolate::GetCurrent();
+	v8::EscapableHandleScope scope(isolate);
+
+	Local<FunctionTemplate> t = FunctionTemplate::New(isolate, ODBCExecutor::New);
+
+	// Constructor Template
+	ODBC::State()->executorTemplate.Reset(isolate, t);
+	t->SetClassName(String::NewFromUtf8(isolate, "ODBCExecutor", String::kInternalizedString));
+
+	// Reserve space for one Handle<Value>
+	Local<ObjectTemplate> instance_template = t->InstanceTemplate();
+	instance_template->SetInternalFieldCount(1);
+
+	// Properties
+	instance_template->SetAccessor(String::NewFromUtf8(isolate, "threads"), ThreadsGetter);
+	instance_template->SetAccessor(String::NewFromUtf8(isolate, "pending"), PendingGetter);
+
+	// Attach the Executor Constructor to the target object
+	target->Set(v8::String::NewFromUtf8(isolate, "ODBCExecutor", String::kInternalizedString), t->GetFunction());
+}
+
+ODBCExecutor::~ODBCExecutor() {
+	DEBUG_PRINTF("ODBCExecutor::~ODBCExecutor\n");
+	m_group->Release();
+}
+
+bool ODBCExecutor::HasInstance(Local<Value> value) {
+	v8::Isolate* isolate = v8::Isolate::GetCurrent();
+
+	v8::Local<v8::FunctionTemplate> ft = v8::Local<v8::FunctionTemplate>::New(isolate, ODBC::State()->executorTemplate);
+
+	return value->IsObject() && ft->HasInstance(value);
+}
+
+/*
+ * New
+ */
+void ODBCExecutor::New(const v8::FunctionCallbackInfo<v8::Value>& args) {
+	DEBUG_PRINTF("ODBCExecutor::New\n");
+	v8::Isolate* isolate = args.GetIsolate();
+	v8::EscapableHandleScope scope(isolate);
+
+	int threads = 1;
+
+	if (args.Length() > 0 && !args[0]->IsUndefined()) {
+		if (!args[0]->IsInt32() || args[0]->Int32Value() < 1 || args[0]->Int32Value() > MAX_EXECUTOR_THREADS) {
+			isolate->ThrowException(Exception::TypeError(String::NewFromUtf8(isolate, "ODBCExecutor(): Argument 0 must be an integer between 1 and 64")));
+			throw Exception::TypeError(String::NewFromUtf8(isolate, "ODBCExecutor(): Argument 0 must be an integer between 1 and 64"));
+		}
+
+		threads = args[0]->Int32Value();
+	}
+
+	ODBCThreadGroup* group = ODBCThreadGroup::Create(ODBC::State(), threads);
+
+	if (!group) {
+		isolate->ThrowException(Exception::Error(String::NewFromUtf8(isolate, "[node-odbc] Could not start executor threads")));
+		throw Exception::Error(String::NewFromUtf8(isolate, "[node-odbc] Could not start executor threads"));
+	}
+
+	ODBCExecutor* executor = new ODBCExecutor(group);
+
+	executor->Wrap(args.Holder());
+
+	args.GetReturnValue().Set(args.Holder());
+}
+
+void ODBCExecutor::ThreadsGetter(Local<String> property, const PropertyCallbackInfo<Value>& info) {
+	v8::Isolate* isolate = info.GetIsolate();
+	v8::EscapableHandleScope scope(isolate);
+
+	ODBCExecutor *obj = ObjectWrap::Unwrap<ODBCExecutor>(info.Holder());
+
+	info.GetReturnValue().Set(Integer::New(isolate, obj->m_group->ThreadCount()));
+}
+
+void ODBCExecutor::PendingGetter(Local<String> property, const PropertyCallbackInfo<Value>& info) {
+	v8::Isolate* isolate = info.GetIsolate();
+	v8::EscapableHandleScope scope(isolate);
+
+	ODBCExecutor *obj = ObjectWrap::Unwrap<ODBCExecutor>(info.Holder());
+
+	info.GetReturnValue().Set(Integer::New(isolate, obj->m_group->Pending()));
+}
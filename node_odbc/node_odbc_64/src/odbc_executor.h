@@ -0,0 +1,137 @@
+/*
+  Copyright (c) 2013, Dan VerWeire <dverweire@gmail.com>
+
+  Permission to use, copy, modify, and/or distribute this software for any
+  purpose with or without fee is hereby granted, provided that the above
+  copyright notice and this permission notice appear in all copies.
+
+  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+#ifndef _SRC_ODBC_EXECUTOR_H
+#define _SRC_ODBC_EXECUTOR_H
+
+#include "odbc_atomic.h"
+
+#define MAX_EXECUTOR_THREADS 64
+
+class ODBCThreadGroup;
+
+//a unit of work queued on an executor thread. The node is intrusive so
+//that moving it from the command queue to the completion queue never
+//allocates.
+struct executor_task {
+  executor_task* volatile next;
+  uv_work_t* req;
+  uv_work_cb work_cb;
+  uv_after_work_cb after_work_cb;
+};
+
+//Unbounded intrusive multi-producer/single-consumer queue (Vyukov).
+//Push() is wait-free and may be called from any thread; Pop() must only
+//be called by the single consumer and may transiently return NULL while
+//a producer is in the middle of a Push().
+class ODBCTaskQueue {
+  public:
+    ODBCTaskQueue();
+
+    void Push(executor_task* task);
+    executor_task* Pop();
+
+  protected:
+    executor_task* volatile m_head;
+    executor_task* m_tail;
+    executor_task m_stub;
+};
+
+struct ODBCWorker {
+  ODBCThreadGroup* group;
+  uv_thread_t thread;
+  uv_sem_t ready;
+  ODBCTaskQueue queue;
+};
+
+//A bounded group of native threads which run the blocking ODBC calls
+//instead of the libuv threadpool. Each connection is pinned to one
+//worker, so everything issued on that connection (and on its statements
+//and results) runs in order on the same thread. Completions are handed
+//back to the event loop through a single uv_async_t.
+//
+//The group is reference counted: the JS ODBCExecutor object and every
+//connection, statement and result using one of its workers hold a
+//reference, as does every task in flight. Retain/Release must be called
+//on the event loop thread of the isolate which created the group. When
+//that isolate's environment is torn down (a worker_thread exiting) the
+//group is stopped regardless of its references.
+class ODBCThreadGroup {
+  public:
+    static ODBCThreadGroup* Create(ODBCState* state, int threadCount);
+    static void ShutdownAll(ODBCState* state);
+    static ODBCWorker* Acquire(ODBCWorker* worker);
+    static void Release(ODBCWorker* worker);
+
+    ODBCWorker* NextWorker();
+    void Dispatch(ODBCWorker* worker, uv_work_t* req, uv_work_cb work_cb, uv_after_work_cb after_work_cb);
+    void Retain();
+    void Release();
+
+    int ThreadCount() { return m_threadCount; }
+    int Pending() { return m_pending; }
+
+  protected:
+    ODBCThreadGroup() {};
+    ~ODBCThreadGroup() {};
+
+    static void WorkerMain(void* arg);
+    static void CompletionCallback(uv_async_t* handle, int status);
+    static void CloseCallback(uv_handle_t* handle);
+
+    void Shutdown();
+
+    ODBCState* m_state;
+    ODBCThreadGroup* m_next;
+    bool m_shutdown;
+    bool m_closed;
+
+    ODBCWorker* m_workers;
+    int m_threadCount;
+    unsigned int m_nextWorker;
+    int m_refs;
+    int m_pending;
+
+    uv_async_t m_async;
+    ODBCTaskQueue m_completions;
+};
+
+class ODBCExecutor : public node::ObjectWrap {
+  public:
+    static void Init(v8::Handle<Object> target);
+
+    static bool HasInstance(Local<Value> value);
+
+    ODBCThreadGroup* Group() { return m_group; }
+
+  protected:
+    explicit ODBCExecutor(ODBCThreadGroup* group):
+      ObjectWrap(),
+      m_group(group) {};
+
+    ~ODBCExecutor();
+
+    //constructor
+	static void New(const v8::FunctionCallbackInfo<v8::Value>& info);
+
+    //property getters
+	static void ThreadsGetter(Local<String> property, const PropertyCallbackInfo<Value>& info);
+	static void PendingGetter(Local<String> property, const PropertyCallbackInfo<Value>& info);
+
+    ODBCThreadGroup* m_group;
+};
+
+#endif
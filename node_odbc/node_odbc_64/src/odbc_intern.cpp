@@ -0,0 +1,134 @@
+/*
+  Copyright (c) 2013, Dan VerWeire <dverweire@gmail.com>
+
+  Permission to use, copy, modify, and/or distribute this software for any
+  purpose with or without fee is hereby granted, provided that the above
+  copyright notice and this permission notice appear in all copies.
+
+  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+
+#include <string.h>
+#include <stdlib.h>
+#include <v8.h>
+#include <node.h>
+#include <uv.h>
+
+#include "odbc.h"
+#include "odbc_intern.h"
+#include "odbc_hash.h"
+#include "odbc_text.h"
+
+#define ODBC_TRACE_CATEGORY TRACE_FETCH
+
+using namespace v8;
+using namespace node;
+
+ODBCIntern::ODBCIntern() :
+	m_buckets(NULL),
+	m_count(0),
+	m_bytes(0),
+	m_hits(0),
+	m_misses(0),
+	m_disabled(false) {
+}
+
+ODBCIntern::~ODBCIntern() {
+	if (!m_buckets) {
+		return;
+	}
+
+	for (int i = 0; i < INTERN_BUCKETS; i++) {
+		intern_entry* entry = m_buckets[i];
+
+		while (entry) {
+			intern_entry* chain = entry->chain;
+
+			entry->string.Reset();
+			free(entry->data);
+			delete entry;
+
+			entry = chain;
+		}
+	}
+
+	free(m_buckets);
+}
+
+/*
+ * Attach
+ */
+void ODBCIntern::Attach(Column* columns, short colCount) {
+	for (int i = 0; i < colCount; i++) {
+		columns[i].intern = new ODBCIntern();
+	}
+}
+
+static Local<String> NewString(Isolate* isolate, const void* data, int bytes, bool utf8) {
+	if (utf8) {
+		return String::NewFromUtf8(isolate, (const char *) data, String::kNormalString, bytes);
+	}
+
+	return ODBCText::NewString(isolate, (const uint16_t *) data, bytes / sizeof(uint16_t));
+}
+
+/*
+ * Get
+ */
+Local<String> ODBCIntern::Get(Isolate* isolate, const void* data, int bytes, bool utf8) {
+	EscapableHandleScope scope(isolate);
+
+	if (m_disabled || bytes > INTERN_MAX_VALUE) {
+		return scope.Escape(NewString(isolate, data, bytes, utf8));
+	}
+
+	uint32_t hash = ODBCHash(data, bytes);
+
+	if (m_buckets) {
+		for (intern_entry* entry = m_buckets[hash % INTERN_BUCKETS]; entry; entry = entry->chain) {
+			if (entry->hash == hash && entry->bytes == bytes && memcmp(entry->data, data, bytes) == 0) {
+				m_hits++;
+
+				return scope.Escape(Local<String>::New(isolate, entry->string));
+			}
+		}
+	}
+
+	m_misses++;
+
+	Local<String> str = NewString(isolate, data, bytes, utf8);
+
+	if (m_count < INTERN_MAX_ENTRIES && m_bytes + bytes <= INTERN_MAX_BYTES) {
+		if (!m_buckets) {
+			m_buckets = (intern_entry **) calloc(INTERN_BUCKETS, sizeof(intern_entry *));
+		}
+
+		intern_entry* entry = new intern_entry();
+
+		entry->hash = hash;
+		entry->bytes = bytes;
+		entry->data = (char *) malloc(bytes ? bytes : 1);
+		memcpy(entry->data, data, bytes);
+		entry->string.Reset(isolate, str);
+		entry->chain = m_buckets[hash % INTERN_BUCKETS];
+		m_buckets[hash % INTERN_BUCKETS] = entry;
+
+		m_count++;
+		m_bytes += bytes;
+	}
+	//the table is full and most cells are still new: the column does not
+	//repeat its values, so stop paying for the lookups
+	else if (m_misses > 4 * INTERN_MAX_ENTRIES && m_misses > m_hits) {
+		DEBUG_PRINTF("ODBCIntern::Get disabled after %u hits, %u misses\n", m_hits, m_misses);
+		m_disabled = true;
+	}
+
+	return scope.Escape(str);
+}
@@ -0,0 +1,65 @@
+/*
+  Copyright (c) 2013, Dan VerWeire <dverweire@gmail.com>
+
+  Permission to use, copy, modify, and/or distribute this software for any
+  purpose with or without fee is hereby granted, provided that the above
+  copyright notice and this permission notice appear in all copies.
+
+  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+
+#ifndef _SRC_ODBC_INTERN_H
+#define _SRC_ODBC_INTERN_H
+
+//limits of one column's table
+#define INTERN_MAX_ENTRIES 1024
+#define INTERN_MAX_BYTES 65536
+//longer values are never interned
+#define INTERN_MAX_VALUE 256
+#define INTERN_BUCKETS 1024
+
+//One distinct value of a column: its text as fetched and the string
+//every cell with that text gets.
+typedef struct intern_entry {
+  uint32_t hash;
+  int bytes;
+  char *data;
+  v8::Persistent<v8::String> string;
+  //next entry in the same hash bucket
+  struct intern_entry *chain;
+} intern_entry;
+
+//Strings of one text column of a result with intern set, so that status,
+//country or category columns share a handful of strings instead of
+//creating one per cell. Lives as long as the columns of the result set
+//and may only be used and deleted on the main thread.
+class ODBCIntern {
+  public:
+    ODBCIntern();
+    ~ODBCIntern();
+
+    //the string for bytes of text fetched as UTF-8 (utf8) or UTF-16
+    v8::Local<v8::String> Get(v8::Isolate* isolate, const void* data, int bytes, bool utf8);
+
+    //give every column of a result set a table of its own
+    static void Attach(Column* columns, short colCount);
+
+  protected:
+    intern_entry **m_buckets;
+    int m_count;
+    int m_bytes;
+
+    uint32_t m_hits;
+    uint32_t m_misses;
+    //set once the column turned out not to repeat its values
+    bool m_disabled;
+};
+
+#endif
@@ -0,0 +1,154 @@
+/*
+  Copyright (c) 2013, Dan VerWeire <dverweire@gmail.com>
+
+  Permission to use, copy, modify, and/or distribute this software for any
+  purpose with or without fee is hereby granted, provided that the above
+  copyright notice and this permission notice appear in all copies.
+
+  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+#include <string.h>
+#include <v8.h>
+#include <node.h>
+#include <node_version.h>
+#include <uv.h>
+
+#include "odbc.h"
+#include "odbc_metrics.h"
+
+#define ODBC_TRACE_CATEGORY TRACE_STATS
+
+using namespace v8;
+using namespace node;
+
+int64_t ODBCMetrics::g_metrics[METRIC_COUNT];
+int64_t ODBCMetrics::g_calls[CALL_COUNT];
+
+typedef struct {
+	char state[6];
+	int64_t count;
+} sqlstate_count;
+
+//errors by SQLSTATE, guarded by g_errorsLock
+static sqlstate_count g_errors[METRIC_MAX_SQLSTATES];
+static int g_errorCount = 0;
+static int64_t g_otherErrors = 0;
+static uv_mutex_t g_errorsLock;
+static uv_once_t g_errorsLockOnce = UV_ONCE_INIT;
+
+//in the order of the CALL_* defines
+static const char* g_callNames[CALL_COUNT] = {
+	"SQLAllocHandle", "SQLFreeHandle", "SQLSetEnvAttr", "SQLSetConnectAttr",
+	"SQLDriverConnect", "SQLDisconnect", "SQLGetFunctions", "SQLPrepare",
+	"SQLBindParameter", "SQLExecute", "SQLExecDirect", "SQLNumResultCols",
+	"SQLColAttribute", "SQLFetch", "SQLGetData", "SQLRowCount",
+	"SQLMoreResults", "SQLFreeStmt", "SQLEndTran", "SQLTables", "SQLColumns",
+	"SQLGetDiagField", "SQLGetDiagRec"
+};
+
+static void InitErrorsLock() {
+	uv_mutex_init(&g_errorsLock);
+}
+
+void ODBCMetrics::Init(v8::Handle<Object> target) {
+	DEBUG_PRINTF("ODBCMetrics::Init\n");
+	v8::Isolate* isolate = v8::Isolate::GetCurrent();
+
+	//the counters are shared by every isolate; only set up the lock once
+	uv_once(&g_errorsLockOnce, InitErrorsLock);
+
+	target->Set(String::NewFromUtf8(isolate, "metrics"), FunctionTemplate::New(isolate, Metrics)->GetFunction());
+}
+
+/*
+ * Error
+ *
+ * Count one diagnostic record with the five character SQLSTATE state.
+ * Errors are rare enough that a lock around the table is fine.
+ */
+void ODBCMetrics::Error(const SQLTCHAR* state) {
+	char narrow[6];
+
+	//SQLSTATEs are plain ASCII, also when SQLTCHAR is a wide character
+	for (int j = 0; j < 5; j++) {
+		narrow[j] = (char) state[j];
+	}
+	narrow[5] = '\0';
+
+	uv_mutex_lock(&g_errorsLock);
+
+	int i;
+
+	for (i = 0; i < g_errorCount; i++) {
+		if (strcmp(g_errors[i].state, narrow) == 0) {
+			break;
+		}
+	}
+
+	if (i == g_errorCount && g_errorCount < METRIC_MAX_SQLSTATES) {
+		strcpy(g_errors[i].state, narrow);
+		g_errorCount++;
+	}
+
+	if (i < g_errorCount) {
+		g_errors[i].count++;
+	}
+	else {
+		g_otherErrors++;
+	}
+
+	uv_mutex_unlock(&g_errorsLock);
+}
+
+/*
+ * Metrics
+ *
+ * metrics() -> { envHandles, dbcHandles, stmtHandles, results, bufferBytes,
+ *   rowsFetched, bytesDecoded, externalStringBytes, calls : { SQLFetch : n, ... },
+ *   errors : { "42S02" : n, ... } }
+ */
+void ODBCMetrics::Metrics(const v8::FunctionCallbackInfo<v8::Value>& args) {
+	v8::Isolate* isolate = args.GetIsolate();
+	v8::EscapableHandleScope scope(isolate);
+
+	Local<Object> metrics = Object::New(isolate);
+	Local<Object> calls = Object::New(isolate);
+	Local<Object> errors = Object::New(isolate);
+
+	metrics->Set(String::NewFromUtf8(isolate, "envHandles"), Number::New(isolate, (double) ODBC_ATOMIC_LOAD64(&g_metrics[METRIC_ENV_HANDLES])));
+	metrics->Set(String::NewFromUtf8(isolate, "dbcHandles"), Number::New(isolate, (double) ODBC_ATOMIC_LOAD64(&g_metrics[METRIC_DBC_HANDLES])));
+	metrics->Set(String::NewFromUtf8(isolate, "stmtHandles"), Number::New(isolate, (double) ODBC_ATOMIC_LOAD64(&g_metrics[METRIC_STMT_HANDLES])));
+	metrics->Set(String::NewFromUtf8(isolate, "results"), Number::New(isolate, (double) ODBC_ATOMIC_LOAD64(&g_metrics[METRIC_RESULTS])));
+	metrics->Set(String::NewFromUtf8(isolate, "bufferBytes"), Number::New(isolate, (double) ODBC_ATOMIC_LOAD64(&g_metrics[METRIC_BUFFER_BYTES])));
+	metrics->Set(String::NewFromUtf8(isolate, "rowsFetched"), Number::New(isolate, (double) ODBC_ATOMIC_LOAD64(&g_metrics[METRIC_ROWS_FETCHED])));
+	metrics->Set(String::NewFromUtf8(isolate, "bytesDecoded"), Number::New(isolate, (double) ODBC_ATOMIC_LOAD64(&g_metrics[METRIC_BYTES_DECODED])));
+	metrics->Set(String::NewFromUtf8(isolate, "externalStringBytes"), Number::New(isolate, (double) ODBC_ATOMIC_LOAD64(&g_metrics[METRIC_EXTERNAL_STRING_BYTES])));
+
+	for (int i = 0; i < CALL_COUNT; i++) {
+		calls->Set(String::NewFromUtf8(isolate, g_callNames[i]), Number::New(isolate, (double) ODBC_ATOMIC_LOAD64(&g_calls[i])));
+	}
+
+	uv_mutex_lock(&g_errorsLock);
+
+	for (int i = 0; i < g_errorCount; i++) {
+		errors->Set(String::NewFromUtf8(isolate, g_errors[i].state), Number::New(isolate, (double) g_errors[i].count));
+	}
+
+	if (g_otherErrors) {
+		errors->Set(String::NewFromUtf8(isolate, "other"), Number::New(isolate, (double) g_otherErrors));
+	}
+
+	uv_mutex_unlock(&g_errorsLock);
+
+	metrics->Set(String::NewFromUtf8(isolate, "calls"), calls);
+	metrics->Set(String::NewFromUtf8(isolate, "errors"), errors);
+
+	args.GetReturnValue().Set(metrics);
+}
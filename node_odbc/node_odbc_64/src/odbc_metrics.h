@@ -0,0 +1,127 @@
+/*
+  Copyright (c) 2013, Dan VerWeire <dverweire@gmail.com>
+
+  Permission to use, copy, modify, and/or distribute this software for any
+  purpose with or without fee is hereby granted, provided that the above
+  copyright notice and this permission notice appear in all copies.
+
+  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+#ifndef _SRC_ODBC_METRICS_H
+#define _SRC_ODBC_METRICS_H
+
+#include "odbc_atomic.h"
+#include "odbc_probes.h"
+
+//gauges and counters
+#define METRIC_ENV_HANDLES 0
+#define METRIC_DBC_HANDLES 1
+#define METRIC_STMT_HANDLES 2
+#define METRIC_RESULTS 3
+#define METRIC_BUFFER_BYTES 4
+#define METRIC_ROWS_FETCHED 5
+#define METRIC_BYTES_DECODED 6
+#define METRIC_EXTERNAL_STRING_BYTES 7
+#define METRIC_COUNT 8
+
+//driver functions, counted with ODBC_COUNT_CALL(SQLFetch)
+#define CALL_SQLAllocHandle 0
+#define CALL_SQLFreeHandle 1
+#define CALL_SQLSetEnvAttr 2
+#define CALL_SQLSetConnectAttr 3
+#define CALL_SQLDriverConnect 4
+#define CALL_SQLDisconnect 5
+#define CALL_SQLGetFunctions 6
+#define CALL_SQLPrepare 7
+#define CALL_SQLBindParameter 8
+#define CALL_SQLExecute 9
+#define CALL_SQLExecDirect 10
+#define CALL_SQLNumResultCols 11
+#define CALL_SQLColAttribute 12
+#define CALL_SQLFetch 13
+#define CALL_SQLGetData 14
+#define CALL_SQLRowCount 15
+#define CALL_SQLMoreResults 16
+#define CALL_SQLFreeStmt 17
+#define CALL_SQLEndTran 18
+#define CALL_SQLTables 19
+#define CALL_SQLColumns 20
+#define CALL_SQLGetDiagField 21
+#define CALL_SQLGetDiagRec 22
+#define CALL_COUNT 23
+
+//distinct SQLSTATEs counted; the rest are counted as "other"
+#define METRIC_MAX_SQLSTATES 128
+
+//## keeps the name from being expanded, so the unicode and dynodbc
+//aliases of the driver functions (SQLExecDirect -> SQLExecDirectW) still
+//map to the right counter
+#define ODBC_COUNT_CALL(fn) ODBC_ATOMIC_ADD64(&ODBCMetrics::g_calls[CALL_##fn], 1)
+#define ODBC_METRIC_ADD(metric, val) ODBC_ATOMIC_ADD64(&ODBCMetrics::g_metrics[metric], (int64_t) (val))
+
+//Process wide runtime counters. Every update is a single relaxed atomic
+//add, cheap enough to leave on in production; they are only read when
+//metrics() is called.
+class ODBCMetrics {
+  public:
+    static void Init(v8::Handle<Object> target);
+
+    //a handle of type was allocated (delta 1) or freed (delta -1);
+    //null handles are not counted
+    static inline void Handle(SQLSMALLINT type, void* handle, int delta) {
+      if (handle == NULL) {
+        return;
+      }
+
+      if (delta > 0) {
+        ODBC_PROBE2(handle__alloc, type, handle);
+      }
+      else {
+        ODBC_PROBE2(handle__free, type, handle);
+      }
+
+      switch (type) {
+        case SQL_HANDLE_ENV :
+          ODBC_METRIC_ADD(METRIC_ENV_HANDLES, delta);
+          break;
+        case SQL_HANDLE_DBC :
+          ODBC_METRIC_ADD(METRIC_DBC_HANDLES, delta);
+          break;
+        case SQL_HANDLE_STMT :
+          ODBC_METRIC_ADD(METRIC_STMT_HANDLES, delta);
+          break;
+      }
+    }
+
+    static inline void Fetched(SQLRETURN ret) {
+      if (SQL_SUCCEEDED(ret)) {
+        ODBC_METRIC_ADD(METRIC_ROWS_FETCHED, 1);
+      }
+    }
+
+    //len is the indicator SQLGetData returned; SQL_NULL_DATA and
+    //SQL_NO_TOTAL are negative
+    static inline void Decoded(SQLRETURN ret, SQLLEN len) {
+      if (SQL_SUCCEEDED(ret) && len > 0) {
+        ODBC_METRIC_ADD(METRIC_BYTES_DECODED, len);
+      }
+    }
+
+    static void Error(const SQLTCHAR* state);
+
+    static int64_t g_metrics[METRIC_COUNT];
+    static int64_t g_calls[CALL_COUNT];
+
+  protected:
+    //JS functions
+    static void Metrics(const v8::FunctionCallbackInfo<v8::Value>& info);
+};
+
+#endif
@@ -0,0 +1,47 @@
+/*
+  Copyright (c) 2013, Dan VerWeire <dverweire@gmail.com>
+
+  Permission to use, copy, modify, and/or distribute this software for any
+  purpose with or without fee is hereby granted, provided that the above
+  copyright notice and this permission notice appear in all copies.
+
+  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+
+//everything in here must call the ANSI functions, whatever the build says
+#undef UNICODE
+#undef _UNICODE
+
+#ifdef dynodbc
+#include "dynodbc.h"
+#else
+#ifdef _WIN32
+#include <windows.h>
+#endif
+#include <sql.h>
+#include <sqltypes.h>
+#include <sqlext.h>
+#endif
+
+#include "odbc_narrow.h"
+
+/*
+ * ExecDirect
+ */
+SQLRETURN ODBCNarrow::ExecDirect(SQLHSTMT hStmt, SQLCHAR* sql, SQLINTEGER length) {
+	return SQLExecDirect(hStmt, sql, length);
+}
+
+/*
+ * Prepare
+ */
+SQLRETURN ODBCNarrow::Prepare(SQLHSTMT hStmt, SQLCHAR* sql, SQLINTEGER length) {
+	return SQLPrepare(hStmt, sql, length);
+}
@@ -0,0 +1,31 @@
+/*
+  Copyright (c) 2013, Dan VerWeire <dverweire@gmail.com>
+
+  Permission to use, copy, modify, and/or distribute this software for any
+  purpose with or without fee is hereby granted, provided that the above
+  copyright notice and this permission notice appear in all copies.
+
+  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+
+#ifndef _SRC_ODBC_NARROW_H
+#define _SRC_ODBC_NARROW_H
+
+//The ANSI functions of the driver manager, for connections opened with
+//encoding 'utf8': the SQL text goes to the driver as UTF-8 bytes. The
+//addon is built with UNICODE, which maps SQLExecDirect to SQLExecDirectW,
+//so these are defined in a file built without it.
+class ODBCNarrow {
+  public:
+    static SQLRETURN ExecDirect(SQLHSTMT hStmt, SQLCHAR* sql, SQLINTEGER length);
+    static SQLRETURN Prepare(SQLHSTMT hStmt, SQLCHAR* sql, SQLINTEGER length);
+};
+
+#endif
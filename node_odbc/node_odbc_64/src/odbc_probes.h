@@ -0,0 +1,78 @@
+/*
+  Copyright (c) 2013, Dan VerWeire <dverweire@gmail.com>
+
+  Permission to use, copy, modify, and/or distribute this software for any
+  purpose with or without fee is hereby granted, provided that the above
+  copyright notice and this permission notice appear in all copies.
+
+  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+#ifndef _SRC_ODBC_PROBES_H
+#define _SRC_ODBC_PROBES_H
+
+#include "odbc_hash.h"
+
+//USDT probes, compiled in with `node-gyp rebuild -- -Dodbc_usdt=true` (needs
+//<sys/sdt.h> from systemtap-sdt-dev). Every probe has a semaphore which the
+//tracer sets while it is attached, so the arguments are only computed when
+//someone listens; without a tracer a probe is a nop plus a predicted branch.
+//
+//  bpftrace -e 'usdt:./build/Release/odbc_bindings.node:odbc:query__done
+//    { @us[arg0] = hist(arg4 / 1000); }'
+//
+//  open__start(connectionId)
+//  open__done(connectionId, ret, ns)
+//  query__start(connectionId, sqlHash)
+//  query__done(connectionId, sqlHash, hSTMT, ret, ns)
+//  execute__start(hSTMT)
+//  execute__done(hSTMT, ret, ns)
+//  fetch__done(hSTMT, ret, ns)                  one SQLFetch
+//  fetchall__done(hSTMT, rows, ns)              a whole fetchAll()
+//  handle__alloc(type, handle)
+//  handle__free(type, handle)
+
+#define ODBC_PROBES(X) \
+  X(open__start) \
+  X(open__done) \
+  X(query__start) \
+  X(query__done) \
+  X(execute__start) \
+  X(execute__done) \
+  X(fetch__done) \
+  X(fetchall__done) \
+  X(handle__alloc) \
+  X(handle__free)
+
+#ifdef ODBC_USDT
+  #define _SDT_HAS_SEMAPHORES 1
+  #include <sys/sdt.h>
+
+  #define ODBC_PROBE_SEMAPHORE(name) extern unsigned short odbc_##name##_semaphore;
+  ODBC_PROBES(ODBC_PROBE_SEMAPHORE)
+
+  //defines the semaphores; used once, in odbc.cpp
+  #define ODBC_PROBE_DEFINE(name) unsigned short odbc_##name##_semaphore __attribute__((section(".probes")));
+
+  #define ODBC_PROBE_ENABLED(name) __builtin_expect(odbc_##name##_semaphore, 0)
+  #define ODBC_PROBE1(name, a) STAP_PROBE1(odbc, name, a)
+  #define ODBC_PROBE2(name, a, b) STAP_PROBE2(odbc, name, a, b)
+  #define ODBC_PROBE3(name, a, b, c) STAP_PROBE3(odbc, name, a, b, c)
+  #define ODBC_PROBE5(name, a, b, c, d, e) STAP_PROBE5(odbc, name, a, b, c, d, e)
+#else
+  #define ODBC_PROBE_DEFINE(name)
+
+  #define ODBC_PROBE_ENABLED(name) 0
+  #define ODBC_PROBE1(name, a)
+  #define ODBC_PROBE2(name, a, b)
+  #define ODBC_PROBE3(name, a, b, c)
+  #define ODBC_PROBE5(name, a, b, c, d, e)
+#endif
+
+#endif
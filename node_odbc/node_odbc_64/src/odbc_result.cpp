@@ -24,13 +24,20 @@
 #include "odbc.h"
 #include "odbc_connection.h"
 #include "odbc_result.h"
+#include "odbc_stats.h"
+#include "odbc_metrics.h"
+#include "odbc_slowlog.h"
+#include "odbc_probes.h"
 #include "odbc_statement.h"
+#include "odbc_executor.h"
+#include "odbc_intern.h"
+#include "odbc_aggregate.h"
+
+#define ODBC_TRACE_CATEGORY TRACE_FETCH
 
 using namespace v8;
 using namespace node;
 
-Persistent<FunctionTemplate> ODBCResult::constructor_template;
-Persistent<String> ODBCResult::OPTION_FETCH_MODE(v8::Isolate::GetCurrent(), String::NewFromUtf8(v8::Isolate::GetCurrent(), "fetchMode"));
 
 void ODBCResult::Init(v8::Handle<Object> target) {
 	DEBUG_PRINTF("ODBCResult::Init\n");
@@ -39,7 +46,7 @@ void ODBCResult::Init(v8::Handle<Object> target) {
 
 	Local<FunctionTemplate> t = FunctionTemplate::New(isolate, ODBCResult::New);
 
-	constructor_template.Reset(isolate, t);
+	ODBC::State()->resultTemplate.Reset(isolate, t);
 	t->SetClassName(String::NewFromUtf8(isolate, "ODBCResult", String::kInternalizedString));
 
 	// Reserve space for one Handle<Value>
@@ -49,6 +56,8 @@ void ODBCResult::Init(v8::Handle<Object> target) {
 	// Prototype Methods
 	NODE_SET_PROTOTYPE_METHOD(t, "fetchAll", FetchAll);
 	NODE_SET_PROTOTYPE_METHOD(t, "fetch", Fetch);
+	NODE_SET_PROTOTYPE_METHOD(t, "fetchBatch", FetchBatch);
+	NODE_SET_PROTOTYPE_METHOD(t, "aggregate", Aggregate);
 
 	NODE_SET_PROTOTYPE_METHOD(t, "moreResultsSync", MoreResultsSync);
 	NODE_SET_PROTOTYPE_METHOD(t, "closeSync", CloseSync);
@@ -58,22 +67,31 @@ void ODBCResult::Init(v8::Handle<Object> target) {
 
 	// Properties
 	instance_template->SetAccessor(String::NewFromUtf8(isolate, "fetchMode"), FetchModeGetter, (AccessorSetterCallback)FetchModeSetter);
+	instance_template->SetAccessor(String::NewFromUtf8(isolate, "intern"), InternGetter, (AccessorSetterCallback)InternSetter);
   
 	// Attach the Database Constructor to the target object
 	target->Set(v8::String::NewFromUtf8(isolate, "ODBCResult", String::kInternalizedString), t->GetFunction());
 }
 
 ODBCResult::~ODBCResult() {
-	DEBUG_PRINTF("ODBCResult::~ODBCResult m_hSTMT=%x\n", m_hSTMT);
+	DEBUG_PRINTF("ODBCResult::~ODBCResult m_hSTMT=%p\n", m_hSTMT);
 	this->Free();
+  
+	ODBCThreadGroup::Release(m_worker);
+
+	ODBCSlowLog::FreeInfo(m_slowQuery);
+
+	ODBC_METRIC_ADD(METRIC_RESULTS, -1);
 }
 
 void ODBCResult::Free() {
-	DEBUG_PRINTF("ODBCResult::Free m_hSTMT=%X m_canFreeHandle=%X\n", m_hSTMT, m_canFreeHandle);
+	DEBUG_PRINTF("ODBCResult::Free m_hSTMT=%p m_canFreeHandle=%i\n", m_hSTMT, m_canFreeHandle);
   
 	if (m_hSTMT && m_canFreeHandle) {
 		uv_mutex_lock(&ODBC::g_odbcMutex);
     
+		ODBC_COUNT_CALL(SQLFreeHandle);
+		ODBCMetrics::Handle(SQL_HANDLE_STMT, m_hSTMT, -1);
 		SQLFreeHandle( SQL_HANDLE_STMT, m_hSTMT);
     
 		m_hSTMT = NULL;
@@ -82,6 +100,7 @@ void ODBCResult::Free() {
 	}
   
 	if (bufferLength > 0) {
+		ODBC_METRIC_ADD(METRIC_BUFFER_BYTES, -(bufferLength + 1));
 		bufferLength = 0;
 		free(buffer);
 	}
@@ -125,17 +144,41 @@ void ODBCResult::New(const v8::FunctionCallbackInfo<v8::Value>& args) {
 	//create a new OBCResult object
 	ODBCResult* objODBCResult = new ODBCResult(hENV, hDBC, hSTMT, *canFreeHandle);
   
-	DEBUG_PRINTF("ODBCResult::New m_hDBC=%X m_hDBC=%X m_hSTMT=%X canFreeHandle=%X\n", objODBCResult->m_hENV, objODBCResult->m_hDBC, objODBCResult->m_hSTMT, objODBCResult->m_canFreeHandle);
+	DEBUG_PRINTF("ODBCResult::New m_hDBC=%p m_hDBC=%p m_hSTMT=%p canFreeHandle=%i\n", objODBCResult->m_hENV, objODBCResult->m_hDBC, objODBCResult->m_hSTMT, objODBCResult->m_canFreeHandle);
   
 	//free the pointer to canFreeHandle
 	delete canFreeHandle;
 
+	//fetch on the same executor worker as the connection or statement
+	//which created this result, if any
+	if (args.Length() > 4 && args[4]->IsExternal()) {
+		ODBCWorker* worker = static_cast<ODBCWorker *>(Local<External>::Cast(args[4])->Value());
+		objODBCResult->m_worker = ODBCThreadGroup::Acquire(worker);
+	}
+
+	//the phase timing of the query which created this result, if any;
+	//FetchAll() completes it
+	memset(&objODBCResult->m_timing, 0, sizeof(ODBCTiming));
+
+	if (args.Length() > 5 && args[5]->IsExternal()) {
+		objODBCResult->m_timing = *static_cast<ODBCTiming *>(Local<External>::Cast(args[5])->Value());
+	}
+
+	//owned by the result from now on
+	objODBCResult->m_slowQuery = NULL;
+
+	if (args.Length() > 6 && args[6]->IsExternal()) {
+		objODBCResult->m_slowQuery = static_cast<slow_query_info *>(Local<External>::Cast(args[6])->Value());
+	}
+
 	//specify the buffer length
 	objODBCResult->bufferLength = MAX_VALUE_SIZE - 1;
   
 	//initialze a buffer for this object
 	objODBCResult->buffer = (uint16_t *) malloc(objODBCResult->bufferLength + 1);
 	//TODO: make sure the malloc succeeded
+	ODBC_METRIC_ADD(METRIC_BUFFER_BYTES, objODBCResult->bufferLength + 1);
+	ODBC_METRIC_ADD(METRIC_RESULTS, 1);
 
 	//set the initial colCount to 0
 	objODBCResult->colCount = 0;
@@ -168,6 +211,43 @@ void ODBCResult::FetchModeSetter(Local<String> property, Local<Value> value, con
 	}
 }
 
+void ODBCResult::InternGetter(Local<String> property, const PropertyCallbackInfo<Value>& args) {
+	v8::Isolate* isolate = args.GetIsolate();
+	v8::EscapableHandleScope scope(isolate);
+
+	ODBCResult *obj = ObjectWrap::Unwrap<ODBCResult>(args.Holder());
+
+	args.GetReturnValue().Set(Boolean::New(isolate, obj->m_intern));
+}
+
+/*
+ * InternSetter
+ *
+ * Takes effect with the next result set whose columns have not been read
+ * yet, so set it before the first fetch.
+ */
+void ODBCResult::InternSetter(Local<String> property, Local<Value> value, const PropertyCallbackInfo<Value>& args) {
+	v8::Isolate* isolate = args.GetIsolate();
+	v8::EscapableHandleScope scope(isolate);
+
+	ODBCResult *obj = ObjectWrap::Unwrap<ODBCResult>(args.Holder());
+
+	obj->m_intern = value->BooleanValue();
+}
+
+/*
+ * GetColumns
+ */
+Column* ODBCResult::GetColumns() {
+	Column* columns = ODBC::GetColumns(m_hSTMT, &colCount, m_utf8);
+
+	if (m_intern) {
+		ODBCIntern::Attach(columns, colCount);
+	}
+
+	return columns;
+}
+
 /*
  * Fetch
  */
@@ -184,22 +264,26 @@ void ODBCResult::Fetch(const v8::FunctionCallbackInfo<v8::Value>& args) {
 	fetch_work_data* data = (fetch_work_data *) calloc(1, sizeof(fetch_work_data));
   
 	Local<Function> cb;
+	Local<Promise> promise;
    
 	//set the fetch mode to the default of this instance
 	data->fetchMode = objODBCResult->m_fetchMode;
   
+	Local<Object> obj;
+
 	if (args.Length() == 1 && args[0]->IsFunction()) {
 		cb = Local<Function>::Cast(args[0]);
 	}
 	else if (args.Length() == 2 && args[0]->IsObject() && args[1]->IsFunction()) {
 		cb = Local<Function>::Cast(args[1]);  
-    
-		Local<Object> obj = args[0]->ToObject();
-    
-		v8::Local<v8::String> optionFetchMode = v8::Local<v8::String>::New(isolate, OPTION_FETCH_MODE);
+		obj = args[0]->ToObject();
+	}
+	else if (args.Length() == 0 || (args.Length() == 1 && args[0]->IsObject())) {
+		//fetch() and fetch({ options }) return a promise
+		cb = ODBC::PromiseCallback(isolate, &promise);
 
-		if (obj->Has(optionFetchMode) && obj->Get(optionFetchMode)->IsInt32()) {
-			data->fetchMode = obj->Get(optionFetchMode)->ToInt32()->Value();
+		if (args.Length() == 1) {
+			obj = args[0]->ToObject();
 		}
 	}
 	else {
@@ -207,23 +291,45 @@ void ODBCResult::Fetch(const v8::FunctionCallbackInfo<v8::Value>& args) {
 		throw Exception::TypeError(String::NewFromUtf8(isolate, "ODBCResult::Fetch(): 1 or 2 arguments are required. The last argument must be a callback function."));
 	}
   
+	if (!obj.IsEmpty()) {
+		v8::Local<v8::String> optionFetchMode = v8::Local<v8::String>::New(isolate, ODBC::State()->optionFetchMode);
+
+		if (obj->Has(optionFetchMode) && obj->Get(optionFetchMode)->IsInt32()) {
+			data->fetchMode = obj->Get(optionFetchMode)->ToInt32()->Value();
+		}
+	}
+
 	v8::Persistent<v8::Function> persistent(isolate, cb);
 	data->cb = persistent;
 
 	data->objResult = objODBCResult;
 	work_req->data = data;
   
-	uv_queue_work(uv_default_loop(), work_req, UV_Fetch, (uv_after_work_cb)UV_AfterFetch);
+	ODBC::QueueWork(objODBCResult->m_worker, work_req, UV_Fetch, (uv_after_work_cb)UV_AfterFetch);
 
 	objODBCResult->Ref();
 
-	args.GetReturnValue().SetUndefined();
+	if (!promise.IsEmpty()) {
+		args.GetReturnValue().Set(promise);
+	}
+	else {
+		args.GetReturnValue().SetUndefined();
+	}
 }
 
 void ODBCResult::UV_Fetch(uv_work_t* work_req) {
 	DEBUG_PRINTF("ODBCResult::UV_Fetch\n");
 	fetch_work_data* data = (fetch_work_data *)(work_req->data);
+
+	uint64_t start = ODBC_PROBE_ENABLED(fetch__done) ? uv_hrtime() : 0;
+
+	ODBC_COUNT_CALL(SQLFetch);
 	data->result = SQLFetch(data->objResult->m_hSTMT);
+	ODBCMetrics::Fetched(data->result);
+
+	if (ODBC_PROBE_ENABLED(fetch__done)) {
+		ODBC_PROBE3(fetch__done, data->objResult->m_hSTMT, data->result, uv_hrtime() - start);
+	}
 }
 
 void ODBCResult::UV_AfterFetch(uv_work_t* work_req, int status) {
@@ -242,7 +348,7 @@ void ODBCResult::UV_AfterFetch(uv_work_t* work_req, int status) {
 	bool error = false;
   
 	if (data->objResult->colCount == 0) {
-		data->objResult->columns = ODBC::GetColumns(data->objResult->m_hSTMT, &data->objResult->colCount);
+		data->objResult->columns = data->objResult->GetColumns();
 	}
   
 	//check to see if the result has no columns
@@ -316,6 +422,285 @@ void ODBCResult::UV_AfterFetch(uv_work_t* work_req, int status) {
 	return;
 }
 
+/*
+ * FetchBatch
+ *
+ * fetchBatch(maxRows, [{ fetchMode }], [cb])
+ *
+ * Fetch up to maxRows rows in one trip to the worker thread. The rows are
+ * read into a RowSet on the worker and turned into JS values in one go, so
+ * the callback (or promise) gets an array of rows, or null once the result
+ * is exhausted.
+ */
+void ODBCResult::FetchBatch(const v8::FunctionCallbackInfo<v8::Value>& args) {
+	DEBUG_PRINTF("ODBCResult::FetchBatch\n");
+  
+	v8::Isolate* isolate = args.GetIsolate();
+	v8::EscapableHandleScope scope(isolate);
+
+	ODBCResult* objODBCResult = ObjectWrap::Unwrap<ODBCResult>(args.Holder());
+
+	if (args.Length() <= (0) || !args[0]->IsInt32() || args[0]->Int32Value() <= 0) {
+		isolate->ThrowException(Exception::TypeError(String::NewFromUtf8(isolate, "ODBCResult::FetchBatch(): Argument 0 must be a positive Integer.")));
+		throw Exception::TypeError(String::NewFromUtf8(isolate, "ODBCResult::FetchBatch(): Argument 0 must be a positive Integer."));
+	}
+
+	Local<Function> cb;
+	Local<Promise> promise;
+	Local<Object> obj;
+	int argc = args.Length();
+
+	if (argc > 1 && args[argc - 1]->IsFunction()) {
+		cb = Local<Function>::Cast(args[argc - 1]);
+		argc--;
+	}
+	else {
+		cb = ODBC::PromiseCallback(isolate, &promise);
+	}
+
+	if (argc > 1 && args[1]->IsObject()) {
+		obj = args[1]->ToObject();
+	}
+
+	uv_work_t* work_req = (uv_work_t *) (calloc(1, sizeof(uv_work_t)));
+  
+	fetch_batch_work_data* data = (fetch_batch_work_data *) calloc(1, sizeof(fetch_batch_work_data));
+
+	data->fetchMode = objODBCResult->m_fetchMode;
+	data->maxRows = args[0]->Int32Value();
+
+	if (!obj.IsEmpty()) {
+		v8::Local<v8::String> optionFetchMode = v8::Local<v8::String>::New(isolate, ODBC::State()->optionFetchMode);
+
+		if (obj->Has(optionFetchMode) && obj->Get(optionFetchMode)->IsInt32()) {
+			data->fetchMode = obj->Get(optionFetchMode)->ToInt32()->Value();
+		}
+	}
+
+	v8::Persistent<v8::Function, CopyablePersistentTraits<v8::Function>> persistent(isolate, cb);
+	data->cb = persistent;
+
+	data->objResult = objODBCResult;
+	work_req->data = data;
+  
+	ODBC::QueueWork(objODBCResult->m_worker, work_req, UV_FetchBatch, (uv_after_work_cb)UV_AfterFetchBatch);
+
+	objODBCResult->Ref();
+
+	if (!promise.IsEmpty()) {
+		args.GetReturnValue().Set(promise);
+	}
+	else {
+		args.GetReturnValue().SetUndefined();
+	}
+}
+
+void ODBCResult::UV_FetchBatch(uv_work_t* work_req) {
+	DEBUG_PRINTF("ODBCResult::UV_FetchBatch\n");
+	fetch_batch_work_data* data = (fetch_batch_work_data *)(work_req->data);
+	ODBCResult* self = data->objResult->self();
+
+	//describe the columns here too so that the event loop never has to
+	if (self->colCount == 0) {
+		self->columns = self->GetColumns();
+	}
+
+	data->rowSet = ODBC::FetchRowSet(self->m_hSTMT, self->columns, self->colCount, self->buffer, self->bufferLength, data->maxRows, self->m_utf8);
+}
+
+void ODBCResult::UV_AfterFetchBatch(uv_work_t* work_req, int status) {
+	DEBUG_PRINTF("ODBCResult::UV_AfterFetchBatch\n");
+  
+	v8::Isolate* isolate = v8::Isolate::GetCurrent();
+	v8::EscapableHandleScope scope(isolate);
+
+	fetch_batch_work_data* data = (fetch_batch_work_data *)(work_req->data);
+	ODBCResult* self = data->objResult->self();
+	RowSet* rowSet = data->rowSet;
+
+	Local<Value> args[2];
+
+	if (rowSet->result == SQL_ERROR) {
+		args[0] = ODBC::GetSQLError(SQL_HANDLE_STMT, self->m_hSTMT, (char *) "Error in ODBCResult::UV_AfterFetchBatch");
+		args[1] = Null(isolate);
+	}
+	else if (rowSet->rowCount == 0) {
+		args[0] = Null(isolate);
+		args[1] = Null(isolate);
+	}
+	else {
+		args[0] = Null(isolate);
+		args[1] = ODBC::RowSetToArray(rowSet, data->fetchMode);
+	}
+
+	//same as fetch(): the columns go once the last row has been read
+	if (rowSet->result != SQL_SUCCESS && self->colCount) {
+		ODBC::FreeColumns(self->columns, &self->colCount);
+	}
+
+	ODBC::FreeRowSet(rowSet);
+
+	TryCatch try_catch;
+
+	v8::Local<v8::Function> f = v8::Local<v8::Function>::New(isolate, data->cb);
+	f->Call(isolate->GetCurrentContext()->Global(), 2, args);
+	data->cb.Reset();
+
+	if (try_catch.HasCaught()) {
+		FatalException(try_catch);
+	}
+
+	data->objResult->Unref();
+
+	free(data);
+	free(work_req);
+}
+
+/*
+ * Aggregate
+ *
+ * aggregate(spec, [cb])
+ *
+ * Filter, group and aggregate the remaining rows of the result set on the
+ * worker thread (see ODBCAggregate for spec). The rows are fetched in
+ * batches and folded into the groups without creating any JS values; the
+ * callback (or promise) gets one object per group and { rows, matched,
+ * groups }.
+ */
+void ODBCResult::Aggregate(const v8::FunctionCallbackInfo<v8::Value>& args) {
+	DEBUG_PRINTF("ODBCResult::Aggregate\n");
+  
+	v8::Isolate* isolate = args.GetIsolate();
+	v8::EscapableHandleScope scope(isolate);
+
+	ODBCResult* objODBCResult = ObjectWrap::Unwrap<ODBCResult>(args.Holder());
+
+	if (args.Length() <= (0) || !args[0]->IsObject()) {
+		isolate->ThrowException(Exception::TypeError(String::NewFromUtf8(isolate, "ODBCResult::Aggregate(): Argument 0 must be an Object.")));
+		throw Exception::TypeError(String::NewFromUtf8(isolate, "ODBCResult::Aggregate(): Argument 0 must be an Object."));
+	}
+
+	const char* error = NULL;
+	ODBCAggregate* aggregate = ODBCAggregate::New(isolate, args[0]->ToObject(), &error);
+
+	if (!aggregate) {
+		isolate->ThrowException(Exception::TypeError(String::NewFromUtf8(isolate, error)));
+		throw Exception::TypeError(String::NewFromUtf8(isolate, error));
+	}
+
+	Local<Function> cb;
+	Local<Promise> promise;
+
+	if (args.Length() > 1 && args[1]->IsFunction()) {
+		cb = Local<Function>::Cast(args[1]);
+	}
+	else {
+		cb = ODBC::PromiseCallback(isolate, &promise);
+	}
+
+	uv_work_t* work_req = (uv_work_t *) (calloc(1, sizeof(uv_work_t)));
+  
+	aggregate_work_data* data = (aggregate_work_data *) calloc(1, sizeof(aggregate_work_data));
+
+	v8::Persistent<v8::Function, CopyablePersistentTraits<v8::Function>> persistent(isolate, cb);
+	data->cb = persistent;
+
+	data->aggregate = aggregate;
+	data->objResult = objODBCResult;
+	work_req->data = data;
+  
+	ODBC::QueueWork(objODBCResult->m_worker, work_req, UV_Aggregate, (uv_after_work_cb)UV_AfterAggregate);
+
+	objODBCResult->Ref();
+
+	if (!promise.IsEmpty()) {
+		args.GetReturnValue().Set(promise);
+	}
+	else {
+		args.GetReturnValue().SetUndefined();
+	}
+}
+
+void ODBCResult::UV_Aggregate(uv_work_t* work_req) {
+	DEBUG_PRINTF("ODBCResult::UV_Aggregate\n");
+	aggregate_work_data* data = (aggregate_work_data *)(work_req->data);
+	ODBCResult* self = data->objResult->self();
+
+	data->result = SQL_SUCCESS;
+
+	if (self->colCount == 0) {
+		self->columns = self->GetColumns();
+	}
+
+	if (!data->aggregate->Bind(self->columns, self->colCount)) {
+		return;
+	}
+
+	//one batch at a time, so that memory does not grow with the result set
+	while (data->result == SQL_SUCCESS) {
+		RowSet* rowSet = ODBC::FetchRowSet(self->m_hSTMT, self->columns, self->colCount, self->buffer, self->bufferLength, AGGREGATE_BATCH_ROWS, self->m_utf8);
+		bool added = data->aggregate->Add(rowSet);
+
+		data->result = rowSet->result;
+		ODBC::FreeRowSet(rowSet);
+
+		if (!added) {
+			break;
+		}
+	}
+}
+
+void ODBCResult::UV_AfterAggregate(uv_work_t* work_req, int status) {
+	DEBUG_PRINTF("ODBCResult::UV_AfterAggregate\n");
+  
+	v8::Isolate* isolate = v8::Isolate::GetCurrent();
+	v8::EscapableHandleScope scope(isolate);
+
+	aggregate_work_data* data = (aggregate_work_data *)(work_req->data);
+	ODBCResult* self = data->objResult->self();
+
+	Local<Value> args[3];
+
+	if (data->aggregate->Error()) {
+		args[0] = Exception::Error(String::NewFromUtf8(isolate, data->aggregate->Error()));
+		args[1] = Null(isolate);
+		args[2] = Null(isolate);
+	}
+	else if (data->result == SQL_ERROR) {
+		args[0] = ODBC::GetSQLError(SQL_HANDLE_STMT, self->m_hSTMT, (char *) "[node-odbc] Error in ODBCResult::UV_AfterAggregate");
+		args[1] = Null(isolate);
+		args[2] = Null(isolate);
+	}
+	else {
+		//before the columns go, the groups are named after them
+		args[0] = Null(isolate);
+		args[1] = data->aggregate->ToArray(isolate);
+		args[2] = data->aggregate->Info(isolate);
+	}
+
+	//same as fetch(): the columns go once the last row has been read
+	if (data->result != SQL_SUCCESS && self->colCount) {
+		ODBC::FreeColumns(self->columns, &self->colCount);
+	}
+
+	delete data->aggregate;
+
+	TryCatch try_catch;
+
+	v8::Local<v8::Function> f = v8::Local<v8::Function>::New(isolate, data->cb);
+	f->Call(isolate->GetCurrentContext()->Global(), 3, args);
+	data->cb.Reset();
+
+	if (try_catch.HasCaught()) {
+		FatalException(try_catch);
+	}
+
+	data->objResult->Unref();
+
+	free(data);
+	free(work_req);
+}
+
 /*
  * FetchSync
  */
@@ -336,17 +721,25 @@ void ODBCResult::FetchSync(const v8::FunctionCallbackInfo<v8::Value>& args) {
 	if (args.Length() == 1 && args[0]->IsObject()) {
 		Local<Object> obj = args[0]->ToObject();
     
-		v8::Local<v8::String> optionFetchMode = v8::Local<v8::String>::New(isolate, OPTION_FETCH_MODE);
+		v8::Local<v8::String> optionFetchMode = v8::Local<v8::String>::New(isolate, ODBC::State()->optionFetchMode);
 	
 		if (obj->Has(optionFetchMode) && obj->Get(optionFetchMode)->IsInt32()) {
 			fetchMode = obj->Get(optionFetchMode)->ToInt32()->Value();
 		}
 	}
   
+	uint64_t start = ODBC_PROBE_ENABLED(fetch__done) ? uv_hrtime() : 0;
+
+	ODBC_COUNT_CALL(SQLFetch);
 	SQLRETURN ret = SQLFetch(objResult->m_hSTMT);
+	ODBCMetrics::Fetched(ret);
+
+	if (ODBC_PROBE_ENABLED(fetch__done)) {
+		ODBC_PROBE3(fetch__done, objResult->m_hSTMT, ret, uv_hrtime() - start);
+	}
 
 	if (objResult->colCount == 0) {
-		objResult->columns = ODBC::GetColumns(objResult->m_hSTMT, &objResult->colCount);
+		objResult->columns = objResult->GetColumns();
 	}
   
 	//check to see if the result has no columns
@@ -418,7 +811,7 @@ void ODBCResult::FetchAll(const v8::FunctionCallbackInfo<v8::Value>& args) {
     
 		Local<Object> obj = args[0]->ToObject();
     
-		v8::Local<v8::String> optionFetchMode = v8::Local<v8::String>::New(isolate, OPTION_FETCH_MODE);
+		v8::Local<v8::String> optionFetchMode = v8::Local<v8::String>::New(isolate, ODBC::State()->optionFetchMode);
 	
 		if (obj->Has(optionFetchMode) && obj->Get(optionFetchMode)->IsInt32()) {
 			data->fetchMode = obj->Get(optionFetchMode)->ToInt32()->Value();
@@ -442,8 +835,21 @@ void ODBCResult::FetchAll(const v8::FunctionCallbackInfo<v8::Value>& args) {
 	data->objResult = objODBCResult;
   
 	work_req->data = data;
+
+	//only the first FetchAll() after a query counts as that query; later
+	//result sets are timed for the callback only. The first FetchAll() of
+	//a statement's result goes on with the timing of the execute, for the
+	//callback and the slow query log, but is not counted either
+	data->record = (objODBCResult->m_timing.enqueued != 0) && objODBCResult->m_timing.histogram;
+
+	if (objODBCResult->m_timing.enqueued != 0) {
+		ODBCStats::Start(&objODBCResult->m_timing);
+	}
+	else {
+		ODBCStats::Begin(&objODBCResult->m_timing, 0);
+	}
   
-	uv_queue_work(uv_default_loop(), work_req, UV_FetchAll, (uv_after_work_cb)UV_AfterFetchAll);
+	ODBC::QueueWork(objODBCResult->m_worker, work_req, UV_FetchAll, (uv_after_work_cb)UV_AfterFetchAll);
 
 	data->objResult->Ref();
 
@@ -453,7 +859,16 @@ void ODBCResult::FetchAll(const v8::FunctionCallbackInfo<v8::Value>& args) {
 void ODBCResult::UV_FetchAll(uv_work_t* work_req) {
 	DEBUG_PRINTF("ODBCResult::UV_FetchAll\n");
 	fetch_work_data* data = (fetch_work_data *)(work_req->data);
+
+	uint64_t start = ODBCStats::Start(&data->objResult->m_timing);
+
+	ODBC_COUNT_CALL(SQLFetch);
 	data->result = SQLFetch(data->objResult->m_hSTMT);
+	ODBCMetrics::Fetched(data->result);
+
+	ODBCStats::End(&data->objResult->m_timing, TIMING_FETCH, start);
+
+	ODBC_PROBE3(fetch__done, data->objResult->m_hSTMT, data->result, data->objResult->m_timing.mark - start);
 }
 
 void ODBCResult::UV_AfterFetchAll(uv_work_t* work_req, int status) {
@@ -467,9 +882,12 @@ void ODBCResult::UV_AfterFetchAll(uv_work_t* work_req, int status) {
 	ODBCResult* self = data->objResult->self();
   
 	bool doMoreWork = true;
+
+	uint64_t start = ODBCStats::Start(&self->m_timing);
   
 	if (self->colCount == 0) {
-		self->columns = ODBC::GetColumns(self->m_hSTMT, &self->colCount);
+		self->columns = self->GetColumns();
+		ODBCStats::End(&self->m_timing, TIMING_FETCH, start);
 	}
   
 	//check to see if the result set has columns
@@ -493,6 +911,8 @@ void ODBCResult::UV_AfterFetchAll(uv_work_t* work_req, int status) {
 	}
 	else {
 		v8::Local<v8::Array> a = v8::Local<v8::Array>::New(isolate, data->rows);
+
+		start = ODBCStats::Start(&self->m_timing);
 	
 		if (data->fetchMode == FETCH_ARRAY) {
 			a->Set(Integer::New(isolate, data->count), ODBC::GetRecordArray(self->m_hSTMT, self->columns, &self->colCount, self->buffer, self->bufferLength));
@@ -500,17 +920,19 @@ void ODBCResult::UV_AfterFetchAll(uv_work_t* work_req, int status) {
 		else {
 			a->Set(Integer::New(isolate, data->count), ODBC::GetRecordTuple(self->m_hSTMT, self->columns, &self->colCount, self->buffer, self->bufferLength));
 		}
+
+		ODBCStats::End(&self->m_timing, TIMING_MATERIALIZE, start);
 		data->count++;
 	}
   
 	if (doMoreWork) {
 		//Go back to the thread pool and fetch more data!
-		uv_queue_work(uv_default_loop(), work_req, UV_FetchAll, (uv_after_work_cb)UV_AfterFetchAll);
+		ODBC::QueueWork(self->m_worker, work_req, UV_FetchAll, (uv_after_work_cb)UV_AfterFetchAll);
 	}
 	else {
 		ODBC::FreeColumns(self->columns, &self->colCount);
     
-		Handle<Value> args[2];
+		Handle<Value> args[3];
     
 		if (data->errorCount > 0) {
 			args[0] = Local<Object>::New(isolate, data->objError);
@@ -521,10 +943,26 @@ void ODBCResult::UV_AfterFetchAll(uv_work_t* work_req, int status) {
     
 		args[1] = Local<Array>::New(isolate, data->rows);
 
+		Local<Object> timing = ODBCStats::Finish(&self->m_timing, data->record);
+		args[2] = timing;
+
+		ODBCSlowLog::Record(self->m_slowQuery, &self->m_timing, data->count);
+		self->m_slowQuery = NULL;
+
+		ODBC_PROBE3(fetchall__done, self->m_hSTMT, data->count, self->m_timing.phases[TIMING_FETCH]);
+
 		TryCatch try_catch;
 
+		start = ODBCStats::Start(&self->m_timing);
+
 		v8::Local<v8::Function> f = v8::Local<v8::Function>::New(isolate, data->cb);
-		f->Call(isolate->GetCurrentContext()->Global(), 2, args);
+		f->Call(isolate->GetCurrentContext()->Global(), 3, args);
+
+		ODBCStats::Callback(&self->m_timing, timing, start, data->record);
+
+		//a later FetchAll() on the next result set is timed on its own
+		self->m_timing.enqueued = 0;
+
 		data->cb.Reset();
 		data->rows.Reset();
 		data->objError.Reset();
@@ -562,15 +1000,17 @@ void ODBCResult::FetchAllSync(const v8::FunctionCallbackInfo<v8::Value>& args) {
 	if (args.Length() == 1 && args[0]->IsObject()) {
 		Local<Object> obj = args[0]->ToObject();
     
-		v8::Local<v8::String> optionFetchMode = v8::Local<v8::String>::New(isolate, OPTION_FETCH_MODE);
+		v8::Local<v8::String> optionFetchMode = v8::Local<v8::String>::New(isolate, ODBC::State()->optionFetchMode);
 	
 		if (obj->Has(optionFetchMode) && obj->Get(optionFetchMode)->IsInt32()) {
 			fetchMode = obj->Get(optionFetchMode)->ToInt32()->Value();
 		}
 	}
   
+	uint64_t start = ODBC_PROBE_ENABLED(fetchall__done) ? uv_hrtime() : 0;
+
 	if (self->colCount == 0) {
-		self->columns = ODBC::GetColumns(self->m_hSTMT, &self->colCount);
+		self->columns = self->GetColumns();
 	}
   
 	Local<Array> rows = Array::New(isolate);
@@ -579,7 +1019,9 @@ void ODBCResult::FetchAllSync(const v8::FunctionCallbackInfo<v8::Value>& args) {
 	if (self->colCount > 0) {
 		//loop through all records
 		while (true) {
+			ODBC_COUNT_CALL(SQLFetch);
 			ret = SQLFetch(self->m_hSTMT);
+			ODBCMetrics::Fetched(ret);
       
 			//check to see if there was an error
 			if (ret == SQL_ERROR)  {
@@ -606,6 +1048,10 @@ void ODBCResult::FetchAllSync(const v8::FunctionCallbackInfo<v8::Value>& args) {
 	else {
 		ODBC::FreeColumns(self->columns, &self->colCount);
 	}
+
+	if (ODBC_PROBE_ENABLED(fetchall__done)) {
+		ODBC_PROBE3(fetchall__done, self->m_hSTMT, count, uv_hrtime() - start);
+	}
   
 	//throw the error object if there were errors
 	if (errorCount > 0) {
@@ -649,6 +1095,7 @@ void ODBCResult::CloseSync(const v8::FunctionCallbackInfo<v8::Value>& args) {
 		//We technically can't free the handle so, we'll SQL_CLOSE
 		uv_mutex_lock(&ODBC::g_odbcMutex);
     
+		ODBC_COUNT_CALL(SQLFreeStmt);
 		SQLFreeStmt(result->m_hSTMT, SQL_CLOSE);
   
 		uv_mutex_unlock(&ODBC::g_odbcMutex);
@@ -656,6 +1103,7 @@ void ODBCResult::CloseSync(const v8::FunctionCallbackInfo<v8::Value>& args) {
 	else {
 		uv_mutex_lock(&ODBC::g_odbcMutex);
     
+		ODBC_COUNT_CALL(SQLFreeStmt);
 		SQLFreeStmt(result->m_hSTMT, closeOption);
   
 		uv_mutex_unlock(&ODBC::g_odbcMutex);
@@ -672,6 +1120,7 @@ void ODBCResult::MoreResultsSync(const v8::FunctionCallbackInfo<v8::Value>& args
 
 	ODBCResult* result = ObjectWrap::Unwrap<ODBCResult>(args.Holder());
   
+	ODBC_COUNT_CALL(SQLMoreResults);
 	SQLRETURN ret = SQLMoreResults(result->m_hSTMT);
 
 	if (ret == SQL_ERROR) {
@@ -696,7 +1145,7 @@ void ODBCResult::GetColumnNamesSync(const v8::FunctionCallbackInfo<v8::Value>& a
 	Local<Array> cols = Array::New(isolate);
   
 	if (self->colCount == 0) {
-		self->columns = ODBC::GetColumns(self->m_hSTMT, &self->colCount);
+		self->columns = self->GetColumns();
 	}
   
 	//Local<Object> cols = Object::New(isolate);
@@ -19,11 +19,12 @@
 
 class ODBCResult : public node::ObjectWrap {
   public:
-   static Persistent<String> OPTION_FETCH_MODE;
-   static Persistent<FunctionTemplate> constructor_template;
    static void Init(v8::Handle<Object> target);
    
    void Free();
+
+   //takes the encoding of the connection that created it
+   void SetUTF8(bool utf8) { m_utf8 = utf8; }
    
   protected:
     ODBCResult() {};
@@ -33,7 +34,10 @@ class ODBCResult : public node::ObjectWrap {
       m_hENV(hENV),
       m_hDBC(hDBC),
       m_hSTMT(hSTMT),
-      m_canFreeHandle(canFreeHandle) {};
+      m_canFreeHandle(canFreeHandle),
+      m_worker(NULL),
+      m_utf8(false),
+      m_intern(false) {};
      
     ~ODBCResult();
 
@@ -45,9 +49,17 @@ class ODBCResult : public node::ObjectWrap {
     static void UV_Fetch(uv_work_t* work_req);
     static void UV_AfterFetch(uv_work_t* work_req, int status);
 
+	static void FetchBatch(const v8::FunctionCallbackInfo<v8::Value>& info);
+    static void UV_FetchBatch(uv_work_t* work_req);
+    static void UV_AfterFetchBatch(uv_work_t* work_req, int status);
+
 	static void FetchAll(const v8::FunctionCallbackInfo<v8::Value>& info);
     static void UV_FetchAll(uv_work_t* work_req);
     static void UV_AfterFetchAll(uv_work_t* work_req, int status);
+
+	static void Aggregate(const v8::FunctionCallbackInfo<v8::Value>& info);
+    static void UV_Aggregate(uv_work_t* work_req);
+    static void UV_AfterAggregate(uv_work_t* work_req, int status);
     
     //sync methods
 	static void CloseSync(const v8::FunctionCallbackInfo<v8::Value>& info);
@@ -59,6 +71,11 @@ class ODBCResult : public node::ObjectWrap {
     //property getter/setters
 	static void FetchModeGetter(Local<String> property, const PropertyCallbackInfo<Value>& info);
 	static void FetchModeSetter(Local<String> property, Local<Value> value, const PropertyCallbackInfo<Value>& info);
+	static void InternGetter(Local<String> property, const PropertyCallbackInfo<Value>& info);
+	static void InternSetter(Local<String> property, Local<Value> value, const PropertyCallbackInfo<Value>& info);
+
+    //the columns of the current result set, with string tables if m_intern
+    Column* GetColumns();
     
     struct fetch_work_data {
 	  Persistent<Function, CopyablePersistentTraits<v8::Function>> cb;
@@ -68,10 +85,28 @@ class ODBCResult : public node::ObjectWrap {
       int fetchMode;
       int count;
       int errorCount;
+      //the timing belongs to a query execution and goes into the histograms
+      bool record;
 	  Persistent<Array, CopyablePersistentTraits<v8::Array>> rows;
 	  Persistent<Object, CopyablePersistentTraits<v8::Object>> objError;
     };
     
+    struct fetch_batch_work_data {
+	  Persistent<Function, CopyablePersistentTraits<v8::Function>> cb;
+      ODBCResult *objResult;
+      
+      int fetchMode;
+      int maxRows;
+      RowSet *rowSet;
+    };
+    
+    struct aggregate_work_data {
+	  Persistent<Function, CopyablePersistentTraits<v8::Function>> cb;
+      ODBCResult *objResult;
+      ODBCAggregate *aggregate;
+      SQLRETURN result;
+    };
+    
     ODBCResult *self(void) { return this; }
 
   protected:
@@ -79,7 +114,14 @@ class ODBCResult : public node::ObjectWrap {
     HDBC m_hDBC;
     HSTMT m_hSTMT;
     bool m_canFreeHandle;
+    ODBCWorker *m_worker;
+    //fetch text and bind strings as UTF-8 (encoding 'utf8')
+    bool m_utf8;
+    //share the strings of repeated text values per column (see ODBCIntern)
+    bool m_intern;
     int m_fetchMode;
+    ODBCTiming m_timing;
+    struct slow_query_info *m_slowQuery;
     
     uint16_t *buffer;
     int bufferLength;
@@ -0,0 +1,904 @@
+/*
+  Copyright (c) 2013, Dan VerWeire <dverweire@gmail.com>
+
+  Permission to use, copy, modify, and/or distribute this software for any
+  purpose with or without fee is hereby granted, provided that the above
+  copyright notice and this permission notice appear in all copies.
+
+  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+#include <string.h>
+#include <v8.h>
+#include <node.h>
+#include <node_version.h>
+#include <uv.h>
+
+#include "odbc.h"
+#include "odbc_connection.h"
+#include "odbc_shared_pool.h"
+#include "odbc_metrics.h"
+
+#define ODBC_TRACE_CATEGORY TRACE_POOL
+
+using namespace v8;
+using namespace node;
+
+//registry of every pool in the process
+static uv_once_t g_poolsOnce = UV_ONCE_INIT;
+static uv_mutex_t g_poolsLock;
+static ODBCSharedPool* g_pools = NULL;
+static int g_nextPoolId = 1;
+
+static void InitPools() {
+	uv_mutex_init(&g_poolsLock);
+}
+
+void ODBCSharedPool::Init(v8::Handle<Object> target) {
+	DEBUG_PRINTF("ODBCSharedPool::Init\n");
+	v8::Isolate* isolate = v8::Isolate::GetCurrent();
+
+	uv_once(&g_poolsOnce, InitPools);
+
+	target->Set(String::NewFromUtf8(isolate, "sharedPoolOpen"), FunctionTemplate::New(isolate, Open)->GetFunction());
+	target->Set(String::NewFromUtf8(isolate, "sharedPoolClose"), FunctionTemplate::New(isolate, Close)->GetFunction());
+	target->Set(String::NewFromUtf8(isolate, "sharedPoolAcquire"), FunctionTemplate::New(isolate, Acquire)->GetFunction());
+	target->Set(String::NewFromUtf8(isolate, "sharedPoolStats"), FunctionTemplate::New(isolate, Stats)->GetFunction());
+}
+
+/*
+ * Find
+ *
+ * Look a pool up by id; the caller must hold g_poolsLock. Closing pools are
+ * unlinked by Close(), so they are never found again.
+ */
+ODBCSharedPool* ODBCSharedPool::Find(int id) {
+	for (ODBCSharedPool* pool = g_pools; pool; pool = pool->m_next) {
+		if (pool->m_id == id && !pool->m_closing) {
+			return pool;
+		}
+	}
+
+	return NULL;
+}
+
+/*
+ * Open
+ *
+ * sharedPoolOpen(name, connectionString, max, timeout) -> id
+ *
+ * Returns the id of the pool registered under name, creating it if this is
+ * the first reference in the process. Every call must be matched by a
+ * sharedPoolClose(id).
+ */
+void ODBCSharedPool::Open(const v8::FunctionCallbackInfo<v8::Value>& args) {
+	DEBUG_PRINTF("ODBCSharedPool::Open\n");
+	v8::Isolate* isolate = args.GetIsolate();
+	v8::EscapableHandleScope scope(isolate);
+
+	if (args.Length() < 2 || !args[0]->IsString() || !args[1]->IsString()) {
+		isolate->ThrowException(Exception::TypeError(String::NewFromUtf8(isolate, "sharedPoolOpen(): Arguments 0 and 1 must be Strings")));
+		throw Exception::TypeError(String::NewFromUtf8(isolate, "sharedPoolOpen(): Arguments 0 and 1 must be Strings"));
+	}
+
+	String::Utf8Value name(args[0]->ToString());
+	Local<String> connection = args[1]->ToString();
+
+	int max = (args.Length() > 2 && args[2]->IsInt32() && args[2]->Int32Value() > 0) ? args[2]->Int32Value() : SHARED_POOL_DEFAULT_MAX;
+	int timeout = (args.Length() > 3 && args[3]->IsInt32() && args[3]->Int32Value() >= 0) ? args[3]->Int32Value() : SHARED_POOL_DEFAULT_TIMEOUT;
+
+	uv_mutex_lock(&g_poolsLock);
+
+	ODBCSharedPool* pool;
+
+	for (pool = g_pools; pool; pool = pool->m_next) {
+		if (!pool->m_closing && strcmp(pool->m_name, *name) == 0) {
+			break;
+		}
+	}
+
+	if (pool) {
+		uv_mutex_lock(&pool->m_lock);
+		pool->m_refs++;
+		uv_mutex_unlock(&pool->m_lock);
+	}
+	else {
+		pool = new ODBCSharedPool();
+
+		pool->m_id = g_nextPoolId++;
+		pool->m_name = strdup(*name);
+		pool->m_max = max;
+		pool->m_timeout = (uint64_t) timeout * 1000000;
+		pool->m_idle = (HDBC *) calloc(max, sizeof(HDBC));
+		pool->m_idleCount = 0;
+		pool->m_size = 0;
+		pool->m_inUse = 0;
+		pool->m_refs = 1;
+		pool->m_closing = false;
+		pool->m_canHaveMoreResults = 0;
+		pool->m_acquired = 0;
+		pool->m_released = 0;
+		pool->m_created = 0;
+		pool->m_waits = 0;
+		pool->m_timeouts = 0;
+		pool->m_errors = 0;
+
+#ifdef UNICODE
+		pool->m_connectionString = malloc(sizeof(uint16_t) * (connection->Length() + 1));
+		connection->Write((uint16_t *) pool->m_connectionString);
+#else
+		pool->m_connectionString = malloc(connection->Utf8Length() + 1);
+		connection->WriteUtf8((char *) pool->m_connectionString);
+#endif
+
+		uv_mutex_init(&pool->m_lock);
+		pool->m_waiters = NULL;
+		pool->m_waitersTail = NULL;
+
+		uv_mutex_lock(&ODBC::g_odbcMutex);
+
+		pool->m_hENV = NULL;
+		ODBC_COUNT_CALL(SQLAllocHandle);
+		SQLAllocHandle(SQL_HANDLE_ENV, SQL_NULL_HANDLE, &pool->m_hENV);
+		ODBCMetrics::Handle(SQL_HANDLE_ENV, pool->m_hENV, 1);
+		ODBC_COUNT_CALL(SQLSetEnvAttr);
+		SQLSetEnvAttr(pool->m_hENV, SQL_ATTR_ODBC_VERSION, (SQLPOINTER) SQL_OV_ODBC3, SQL_IS_UINTEGER);
+
+		uv_mutex_unlock(&ODBC::g_odbcMutex);
+
+		pool->m_next = g_pools;
+		g_pools = pool;
+	}
+
+	int id = pool->m_id;
+
+	uv_mutex_unlock(&g_poolsLock);
+
+	args.GetReturnValue().Set(Integer::New(isolate, id));
+}
+
+/*
+ * Close
+ *
+ * sharedPoolClose(id)
+ *
+ * Drop a reference. The idle connections are disconnected once the last
+ * reference is gone; connections still in use are disconnected when they
+ * are released.
+ */
+void ODBCSharedPool::Close(const v8::FunctionCallbackInfo<v8::Value>& args) {
+	DEBUG_PRINTF("ODBCSharedPool::Close\n");
+	v8::Isolate* isolate = args.GetIsolate();
+	v8::EscapableHandleScope scope(isolate);
+
+	if (args.Length() < 1 || !args[0]->IsInt32()) {
+		isolate->ThrowException(Exception::TypeError(String::NewFromUtf8(isolate, "sharedPoolClose(): Argument 0 must be an Integer")));
+		throw Exception::TypeError(String::NewFromUtf8(isolate, "sharedPoolClose(): Argument 0 must be an Integer"));
+	}
+
+	uv_mutex_lock(&g_poolsLock);
+
+	ODBCSharedPool* pool = Find(args[0]->Int32Value());
+	shared_pool_waiter* waiters = NULL;
+	bool destroy = false;
+
+	if (pool) {
+		uv_mutex_lock(&pool->m_lock);
+
+		if (--pool->m_refs == 0) {
+			pool->m_closing = true;
+			destroy = (pool->m_inUse == 0);
+
+			//unlink it while still holding g_poolsLock, so that no Acquire()
+			//can find it between here and Destroy()
+			for (ODBCSharedPool** link = &g_pools; *link; link = &(*link)->m_next) {
+				if (*link == pool) {
+					*link = pool->m_next;
+					break;
+				}
+			}
+
+			//fail anybody still waiting instead of leaving them hanging
+			waiters = pool->m_waiters;
+			pool->m_waiters = NULL;
+			pool->m_waitersTail = NULL;
+
+			//a waiter is only freed once its loop has seen the wake up
+			while (waiters) {
+				shared_pool_waiter* next = waiters->next;
+
+				waiters->queued = false;
+				waiters->next = NULL;
+				uv_async_send(&waiters->async);
+				waiters = next;
+			}
+		}
+
+		uv_mutex_unlock(&pool->m_lock);
+	}
+
+	uv_mutex_unlock(&g_poolsLock);
+
+	if (destroy) {
+		Destroy(pool);
+	}
+
+	args.GetReturnValue().SetUndefined();
+}
+
+/*
+ * Destroy
+ *
+ * Disconnect every idle connection and free the pool once it is closing
+ * and nothing is in use. Close() has already unlinked it, so whoever saw
+ * m_inUse drop to 0 is the only one left holding it.
+ */
+void ODBCSharedPool::Destroy(ODBCSharedPool* pool) {
+	DEBUG_PRINTF("ODBCSharedPool::Destroy id=%i\n", pool->m_id);
+
+	uv_mutex_lock(&ODBC::g_odbcMutex);
+
+	for (int i = 0; i < pool->m_idleCount; i++) {
+		ODBC_COUNT_CALL(SQLDisconnect);
+		SQLDisconnect(pool->m_idle[i]);
+		ODBC_COUNT_CALL(SQLFreeHandle);
+		ODBCMetrics::Handle(SQL_HANDLE_DBC, pool->m_idle[i], -1);
+		SQLFreeHandle(SQL_HANDLE_DBC, pool->m_idle[i]);
+	}
+
+	ODBC_COUNT_CALL(SQLFreeHandle);
+	ODBCMetrics::Handle(SQL_HANDLE_ENV, pool->m_hENV, -1);
+	SQLFreeHandle(SQL_HANDLE_ENV, pool->m_hENV);
+
+	uv_mutex_unlock(&ODBC::g_odbcMutex);
+
+	uv_mutex_destroy(&pool->m_lock);
+
+	free(pool->m_idle);
+	free(pool->m_connectionString);
+	free(pool->m_name);
+
+	delete pool;
+}
+
+/*
+ * Release
+ *
+ * Give a connection back. Called from ODBCConnection::Free() on the thread
+ * which closes the connection, never the event loop (see ReleaseLater()),
+ * and outside m_lock for the rollback. A connection which can not be reset is
+ * disconnected instead of pooled, and its slot goes to the oldest waiter.
+ */
+void ODBCSharedPool::Release(ODBCSharedPool* pool, HDBC hDBC) {
+	DEBUG_PRINTF("ODBCSharedPool::Release id=%i\n", pool->m_id);
+
+	shared_pool_waiter* waiter = NULL;
+	bool destroy = false;
+	bool discard = false;
+	bool reset = Reset(hDBC);
+
+	uv_mutex_lock(&pool->m_lock);
+
+	pool->m_inUse--;
+	pool->m_released++;
+
+	if (pool->m_closing) {
+		//nobody references the pool any more; do not keep the connection
+		pool->m_size--;
+		destroy = (pool->m_inUse == 0);
+		discard = true;
+	}
+	else if (!reset) {
+		pool->m_size--;
+		discard = true;
+
+		//let the oldest waiter try to connect in the slot instead
+		waiter = pool->PopWaiter();
+
+		if (waiter) {
+			waiter->slot = true;
+			pool->m_size++;
+		}
+	}
+	else {
+		waiter = pool->PopWaiter();
+
+		if (waiter) {
+			waiter->hDBC = hDBC;
+		}
+		else {
+			pool->m_idle[pool->m_idleCount++] = hDBC;
+		}
+	}
+
+	if (waiter) {
+		uv_async_send(&waiter->async);
+	}
+
+	uv_mutex_unlock(&pool->m_lock);
+
+	if (discard) {
+		uv_mutex_lock(&ODBC::g_odbcMutex);
+
+		ODBC_COUNT_CALL(SQLDisconnect);
+		SQLDisconnect(hDBC);
+		ODBC_COUNT_CALL(SQLFreeHandle);
+		ODBCMetrics::Handle(SQL_HANDLE_DBC, hDBC, -1);
+		SQLFreeHandle(SQL_HANDLE_DBC, hDBC);
+
+		uv_mutex_unlock(&ODBC::g_odbcMutex);
+	}
+
+	if (destroy) {
+		Destroy(pool);
+	}
+}
+
+/*
+ * ReleaseLater
+ *
+ * Release() for the event loop thread: the rollback, and the disconnect of
+ * a connection which is not kept, run on the threadpool instead.
+ */
+void ODBCSharedPool::ReleaseLater(ODBCSharedPool* pool, HDBC hDBC) {
+	DEBUG_PRINTF("ODBCSharedPool::ReleaseLater id=%i\n", pool->m_id);
+
+	if (!ODBC::State()) {
+		//the environment is going away; there is no loop to come back to
+		Release(pool, hDBC);
+		return;
+	}
+
+	uv_work_t* work_req = (uv_work_t *) (calloc(1, sizeof(uv_work_t)));
+	shared_pool_work_data* data = (shared_pool_work_data *) calloc(1, sizeof(shared_pool_work_data));
+
+	data->pool = pool;
+	data->hDBC = hDBC;
+
+	work_req->data = data;
+
+	ODBC::QueueWork(NULL, work_req, UV_Release, (uv_after_work_cb)UV_AfterRelease);
+}
+
+void ODBCSharedPool::UV_Release(uv_work_t* req) {
+	DEBUG_PRINTF("ODBCSharedPool::UV_Release\n");
+	shared_pool_work_data* data = (shared_pool_work_data *)(req->data);
+
+	Release(data->pool, data->hDBC);
+}
+
+void ODBCSharedPool::UV_AfterRelease(uv_work_t* req, int status) {
+	free(req->data);
+	free(req);
+}
+
+/*
+ * Reset
+ *
+ * Put a connection back the way Acquire() hands them out: roll back
+ * anything the previous user left open and turn autocommit back on, which
+ * beginTransaction() switches off. Returns false if either call fails.
+ */
+bool ODBCSharedPool::Reset(HDBC hDBC) {
+	ODBC_COUNT_CALL(SQLEndTran);
+	SQLRETURN ret = SQLEndTran(SQL_HANDLE_DBC, hDBC, SQL_ROLLBACK);
+
+	if (SQL_SUCCEEDED(ret)) {
+		ODBC_COUNT_CALL(SQLSetConnectAttr);
+		ret = SQLSetConnectAttr(hDBC, SQL_ATTR_AUTOCOMMIT, (SQLPOINTER) SQL_AUTOCOMMIT_ON, SQL_NTS);
+	}
+
+	return SQL_SUCCEEDED(ret);
+}
+
+/*
+ * PopWaiter
+ *
+ * The caller wakes the waiter before it lets go of m_lock:
+ * DestroyWaiters() may free it as soon as the lock is free.
+ */
+shared_pool_waiter* ODBCSharedPool::PopWaiter() {
+	shared_pool_waiter* waiter = m_waiters;
+
+	if (waiter) {
+		m_waiters = waiter->next;
+
+		if (!m_waiters) {
+			m_waitersTail = NULL;
+		}
+
+		waiter->next = NULL;
+		waiter->queued = false;
+	}
+
+	return waiter;
+}
+
+/*
+ * RemoveWaiter
+ *
+ * Take a waiter which is still queued off the list; the caller holds m_lock.
+ */
+void ODBCSharedPool::RemoveWaiter(shared_pool_waiter* waiter) {
+	shared_pool_waiter** link = &m_waiters;
+	shared_pool_waiter* previous = NULL;
+
+	while (*link != waiter) {
+		previous = *link;
+		link = &(*link)->next;
+	}
+
+	*link = waiter->next;
+
+	if (m_waitersTail == waiter) {
+		m_waitersTail = previous;
+	}
+
+	waiter->next = NULL;
+	waiter->queued = false;
+}
+
+/*
+ * Stats
+ *
+ * sharedPoolStats(id) -> { name, max, size, idle, inUse, acquired, released,
+ *   created, waits, timeouts, errors }
+ *
+ * The counters cover every isolate using the pool.
+ */
+void ODBCSharedPool::Stats(const v8::FunctionCallbackInfo<v8::Value>& args) {
+	v8::Isolate* isolate = args.GetIsolate();
+	v8::EscapableHandleScope scope(isolate);
+
+	if (args.Length() < 1 || !args[0]->IsInt32()) {
+		isolate->ThrowException(Exception::TypeError(String::NewFromUtf8(isolate, "sharedPoolStats(): Argument 0 must be an Integer")));
+		throw Exception::TypeError(String::NewFromUtf8(isolate, "sharedPoolStats(): Argument 0 must be an Integer"));
+	}
+
+	uv_mutex_lock(&g_poolsLock);
+
+	ODBCSharedPool* pool = Find(args[0]->Int32Value());
+
+	if (!pool) {
+		uv_mutex_unlock(&g_poolsLock);
+
+		args.GetReturnValue().SetNull();
+		return;
+	}
+
+	Local<Object> stats = Object::New(isolate);
+
+	uv_mutex_lock(&pool->m_lock);
+
+	stats->Set(String::NewFromUtf8(isolate, "name"), String::NewFromUtf8(isolate, pool->m_name));
+	stats->Set(String::NewFromUtf8(isolate, "max"), Integer::New(isolate, pool->m_max));
+	stats->Set(String::NewFromUtf8(isolate, "size"), Integer::New(isolate, pool->m_size));
+	stats->Set(String::NewFromUtf8(isolate, "idle"), Integer::New(isolate, pool->m_idleCount));
+	stats->Set(String::NewFromUtf8(isolate, "inUse"), Integer::New(isolate, pool->m_inUse));
+	stats->Set(String::NewFromUtf8(isolate, "acquired"), Number::New(isolate, (double) pool->m_acquired));
+	stats->Set(String::NewFromUtf8(isolate, "released"), Number::New(isolate, (double) pool->m_released));
+	stats->Set(String::NewFromUtf8(isolate, "created"), Number::New(isolate, (double) pool->m_created));
+	stats->Set(String::NewFromUtf8(isolate, "waits"), Number::New(isolate, (double) pool->m_waits));
+	stats->Set(String::NewFromUtf8(isolate, "timeouts"), Number::New(isolate, (double) pool->m_timeouts));
+	stats->Set(String::NewFromUtf8(isolate, "errors"), Number::New(isolate, (double) pool->m_errors));
+
+	uv_mutex_unlock(&pool->m_lock);
+	uv_mutex_unlock(&g_poolsLock);
+
+	args.GetReturnValue().Set(stats);
+}
+
+/*
+ * Acquire
+ *
+ * sharedPoolAcquire(id, cb)
+ *
+ * cb(err, conn) with an open ODBCConnection of the calling isolate. If the
+ * pool is at its maximum size the request waits on the event loop for a
+ * release, up to the pool's timeout; no worker thread is held meanwhile.
+ */
+void ODBCSharedPool::Acquire(const v8::FunctionCallbackInfo<v8::Value>& args) {
+	DEBUG_PRINTF("ODBCSharedPool::Acquire\n");
+	v8::Isolate* isolate = args.GetIsolate();
+	v8::EscapableHandleScope scope(isolate);
+
+	if (args.Length() < 2 || !args[0]->IsInt32() || !args[1]->IsFunction()) {
+		isolate->ThrowException(Exception::TypeError(String::NewFromUtf8(isolate, "sharedPoolAcquire(): Requires an Integer and a Function")));
+		throw Exception::TypeError(String::NewFromUtf8(isolate, "sharedPoolAcquire(): Requires an Integer and a Function"));
+	}
+
+	v8::Persistent<v8::Function, CopyablePersistentTraits<v8::Function>> persistent(isolate, Local<Function>::Cast(args[1]));
+	shared_pool_waiter* waiter = NULL;
+	HDBC hDBC = NULL;
+	bool created = false;
+
+	uv_mutex_lock(&g_poolsLock);
+
+	ODBCSharedPool* pool = Find(args[0]->Int32Value());
+
+	if (pool) {
+		uv_mutex_lock(&pool->m_lock);
+
+		//counted as in use right away so that the pool can not go away
+		//while we are waiting
+		pool->m_inUse++;
+
+		if (pool->m_idleCount) {
+			hDBC = pool->m_idle[--pool->m_idleCount];
+		}
+		else if (pool->m_size < pool->m_max) {
+			//reserve the slot now and connect on the worker thread
+			pool->m_size++;
+			created = true;
+		}
+		else {
+			ODBCState* state = ODBC::State();
+
+			pool->m_waits++;
+
+			waiter = (shared_pool_waiter *) calloc(1, sizeof(shared_pool_waiter));
+			waiter->cb = persistent;
+			waiter->pool = pool;
+			waiter->state = state;
+			waiter->queued = true;
+			waiter->handles = 2;
+
+			//only this loop touches the list of the state
+			waiter->nextInState = state->waiters;
+			state->waiters = waiter;
+
+			uv_async_init(state->loop, &waiter->async, (uv_async_cb) WaiterReady);
+			waiter->async.data = waiter;
+			uv_timer_init(state->loop, &waiter->timer);
+			waiter->timer.data = waiter;
+			uv_timer_start(&waiter->timer, (uv_timer_cb) WaiterTimeout, pool->m_timeout / 1000000, 0);
+
+			if (pool->m_waitersTail) {
+				pool->m_waitersTail->next = waiter;
+			}
+			else {
+				pool->m_waiters = waiter;
+			}
+
+			pool->m_waitersTail = waiter;
+		}
+
+		uv_mutex_unlock(&pool->m_lock);
+	}
+
+	uv_mutex_unlock(&g_poolsLock);
+
+	if (!pool) {
+		persistent.Reset();
+
+		isolate->ThrowException(Exception::Error(String::NewFromUtf8(isolate, "[node-odbc] Unknown shared pool")));
+		throw Exception::Error(String::NewFromUtf8(isolate, "[node-odbc] Unknown shared pool"));
+	}
+
+	if (!waiter) {
+		uv_work_t* work_req = (uv_work_t *) (calloc(1, sizeof(uv_work_t)));
+		shared_pool_work_data* data = (shared_pool_work_data *) calloc(1, sizeof(shared_pool_work_data));
+
+		data->cb = persistent;
+		data->pool = pool;
+		data->hDBC = hDBC;
+		data->created = created;
+
+		work_req->data = data;
+
+		ODBC::QueueWork(NULL, work_req, UV_Acquire, (uv_after_work_cb)UV_AfterAcquire);
+	}
+
+	persistent.Reset();
+
+	args.GetReturnValue().SetUndefined();
+}
+
+static void WaiterClosed(uv_handle_t* handle) {
+	shared_pool_waiter* waiter = (shared_pool_waiter *) handle->data;
+
+	if (--waiter->handles == 0) {
+		waiter->cb.Reset();
+		free(waiter);
+	}
+}
+
+//work data to finish a waiter with, through UV_Acquire or UV_AfterAcquire
+static void CloseWaiter(shared_pool_waiter* waiter) {
+	shared_pool_waiter** link = &waiter->state->waiters;
+
+	while (*link != waiter) {
+		link = &(*link)->nextInState;
+	}
+
+	*link = waiter->nextInState;
+
+	uv_timer_stop(&waiter->timer);
+	uv_close((uv_handle_t *) &waiter->async, WaiterClosed);
+	uv_close((uv_handle_t *) &waiter->timer, WaiterClosed);
+}
+
+//work data to finish a waiter with, through UV_Acquire or UV_AfterAcquire
+static uv_work_t* WaiterWork(shared_pool_waiter* waiter) {
+	uv_work_t* work_req = (uv_work_t *) (calloc(1, sizeof(uv_work_t)));
+	shared_pool_work_data* data = (shared_pool_work_data *) calloc(1, sizeof(shared_pool_work_data));
+
+	data->cb = waiter->cb;
+	data->pool = waiter->pool;
+	work_req->data = data;
+
+	CloseWaiter(waiter);
+
+	return work_req;
+}
+
+/*
+ * DestroyWaiters
+ *
+ * Called by ODBC::DestroyState() when the environment of state goes away
+ * with acquire()s still waiting. Their handles belong to its loop, so they
+ * are taken off their pools and closed here instead of being woken later.
+ * A connection or slot already handed to one of them goes back to the pool.
+ */
+void ODBCSharedPool::DestroyWaiters(ODBCState* state) {
+	DEBUG_PRINTF("ODBCSharedPool::DestroyWaiters\n");
+
+	while (state->waiters) {
+		shared_pool_waiter* waiter = state->waiters;
+		ODBCSharedPool* pool = waiter->pool;
+		shared_pool_waiter* next = NULL;
+		bool destroy = false;
+
+		uv_mutex_lock(&pool->m_lock);
+
+		if (waiter->queued) {
+			pool->RemoveWaiter(waiter);
+		}
+
+		HDBC hDBC = waiter->hDBC;
+
+		if (!hDBC) {
+			pool->m_inUse--;
+
+			if (waiter->slot) {
+				pool->m_size--;
+
+				next = pool->PopWaiter();
+
+				if (next) {
+					next->slot = true;
+					pool->m_size++;
+					uv_async_send(&next->async);
+				}
+			}
+
+			destroy = pool->m_closing && pool->m_inUse == 0;
+		}
+
+		uv_mutex_unlock(&pool->m_lock);
+
+		CloseWaiter(waiter);
+
+		if (hDBC) {
+			Release(pool, hDBC);
+		}
+
+		if (destroy) {
+			Destroy(pool);
+		}
+	}
+}
+
+/*
+ * WaiterReady
+ *
+ * The waiter was taken off the list by Release() (with a connection),
+ * UV_AfterAcquire() (with the slot of a failed connect) or Close() (with
+ * nothing, as the pool is closing).
+ */
+void ODBCSharedPool::WaiterReady(uv_async_t* handle) {
+	DEBUG_PRINTF("ODBCSharedPool::WaiterReady\n");
+	v8::Isolate* isolate = v8::Isolate::GetCurrent();
+	v8::HandleScope scope(isolate);
+
+	shared_pool_waiter* waiter = (shared_pool_waiter *) handle->data;
+
+	uv_work_t* work_req = WaiterWork(waiter);
+	shared_pool_work_data* data = (shared_pool_work_data *)(work_req->data);
+
+	data->hDBC = waiter->hDBC;
+	data->created = waiter->slot;
+
+	if (data->created) {
+		ODBC::QueueWork(NULL, work_req, UV_Acquire, (uv_after_work_cb)UV_AfterAcquire);
+	}
+	else {
+		data->result = (data->hDBC) ? SQL_SUCCESS : SQL_ERROR;
+		UV_AfterAcquire(work_req, 0);
+	}
+}
+
+void ODBCSharedPool::WaiterTimeout(uv_timer_t* handle) {
+	DEBUG_PRINTF("ODBCSharedPool::WaiterTimeout\n");
+	v8::Isolate* isolate = v8::Isolate::GetCurrent();
+	v8::HandleScope scope(isolate);
+
+	shared_pool_waiter* waiter = (shared_pool_waiter *) handle->data;
+	ODBCSharedPool* pool = waiter->pool;
+	bool timedOut = false;
+
+	uv_mutex_lock(&pool->m_lock);
+
+	if (waiter->queued) {
+		pool->RemoveWaiter(waiter);
+		pool->m_timeouts++;
+		timedOut = true;
+	}
+
+	uv_mutex_unlock(&pool->m_lock);
+
+	//otherwise it was served just now and WaiterReady() is on its way
+	if (!timedOut) {
+		return;
+	}
+
+	uv_work_t* work_req = WaiterWork(waiter);
+	shared_pool_work_data* data = (shared_pool_work_data *)(work_req->data);
+
+	data->timedOut = true;
+	data->result = SQL_ERROR;
+
+	UV_AfterAcquire(work_req, 0);
+}
+
+/*
+ * UV_Acquire
+ *
+ * Connect in the slot reserved by Acquire() or handed to a waiter.
+ */
+void ODBCSharedPool::UV_Acquire(uv_work_t* req) {
+	DEBUG_PRINTF("ODBCSharedPool::UV_Acquire\n");
+	shared_pool_work_data* data = (shared_pool_work_data *)(req->data);
+	ODBCSharedPool* pool = data->pool;
+
+	if (!data->created) {
+		data->result = (data->hDBC) ? SQL_SUCCESS : SQL_ERROR;
+		return;
+	}
+
+	uv_mutex_lock(&ODBC::g_odbcMutex);
+
+	ODBC_COUNT_CALL(SQLAllocHandle);
+	SQLRETURN ret = SQLAllocHandle(SQL_HANDLE_DBC, pool->m_hENV, &data->hDBC);
+	ODBCMetrics::Handle(SQL_HANDLE_DBC, data->hDBC, 1);
+
+	if (SQL_SUCCEEDED(ret)) {
+		//NOTE: SQLDriverConnect requires the thread to be locked
+		ODBC_COUNT_CALL(SQLDriverConnect);
+		ret = SQLDriverConnect(data->hDBC, NULL, (SQLTCHAR *) pool->m_connectionString, SQL_NTS, NULL, 0, NULL, SQL_DRIVER_NOPROMPT);
+	}
+
+	if (SQL_SUCCEEDED(ret)) {
+		SQLUSMALLINT canHaveMoreResults = 0;
+
+		ODBC_COUNT_CALL(SQLGetFunctions);
+		if (!SQL_SUCCEEDED(SQLGetFunctions(data->hDBC, SQL_API_SQLMORERESULTS, &canHaveMoreResults))) {
+			canHaveMoreResults = 0;
+		}
+
+		pool->m_canHaveMoreResults = canHaveMoreResults;
+	}
+
+	uv_mutex_unlock(&ODBC::g_odbcMutex);
+
+	data->result = ret;
+}
+
+void ODBCSharedPool::UV_AfterAcquire(uv_work_t* req, int status) {
+	DEBUG_PRINTF("ODBCSharedPool::UV_AfterAcquire\n");
+	v8::Isolate* isolate = v8::Isolate::GetCurrent();
+	v8::EscapableHandleScope scope(isolate);
+
+	shared_pool_work_data* data = (shared_pool_work_data *)(req->data);
+	ODBCSharedPool* pool = data->pool;
+
+	Local<Value> argv[2];
+	int argc = 1;
+	bool failed = !SQL_SUCCEEDED(data->result);
+	shared_pool_waiter* waiter = NULL;
+	bool destroy = false;
+
+	if (failed) {
+		if (data->created && data->hDBC) {
+			argv[0] = ODBC::GetSQLError(SQL_HANDLE_DBC, data->hDBC, (char *) "[node-odbc] Error connecting shared pool connection");
+		}
+		else if (data->timedOut) {
+			argv[0] = Exception::Error(String::NewFromUtf8(isolate, "[node-odbc] Timed out waiting for a shared pool connection"));
+		}
+		else {
+			argv[0] = Exception::Error(String::NewFromUtf8(isolate, "[node-odbc] Shared pool is closed"));
+		}
+
+		if (data->created && data->hDBC) {
+			uv_mutex_lock(&ODBC::g_odbcMutex);
+			ODBC_COUNT_CALL(SQLFreeHandle);
+			ODBCMetrics::Handle(SQL_HANDLE_DBC, data->hDBC, -1);
+			SQLFreeHandle(SQL_HANDLE_DBC, data->hDBC);
+			uv_mutex_unlock(&ODBC::g_odbcMutex);
+		}
+
+		uv_mutex_lock(&pool->m_lock);
+
+		pool->m_inUse--;
+		pool->m_errors++;
+
+		if (data->created) {
+			pool->m_size--;
+
+			//let the oldest waiter try to connect in the slot instead
+			waiter = pool->PopWaiter();
+
+			if (waiter) {
+				waiter->slot = true;
+				pool->m_size++;
+			}
+		}
+
+		if (waiter) {
+			uv_async_send(&waiter->async);
+		}
+
+		destroy = pool->m_closing && pool->m_inUse == 0;
+
+		uv_mutex_unlock(&pool->m_lock);
+	}
+	else {
+		uv_mutex_lock(&pool->m_lock);
+
+		pool->m_acquired++;
+
+		if (data->created) {
+			pool->m_created++;
+		}
+
+		uv_mutex_unlock(&pool->m_lock);
+
+		Local<Value> args[4];
+
+		args[0] = External::New(isolate, pool->m_hENV);
+		args[1] = External::New(isolate, data->hDBC);
+		args[2] = External::New(isolate, pool);
+		args[3] = Integer::New(isolate, pool->m_canHaveMoreResults);
+
+		v8::Local<v8::FunctionTemplate> ft = v8::Local<v8::FunctionTemplate>::New(isolate, ODBC::State()->connectionTemplate);
+		Local<Object> js_connection = ft->GetFunction()->NewInstance(4, args);
+
+		argv[0] = Null(isolate);
+		argv[1] = js_connection;
+		argc = 2;
+	}
+
+	if (destroy) {
+		Destroy(pool);
+	}
+
+	TryCatch try_catch;
+
+	v8::Local<v8::Function> f = v8::Local<v8::Function>::New(isolate, data->cb);
+	f->Call(isolate->GetCurrentContext()->Global(), argc, argv);
+
+	if (try_catch.HasCaught()) {
+		FatalException(try_catch);
+	}
+
+	data->cb.Reset();
+
+	free(data);
+	free(req);
+}
@@ -0,0 +1,129 @@
+/*
+  Copyright (c) 2013, Dan VerWeire <dverweire@gmail.com>
+
+  Permission to use, copy, modify, and/or distribute this software for any
+  purpose with or without fee is hereby granted, provided that the above
+  copyright notice and this permission notice appear in all copies.
+
+  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+#ifndef _SRC_ODBC_SHARED_POOL_H
+#define _SRC_ODBC_SHARED_POOL_H
+
+#define SHARED_POOL_DEFAULT_MAX 10
+#define SHARED_POOL_DEFAULT_TIMEOUT 30000
+
+struct shared_pool_waiter;
+
+//A connection pool that belongs to the process rather than to an isolate.
+//Pools are registered by name, so the main thread and every worker_thread
+//which opens the same name share one HENV and one set of HDBCs. A
+//connection acquired from the pool is wrapped in an ODBCConnection of the
+//calling isolate and goes back to the pool when it is closed or garbage
+//collected. All members are guarded by m_lock.
+class ODBCSharedPool {
+  public:
+    static void Init(v8::Handle<Object> target);
+
+    static void Release(ODBCSharedPool* pool, HDBC hDBC);
+    static void ReleaseLater(ODBCSharedPool* pool, HDBC hDBC);
+    static void DestroyWaiters(ODBCState* state);
+
+  protected:
+    ODBCSharedPool() {};
+    ~ODBCSharedPool() {};
+
+    static ODBCSharedPool* Find(int id);
+    static void Destroy(ODBCSharedPool* pool);
+    static bool Reset(HDBC hDBC);
+
+    //JS functions
+    static void Open(const v8::FunctionCallbackInfo<v8::Value>& info);
+    static void Close(const v8::FunctionCallbackInfo<v8::Value>& info);
+    static void Stats(const v8::FunctionCallbackInfo<v8::Value>& info);
+
+    static void Acquire(const v8::FunctionCallbackInfo<v8::Value>& info);
+    static void UV_Acquire(uv_work_t* work_req);
+    static void UV_AfterAcquire(uv_work_t* work_req, int status);
+
+    static void UV_Release(uv_work_t* work_req);
+    static void UV_AfterRelease(uv_work_t* work_req, int status);
+
+    //event loop side of an acquire() waiting for a connection
+    static void WaiterReady(uv_async_t* handle);
+    static void WaiterTimeout(uv_timer_t* handle);
+
+    //the oldest waiter, taken off the list; the caller holds m_lock
+    shared_pool_waiter* PopWaiter();
+    void RemoveWaiter(shared_pool_waiter* waiter);
+
+    int m_id;
+    char* m_name;
+    void* m_connectionString;
+    int m_max;
+    uint64_t m_timeout;
+
+    HENV m_hENV;
+    HDBC* m_idle;
+    int m_idleCount;
+    int m_size;
+    int m_inUse;
+    int m_refs;
+    bool m_closing;
+    SQLUSMALLINT m_canHaveMoreResults;
+
+    //counters, summed over every isolate using the pool
+    uint64_t m_acquired;
+    uint64_t m_released;
+    uint64_t m_created;
+    uint64_t m_waits;
+    uint64_t m_timeouts;
+    uint64_t m_errors;
+
+    uv_mutex_t m_lock;
+    //acquires waiting for a connection, oldest first
+    shared_pool_waiter* m_waiters;
+    shared_pool_waiter* m_waitersTail;
+
+    ODBCSharedPool* m_next;
+};
+
+//An acquire() on a pool at its maximum size. It waits on the event loop of
+//the isolate that asked instead of on a worker thread: Release() hands it
+//a connection, or a free slot to connect in, and wakes that loop through
+//async; timer fails it after the pool's timeout.
+struct shared_pool_waiter {
+	Persistent<Function, CopyablePersistentTraits<v8::Function>> cb;
+  ODBCSharedPool *pool;
+  //the isolate whose loop it waits on
+  ODBCState *state;
+  uv_async_t async;
+  uv_timer_t timer;
+  //set under the pool's m_lock when the waiter is taken off the list
+  HDBC hDBC;
+  bool slot;
+  bool queued;
+  //handles not closed yet
+  int handles;
+  struct shared_pool_waiter *next;
+  //the other waiters of state, see ODBCSharedPool::DestroyWaiters()
+  struct shared_pool_waiter *nextInState;
+};
+
+struct shared_pool_work_data {
+	Persistent<Function, CopyablePersistentTraits<v8::Function>> cb;
+  ODBCSharedPool *pool;
+  HDBC hDBC;
+  bool created;
+  bool timedOut;
+  int result;
+};
+
+#endif
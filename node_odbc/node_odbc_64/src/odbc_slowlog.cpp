@@ -0,0 +1,505 @@
+/*
+  Copyright (c) 2013, Dan VerWeire <dverweire@gmail.com>
+
+  Permission to use, copy, modify, and/or distribute this software for any
+  purpose with or without fee is hereby granted, provided that the above
+  copyright notice and this permission notice appear in all copies.
+
+  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+#include <string.h>
+#include <stdio.h>
+#include <time.h>
+#include <v8.h>
+#include <node.h>
+#include <node_version.h>
+#include <uv.h>
+
+#include "odbc.h"
+#include "odbc_stats.h"
+#include "odbc_slowlog.h"
+
+#define ODBC_TRACE_CATEGORY TRACE_STATS
+
+using namespace v8;
+using namespace node;
+
+//growable, NUL terminated text buffer used to build the JSON lines
+typedef struct {
+	char *data;
+	size_t length;
+	size_t size;
+} slowlog_buffer;
+
+//everything below is guarded by g_slowLock
+static uv_mutex_t g_slowLock;
+static uv_cond_t g_slowCond;
+static uv_once_t g_slowOnce = UV_ONCE_INIT;
+
+static double g_threshold = -1;
+static bool g_redact = true;
+
+static slow_query_entry *g_entries = NULL;
+static int g_capacity = 0;
+static int g_head = 0;
+static int g_count = 0;
+
+static char *g_file = NULL;
+static uv_thread_t g_writer;
+static bool g_writerRunning = false;
+static bool g_writerStop = false;
+
+//wall clock at load time, to turn uv_hrtime() into milliseconds since the
+//epoch without a gettimeofday() that works everywhere
+static double g_epochBase;
+static uint64_t g_hrtimeBase;
+
+static void InitSlowLog() {
+	uv_mutex_init(&g_slowLock);
+	uv_cond_init(&g_slowCond);
+
+	g_epochBase = (double) time(NULL) * 1000;
+	g_hrtimeBase = uv_hrtime();
+}
+
+static void BufferAppend(slowlog_buffer* buffer, const char* text, size_t length) {
+	if (buffer->length + length + 1 > buffer->size) {
+		buffer->size = (buffer->size) ? buffer->size : 256;
+
+		while (buffer->length + length + 1 > buffer->size) {
+			buffer->size *= 2;
+		}
+
+		buffer->data = (char *) realloc(buffer->data, buffer->size);
+	}
+
+	memcpy(buffer->data + buffer->length, text, length);
+	buffer->length += length;
+	buffer->data[buffer->length] = '\0';
+}
+
+static void BufferAppend(slowlog_buffer* buffer, const char* text) {
+	BufferAppend(buffer, text, strlen(text));
+}
+
+static void BufferAppendNumber(slowlog_buffer* buffer, double value) {
+	char number[32];
+
+	snprintf(number, sizeof(number), "%.15g", value);
+	BufferAppend(buffer, number);
+}
+
+//text as a quoted JSON string; the text is UTF-8, so only quotes,
+//backslashes and control characters need escaping
+static void BufferAppendString(slowlog_buffer* buffer, const char* text) {
+	char escape[8];
+
+	BufferAppend(buffer, "\"", 1);
+
+	for (const char* c = text; *c; c++) {
+		if (*c == '"' || *c == '\\') {
+			escape[0] = '\\';
+			escape[1] = *c;
+			BufferAppend(buffer, escape, 2);
+		}
+		else if ((unsigned char) *c < 0x20) {
+			snprintf(escape, sizeof(escape), "\\u%04x", (unsigned char) *c);
+			BufferAppend(buffer, escape);
+		}
+		else {
+			BufferAppend(buffer, c, 1);
+		}
+	}
+
+	BufferAppend(buffer, "\"", 1);
+}
+
+static void BufferAppendValue(slowlog_buffer* buffer, Local<Value> value, bool redact) {
+	const char* type;
+
+	if (value->IsNull() || value->IsUndefined()) {
+		BufferAppend(buffer, "null");
+		return;
+	}
+
+	if (value->IsString()) {
+		type = "string";
+	}
+	else if (value->IsInt32()) {
+		type = "integer";
+	}
+	else if (value->IsNumber()) {
+		type = "number";
+	}
+	else if (value->IsBoolean()) {
+		type = "boolean";
+	}
+	else {
+		type = "other";
+	}
+
+	BufferAppend(buffer, "{\"type\":\"");
+	BufferAppend(buffer, type);
+	BufferAppend(buffer, "\"");
+
+	if (value->IsString()) {
+		BufferAppend(buffer, ",\"length\":");
+		BufferAppendNumber(buffer, value->ToString()->Length());
+	}
+
+	if (!redact) {
+		BufferAppend(buffer, ",\"value\":");
+
+		if (value->IsNumber()) {
+			BufferAppendNumber(buffer, value->NumberValue());
+		}
+		else if (value->IsBoolean()) {
+			BufferAppend(buffer, value->BooleanValue() ? "true" : "false");
+		}
+		else {
+			String::Utf8Value text(value);
+			BufferAppendString(buffer, *text ? *text : "");
+		}
+	}
+
+	BufferAppend(buffer, "}");
+}
+
+//one entry as a line of JSON, without the newline
+static void BufferAppendEntry(slowlog_buffer* buffer, slow_query_entry* entry) {
+	BufferAppend(buffer, "{\"time\":");
+	BufferAppendNumber(buffer, entry->time);
+	BufferAppend(buffer, ",\"connectionId\":");
+	BufferAppendNumber(buffer, entry->connectionId);
+	BufferAppend(buffer, ",\"rows\":");
+	BufferAppendNumber(buffer, (double) entry->rows);
+	BufferAppend(buffer, ",\"sql\":");
+	BufferAppendString(buffer, entry->sql);
+	BufferAppend(buffer, ",\"params\":");
+	BufferAppend(buffer, entry->params);
+	BufferAppend(buffer, ",\"timing\":{");
+
+	//the callback has not run yet when a query is logged
+	for (int i = 0; i < TIMING_PHASES; i++) {
+		if (i != TIMING_CALLBACK) {
+			BufferAppend(buffer, (i) ? ",\"" : "\"");
+			BufferAppend(buffer, ODBCStats::PhaseName(i));
+			BufferAppend(buffer, "\":");
+			BufferAppendNumber(buffer, entry->phases[i] / 1e6);
+		}
+	}
+
+	BufferAppend(buffer, "}}");
+}
+
+static void FreeEntries(int count) {
+	for (int i = 0; i < count; i++) {
+		slow_query_entry* entry = &g_entries[(g_head + i) % g_capacity];
+
+		free(entry->sql);
+		free(entry->params);
+	}
+
+	g_head = (g_head + count) % ((g_capacity) ? g_capacity : 1);
+	g_count -= count;
+}
+
+void ODBCSlowLog::Init(v8::Handle<Object> target) {
+	DEBUG_PRINTF("ODBCSlowLog::Init\n");
+	v8::Isolate* isolate = v8::Isolate::GetCurrent();
+
+	//the log is shared by every isolate
+	uv_once(&g_slowOnce, InitSlowLog);
+
+	target->Set(String::NewFromUtf8(isolate, "setSlowQueryLog"), FunctionTemplate::New(isolate, SetSlowQueryLog)->GetFunction());
+	target->Set(String::NewFromUtf8(isolate, "drainSlowQueries"), FunctionTemplate::New(isolate, DrainSlowQueries)->GetFunction());
+}
+
+/*
+ * Capture
+ *
+ * Copy the SQL text and a description of the parameters of a query which
+ * may have to be logged. threshold overrides the configured threshold if
+ * it is not negative.
+ */
+slow_query_info* ODBCSlowLog::Capture(Local<String> sql, Local<Array> params, int connectionId, double threshold) {
+	uv_mutex_lock(&g_slowLock);
+
+	bool redact = g_redact;
+
+	if (threshold < 0) {
+		threshold = g_threshold;
+	}
+
+	uv_mutex_unlock(&g_slowLock);
+
+	if (threshold < 0) {
+		return NULL;
+	}
+
+	slow_query_info* info = (slow_query_info *) calloc(1, sizeof(slow_query_info));
+	slowlog_buffer buffer = { NULL, 0, 0 };
+
+	info->threshold = threshold;
+	info->connectionId = connectionId;
+
+	info->sql = (char *) malloc(sql->Utf8Length() + 1);
+	sql->WriteUtf8(info->sql);
+
+	BufferAppend(&buffer, "[");
+
+	if (!params.IsEmpty()) {
+		for (uint32_t i = 0; i < params->Length(); i++) {
+			if (i) {
+				BufferAppend(&buffer, ",");
+			}
+
+			BufferAppendValue(&buffer, params->Get(i), redact);
+		}
+	}
+
+	BufferAppend(&buffer, "]");
+
+	info->params = buffer.data;
+
+	return info;
+}
+
+void ODBCSlowLog::FreeInfo(slow_query_info* info) {
+	if (info) {
+		free(info->sql);
+		free(info->params);
+		free(info);
+	}
+}
+
+/*
+ * Record
+ *
+ * Called when the last phase of a query is done. Queries which were faster
+ * than their threshold are only freed.
+ */
+void ODBCSlowLog::Record(slow_query_info* info, ODBCTiming* timing, int64_t rows) {
+	if (!info) {
+		return;
+	}
+
+	if (timing->phases[TIMING_TOTAL] / 1e6 < info->threshold) {
+		FreeInfo(info);
+		return;
+	}
+
+	uv_mutex_lock(&g_slowLock);
+
+	if (!g_entries) {
+		g_capacity = SLOWLOG_DEFAULT_CAPACITY;
+		g_entries = (slow_query_entry *) calloc(g_capacity, sizeof(slow_query_entry));
+	}
+
+	//full; overwrite the oldest entry
+	if (g_count == g_capacity) {
+		FreeEntries(1);
+	}
+
+	slow_query_entry* entry = &g_entries[(g_head + g_count) % g_capacity];
+
+	entry->time = g_epochBase + (uv_hrtime() - g_hrtimeBase) / 1e6;
+	entry->sql = info->sql;
+	entry->params = info->params;
+	entry->connectionId = info->connectionId;
+	entry->rows = rows;
+	memcpy(entry->phases, timing->phases, sizeof(entry->phases));
+
+	g_count++;
+
+	if (g_writerRunning) {
+		uv_cond_signal(&g_slowCond);
+	}
+
+	uv_mutex_unlock(&g_slowLock);
+
+	free(info);
+}
+
+/*
+ * Write
+ *
+ * Background thread which appends the entries to g_file as they are
+ * recorded, so that the event loop never waits on the disk.
+ */
+void ODBCSlowLog::Write(void* arg) {
+	slowlog_buffer buffer = { NULL, 0, 0 };
+
+	uv_mutex_lock(&g_slowLock);
+
+	while (!g_writerStop) {
+		if (g_count == 0) {
+			uv_cond_wait(&g_slowCond, &g_slowLock);
+			continue;
+		}
+
+		buffer.length = 0;
+
+		for (int i = 0; i < g_count; i++) {
+			BufferAppendEntry(&buffer, &g_entries[(g_head + i) % g_capacity]);
+			BufferAppend(&buffer, "\n", 1);
+		}
+
+		FreeEntries(g_count);
+
+		//g_file only changes while this thread is stopped
+		uv_mutex_unlock(&g_slowLock);
+
+		FILE* file = fopen(g_file, "a");
+
+		if (file) {
+			fwrite(buffer.data, 1, buffer.length, file);
+			fclose(file);
+		}
+
+		uv_mutex_lock(&g_slowLock);
+	}
+
+	uv_mutex_unlock(&g_slowLock);
+
+	free(buffer.data);
+}
+
+/*
+ * SetSlowQueryLog
+ *
+ * setSlowQueryLog({ threshold, capacity, redact, file })
+ *
+ * threshold is in milliseconds; a negative threshold turns the log off.
+ * file starts a thread which appends the entries to that file, null stops
+ * it. Changing the capacity drops the entries which were not drained yet.
+ */
+void ODBCSlowLog::SetSlowQueryLog(const v8::FunctionCallbackInfo<v8::Value>& args) {
+	DEBUG_PRINTF("ODBCSlowLog::SetSlowQueryLog\n");
+
+	v8::Isolate* isolate = args.GetIsolate();
+	v8::EscapableHandleScope scope(isolate);
+
+	if (args.Length() < 1 || !args[0]->IsObject()) {
+		isolate->ThrowException(Exception::TypeError(String::NewFromUtf8(isolate, "ODBC::SetSlowQueryLog(): Argument 0 must be an Object.")));
+		throw Exception::TypeError(String::NewFromUtf8(isolate, "ODBC::SetSlowQueryLog(): Argument 0 must be an Object."));
+	}
+
+	Local<Object> options = args[0]->ToObject();
+	Local<String> optionFile = String::NewFromUtf8(isolate, "file");
+	Local<Value> threshold = options->Get(String::NewFromUtf8(isolate, "threshold"));
+	Local<Value> capacity = options->Get(String::NewFromUtf8(isolate, "capacity"));
+	Local<Value> redact = options->Get(String::NewFromUtf8(isolate, "redact"));
+
+	//stop the writer before its file changes
+	if (options->Has(optionFile)) {
+		uv_mutex_lock(&g_slowLock);
+
+		bool running = g_writerRunning;
+
+		g_writerStop = true;
+		uv_cond_signal(&g_slowCond);
+
+		uv_mutex_unlock(&g_slowLock);
+
+		if (running) {
+			uv_thread_join(&g_writer);
+		}
+
+		uv_mutex_lock(&g_slowLock);
+
+		g_writerStop = false;
+		g_writerRunning = false;
+
+		free(g_file);
+		g_file = NULL;
+
+		uv_mutex_unlock(&g_slowLock);
+	}
+
+	uv_mutex_lock(&g_slowLock);
+
+	if (threshold->IsNumber()) {
+		g_threshold = threshold->NumberValue();
+	}
+	else if (threshold->IsBoolean() && !threshold->BooleanValue()) {
+		g_threshold = -1;
+	}
+
+	if (redact->IsBoolean()) {
+		g_redact = redact->BooleanValue();
+	}
+
+	if (capacity->IsNumber() && capacity->Int32Value() > 0 && capacity->Int32Value() != g_capacity) {
+		if (g_entries) {
+			FreeEntries(g_count);
+			free(g_entries);
+		}
+
+		g_capacity = capacity->Int32Value();
+		g_entries = (slow_query_entry *) calloc(g_capacity, sizeof(slow_query_entry));
+		g_head = 0;
+	}
+
+	if (!g_entries) {
+		g_capacity = SLOWLOG_DEFAULT_CAPACITY;
+		g_entries = (slow_query_entry *) calloc(g_capacity, sizeof(slow_query_entry));
+	}
+
+	Local<Value> file = options->Get(optionFile);
+
+	if (file->IsString()) {
+		String::Utf8Value path(file);
+
+		g_file = strdup(*path);
+		g_writerRunning = true;
+
+		uv_thread_create(&g_writer, Write, NULL);
+	}
+
+	uv_mutex_unlock(&g_slowLock);
+
+	args.GetReturnValue().SetUndefined();
+}
+
+/*
+ * DrainSlowQueries
+ *
+ * drainSlowQueries() -> [ json, ... ]
+ *
+ * Removes and returns the logged queries, oldest first, as the same JSON
+ * text the writer thread appends to the file; lib/odbc.js parses them.
+ */
+void ODBCSlowLog::DrainSlowQueries(const v8::FunctionCallbackInfo<v8::Value>& args) {
+	DEBUG_PRINTF("ODBCSlowLog::DrainSlowQueries\n");
+
+	v8::Isolate* isolate = args.GetIsolate();
+	v8::EscapableHandleScope scope(isolate);
+
+	Local<Array> entries = Array::New(isolate);
+	slowlog_buffer buffer = { NULL, 0, 0 };
+
+	uv_mutex_lock(&g_slowLock);
+
+	for (int i = 0; i < g_count; i++) {
+		buffer.length = 0;
+		BufferAppendEntry(&buffer, &g_entries[(g_head + i) % g_capacity]);
+
+		entries->Set(i, String::NewFromUtf8(isolate, buffer.data));
+	}
+
+	FreeEntries(g_count);
+
+	uv_mutex_unlock(&g_slowLock);
+
+	free(buffer.data);
+
+	args.GetReturnValue().Set(entries);
+}
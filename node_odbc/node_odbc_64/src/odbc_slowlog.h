@@ -0,0 +1,66 @@
+/*
+  Copyright (c) 2013, Dan VerWeire <dverweire@gmail.com>
+
+  Permission to use, copy, modify, and/or distribute this software for any
+  purpose with or without fee is hereby granted, provided that the above
+  copyright notice and this permission notice appear in all copies.
+
+  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+#ifndef _SRC_ODBC_SLOWLOG_H
+#define _SRC_ODBC_SLOWLOG_H
+
+#define SLOWLOG_DEFAULT_CAPACITY 256
+
+//What a query needs to be logged, captured when it is queued; only
+//allocated while the slow query log is enabled.
+typedef struct slow_query_info {
+  char *sql;
+  //JSON array describing the parameters, redacted if configured
+  char *params;
+  int connectionId;
+  //milliseconds
+  double threshold;
+} slow_query_info;
+
+//One logged query.
+typedef struct slow_query_entry {
+  //milliseconds since the epoch
+  double time;
+  char *sql;
+  char *params;
+  int connectionId;
+  int64_t rows;
+  uint64_t phases[TIMING_PHASES];
+} slow_query_entry;
+
+//Process wide, bounded log of the queries which took longer than a
+//threshold. When it is full the oldest entries are overwritten. The entries
+//are either drained from JS or appended to a file, one JSON object per
+//line, by a background thread.
+class ODBCSlowLog {
+  public:
+    static void Init(v8::Handle<Object> target);
+
+    //returns NULL unless the log is enabled or threshold is not negative
+    static slow_query_info* Capture(Local<String> sql, Local<Array> params, int connectionId, double threshold);
+    //logs the query if it was slow and frees info
+    static void Record(slow_query_info* info, ODBCTiming* timing, int64_t rows);
+    static void FreeInfo(slow_query_info* info);
+
+  protected:
+    static void Write(void* arg);
+
+    //JS functions
+    static void SetSlowQueryLog(const v8::FunctionCallbackInfo<v8::Value>& info);
+    static void DrainSlowQueries(const v8::FunctionCallbackInfo<v8::Value>& info);
+};
+
+#endif
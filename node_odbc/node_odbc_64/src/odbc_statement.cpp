@@ -25,11 +25,18 @@
 #include "odbc_connection.h"
 #include "odbc_result.h"
 #include "odbc_statement.h"
+#include "odbc_executor.h"
+#include "odbc_metrics.h"
+#include "odbc_stats.h"
+#include "odbc_slowlog.h"
+#include "odbc_probes.h"
+#include "odbc_narrow.h"
+
+#define ODBC_TRACE_CATEGORY TRACE_STATEMENT
 
 using namespace v8;
 using namespace node;
 
-Persistent<FunctionTemplate> ODBCStatement::constructor_template;
 
 void ODBCStatement::Init(v8::Handle<Object> target) {
 	DEBUG_PRINTF("ODBCStatement::Init\n");
@@ -38,7 +45,7 @@ void ODBCStatement::Init(v8::Handle<Object> target) {
 
 	Local<FunctionTemplate> t = FunctionTemplate::New(isolate, ODBCStatement::New);
 
-	constructor_template.Reset(isolate, t);
+	ODBC::State()->statementTemplate.Reset(isolate, t);
 	t->SetClassName(String::NewFromUtf8(isolate, "ODBCStatement", String::kInternalizedString));
 
 	// Reserve space for one Handle<Value>
@@ -69,6 +76,35 @@ void ODBCStatement::Init(v8::Handle<Object> target) {
 
 ODBCStatement::~ODBCStatement() {
 	this->Free();
+  
+	ODBCThreadGroup::Release(m_worker);
+
+	m_sql.Reset();
+	m_params.Reset();
+}
+
+/*
+ * CaptureSlowQuery
+ *
+ * The entry is filled in from the SQL given to prepare() and the parameters
+ * given to bind(), as they are when the statement is executed.
+ */
+slow_query_info* ODBCStatement::CaptureSlowQuery(v8::Isolate* isolate, Local<String> sql) {
+	Local<Array> params;
+
+	if (sql.IsEmpty()) {
+		if (m_sql.IsEmpty()) {
+			return NULL;
+		}
+
+		sql = Local<String>::New(isolate, m_sql);
+	}
+
+	if (!m_params.IsEmpty()) {
+		params = Local<Array>::New(isolate, m_params);
+	}
+
+	return ODBCSlowLog::Capture(sql, params, m_connectionId, -1);
 }
 
 void ODBCStatement::Free() {
@@ -109,12 +145,15 @@ void ODBCStatement::Free() {
 	if (m_hSTMT) {
 		uv_mutex_lock(&ODBC::g_odbcMutex);
     
+		ODBC_COUNT_CALL(SQLFreeHandle);
+		ODBCMetrics::Handle(SQL_HANDLE_STMT, m_hSTMT, -1);
 		SQLFreeHandle(SQL_HANDLE_STMT, m_hSTMT);
 		m_hSTMT = NULL;
     
 		uv_mutex_unlock(&ODBC::g_odbcMutex);
     
 		if (bufferLength > 0) {
+			ODBC_METRIC_ADD(METRIC_BUFFER_BYTES, -(bufferLength + 1));
 			free(buffer);
 		}
 	}
@@ -156,6 +195,7 @@ void ODBCStatement::New(const v8::FunctionCallbackInfo<v8::Value>& args) {
 	//initialze a buffer for this object
 	stmt->buffer = (uint16_t *) malloc(stmt->bufferLength + 1);
 	//TODO: make sure the malloc succeeded
+	ODBC_METRIC_ADD(METRIC_BUFFER_BYTES, stmt->bufferLength + 1);
 
 	//set the initial colCount to 0
 	stmt->colCount = 0;
@@ -163,6 +203,12 @@ void ODBCStatement::New(const v8::FunctionCallbackInfo<v8::Value>& args) {
 	//initialize the paramCount
 	stmt->paramCount = 0;
   
+	//run on the executor worker of the connection, if it has one
+	if (args.Length() > 3 && args[3]->IsExternal()) {
+		ODBCWorker* worker = static_cast<ODBCWorker *>(Local<External>::Cast(args[3])->Value());
+		stmt->m_worker = ODBCThreadGroup::Acquire(worker);
+	}
+  
 	stmt->Wrap(args.Holder());
   
 	args.GetReturnValue().Set(args.Holder());
@@ -177,11 +223,20 @@ void ODBCStatement::Execute(const v8::FunctionCallbackInfo<v8::Value>& args) {
 	v8::Isolate* isolate = args.GetIsolate();
 	v8::EscapableHandleScope scope(isolate);
 
-	if (args.Length() <= (0) || !args[0]->IsFunction()) {
+	Local<Function> cb;
+	Local<Promise> promise;
+
+	//execute() without a callback returns a promise
+	if (args.Length() <= (0) || args[0]->IsUndefined()) {
+		cb = ODBC::PromiseCallback(isolate, &promise);
+	}
+	else if (!args[0]->IsFunction()) {
 		isolate->ThrowException(Exception::TypeError(String::NewFromUtf8(isolate, "Argument 0 must be a function")));
 		throw Exception::TypeError(String::NewFromUtf8(isolate, "Argument 0 must be a function"));
 	}
-	Local<Function> cb = Local<Function>::Cast(args[0]);
+	else {
+		cb = Local<Function>::Cast(args[0]);
+	}
 
 	ODBCStatement* stmt = ObjectWrap::Unwrap<ODBCStatement>(args.Holder());
   
@@ -194,12 +249,20 @@ void ODBCStatement::Execute(const v8::FunctionCallbackInfo<v8::Value>& args) {
 
 	data->stmt = stmt;
 	work_req->data = data;
+
+	ODBCStats::Begin(&data->timing, 0);
+	data->slowQuery = stmt->CaptureSlowQuery(isolate, Local<String>());
   
-	uv_queue_work(uv_default_loop(), work_req, UV_Execute, (uv_after_work_cb)UV_AfterExecute);
+	ODBC::QueueWork(stmt->m_worker, work_req, UV_Execute, (uv_after_work_cb)UV_AfterExecute);
 
 	stmt->Ref();
 
-	args.GetReturnValue().SetUndefined();
+	if (!promise.IsEmpty()) {
+		args.GetReturnValue().Set(promise);
+	}
+	else {
+		args.GetReturnValue().SetUndefined();
+	}
 }
 
 void ODBCStatement::UV_Execute(uv_work_t* req) {
@@ -208,9 +271,17 @@ void ODBCStatement::UV_Execute(uv_work_t* req) {
 	execute_work_data* data = (execute_work_data *)(req->data);
 
 	SQLRETURN ret;
+	uint64_t start = ODBCStats::Start(&data->timing);
+
+	ODBC_PROBE1(execute__start, data->stmt->m_hSTMT);
   
+	ODBC_COUNT_CALL(SQLExecute);
 	ret = SQLExecute(data->stmt->m_hSTMT); 
 
+	ODBCStats::End(&data->timing, TIMING_EXECUTE, start);
+
+	ODBC_PROBE3(execute__done, data->stmt->m_hSTMT, ret, data->timing.phases[TIMING_EXECUTE]);
+
 	data->result = ret;
 }
 
@@ -230,16 +301,30 @@ void ODBCStatement::UV_AfterExecute(uv_work_t* req, int status) {
 		ODBC::CallbackSQLError(SQL_HANDLE_STMT, self->m_hSTMT, data->cb);
 	}
 	else {
-		Local<Value> args[4];
+		Local<Value> args[7];
 		bool* canFreeHandle = new bool(false);
+		int argc = 6;
     
 		args[0] = External::New(isolate, self->m_hENV);
 		args[1] = External::New(isolate, self->m_hDBC);
 		args[2] = External::New(isolate, self->m_hSTMT);
 		args[3] = External::New(isolate, canFreeHandle);
+		args[4] = External::New(isolate, self->m_worker);
+
+		//fetchAll() goes on with the timing of the execute
+		ODBCStats::Start(&data->timing);
+		args[5] = External::New(isolate, &data->timing);
+
+		//the result logs the execution once it has been fetched
+		if (data->slowQuery) {
+			args[6] = External::New(isolate, data->slowQuery);
+			argc = 7;
+			data->slowQuery = NULL;
+		}
     
-		v8::Local<v8::FunctionTemplate> ft = v8::Local<v8::FunctionTemplate>::New(isolate, ODBCResult::constructor_template);
-		Local<Object> js_result = ft->GetFunction()->NewInstance(4, args);
+		v8::Local<v8::FunctionTemplate> ft = v8::Local<v8::FunctionTemplate>::New(isolate, ODBC::State()->resultTemplate);
+		Local<Object> js_result = ft->GetFunction()->NewInstance(argc, args);
+		ObjectWrap::Unwrap<ODBCResult>(js_result)->SetUTF8(self->m_utf8);
 
 		args[0] = Local<Value>::New(isolate, Null(isolate));
 		args[1] = Local<Object>::New(isolate, js_result);
@@ -256,6 +341,8 @@ void ODBCStatement::UV_AfterExecute(uv_work_t* req, int status) {
 
 	self->Unref();
 	data->cb.Reset();
+
+	ODBCSlowLog::FreeInfo(data->slowQuery);
   
 	free(data);
 	free(req);
@@ -273,7 +360,16 @@ void ODBCStatement::ExecuteSync(const v8::FunctionCallbackInfo<v8::Value>& args)
 
 	ODBCStatement* stmt = ObjectWrap::Unwrap<ODBCStatement>(args.Holder());
 
+	uint64_t start = ODBC_PROBE_ENABLED(execute__done) ? uv_hrtime() : 0;
+
+	ODBC_PROBE1(execute__start, stmt->m_hSTMT);
+
+	ODBC_COUNT_CALL(SQLExecute);
 	SQLRETURN ret = SQLExecute(stmt->m_hSTMT); 
+
+	if (ODBC_PROBE_ENABLED(execute__done)) {
+		ODBC_PROBE3(execute__done, stmt->m_hSTMT, ret, uv_hrtime() - start);
+	}
   
 	if(ret == SQL_ERROR) {
 		isolate->ThrowException(ODBC::GetSQLError(SQL_HANDLE_STMT, stmt->m_hSTMT, (char *) "[node-odbc] Error in ODBCStatement::ExecuteSync"));
@@ -281,16 +377,18 @@ void ODBCStatement::ExecuteSync(const v8::FunctionCallbackInfo<v8::Value>& args)
 		throw ODBC::GetSQLError(SQL_HANDLE_STMT, stmt->m_hSTMT, (char *) "[node-odbc] Error in ODBCStatement::ExecuteSync");
 	}
 	else {
-		Local<Value> args1[4];
+		Local<Value> args1[5];
 		bool* canFreeHandle = new bool(false);
     
 		args1[0] = External::New(isolate, stmt->m_hENV);
 		args1[1] = External::New(isolate, stmt->m_hDBC);
 		args1[2] = External::New(isolate, stmt->m_hSTMT);
 		args1[3] = External::New(isolate, canFreeHandle);
+		args1[4] = External::New(isolate, stmt->m_worker);
     
-		v8::Local<v8::FunctionTemplate> ft = v8::Local<v8::FunctionTemplate>::New(isolate, ODBCResult::constructor_template);
-		Local<Object> js_result = ft->GetFunction()->NewInstance(4, args1);
+		v8::Local<v8::FunctionTemplate> ft = v8::Local<v8::FunctionTemplate>::New(isolate, ODBC::State()->resultTemplate);
+		Local<Object> js_result = ft->GetFunction()->NewInstance(5, args1);
+		ObjectWrap::Unwrap<ODBCResult>(js_result)->SetUTF8(stmt->m_utf8);
     
 		args.GetReturnValue().Set(js_result);
 	}
@@ -322,8 +420,11 @@ void ODBCStatement::ExecuteNonQuery(const v8::FunctionCallbackInfo<v8::Value>& a
 
 	data->stmt = stmt;
 	work_req->data = data;
+
+	ODBCStats::Begin(&data->timing, 0);
+	data->slowQuery = stmt->CaptureSlowQuery(isolate, Local<String>());
   
-	uv_queue_work(uv_default_loop(), work_req, UV_ExecuteNonQuery, (uv_after_work_cb)UV_AfterExecuteNonQuery);
+	ODBC::QueueWork(stmt->m_worker, work_req, UV_ExecuteNonQuery, (uv_after_work_cb)UV_AfterExecuteNonQuery);
 
 	stmt->Ref();
 
@@ -336,9 +437,17 @@ void ODBCStatement::UV_ExecuteNonQuery(uv_work_t* req) {
 	execute_work_data* data = (execute_work_data *)(req->data);
 
 	SQLRETURN ret;
+	uint64_t start = ODBCStats::Start(&data->timing);
+
+	ODBC_PROBE1(execute__start, data->stmt->m_hSTMT);
   
+	ODBC_COUNT_CALL(SQLExecute);
 	ret = SQLExecute(data->stmt->m_hSTMT); 
 
+	ODBCStats::End(&data->timing, TIMING_EXECUTE, start);
+
+	ODBC_PROBE3(execute__done, data->stmt->m_hSTMT, ret, data->timing.phases[TIMING_EXECUTE]);
+
 	data->result = ret;
 }
 
@@ -360,13 +469,21 @@ void ODBCStatement::UV_AfterExecuteNonQuery(uv_work_t* req, int status) {
 	else {
 		SQLLEN rowCount = 0;
     
+		ODBC_COUNT_CALL(SQLRowCount);
 		SQLRETURN ret = SQLRowCount(self->m_hSTMT, &rowCount);
     
 		if (!SQL_SUCCEEDED(ret)) {
 			rowCount = 0;
 		}
+
+		if (data->slowQuery) {
+			ODBCStats::Stop(&data->timing);
+			ODBCSlowLog::Record(data->slowQuery, &data->timing, rowCount);
+			data->slowQuery = NULL;
+		}
     
 		uv_mutex_lock(&ODBC::g_odbcMutex);
+		ODBC_COUNT_CALL(SQLFreeStmt);
 		SQLFreeStmt(self->m_hSTMT, SQL_CLOSE);
 		uv_mutex_unlock(&ODBC::g_odbcMutex);
     
@@ -387,6 +504,8 @@ void ODBCStatement::UV_AfterExecuteNonQuery(uv_work_t* req, int status) {
 
 	self->Unref();
 	data->cb.Reset();
+
+	ODBCSlowLog::FreeInfo(data->slowQuery);
   
 	free(data);
 	free(req);
@@ -404,7 +523,16 @@ void ODBCStatement::ExecuteNonQuerySync(const v8::FunctionCallbackInfo<v8::Value
 
 	ODBCStatement* stmt = ObjectWrap::Unwrap<ODBCStatement>(args.Holder());
 
+	uint64_t start = ODBC_PROBE_ENABLED(execute__done) ? uv_hrtime() : 0;
+
+	ODBC_PROBE1(execute__start, stmt->m_hSTMT);
+
+	ODBC_COUNT_CALL(SQLExecute);
 	SQLRETURN ret = SQLExecute(stmt->m_hSTMT); 
+
+	if (ODBC_PROBE_ENABLED(execute__done)) {
+		ODBC_PROBE3(execute__done, stmt->m_hSTMT, ret, uv_hrtime() - start);
+	}
   
 	if(ret == SQL_ERROR) {
 		isolate->ThrowException(ODBC::GetSQLError(SQL_HANDLE_STMT, stmt->m_hSTMT, (char *) "[node-odbc] Error in ODBCStatement::ExecuteSync"));
@@ -414,6 +542,7 @@ void ODBCStatement::ExecuteNonQuerySync(const v8::FunctionCallbackInfo<v8::Value
 	else {
 		SQLLEN rowCount = 0;
     
+		ODBC_COUNT_CALL(SQLRowCount);
 		SQLRETURN ret = SQLRowCount(stmt->m_hSTMT, &rowCount);
     
 		if (!SQL_SUCCEEDED(ret)) {
@@ -421,6 +550,7 @@ void ODBCStatement::ExecuteNonQuerySync(const v8::FunctionCallbackInfo<v8::Value
 		}
     
 		uv_mutex_lock(&ODBC::g_odbcMutex);
+		ODBC_COUNT_CALL(SQLFreeStmt);
 		SQLFreeStmt(stmt->m_hSTMT, SQL_CLOSE);
 		uv_mutex_unlock(&ODBC::g_odbcMutex);
     
@@ -451,6 +581,7 @@ void ODBCStatement::ExecuteDirect(const v8::FunctionCallbackInfo<v8::Value>& arg
 	Local<Function> cb = Local<Function>::Cast(args[1]);
 
 	ODBCStatement* stmt = ObjectWrap::Unwrap<ODBCStatement>(args.Holder());
+	int sqlSize;
   
 	uv_work_t* work_req = (uv_work_t *) (calloc(1, sizeof(uv_work_t)));
   
@@ -459,20 +590,15 @@ void ODBCStatement::ExecuteDirect(const v8::FunctionCallbackInfo<v8::Value>& arg
 	v8::Persistent<v8::Function, CopyablePersistentTraits<v8::Function>> persistent(isolate, cb);
 	data->cb = persistent;
 
-	data->sqlLen = sql->Length();
-
-#ifdef UNICODE
-	data->sql = (uint16_t *) malloc((data->sqlLen * sizeof(uint16_t)) + sizeof(uint16_t));
-	sql->Write((uint16_t *) data->sql);
-#else
-	data->sql = (char *) malloc(data->sqlLen +1);
-	sql->WriteUtf8((char *) data->sql);
-#endif
+	data->sql = ODBC::CopySQL(sql, stmt->m_utf8, &data->sqlLen, &sqlSize);
 
 	data->stmt = stmt;
 	work_req->data = data;
+
+	ODBCStats::Begin(&data->timing, 0);
+	data->slowQuery = stmt->CaptureSlowQuery(isolate, sql);
   
-	uv_queue_work(uv_default_loop(), work_req, UV_ExecuteDirect, (uv_after_work_cb)UV_AfterExecuteDirect);
+	ODBC::QueueWork(stmt->m_worker, work_req, UV_ExecuteDirect, (uv_after_work_cb)UV_AfterExecuteDirect);
 
 	stmt->Ref();
 
@@ -485,8 +611,21 @@ void ODBCStatement::UV_ExecuteDirect(uv_work_t* req) {
 	execute_direct_work_data* data = (execute_direct_work_data *)(req->data);
 
 	SQLRETURN ret;
+	uint64_t start = ODBCStats::Start(&data->timing);
+
+	ODBC_PROBE1(execute__start, data->stmt->m_hSTMT);
   
-	ret = SQLExecDirect(data->stmt->m_hSTMT, (SQLTCHAR *) data->sql, data->sqlLen);  
+	ODBC_COUNT_CALL(SQLExecDirect);
+	if (data->stmt->m_utf8) {
+		ret = ODBCNarrow::ExecDirect(data->stmt->m_hSTMT, (SQLCHAR *) data->sql, data->sqlLen);
+	}
+	else {
+		ret = SQLExecDirect(data->stmt->m_hSTMT, (SQLTCHAR *) data->sql, data->sqlLen);
+	}
+
+	ODBCStats::End(&data->timing, TIMING_EXECUTE, start);
+
+	ODBC_PROBE3(execute__done, data->stmt->m_hSTMT, ret, data->timing.phases[TIMING_EXECUTE]);
 
 	data->result = ret;
 }
@@ -507,16 +646,30 @@ void ODBCStatement::UV_AfterExecuteDirect(uv_work_t* req, int status) {
 		ODBC::CallbackSQLError(SQL_HANDLE_STMT, self->m_hSTMT, data->cb);
 	}
 	else {
-		Local<Value> args[4];
+		Local<Value> args[7];
 		bool* canFreeHandle = new bool(false);
+		int argc = 6;
     
 		args[0] = External::New(isolate, self->m_hENV);
 		args[1] = External::New(isolate, self->m_hDBC);
 		args[2] = External::New(isolate, self->m_hSTMT);
 		args[3] = External::New(isolate, canFreeHandle);
+		args[4] = External::New(isolate, self->m_worker);
+
+		//fetchAll() goes on with the timing of the execute
+		ODBCStats::Start(&data->timing);
+		args[5] = External::New(isolate, &data->timing);
+
+		//the result logs the execution once it has been fetched
+		if (data->slowQuery) {
+			args[6] = External::New(isolate, data->slowQuery);
+			argc = 7;
+			data->slowQuery = NULL;
+		}
     
-		v8::Local<v8::FunctionTemplate> ft = v8::Local<v8::FunctionTemplate>::New(isolate, ODBCResult::constructor_template);
-		Local<Object> js_result = ft->GetFunction()->NewInstance(4, args);
+		v8::Local<v8::FunctionTemplate> ft = v8::Local<v8::FunctionTemplate>::New(isolate, ODBC::State()->resultTemplate);
+		Local<Object> js_result = ft->GetFunction()->NewInstance(argc, args);
+		ObjectWrap::Unwrap<ODBCResult>(js_result)->SetUTF8(self->m_utf8);
 
 		args[0] = Local<Value>::New(isolate, Null(isolate));
 		args[1] = Local<Object>::New(isolate, js_result);
@@ -533,6 +686,8 @@ void ODBCStatement::UV_AfterExecuteDirect(uv_work_t* req, int status) {
 
 	self->Unref();
 	data->cb.Reset();
+
+	ODBCSlowLog::FreeInfo(data->slowQuery);
   
 	free(data->sql);
 	free(data);
@@ -549,20 +704,35 @@ void ODBCStatement::ExecuteDirectSync(const v8::FunctionCallbackInfo<v8::Value>&
 	v8::Isolate* isolate = args.GetIsolate();
 	v8::EscapableHandleScope scope(isolate);
 
-#ifdef UNICODE
 	if (args.Length() <= (0) || !args[0]->IsString()) {
 		isolate->ThrowException(Exception::TypeError(String::NewFromUtf8(isolate, "Argument 0 must be a string")));
 		throw Exception::TypeError(String::NewFromUtf8(isolate, "Argument 0 must be a string"));
 	}
-	String::Value sql(args[0]->ToString());
-
-#else
-	REQ_STR_ARG(0, sql);
-#endif
 
 	ODBCStatement* stmt = ObjectWrap::Unwrap<ODBCStatement>(args.Holder());
+
+	SQLRETURN ret;
+	int sqlLen;
+	int sqlSize;
+	void* sql = ODBC::CopySQL(args[0]->ToString(), stmt->m_utf8, &sqlLen, &sqlSize);
   
-	SQLRETURN ret = SQLExecDirect(stmt->m_hSTMT, (SQLTCHAR *) *sql, sql.length());  
+	uint64_t start = ODBC_PROBE_ENABLED(execute__done) ? uv_hrtime() : 0;
+
+	ODBC_PROBE1(execute__start, stmt->m_hSTMT);
+
+	ODBC_COUNT_CALL(SQLExecDirect);
+	if (stmt->m_utf8) {
+		ret = ODBCNarrow::ExecDirect(stmt->m_hSTMT, (SQLCHAR *) sql, sqlLen);
+	}
+	else {
+		ret = SQLExecDirect(stmt->m_hSTMT, (SQLTCHAR *) sql, sqlLen);
+	}
+
+	if (ODBC_PROBE_ENABLED(execute__done)) {
+		ODBC_PROBE3(execute__done, stmt->m_hSTMT, ret, uv_hrtime() - start);
+	}
+
+	free(sql);
 
 	if(ret == SQL_ERROR) {
 		isolate->ThrowException(ODBC::GetSQLError(SQL_HANDLE_STMT, stmt->m_hSTMT, (char *) "[node-odbc] Error in ODBCStatement::ExecuteDirectSync"));
@@ -570,16 +740,18 @@ void ODBCStatement::ExecuteDirectSync(const v8::FunctionCallbackInfo<v8::Value>&
 		throw ODBC::GetSQLError(SQL_HANDLE_STMT, stmt->m_hSTMT, (char *) "[node-odbc] Error in ODBCStatement::ExecuteDirectSync");
 	}
 	else {
-		Local<Value> args1[4];
+		Local<Value> args1[5];
 		bool* canFreeHandle = new bool(false);
     
 		args1[0] = External::New(isolate, stmt->m_hENV);
 		args1[1] = External::New(isolate, stmt->m_hDBC);
 		args1[2] = External::New(isolate, stmt->m_hSTMT);
 		args1[3] = External::New(isolate, canFreeHandle);
+		args1[4] = External::New(isolate, stmt->m_worker);
     
-		v8::Local<v8::FunctionTemplate> ft = v8::Local<v8::FunctionTemplate>::New(isolate, ODBCResult::constructor_template);
-		Local<Object> js_result = ft->GetFunction()->NewInstance(4, args1);
+		v8::Local<v8::FunctionTemplate> ft = v8::Local<v8::FunctionTemplate>::New(isolate, ODBC::State()->resultTemplate);
+		Local<Object> js_result = ft->GetFunction()->NewInstance(5, args1);
+		ObjectWrap::Unwrap<ODBCResult>(js_result)->SetUTF8(stmt->m_utf8);
 	
 		args.GetReturnValue().Set(js_result);
 	}
@@ -604,20 +776,21 @@ void ODBCStatement::PrepareSync(const v8::FunctionCallbackInfo<v8::Value>& args)
 	ODBCStatement* stmt = ObjectWrap::Unwrap<ODBCStatement>(args.Holder());
 
 	SQLRETURN ret;
+	int sqlLen;
+	int sqlSize;
+	void* sql2 = ODBC::CopySQL(sql, stmt->m_utf8, &sqlLen, &sqlSize);
 
-	int sqlLen = sql->Length() + 1;
-
-#ifdef UNICODE
-	uint16_t *sql2;
-	sql2 = (uint16_t *) malloc(sqlLen * sizeof(uint16_t));
-	sql->Write(sql2);
-#else
-	char *sql2;
-	sql2 = (char *) malloc(sqlLen);
-	sql->WriteUtf8(sql2);
-#endif
+	stmt->m_sql.Reset(isolate, sql);
   
-	ret = SQLPrepare(stmt->m_hSTMT, (SQLTCHAR *) sql2, sqlLen);
+	ODBC_COUNT_CALL(SQLPrepare);
+	if (stmt->m_utf8) {
+		ret = ODBCNarrow::Prepare(stmt->m_hSTMT, (SQLCHAR *) sql2, sqlLen);
+	}
+	else {
+		ret = SQLPrepare(stmt->m_hSTMT, (SQLTCHAR *) sql2, sqlLen);
+	}
+
+	free(sql2);
   
 	if (SQL_SUCCEEDED(ret)) {
 		args.GetReturnValue().Set(True(isolate));
@@ -652,6 +825,7 @@ void ODBCStatement::Prepare(const v8::FunctionCallbackInfo<v8::Value>& args) {
 	Local<Function> cb = Local<Function>::Cast(args[1]);
 
 	ODBCStatement* stmt = ObjectWrap::Unwrap<ODBCStatement>(args.Holder());
+	int sqlSize;
   
 	uv_work_t* work_req = (uv_work_t *) (calloc(1, sizeof(uv_work_t)));
   
@@ -660,21 +834,15 @@ void ODBCStatement::Prepare(const v8::FunctionCallbackInfo<v8::Value>& args) {
 	v8::Persistent<v8::Function, CopyablePersistentTraits<v8::Function>> persistent(isolate, cb);
 	data->cb = persistent;
 
-	data->sqlLen = sql->Length();
+	data->sql = ODBC::CopySQL(sql, stmt->m_utf8, &data->sqlLen, &sqlSize);
 
-#ifdef UNICODE
-	data->sql = (uint16_t *) malloc((data->sqlLen * sizeof(uint16_t)) + sizeof(uint16_t));
-	sql->Write((uint16_t *) data->sql);
-#else
-	data->sql = (char *) malloc(data->sqlLen +1);
-	sql->WriteUtf8((char *) data->sql);
-#endif
+	stmt->m_sql.Reset(isolate, sql);
   
 	data->stmt = stmt;
   
 	work_req->data = data;
   
-	uv_queue_work(uv_default_loop(), work_req, UV_Prepare, (uv_after_work_cb)UV_AfterPrepare);
+	ODBC::QueueWork(stmt->m_worker, work_req, UV_Prepare, (uv_after_work_cb)UV_AfterPrepare);
 
 	stmt->Ref();
 
@@ -686,11 +854,17 @@ void ODBCStatement::UV_Prepare(uv_work_t* req) {
   
 	prepare_work_data* data = (prepare_work_data *)(req->data);
 
-	DEBUG_PRINTF("ODBCStatement::UV_Prepare m_hDBC=%X m_hDBC=%X m_hSTMT=%X\n", data->stmt->m_hENV, data->stmt->m_hDBC, data->stmt->m_hSTMT);
+	DEBUG_PRINTF("ODBCStatement::UV_Prepare m_hDBC=%p m_hDBC=%p m_hSTMT=%p\n", data->stmt->m_hENV, data->stmt->m_hDBC, data->stmt->m_hSTMT);
   
 	SQLRETURN ret;
   
-	ret = SQLPrepare(data->stmt->m_hSTMT, (SQLTCHAR *) data->sql, data->sqlLen);
+	ODBC_COUNT_CALL(SQLPrepare);
+	if (data->stmt->m_utf8) {
+		ret = ODBCNarrow::Prepare(data->stmt->m_hSTMT, (SQLCHAR *) data->sql, data->sqlLen);
+	}
+	else {
+		ret = SQLPrepare(data->stmt->m_hSTMT, (SQLTCHAR *) data->sql, data->sqlLen);
+	}
 
 	data->result = ret;
 }
@@ -700,7 +874,7 @@ void ODBCStatement::UV_AfterPrepare(uv_work_t* req, int status) {
   
 	prepare_work_data* data = (prepare_work_data *)(req->data);
   
-	DEBUG_PRINTF("ODBCStatement::UV_AfterPrepare m_hDBC=%X m_hDBC=%X m_hSTMT=%X\n",	data->stmt->m_hENV,	data->stmt->m_hDBC,	data->stmt->m_hSTMT);
+	DEBUG_PRINTF("ODBCStatement::UV_AfterPrepare m_hDBC=%p m_hDBC=%p m_hSTMT=%p\n",	data->stmt->m_hENV,	data->stmt->m_hDBC,	data->stmt->m_hSTMT);
   
 	v8::Isolate* isolate = v8::Isolate::GetCurrent();
 	v8::EscapableHandleScope scope(isolate);
@@ -750,7 +924,7 @@ void ODBCStatement::BindSync(const v8::FunctionCallbackInfo<v8::Value>& args) {
 
 	ODBCStatement* stmt = ObjectWrap::Unwrap<ODBCStatement>(args.Holder());
   
-	DEBUG_PRINTF("ODBCStatement::BindSync m_hDBC=%X m_hDBC=%X m_hSTMT=%X\n", stmt->m_hENV, stmt->m_hDBC, stmt->m_hSTMT);
+	DEBUG_PRINTF("ODBCStatement::BindSync m_hDBC=%p m_hDBC=%p m_hSTMT=%p\n", stmt->m_hENV, stmt->m_hDBC, stmt->m_hSTMT);
   
 	//if we previously had parameters, then be sure to free them
 	//before allocating more
@@ -786,7 +960,8 @@ void ODBCStatement::BindSync(const v8::FunctionCallbackInfo<v8::Value>& args) {
 		free(stmt->params);
 	}
   
-	stmt->params = ODBC::GetParametersFromArray(Local<Array>::Cast(args[0]), &stmt->paramCount);
+	stmt->params = ODBC::GetParametersFromArray(Local<Array>::Cast(args[0]), &stmt->paramCount, stmt->m_utf8);
+	stmt->m_params.Reset(isolate, Local<Array>::Cast(args[0]));
   
 	SQLRETURN ret = SQL_SUCCESS;
 	Parameter prm;
@@ -794,9 +969,10 @@ void ODBCStatement::BindSync(const v8::FunctionCallbackInfo<v8::Value>& args) {
 	for (int i = 0; i < stmt->paramCount; i++) {
 		prm = stmt->params[i];
     
-		DEBUG_PRINTF("ODBCStatement::BindSync - param[%i]: c_type=%i type=%i buffer_length=%i size=%i length=%i &length=%X decimals=%i value=%s\n", i, prm.ValueType, prm.ParameterType, prm.BufferLength, prm.ColumnSize, prm.StrLen_or_IndPtr, &stmt->params[i].StrLen_or_IndPtr, prm.DecimalDigits, prm.ParameterValuePtr);
+		DEBUG_PRINTF("ODBCStatement::BindSync - param[%i]: c_type=%i type=%i buffer_length=%lld size=%lld length=%lld &length=%p decimals=%i value=%s\n", i, prm.ValueType, prm.ParameterType, (long long) prm.BufferLength, (long long) prm.ColumnSize, (long long) prm.StrLen_or_IndPtr, (void *) &stmt->params[i].StrLen_or_IndPtr, prm.DecimalDigits, (prm.ValueType == SQL_C_CHAR) ? (char *) prm.ParameterValuePtr : "");
 		
 		//StatementHandle, ParameterNumber, InputOutputType
+		ODBC_COUNT_CALL(SQLBindParameter);
 		ret = SQLBindParameter(stmt->m_hSTMT, i + 1, SQL_PARAM_INPUT, prm.ValueType, prm.ParameterType,	prm.ColumnSize, prm.DecimalDigits, prm.ParameterValuePtr, prm.BufferLength, &stmt->params[i].StrLen_or_IndPtr);
 
 		if (ret == SQL_ERROR) {
@@ -879,18 +1055,20 @@ void ODBCStatement::Bind(const v8::FunctionCallbackInfo<v8::Value>& args) {
   
 	data->stmt = stmt;
   
-	DEBUG_PRINTF("ODBCStatement::Bind m_hDBC=%X m_hDBC=%X m_hSTMT=%X\n", data->stmt->m_hENV, data->stmt->m_hDBC, data->stmt->m_hSTMT);
+	DEBUG_PRINTF("ODBCStatement::Bind m_hDBC=%p m_hDBC=%p m_hSTMT=%p\n", data->stmt->m_hENV, data->stmt->m_hDBC, data->stmt->m_hSTMT);
   
 	v8::Persistent<v8::Function, CopyablePersistentTraits<v8::Function>> persistent(isolate, cb);
 	data->cb = persistent;
 
 	data->stmt->params = ODBC::GetParametersFromArray(
 	Local<Array>::Cast(args[0]), 
-	&data->stmt->paramCount);
+	&data->stmt->paramCount,
+	data->stmt->m_utf8);
+	data->stmt->m_params.Reset(isolate, Local<Array>::Cast(args[0]));
   
 	work_req->data = data;
   
-	uv_queue_work(uv_default_loop(), work_req, UV_Bind, (uv_after_work_cb)UV_AfterBind);
+	ODBC::QueueWork(stmt->m_worker, work_req, UV_Bind, (uv_after_work_cb)UV_AfterBind);
 
 	stmt->Ref();
 
@@ -902,7 +1080,7 @@ void ODBCStatement::UV_Bind(uv_work_t* req) {
   
 	bind_work_data* data = (bind_work_data *)(req->data);
 
-	DEBUG_PRINTF("ODBCStatement::UV_Bind m_hDBC=%X m_hDBC=%X m_hSTMT=%X\n",	data->stmt->m_hENV,	data->stmt->m_hDBC,	data->stmt->m_hSTMT);
+	DEBUG_PRINTF("ODBCStatement::UV_Bind m_hDBC=%p m_hDBC=%p m_hSTMT=%p\n",	data->stmt->m_hENV,	data->stmt->m_hDBC,	data->stmt->m_hSTMT);
   
 	SQLRETURN ret = SQL_SUCCESS;
 	Parameter prm;
@@ -910,9 +1088,10 @@ void ODBCStatement::UV_Bind(uv_work_t* req) {
 	for (int i = 0; i < data->stmt->paramCount; i++) {
 		prm = data->stmt->params[i];
     
-		DEBUG_PRINTF("ODBCStatement::UV_Bind - param[%i]: c_type=%i type=%i buffer_length=%i size=%i length=%i &length=%X decimals=%i value=%s\n", i, prm.ValueType, prm.ParameterType, prm.BufferLength, prm.ColumnSize, prm.StrLen_or_IndPtr,	&data->stmt->params[i].StrLen_or_IndPtr, prm.DecimalDigits, prm.ParameterValuePtr);
+		DEBUG_PRINTF("ODBCStatement::UV_Bind - param[%i]: c_type=%i type=%i buffer_length=%lld size=%lld length=%lld &length=%p decimals=%i value=%s\n", i, prm.ValueType, prm.ParameterType, (long long) prm.BufferLength, (long long) prm.ColumnSize, (long long) prm.StrLen_or_IndPtr,	(void *) &data->stmt->params[i].StrLen_or_IndPtr, prm.DecimalDigits, (prm.ValueType == SQL_C_CHAR) ? (char *) prm.ParameterValuePtr : "");
 
 		//StatementHandle, ParameterNumber, InputOutputType
+		ODBC_COUNT_CALL(SQLBindParameter);
 		ret = SQLBindParameter(data->stmt->m_hSTMT,	i + 1, SQL_PARAM_INPUT, prm.ValueType, prm.ParameterType, prm.ColumnSize, prm.DecimalDigits, prm.ParameterValuePtr, prm.BufferLength, &data->stmt->params[i].StrLen_or_IndPtr);
 
 		if (ret == SQL_ERROR) {
@@ -991,6 +1170,7 @@ void ODBCStatement::CloseSync(const v8::FunctionCallbackInfo<v8::Value>& args) {
 	}
 	else {
 		uv_mutex_lock(&ODBC::g_odbcMutex);
+    	ODBC_COUNT_CALL(SQLFreeStmt);
     	SQLFreeStmt(stmt->m_hSTMT, closeOption);
 		uv_mutex_unlock(&ODBC::g_odbcMutex);
 	}
@@ -19,10 +19,14 @@
 
 class ODBCStatement : public node::ObjectWrap {
   public:
-   static Persistent<FunctionTemplate> constructor_template;
    static void Init(v8::Handle<Object> target);
    
    void Free();
+
+   //takes the encoding of the connection that created it
+   void SetUTF8(bool utf8) { m_utf8 = utf8; }
+   //and its id, for the slow query log
+   void SetConnectionId(int id) { m_connectionId = id; }
    
   protected:
     ODBCStatement() {};
@@ -31,10 +35,17 @@ class ODBCStatement : public node::ObjectWrap {
       ObjectWrap(),
       m_hENV(hENV),
       m_hDBC(hDBC),
-      m_hSTMT(hSTMT) {};
+      m_hSTMT(hSTMT),
+      m_worker(NULL),
+      m_utf8(false),
+      m_connectionId(0) {};
      
     ~ODBCStatement();
 
+    //a slow query log entry for an execution of sql, or of the prepared
+    //statement if sql is empty; NULL unless the log is enabled
+    struct slow_query_info* CaptureSlowQuery(v8::Isolate* isolate, Local<String> sql);
+
     //constructor
 	static void New(const v8::FunctionCallbackInfo<v8::Value>& info);
 
@@ -79,6 +90,13 @@ class ODBCStatement : public node::ObjectWrap {
     HENV m_hENV;
     HDBC m_hDBC;
     HSTMT m_hSTMT;
+    ODBCWorker *m_worker;
+    //fetch text and bind strings as UTF-8 (encoding 'utf8')
+    bool m_utf8;
+    int m_connectionId;
+    //the last prepared SQL and bound parameters, for the slow query log
+    Persistent<String> m_sql;
+    Persistent<Array> m_params;
     
     Parameter *params;
     int paramCount;
@@ -95,12 +113,16 @@ struct execute_direct_work_data {
   int result;
   void *sql;
   int sqlLen;
+  ODBCTiming timing;
+  struct slow_query_info *slowQuery;
 };
 
 struct execute_work_data {
 	Persistent<Function, CopyablePersistentTraits<v8::Function>> cb;
   ODBCStatement *stmt;
   int result;
+  ODBCTiming timing;
+  struct slow_query_info *slowQuery;
 };
 
 struct prepare_work_data {
@@ -0,0 +1,232 @@
+/*
+  Copyright (c) 2013, Dan VerWeire <dverweire@gmail.com>
+
+  Permission to use, copy, modify, and/or distribute this software for any
+  purpose with or without fee is hereby granted, provided that the above
+  copyright notice and this permission notice appear in all copies.
+
+  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+#include <string.h>
+#include <v8.h>
+#include <node.h>
+#include <node_version.h>
+#include <uv.h>
+
+#include "odbc.h"
+#include "odbc_stats.h"
+
+#define ODBC_TRACE_CATEGORY TRACE_STATS
+
+using namespace v8;
+using namespace node;
+
+static const char* g_phaseNames[TIMING_PHASES] = {
+	"queue", "wait", "execute", "fetch", "materialize", "callback", "total"
+};
+
+void ODBCStats::Init(v8::Handle<Object> target) {
+	DEBUG_PRINTF("ODBCStats::Init\n");
+	v8::Isolate* isolate = v8::Isolate::GetCurrent();
+
+	target->Set(String::NewFromUtf8(isolate, "getStats"), FunctionTemplate::New(isolate, GetStats)->GetFunction());
+}
+
+const char* ODBCStats::PhaseName(int phase) {
+	return g_phaseNames[phase];
+}
+
+/*
+ * Begin
+ *
+ * Start timing a query which entered the JS queue at enqueued (a
+ * uv_hrtime() value), or now if enqueued is 0.
+ */
+void ODBCStats::Begin(ODBCTiming* timing, uint64_t enqueued) {
+	uint64_t now = uv_hrtime();
+
+	memset(timing, 0, sizeof(ODBCTiming));
+
+	timing->enqueued = (enqueued && enqueued <= now) ? enqueued : now;
+	timing->phases[TIMING_QUEUE] = now - timing->enqueued;
+	timing->mark = now;
+}
+
+uint64_t ODBCStats::Start(ODBCTiming* timing) {
+	uint64_t now = uv_hrtime();
+
+	timing->phases[TIMING_WAIT] += now - timing->mark;
+	timing->mark = now;
+
+	return now;
+}
+
+void ODBCStats::End(ODBCTiming* timing, int phase, uint64_t start) {
+	uint64_t now = uv_hrtime();
+
+	timing->phases[phase] += now - start;
+	timing->mark = now;
+}
+
+void ODBCStats::Stop(ODBCTiming* timing) {
+	timing->phases[TIMING_TOTAL] = uv_hrtime() - timing->enqueued;
+}
+
+/*
+ * Finish
+ *
+ * Record every phase but the callback, if histogram is set, and return the
+ * timing record: { queue, wait, execute, fetch, materialize, callback,
+ * total } in milliseconds. callback is filled in by Callback().
+ */
+Local<Object> ODBCStats::Finish(ODBCTiming* timing, bool histogram) {
+	v8::Isolate* isolate = v8::Isolate::GetCurrent();
+	v8::EscapableHandleScope scope(isolate);
+
+	ODBCState* state = ODBC::State();
+	Local<Object> record = Object::New(isolate);
+
+	Stop(timing);
+
+	for (int i = 0; i < TIMING_PHASES; i++) {
+		if (histogram && i != TIMING_CALLBACK) {
+			HistogramRecord(&state->histograms[i], timing->phases[i] / 1000);
+		}
+
+		record->Set(String::NewFromUtf8(isolate, g_phaseNames[i]), Number::New(isolate, timing->phases[i] / 1e6));
+	}
+
+	return scope.Escape(record);
+}
+
+void ODBCStats::Callback(ODBCTiming* timing, Local<Object> record, uint64_t start, bool histogram) {
+	v8::Isolate* isolate = v8::Isolate::GetCurrent();
+
+	timing->phases[TIMING_CALLBACK] = uv_hrtime() - start;
+
+	if (histogram) {
+		HistogramRecord(&ODBC::State()->histograms[TIMING_CALLBACK], timing->phases[TIMING_CALLBACK] / 1000);
+	}
+
+	record->Set(String::NewFromUtf8(isolate, g_phaseNames[TIMING_CALLBACK]), Number::New(isolate, timing->phases[TIMING_CALLBACK] / 1e6));
+}
+
+//values below HISTOGRAM_SUB_BUCKETS get a bucket each; above that every
+//power of two is split into HISTOGRAM_SUB_BUCKETS linear buckets
+static int HistogramIndex(uint64_t value) {
+	if (value < HISTOGRAM_SUB_BUCKETS) {
+		return (int) value;
+	}
+
+	int exponent = 0;
+
+	while ((value >> exponent) > 1) {
+		exponent++;
+	}
+
+	int index = (exponent - 2) * HISTOGRAM_SUB_BUCKETS + (int) ((value >> (exponent - 3)) & (HISTOGRAM_SUB_BUCKETS - 1));
+
+	return (index < HISTOGRAM_BUCKETS) ? index : HISTOGRAM_BUCKETS - 1;
+}
+
+//the highest value that falls into a bucket
+static uint64_t HistogramValue(int index) {
+	if (index < HISTOGRAM_SUB_BUCKETS) {
+		return index;
+	}
+
+	int exponent = index / HISTOGRAM_SUB_BUCKETS + 2;
+	uint64_t base = (uint64_t) (HISTOGRAM_SUB_BUCKETS + index % HISTOGRAM_SUB_BUCKETS) << (exponent - 3);
+
+	return base + ((uint64_t) 1 << (exponent - 3)) - 1;
+}
+
+void ODBCStats::HistogramRecord(ODBCHistogram* histogram, uint64_t value) {
+	if (histogram->count == 0 || value < histogram->min) {
+		histogram->min = value;
+	}
+
+	if (value > histogram->max) {
+		histogram->max = value;
+	}
+
+	histogram->count++;
+	histogram->sum += value;
+	histogram->buckets[HistogramIndex(value)]++;
+}
+
+uint64_t ODBCStats::HistogramPercentile(ODBCHistogram* histogram, double percentile) {
+	if (histogram->count == 0) {
+		return 0;
+	}
+
+	uint64_t rank = (uint64_t) (percentile / 100 * histogram->count + 0.5);
+	uint64_t seen = 0;
+
+	if (rank < 1) {
+		rank = 1;
+	}
+
+	for (int i = 0; i < HISTOGRAM_BUCKETS; i++) {
+		seen += histogram->buckets[i];
+
+		if (seen >= rank) {
+			uint64_t value = HistogramValue(i);
+
+			return (value < histogram->max) ? value : histogram->max;
+		}
+	}
+
+	return histogram->max;
+}
+
+/*
+ * GetStats
+ *
+ * getStats([{ reset }]) -> { phase : { count, min, max, mean, p50, p90, p99,
+ *   p999 }, ... } in milliseconds, for the queries completed in this isolate
+ * since the last reset.
+ */
+void ODBCStats::GetStats(const v8::FunctionCallbackInfo<v8::Value>& args) {
+	v8::Isolate* isolate = args.GetIsolate();
+	v8::EscapableHandleScope scope(isolate);
+
+	ODBCState* state = ODBC::State();
+	Local<Object> stats = Object::New(isolate);
+	bool reset = false;
+
+	if (args.Length() > 0 && args[0]->IsObject()) {
+		Local<Value> value = args[0]->ToObject()->Get(String::NewFromUtf8(isolate, "reset"));
+
+		reset = value->BooleanValue();
+	}
+
+	for (int i = 0; i < TIMING_PHASES; i++) {
+		ODBCHistogram* histogram = &state->histograms[i];
+		Local<Object> phase = Object::New(isolate);
+
+		phase->Set(String::NewFromUtf8(isolate, "count"), Number::New(isolate, (double) histogram->count));
+		phase->Set(String::NewFromUtf8(isolate, "min"), Number::New(isolate, histogram->min / 1e3));
+		phase->Set(String::NewFromUtf8(isolate, "max"), Number::New(isolate, histogram->max / 1e3));
+		phase->Set(String::NewFromUtf8(isolate, "mean"), Number::New(isolate, (histogram->count) ? (double) histogram->sum / histogram->count / 1e3 : 0));
+		phase->Set(String::NewFromUtf8(isolate, "p50"), Number::New(isolate, HistogramPercentile(histogram, 50) / 1e3));
+		phase->Set(String::NewFromUtf8(isolate, "p90"), Number::New(isolate, HistogramPercentile(histogram, 90) / 1e3));
+		phase->Set(String::NewFromUtf8(isolate, "p99"), Number::New(isolate, HistogramPercentile(histogram, 99) / 1e3));
+		phase->Set(String::NewFromUtf8(isolate, "p999"), Number::New(isolate, HistogramPercentile(histogram, 99.9) / 1e3));
+
+		stats->Set(String::NewFromUtf8(isolate, g_phaseNames[i]), phase);
+	}
+
+	if (reset) {
+		memset(state->histograms, 0, sizeof(state->histograms));
+	}
+
+	args.GetReturnValue().Set(stats);
+}
@@ -0,0 +1,49 @@
+/*
+  Copyright (c) 2013, Dan VerWeire <dverweire@gmail.com>
+
+  Permission to use, copy, modify, and/or distribute this software for any
+  purpose with or without fee is hereby granted, provided that the above
+  copyright notice and this permission notice appear in all copies.
+
+  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+#ifndef _SRC_ODBC_STATS_H
+#define _SRC_ODBC_STATS_H
+
+//Per query phase timing. The stages of a query call Start() when they
+//begin and End() when they are done; Finish() adds the query to the
+//histograms of the isolate, if histogram is set, and returns its timing record
+//for the callback. Stop() only sets the total, for queries without a
+//timing record.
+//Start() and End() only read the clock, so they may be called on any
+//thread; the rest must be called on the event loop thread.
+class ODBCStats {
+  public:
+    static void Init(v8::Handle<Object> target);
+
+    static void Begin(ODBCTiming* timing, uint64_t enqueued);
+    static uint64_t Start(ODBCTiming* timing);
+    static void End(ODBCTiming* timing, int phase, uint64_t start);
+
+    static void Stop(ODBCTiming* timing);
+    static Local<Object> Finish(ODBCTiming* timing, bool histogram);
+    static void Callback(ODBCTiming* timing, Local<Object> record, uint64_t start, bool histogram);
+
+    static void HistogramRecord(ODBCHistogram* histogram, uint64_t value);
+    static uint64_t HistogramPercentile(ODBCHistogram* histogram, double percentile);
+
+    static const char* PhaseName(int phase);
+
+  protected:
+    //JS functions
+    static void GetStats(const v8::FunctionCallbackInfo<v8::Value>& info);
+};
+
+#endif
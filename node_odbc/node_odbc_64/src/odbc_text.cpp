@@ -0,0 +1,315 @@
+/*
+  Copyright (c) 2013, Dan VerWeire <dverweire@gmail.com>
+
+  Permission to use, copy, modify, and/or distribute this software for any
+  purpose with or without fee is hereby granted, provided that the above
+  copyright notice and this permission notice appear in all copies.
+
+  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+
+#include <string.h>
+#include <stdlib.h>
+#include <v8.h>
+#include <node.h>
+#include <uv.h>
+
+#include "odbc.h"
+#include "odbc_metrics.h"
+#include "odbc_text.h"
+
+#define ODBC_TRACE_CATEGORY TRACE_FETCH
+
+//SSE2 is part of every x86-64 target
+#if defined(__x86_64__) || defined(_M_X64) || defined(__SSE2__)
+#define ODBC_TEXT_SSE2
+#include <emmintrin.h>
+#endif
+
+//AVX2 is used when the CPU has it; the kernel is compiled for it on its
+//own so that the addon still loads on older CPUs
+#if defined(ODBC_TEXT_SSE2) && (defined(_MSC_VER) || defined(__clang__) || (defined(__GNUC__) && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))))
+#define ODBC_TEXT_AVX2
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define ODBC_TEXT_TARGET_AVX2
+#else
+#define ODBC_TEXT_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+using namespace v8;
+using namespace node;
+
+//bytes of UTF-16 from which text becomes an external string; 0 is off.
+//Process wide, like the metrics.
+static long g_externalThreshold = ODBC_EXTERNAL_STRING_THRESHOLD;
+
+/*
+ * ODBCExternalString
+ *
+ * Owns the malloc()ed characters of an external string. V8 deletes it
+ * when the string is collected.
+ */
+template <class Resource, typename Char>
+class ODBCExternalString : public Resource {
+  public:
+    ODBCExternalString(Isolate* isolate, Char* data, size_t length) :
+      m_isolate(isolate),
+      m_data(data),
+      m_length(length) {
+      m_isolate->AdjustAmountOfExternalAllocatedMemory(Bytes());
+      ODBC_METRIC_ADD(METRIC_EXTERNAL_STRING_BYTES, Bytes());
+    }
+
+    ~ODBCExternalString() {
+      free(m_data);
+      m_isolate->AdjustAmountOfExternalAllocatedMemory(-Bytes());
+      ODBC_METRIC_ADD(METRIC_EXTERNAL_STRING_BYTES, -Bytes());
+    }
+
+    const Char* data() const { return m_data; }
+    size_t length() const { return m_length; }
+
+  protected:
+    int64_t Bytes() const { return (int64_t) (m_length * sizeof(Char)); }
+
+    Isolate* m_isolate;
+    Char* m_data;
+    size_t m_length;
+};
+
+typedef ODBCExternalString<String::ExternalOneByteStringResource, char> ODBCExternalOneByte;
+typedef ODBCExternalString<String::ExternalStringResource, uint16_t> ODBCExternalTwoByte;
+
+#ifdef ODBC_TEXT_AVX2
+/*
+ * HasAVX2
+ */
+static bool HasAVX2() {
+#ifdef _MSC_VER
+	int info[4];
+
+	__cpuid(info, 0);
+
+	if (info[0] < 7) {
+		return false;
+	}
+
+	//the OS must save the YMM registers too
+	__cpuid(info, 1);
+
+	if (!(info[2] & (1 << 27)) || !(info[2] & (1 << 28)) || (_xgetbv(0) & 6) != 6) {
+		return false;
+	}
+
+	__cpuidex(info, 7, 0);
+
+	return (info[1] & (1 << 5)) != 0;
+#else
+	__builtin_cpu_init();
+
+	return __builtin_cpu_supports("avx2");
+#endif
+}
+
+static const bool g_hasAVX2 = HasAVX2();
+
+/*
+ * NarrowAVX2
+ *
+ * Narrow 32 code units at a time. Returns how many were narrowed; stops at
+ * the first block with a code unit above 0xFF.
+ */
+ODBC_TEXT_TARGET_AVX2
+static int NarrowAVX2(const uint16_t* data, int length, uint8_t* out) {
+	const __m256i high = _mm256_set1_epi16((short) 0xFF00);
+	int i = 0;
+
+	for (; i + 32 <= length; i += 32) {
+		__m256i a = _mm256_loadu_si256((const __m256i *) (data + i));
+		__m256i b = _mm256_loadu_si256((const __m256i *) (data + i + 16));
+
+		if (!_mm256_testz_si256(_mm256_or_si256(a, b), high)) {
+			break;
+		}
+
+		//packus works per 128 bit lane, which leaves the quarters of the
+		//result in the order a0 b0 a1 b1
+		__m256i packed = _mm256_packus_epi16(a, b);
+
+		_mm256_storeu_si256((__m256i *) (out + i), _mm256_permute4x64_epi64(packed, 0xD8));
+	}
+
+	return i;
+}
+#endif
+
+#ifdef ODBC_TEXT_SSE2
+/*
+ * NarrowSSE2
+ *
+ * Same as NarrowAVX2, 16 code units at a time.
+ */
+static int NarrowSSE2(const uint16_t* data, int length, uint8_t* out) {
+	const __m128i high = _mm_set1_epi16((short) 0xFF00);
+	const __m128i zero = _mm_setzero_si128();
+	int i = 0;
+
+	for (; i + 16 <= length; i += 16) {
+		__m128i a = _mm_loadu_si128((const __m128i *) (data + i));
+		__m128i b = _mm_loadu_si128((const __m128i *) (data + i + 8));
+		__m128i wide = _mm_and_si128(_mm_or_si128(a, b), high);
+
+		if (_mm_movemask_epi8(_mm_cmpeq_epi16(wide, zero)) != 0xFFFF) {
+			break;
+		}
+
+		_mm_storeu_si128((__m128i *) (out + i), _mm_packus_epi16(a, b));
+	}
+
+	return i;
+}
+#endif
+
+/*
+ * Narrow
+ */
+bool ODBCText::Narrow(const uint16_t* data, int length, uint8_t* out) {
+	int i = 0;
+
+#ifdef ODBC_TEXT_AVX2
+	if (g_hasAVX2) {
+		i = NarrowAVX2(data, length, out);
+	}
+#endif
+#ifdef ODBC_TEXT_SSE2
+	i += NarrowSSE2(data + i, length - i, out + i);
+#endif
+
+	//the tail, or the block in which a SIMD kernel stopped
+	for (; i < length; i++) {
+		if (data[i] > 0xFF) {
+			return false;
+		}
+
+		out[i] = (uint8_t) data[i];
+	}
+
+	return true;
+}
+
+void ODBCText::Init(v8::Handle<Object> target) {
+	DEBUG_PRINTF("ODBCText::Init\n");
+	v8::Isolate* isolate = v8::Isolate::GetCurrent();
+
+	target->Set(String::NewFromUtf8(isolate, "setExternalStringThreshold"), FunctionTemplate::New(isolate, SetExternalStringThreshold)->GetFunction());
+}
+
+/*
+ * SetExternalStringThreshold
+ *
+ * setExternalStringThreshold(bytes): text values of at least bytes of
+ * UTF-16 are kept outside of the V8 heap; 0 turns that off.
+ */
+void ODBCText::SetExternalStringThreshold(const v8::FunctionCallbackInfo<v8::Value>& args) {
+	v8::Isolate* isolate = args.GetIsolate();
+	v8::EscapableHandleScope scope(isolate);
+
+	if (args.Length() < 1 || !args[0]->IsNumber() || args[0]->NumberValue() < 0) {
+		isolate->ThrowException(Exception::TypeError(String::NewFromUtf8(isolate, "ODBC::SetExternalStringThreshold(): Argument 0 must be a positive Number or 0.")));
+		throw Exception::TypeError(String::NewFromUtf8(isolate, "ODBC::SetExternalStringThreshold(): Argument 0 must be a positive Number or 0."));
+	}
+
+	ODBC_ATOMIC_STORE(&g_externalThreshold, (long) args[0]->Uint32Value());
+
+	args.GetReturnValue().SetUndefined();
+}
+
+/*
+ * IsExternal
+ */
+static inline bool IsExternal(int length) {
+	long threshold = ODBC_ATOMIC_LOAD(&g_externalThreshold);
+
+	return threshold > 0 && (long) (length * sizeof(uint16_t)) >= threshold;
+}
+
+/*
+ * NewString
+ */
+Local<String> ODBCText::NewString(Isolate* isolate, const uint16_t* data, int length) {
+	EscapableHandleScope scope(isolate);
+
+	if (length < 0) {
+		for (length = 0; data[length]; length++) {
+		}
+	}
+
+	//the fetch buffer is reused, so an external string needs a copy
+	if (IsExternal(length)) {
+		uint16_t* copy = (uint16_t *) malloc(length * sizeof(uint16_t));
+
+		if (copy) {
+			memcpy(copy, data, length * sizeof(uint16_t));
+
+			return scope.Escape(AdoptString(isolate, copy, length));
+		}
+	}
+
+	uint8_t stack[ODBC_TEXT_STACK_CHARS];
+	uint8_t* out = (length <= ODBC_TEXT_STACK_CHARS) ? stack : (uint8_t *) malloc(length);
+	Local<String> str;
+
+	if (out && Narrow(data, length, out)) {
+		str = String::NewFromOneByte(isolate, out, String::kNormalString, length);
+	}
+	else {
+		str = String::NewFromTwoByte(isolate, data, String::kNormalString, length);
+	}
+
+	if (out != stack) {
+		free(out);
+	}
+
+	return scope.Escape(str);
+}
+
+/*
+ * AdoptString
+ */
+Local<String> ODBCText::AdoptString(Isolate* isolate, uint16_t* data, int length) {
+	EscapableHandleScope scope(isolate);
+	Local<String> str;
+
+	if (!IsExternal(length)) {
+		str = NewString(isolate, data, length);
+		free(data);
+
+		return scope.Escape(str);
+	}
+
+	//Latin-1 text takes half the memory as a one-byte string
+	uint8_t* narrow = (uint8_t *) malloc(length);
+
+	if (narrow && Narrow(data, length, narrow)) {
+		free(data);
+
+		str = String::NewExternal(isolate, new ODBCExternalOneByte(isolate, (char *) narrow, length));
+	}
+	else {
+		free(narrow);
+
+		str = String::NewExternal(isolate, new ODBCExternalTwoByte(isolate, data, length));
+	}
+
+	return scope.Escape(str);
+}
@@ -0,0 +1,50 @@
+/*
+  Copyright (c) 2013, Dan VerWeire <dverweire@gmail.com>
+
+  Permission to use, copy, modify, and/or distribute this software for any
+  purpose with or without fee is hereby granted, provided that the above
+  copyright notice and this permission notice appear in all copies.
+
+  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+
+#ifndef _SRC_ODBC_TEXT_H
+#define _SRC_ODBC_TEXT_H
+
+#include <stdint.h>
+#include <v8.h>
+
+//strings up to this many characters are narrowed on the stack
+#define ODBC_TEXT_STACK_CHARS 1024
+
+//default for setExternalStringThreshold(), in bytes of UTF-16
+#define ODBC_EXTERNAL_STRING_THRESHOLD 262144
+
+//Text cells fetched as UTF-16. When every code unit is below 0x100 the
+//string is narrowed to Latin-1 and created as a one-byte V8 string, which
+//takes half the heap of a two-byte one. Strings above the external
+//threshold are kept in native memory as external strings instead.
+class ODBCText {
+  public:
+    static void Init(v8::Handle<v8::Object> target);
+    static void SetExternalStringThreshold(const v8::FunctionCallbackInfo<v8::Value>& args);
+
+    //length in code units, or -1 if data is null terminated
+    static v8::Local<v8::String> NewString(v8::Isolate* isolate, const uint16_t* data, int length);
+
+    //like NewString, but takes over data, which must come from malloc()
+    static v8::Local<v8::String> AdoptString(v8::Isolate* isolate, uint16_t* data, int length);
+
+    //copy data to out as Latin-1; false as soon as a code unit does not
+    //fit in a byte, leaving out partly written
+    static bool Narrow(const uint16_t* data, int length, uint8_t* out);
+};
+
+#endif
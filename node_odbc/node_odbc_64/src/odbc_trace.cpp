@@ -0,0 +1,461 @@
+/*
+  Copyright (c) 2013, Dan VerWeire <dverweire@gmail.com>
+
+  Permission to use, copy, modify, and/or distribute this software for any
+  purpose with or without fee is hereby granted, provided that the above
+  copyright notice and this permission notice appear in all copies.
+
+  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+#include <string.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <wchar.h>
+#include <v8.h>
+#include <node.h>
+#include <node_version.h>
+#include <uv.h>
+
+#include "odbc.h"
+#include "odbc_trace.h"
+
+#define ODBC_TRACE_CATEGORY TRACE_CORE
+
+using namespace v8;
+using namespace node;
+
+//built with -DDEBUG everything is traced from the start, like the
+//DEBUG_PRINTF of old
+#ifdef DEBUG
+int ODBCTrace::g_level = TRACE_DEBUG;
+int ODBCTrace::g_categories = TRACE_ALL;
+#else
+int ODBCTrace::g_level = TRACE_OFF;
+int ODBCTrace::g_categories = 0;
+#endif
+
+static trace_record g_ring[TRACE_RING_SLOTS];
+//next position to write; only ever incremented
+static uint64_t g_writePos = 0;
+
+//serialises starting and stopping the flusher and counts the environments
+//which loaded the addon; the flusher never takes it, so it may be held
+//while joining the flusher
+static uv_mutex_t g_controlLock;
+static int g_environments = 0;
+
+//the flusher; everything below is guarded by g_flushLock, which producers
+//never take
+static uv_mutex_t g_flushLock;
+static uv_cond_t g_flushCond;
+static uv_once_t g_flushOnce = UV_ONCE_INIT;
+static uv_thread_t g_flusher;
+static bool g_flusherRunning = false;
+static bool g_flusherStop = false;
+static FILE* g_output = NULL;
+//set by setTrace({ file }) while the flusher runs; the flusher switches to
+//it once it has printed what is pending to g_output
+static FILE* g_nextOutput = NULL;
+static bool g_switchOutput = false;
+static uint64_t g_readPos = 0;
+static uint64_t g_dropped = 0;
+static uint64_t g_startTime;
+
+static const char* g_levelNames[] = { "off", "error", "warn", "info", "debug" };
+
+//in the order of the TRACE_* category bits
+static const char* g_categoryNames[] = {
+	"core", "connection", "statement", "fetch", "executor", "pool", "cache", "stats"
+};
+
+static void InitTrace() {
+	uv_mutex_init(&g_controlLock);
+	uv_mutex_init(&g_flushLock);
+	uv_cond_init(&g_flushCond);
+
+	g_startTime = uv_hrtime();
+}
+
+static const char* CategoryName(int category) {
+	for (int i = 0; i < 8; i++) {
+		if (category == (1 << i)) {
+			return g_categoryNames[i];
+		}
+	}
+
+	return "?";
+}
+
+//claim the next slot; the caller fills in the text and publishes it
+static trace_record* Claim(int category, int level, uint64_t* pos) {
+	*pos = ODBC_ATOMIC_ADD64(&g_writePos, 1) - 1;
+
+	trace_record* record = &g_ring[*pos & (TRACE_RING_SLOTS - 1)];
+
+	ODBC_ATOMIC_STORE64(&record->seq, 0);
+
+	record->time = uv_hrtime();
+	record->thread = (uint64_t) (uintptr_t) uv_thread_self();
+	record->level = level;
+	record->category = category;
+
+	return record;
+}
+
+static void Publish(trace_record* record, uint64_t pos) {
+	ODBC_ATOMIC_STORE64(&record->seq, pos + 1);
+}
+
+void ODBCTrace::Write(int category, int level, const char* format, ...) {
+	uint64_t pos;
+	trace_record* record = Claim(category, level, &pos);
+	va_list args;
+
+	va_start(args, format);
+	vsnprintf(record->text, TRACE_TEXT_SIZE, format, args);
+	va_end(args);
+
+	Publish(record, pos);
+}
+
+//for the SQL_T() formats of DEBUG_TPRINTF; the text is narrowed to ASCII
+void ODBCTrace::WriteW(int category, int level, const wchar_t* format, ...) {
+	uint64_t pos;
+	trace_record* record = Claim(category, level, &pos);
+	wchar_t text[TRACE_TEXT_SIZE];
+	va_list args;
+
+	va_start(args, format);
+	int length = vswprintf(text, TRACE_TEXT_SIZE, format, args);
+	va_end(args);
+
+	//vswprintf fails when the text does not fit; keep what was written
+	if (length < 0) {
+		text[TRACE_TEXT_SIZE - 1] = L'\0';
+	}
+
+	int i;
+
+	for (i = 0; i < TRACE_TEXT_SIZE - 1 && text[i]; i++) {
+		record->text[i] = (text[i] < 0x80) ? (char) text[i] : '?';
+	}
+	record->text[i] = '\0';
+
+	Publish(record, pos);
+}
+
+/*
+ * Drain
+ *
+ * Print every published record after g_readPos. Called with g_flushLock
+ * held, by the flusher only.
+ */
+static void Drain() {
+	uint64_t writePos = ODBC_ATOMIC_LOAD64(&g_writePos);
+	trace_record copy;
+
+	//lapped: those records were overwritten before they were printed
+	if (writePos - g_readPos > TRACE_RING_SLOTS) {
+		g_dropped += writePos - g_readPos - TRACE_RING_SLOTS;
+		g_readPos = writePos - TRACE_RING_SLOTS;
+	}
+
+	while (g_readPos < writePos) {
+		trace_record* record = &g_ring[g_readPos & (TRACE_RING_SLOTS - 1)];
+		uint64_t seq = ODBC_ATOMIC_LOAD64(&record->seq);
+
+		//claimed but not written yet; try again next time
+		if (seq == 0 || seq < g_readPos + 1) {
+			break;
+		}
+
+		memcpy(&copy, record, sizeof(trace_record));
+		ODBC_ATOMIC_FENCE();
+
+		//overwritten by a later producer, before or while it was copied
+		if (seq != g_readPos + 1 || ODBC_ATOMIC_LOAD64(&record->seq) != seq) {
+			g_dropped++;
+			g_readPos++;
+			continue;
+		}
+
+		copy.text[TRACE_TEXT_SIZE - 1] = '\0';
+
+		size_t length = strlen(copy.text);
+
+		//DEBUG_PRINTF texts end with a newline of their own
+		while (length && (copy.text[length - 1] == '\n' || copy.text[length - 1] == '\r')) {
+			copy.text[--length] = '\0';
+		}
+
+		fprintf(g_output, "[%.6f] [%llx] %s %s: %s\n",
+			(copy.time - g_startTime) / 1e9,
+			(unsigned long long) copy.thread,
+			g_levelNames[copy.level],
+			CategoryName(copy.category),
+			copy.text);
+
+		g_readPos++;
+	}
+
+	fflush(g_output);
+}
+
+//switch to the output setTrace() asked for; called with g_flushLock held,
+//by the flusher only
+static void SwitchOutput() {
+	if (!g_switchOutput) {
+		return;
+	}
+
+	if (g_output && g_output != stdout) {
+		fclose(g_output);
+	}
+
+	g_output = g_nextOutput;
+	g_nextOutput = NULL;
+	g_switchOutput = false;
+}
+
+void ODBCTrace::Flush(void* arg) {
+	uv_mutex_lock(&g_flushLock);
+
+	while (!g_flusherStop) {
+		Drain();
+		SwitchOutput();
+
+		uv_cond_timedwait(&g_flushCond, &g_flushLock, (uint64_t) TRACE_FLUSH_INTERVAL * 1000000);
+	}
+
+	//print what is left before stopping
+	Drain();
+	SwitchOutput();
+
+	uv_mutex_unlock(&g_flushLock);
+}
+
+//start the flusher if it is not running; called with g_controlLock and
+//g_flushLock held
+void ODBCTrace::Start() {
+	if (!g_flusherRunning) {
+		if (!g_output) {
+			g_output = stdout;
+		}
+
+		g_readPos = ODBC_ATOMIC_LOAD64(&g_writePos);
+		g_flusherStop = false;
+		g_flusherRunning = true;
+
+		uv_thread_create(&g_flusher, Flush, NULL);
+	}
+}
+
+//stop the flusher, once it has printed what is left, and wait for it; called
+//with g_controlLock held
+void ODBCTrace::Stop() {
+	uv_mutex_lock(&g_flushLock);
+
+	if (!g_flusherRunning) {
+		uv_mutex_unlock(&g_flushLock);
+		return;
+	}
+
+	g_flusherStop = true;
+	uv_cond_signal(&g_flushCond);
+
+	uv_mutex_unlock(&g_flushLock);
+
+	uv_thread_join(&g_flusher);
+
+	uv_mutex_lock(&g_flushLock);
+	g_flusherRunning = false;
+	uv_mutex_unlock(&g_flushLock);
+}
+
+void ODBCTrace::Init(v8::Handle<Object> target) {
+	v8::Isolate* isolate = v8::Isolate::GetCurrent();
+
+	uv_once(&g_flushOnce, InitTrace);
+
+	uv_mutex_lock(&g_controlLock);
+
+	g_environments++;
+
+	//built with -DDEBUG, or switched on before the last environment went away
+	if (ODBC_ATOMIC_LOAD(&g_level) != TRACE_OFF) {
+		uv_mutex_lock(&g_flushLock);
+		Start();
+		uv_mutex_unlock(&g_flushLock);
+	}
+
+	uv_mutex_unlock(&g_controlLock);
+
+	target->Set(String::NewFromUtf8(isolate, "setTrace"), FunctionTemplate::New(isolate, SetTrace)->GetFunction());
+}
+
+/*
+ * Shutdown
+ *
+ * Called by ODBC::DestroyState() for every environment which goes away.
+ * The trace log is shared by the whole process, so the flusher is only
+ * stopped, and the trace file closed, with the last one.
+ */
+void ODBCTrace::Shutdown() {
+	uv_mutex_lock(&g_controlLock);
+
+	if (--g_environments == 0) {
+		Stop();
+
+		uv_mutex_lock(&g_flushLock);
+
+		if (g_output && g_output != stdout) {
+			fclose(g_output);
+		}
+
+		g_output = NULL;
+
+		uv_mutex_unlock(&g_flushLock);
+	}
+
+	uv_mutex_unlock(&g_controlLock);
+}
+
+/*
+ * SetTrace
+ *
+ * setTrace({ fetch : true, connection : true, level : "info", file : path })
+ * setTrace(false)
+ *
+ * Categories which are not mentioned keep their setting; all : true turns
+ * every category on. level defaults to "debug". file appends to that file
+ * instead of stdout, null goes back to stdout; the flusher makes the switch
+ * after printing what is pending to the old output. Turning tracing off
+ * stops the flusher. Returns { dropped }, the number of records lost
+ * because the flusher could not keep up.
+ */
+void ODBCTrace::SetTrace(const v8::FunctionCallbackInfo<v8::Value>& args) {
+	v8::Isolate* isolate = args.GetIsolate();
+	v8::EscapableHandleScope scope(isolate);
+
+	int categories = ODBC_ATOMIC_LOAD(&g_categories);
+	int level = ODBC_ATOMIC_LOAD(&g_level);
+
+	if (args.Length() < 1 || !(args[0]->IsObject() || args[0]->IsBoolean())) {
+		isolate->ThrowException(Exception::TypeError(String::NewFromUtf8(isolate, "ODBC::SetTrace(): Argument 0 must be an Object or false.")));
+		throw Exception::TypeError(String::NewFromUtf8(isolate, "ODBC::SetTrace(): Argument 0 must be an Object or false."));
+	}
+
+	if (args[0]->IsBoolean()) {
+		categories = (args[0]->BooleanValue()) ? TRACE_ALL : 0;
+		level = (args[0]->BooleanValue()) ? TRACE_DEBUG : TRACE_OFF;
+	}
+	else {
+		Local<Object> options = args[0]->ToObject();
+		Local<Value> all = options->Get(String::NewFromUtf8(isolate, "all"));
+
+		if (all->IsBoolean()) {
+			categories = (all->BooleanValue()) ? TRACE_ALL : 0;
+		}
+
+		for (int i = 0; i < 8; i++) {
+			Local<Value> value = options->Get(String::NewFromUtf8(isolate, g_categoryNames[i]));
+
+			if (value->IsBoolean()) {
+				categories = (value->BooleanValue()) ? (categories | (1 << i)) : (categories & ~(1 << i));
+			}
+		}
+
+		Local<Value> levelName = options->Get(String::NewFromUtf8(isolate, "level"));
+
+		level = TRACE_DEBUG;
+
+		if (levelName->IsString()) {
+			String::Utf8Value name(levelName);
+
+			for (int i = TRACE_OFF; i <= TRACE_DEBUG; i++) {
+				if (strcmp(*name, g_levelNames[i]) == 0) {
+					level = i;
+				}
+			}
+		}
+
+		Local<String> optionFile = String::NewFromUtf8(isolate, "file");
+
+		if (options->Has(optionFile)) {
+			Local<Value> file = options->Get(optionFile);
+			FILE* output = stdout;
+
+			if (file->IsString()) {
+				String::Utf8Value path(file);
+
+				output = fopen(*path, "a");
+
+				if (!output) {
+					isolate->ThrowException(Exception::Error(String::NewFromUtf8(isolate, "ODBC::SetTrace(): Could not open the trace file.")));
+					throw Exception::Error(String::NewFromUtf8(isolate, "ODBC::SetTrace(): Could not open the trace file."));
+				}
+			}
+
+			uv_mutex_lock(&g_controlLock);
+			uv_mutex_lock(&g_flushLock);
+
+			if (g_flusherRunning) {
+				//replaces a switch the flusher has not made yet
+				if (g_switchOutput && g_nextOutput != stdout) {
+					fclose(g_nextOutput);
+				}
+
+				g_nextOutput = output;
+				g_switchOutput = true;
+
+				uv_cond_signal(&g_flushCond);
+			}
+			else {
+				if (g_output && g_output != stdout) {
+					fclose(g_output);
+				}
+
+				g_output = output;
+			}
+
+			uv_mutex_unlock(&g_flushLock);
+			uv_mutex_unlock(&g_controlLock);
+		}
+	}
+
+	if (!categories) {
+		level = TRACE_OFF;
+	}
+
+	uv_mutex_lock(&g_controlLock);
+
+	ODBC_ATOMIC_STORE(&g_categories, categories);
+	ODBC_ATOMIC_STORE(&g_level, level);
+
+	if (level == TRACE_OFF) {
+		Stop();
+	}
+
+	uv_mutex_lock(&g_flushLock);
+
+	if (level != TRACE_OFF) {
+		Start();
+	}
+
+	double dropped = (double) g_dropped;
+
+	uv_mutex_unlock(&g_flushLock);
+	uv_mutex_unlock(&g_controlLock);
+
+	Local<Object> result = Object::New(isolate);
+	result->Set(String::NewFromUtf8(isolate, "dropped"), Number::New(isolate, dropped));
+
+	args.GetReturnValue().Set(result);
+}
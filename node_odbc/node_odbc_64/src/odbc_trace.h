@@ -0,0 +1,110 @@
+/*
+  Copyright (c) 2013, Dan VerWeire <dverweire@gmail.com>
+
+  Permission to use, copy, modify, and/or distribute this software for any
+  purpose with or without fee is hereby granted, provided that the above
+  copyright notice and this permission notice appear in all copies.
+
+  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+#ifndef _SRC_ODBC_TRACE_H
+#define _SRC_ODBC_TRACE_H
+
+#include <stdint.h>
+#include "odbc_atomic.h"
+
+//levels; a record is kept if its level is at most the configured level
+#define TRACE_OFF 0
+#define TRACE_ERROR 1
+#define TRACE_WARN 2
+#define TRACE_INFO 3
+#define TRACE_DEBUG 4
+
+//categories, one per source file; every .cpp which traces defines
+//ODBC_TRACE_CATEGORY as one of these after its includes
+#define TRACE_CORE 0x01
+#define TRACE_CONNECTION 0x02
+#define TRACE_STATEMENT 0x04
+#define TRACE_FETCH 0x08
+#define TRACE_EXECUTOR 0x10
+#define TRACE_POOL 0x20
+#define TRACE_CACHE 0x40
+#define TRACE_STATS 0x80
+#define TRACE_ALL 0xff
+
+//must be a power of two
+#define TRACE_RING_SLOTS 4096
+#define TRACE_TEXT_SIZE 224
+#define TRACE_FLUSH_INTERVAL 100
+
+//lets the compiler check the arguments of ODBC_TRACE against its format
+#if defined(__GNUC__)
+  #define ODBC_TRACE_PRINTF(fmt, args) __attribute__((format(printf, fmt, args)))
+#else
+  #define ODBC_TRACE_PRINTF(fmt, args)
+#endif
+
+//a disabled trace costs two loads and a branch; the text is only
+//formatted for the records which are kept
+#define ODBC_TRACE(level, ...) \
+  do { \
+    if (ODBCTrace::Enabled(ODBC_TRACE_CATEGORY, level)) { \
+      ODBCTrace::Write(ODBC_TRACE_CATEGORY, level, __VA_ARGS__); \
+    } \
+  } while (0)
+
+#define ODBC_TRACE_W(level, ...) \
+  do { \
+    if (ODBCTrace::Enabled(ODBC_TRACE_CATEGORY, level)) { \
+      ODBCTrace::WriteW(ODBC_TRACE_CATEGORY, level, __VA_ARGS__); \
+    } \
+  } while (0)
+
+//One record of the ring. seq is the position the record was written at
+//plus one, or 0 while a producer is writing it, so that the flusher can
+//tell finished, torn and overwritten records apart without a lock.
+typedef struct {
+  uint64_t seq;
+  uint64_t time;
+  uint64_t thread;
+  int level;
+  int category;
+  char text[TRACE_TEXT_SIZE];
+} trace_record;
+
+//Process wide trace log. Any thread claims a slot of the ring with an
+//atomic add and writes its record there; a background thread prints the
+//records to stdout or a file every TRACE_FLUSH_INTERVAL milliseconds. When
+//producers lap the flusher the oldest records are dropped and counted.
+class ODBCTrace {
+  public:
+    static void Init(v8::Handle<Object> target);
+    static void Shutdown();
+
+    static inline bool Enabled(int category, int level) {
+      return level <= ODBC_ATOMIC_LOAD(&g_level) && (ODBC_ATOMIC_LOAD(&g_categories) & category);
+    }
+
+    static void Write(int category, int level, const char* format, ...) ODBC_TRACE_PRINTF(3, 4);
+    static void WriteW(int category, int level, const wchar_t* format, ...);
+
+    static int g_level;
+    static int g_categories;
+
+  protected:
+    static void Flush(void* arg);
+    static void Start();
+    static void Stop();
+
+    //JS functions
+    static void SetTrace(const v8::FunctionCallbackInfo<v8::Value>& info);
+};
+
+#endif
@@ -0,0 +1,122 @@
+//Pieces shared by run-benchmarks.js and run-soak.js: argument parsing,
+//connection selection, the operations both of them loop, and the parent
+//side which runs every run in a child process of its own.
+
+var spawn = require("child_process").spawn;
+
+//parse process.argv into options. flags maps "--name" to [key, parse]; every
+//flag takes a value and "--child" is always accepted
+exports.parseArgs = function (options, flags) {
+  for (var i = 2; i < process.argv.length; i++) {
+    var arg = process.argv[i]
+      , flag = (arg === "--child") ? ["child", String] : flags[arg]
+      ;
+
+    if (!flag) {
+      console.error("unknown option %s", arg);
+      process.exit(2);
+    }
+
+    options[flag[0]] = flag[1](process.argv[i + 1]);
+    i++;
+  }
+
+  return options;
+};
+
+exports.list = function (value) {
+  return value.split(",");
+};
+
+exports.numbers = function (value) {
+  return value.split(",").map(Number);
+};
+
+//the entry of connectionStrings with that title, or the first one
+exports.findConnection = function (connectionStrings, title) {
+  var connection = connectionStrings[0];
+
+  connectionStrings.forEach(function (connectionString) {
+    if (connectionString.title === title) {
+      connection = connectionString;
+    }
+  });
+
+  return connection;
+};
+
+//operations with the run(db, cb) signature of scenarios and surfaces
+exports.query = function (db, cb) {
+  db.query("select 1 + 1 as test", cb);
+};
+
+//queryResult() and then result[method]() ("fetch" or "fetchAll")
+exports.queryResult = function (method) {
+  return function (db, cb) {
+    db.queryResult("select 1 + 1 as test", function (err, result) {
+      if (err) {
+        return cb(err);
+      }
+
+      result[method](function (err, data) {
+        result.closeSync();
+        cb(err, data);
+      });
+    });
+  };
+};
+
+/*
+ * runChildren
+ *
+ * Run script with "--child <JSON of run>" under --expose_gc for each of
+ * runs in turn, so that the memory numbers of one run do not leak into the
+ * next. label(run) is printed before each run; done(run, result) gets the
+ * JSON the child printed, or null when it failed. finish() is called after
+ * the last run.
+ */
+exports.runChildren = function (script, runs, label, done, finish) {
+  runs = runs.slice();
+
+  (function next() {
+    var run = runs.shift();
+
+    if (!run) {
+      return finish();
+    }
+
+    process.stdout.write(label(run));
+
+    var child = spawn(process.execPath, ["--expose_gc", script, "--child", JSON.stringify(run)])
+      , output = ""
+      ;
+
+    child.stdout.on("data", function (data) {
+      output += data;
+    });
+
+    child.stderr.on("data", function (data) {
+      process.stderr.write(data);
+    });
+
+    child.on("exit", function (code) {
+      var result = null;
+
+      try {
+        result = JSON.parse(output);
+      }
+      catch (e) {
+      }
+
+      if (code !== 0 || !result) {
+        console.log("\033[01;31mfailed\033[01;0m (exit code %s)", code);
+        done(run, null);
+      }
+      else {
+        done(run, result);
+      }
+
+      next();
+    });
+  })();
+};
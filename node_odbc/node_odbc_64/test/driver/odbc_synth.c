@@ -0,0 +1,1351 @@
+/*
+  Copyright (c) 2013, Dan VerWeire <dverweire@gmail.com>
+
+  Permission to use, copy, modify, and/or distribute this software for any
+  purpose with or without fee is hereby granted, provided that the above
+  copyright notice and this permission notice appear in all copies.
+
+  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+
+/*
+ * A synthetic ODBC driver for benchmarks.
+ *
+ * It has no server and no storage: every query returns a result set which
+ * is generated from the connection string (or from key=value settings in
+ * the SQL text) and every insert, update or delete just reads its
+ * parameters, sleeps for LATENCY microseconds and reports one row. The
+ * values only depend on SEED, the row and the column, so two runs fetch
+ * exactly the same data.
+ *
+ * It can be used through unixODBC (DRIVER=/path/to/odbc_synth.so;...) or
+ * loaded directly by a dynodbc build of the binding.
+ */
+
+//both the ANSI and the W entry points are defined here, also when the
+//driver is compiled into a UNICODE target
+#undef UNICODE
+#undef _UNICODE
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+#include <sql.h>
+#include <sqltypes.h>
+#include <sqlext.h>
+
+#ifdef __GNUC__
+#define SYNTH_API __attribute__((visibility("default"))) SQLRETURN SQL_API
+#else
+#define SYNTH_API SQLRETURN SQL_API
+#endif
+
+#define SYNTH_MAX_COLUMNS 64
+#define SYNTH_MAX_PARAMS 64
+#define SYNTH_MAX_SQL 4096
+#define SYNTH_MESSAGE_SIZE 256
+
+//column types
+#define SYNTH_INT 0
+#define SYNTH_DOUBLE 1
+#define SYNTH_VARCHAR 2
+#define SYNTH_LOB 3
+#define SYNTH_TIMESTAMP 4
+#define SYNTH_BIT 5
+
+//2000-01-01 00:00:00 UTC, the first generated timestamp
+#define SYNTH_EPOCH 946684800
+
+typedef struct {
+	int type;
+	long width;
+} synth_column;
+
+//what a result set looks like; parsed from the connection string and
+//overridden per statement by the SQL text
+typedef struct {
+	long rows;
+	int columnCount;
+	synth_column columns[SYNTH_MAX_COLUMNS];
+	double nulls;
+	long distinct;
+	unsigned long long seed;
+	long latency;
+} synth_config;
+
+//every handle starts with this so that SQLGetDiagRec and SQLFreeHandle
+//can tell them apart
+typedef struct {
+	SQLSMALLINT handleType;
+	int hasError;
+	char state[SQL_SQLSTATE_SIZE + 1];
+	char message[SYNTH_MESSAGE_SIZE];
+} synth_handle;
+
+typedef struct {
+	synth_handle head;
+} synth_env;
+
+typedef struct {
+	synth_handle head;
+	synth_config config;
+	int connected;
+	//a UNICODE build of the binding which loaded us with dynodbc calls the
+	//ANSI entry points with SQLWCHAR strings; seen in SQLDriverConnect
+	int wideAnsi;
+} synth_dbc;
+
+typedef struct {
+	SQLSMALLINT valueType;
+	SQLPOINTER value;
+	SQLLEN bufferLength;
+	SQLLEN* indicator;
+} synth_param;
+
+typedef struct {
+	synth_handle head;
+	synth_dbc* dbc;
+	synth_config config;
+	char sql[SYNTH_MAX_SQL];
+	int prepared;
+	int hasResult;
+	long row;
+	SQLLEN rowCount;
+	synth_param params[SYNTH_MAX_PARAMS];
+	int paramCount;
+	//SQLGetData state of the current row: the column being read, its text
+	//and how much of it has been returned
+	int dataColumn;
+	int dataDone;
+	int dataNull;
+	size_t dataOffset;
+	char* cell;
+	size_t cellLength;
+	size_t cellCapacity;
+	//folded over the parameter data so that reading it is not optimized out
+	unsigned long long checksum;
+} synth_stmt;
+
+static const char* g_typeNames[] = { "int", "double", "varchar", "lob", "timestamp", "bit" };
+
+/*
+ * Diagnostics
+ */
+
+static void ClearError(void* handle) {
+	((synth_handle*) handle)->hasError = 0;
+}
+
+static SQLRETURN SetError(void* handle, const char* state, const char* message) {
+	synth_handle* head = (synth_handle*) handle;
+
+	head->hasError = 1;
+	strncpy(head->state, state, SQL_SQLSTATE_SIZE);
+	head->state[SQL_SQLSTATE_SIZE] = '\0';
+	snprintf(head->message, SYNTH_MESSAGE_SIZE, "[node-odbc][synth]%s", message);
+
+	return SQL_ERROR;
+}
+
+/*
+ * Strings
+ *
+ * Everything the driver reads or returns is ASCII, so a SQLWCHAR string is
+ * narrowed and widened one unit at a time.
+ */
+
+static void Narrow(const void* in, SQLINTEGER length, int wide, char* out, size_t size) {
+	size_t i = 0;
+
+	if (in) {
+		for (; i < size - 1 && (length == SQL_NTS || (SQLINTEGER) i < length); i++) {
+			unsigned int c = (wide) ? ((const SQLWCHAR*) in)[i] : ((const SQLCHAR*) in)[i];
+
+			if (length == SQL_NTS && c == 0) {
+				break;
+			}
+
+			out[i] = (c < 0x80) ? (char) c : '?';
+		}
+	}
+
+	out[i] = '\0';
+}
+
+//copy text into a caller buffer of size bytes; returns SQL_SUCCESS_WITH_INFO
+//when it was truncated. *written gets the full length in bytes.
+static SQLRETURN CopyOut(const char* text, int wide, void* out, SQLLEN size, SQLLEN* written) {
+	size_t length = strlen(text);
+	size_t unit = (wide) ? sizeof(SQLWCHAR) : 1;
+	size_t room = (size > 0) ? (size_t) size / unit : 0;
+	size_t count = 0;
+
+	if (written) {
+		*written = (SQLLEN) (length * unit);
+	}
+
+	if (out && room > 0) {
+		count = (length < room - 1) ? length : room - 1;
+
+		for (size_t i = 0; i < count; i++) {
+			if (wide) {
+				((SQLWCHAR*) out)[i] = (SQLWCHAR) (unsigned char) text[i];
+			}
+			else {
+				((SQLCHAR*) out)[i] = (SQLCHAR) text[i];
+			}
+		}
+
+		if (wide) {
+			((SQLWCHAR*) out)[count] = 0;
+		}
+		else {
+			((SQLCHAR*) out)[count] = '\0';
+		}
+	}
+
+	return (count < length) ? SQL_SUCCESS_WITH_INFO : SQL_SUCCESS;
+}
+
+static SQLRETURN CopyOutSmall(const char* text, int wide, void* out, SQLSMALLINT size, SQLSMALLINT* written) {
+	SQLLEN length;
+	SQLRETURN ret = CopyOut(text, wide, out, size, &length);
+
+	if (written) {
+		*written = (SQLSMALLINT) length;
+	}
+
+	return ret;
+}
+
+/*
+ * Configuration
+ *
+ * Settings are key=value pairs separated by ';' or spaces, so the same
+ * parser reads the connection string and the SQL text:
+ *
+ *   ROWS=1000;COLUMNS=int,double,varchar(32),lob(65536),timestamp,bit;
+ *   NULLS=0.1;DISTINCT=0;SEED=1;LATENCY=0
+ */
+
+static void DefaultConfig(synth_config* config) {
+	memset(config, 0, sizeof(synth_config));
+
+	config->rows = 1;
+	config->columnCount = 1;
+	config->columns[0].type = SYNTH_INT;
+	config->seed = 1;
+}
+
+static int ParseColumns(synth_config* config, const char* value) {
+	int count = 0;
+
+	while (*value && count < SYNTH_MAX_COLUMNS) {
+		size_t length = strcspn(value, ",");
+		int type = -1;
+
+		for (int i = 0; i < (int) (sizeof(g_typeNames) / sizeof(g_typeNames[0])); i++) {
+			size_t nameLength = strlen(g_typeNames[i]);
+
+			if (strncasecmp(value, g_typeNames[i], nameLength) == 0 && (value[nameLength] == '(' || nameLength == length)) {
+				type = i;
+				break;
+			}
+		}
+
+		if (type < 0) {
+			return 0;
+		}
+
+		config->columns[count].type = type;
+		config->columns[count].width = (type == SYNTH_LOB) ? 65536 : 32;
+
+		const char* open = memchr(value, '(', length);
+
+		if (open) {
+			config->columns[count].width = atol(open + 1);
+		}
+
+		count++;
+		value += length;
+
+		if (*value == ',') {
+			value++;
+		}
+	}
+
+	config->columnCount = count;
+
+	return 1;
+}
+
+//returns 0 and names the bad setting in message when a value is invalid
+static int ParseConfig(synth_config* config, const char* text, char* message) {
+	char key[32];
+	char value[1024];
+
+	while (*text) {
+		size_t length = strcspn(text, "; \t\r\n");
+
+		if (length == 0) {
+			text++;
+			continue;
+		}
+
+		const char* equals = memchr(text, '=', length);
+
+		//a word of the SQL or a key we do not know
+		if (!equals || (size_t) (equals - text) >= sizeof(key) || length - (equals - text) > sizeof(value)) {
+			text += length;
+			continue;
+		}
+
+		memcpy(key, text, equals - text);
+		key[equals - text] = '\0';
+		memcpy(value, equals + 1, length - (equals - text) - 1);
+		value[length - (equals - text) - 1] = '\0';
+		text += length;
+
+		if (strcasecmp(key, "ROWS") == 0) {
+			config->rows = atol(value);
+		}
+		else if (strcasecmp(key, "COLUMNS") == 0) {
+			if (!ParseColumns(config, value)) {
+				snprintf(message, SYNTH_MESSAGE_SIZE, "Unknown column type in COLUMNS=%.200s", value);
+				return 0;
+			}
+		}
+		else if (strcasecmp(key, "NULLS") == 0) {
+			config->nulls = atof(value);
+		}
+		else if (strcasecmp(key, "DISTINCT") == 0) {
+			config->distinct = atol(value);
+		}
+		else if (strcasecmp(key, "SEED") == 0) {
+			config->seed = strtoull(value, NULL, 10);
+		}
+		else if (strcasecmp(key, "LATENCY") == 0) {
+			config->latency = atol(value);
+		}
+	}
+
+	return 1;
+}
+
+/*
+ * Data
+ */
+
+//splitmix64; good enough to make every cell look independent
+static unsigned long long Mix(unsigned long long x) {
+	x += 0x9E3779B97F4A7C15ULL;
+	x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+	x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+
+	return x ^ (x >> 31);
+}
+
+static unsigned long long CellHash(synth_stmt* stmt, long row, int column) {
+	return Mix(stmt->config.seed ^ Mix(((unsigned long long) row << 8) | (unsigned long long) column));
+}
+
+static int CellIsNull(synth_stmt* stmt, long row, int column) {
+	unsigned long long hash = Mix(CellHash(stmt, row, column));
+
+	return stmt->config.nulls > 0 && (double) (hash >> 11) / 9007199254740992.0 < stmt->config.nulls;
+}
+
+static void CellTimestamp(unsigned long long hash, SQL_TIMESTAMP_STRUCT* value) {
+	time_t seconds = SYNTH_EPOCH + (time_t) (hash % 631152000);
+	struct tm parts;
+
+	gmtime_r(&seconds, &parts);
+
+	value->year = (SQLSMALLINT) (parts.tm_year + 1900);
+	value->month = (SQLUSMALLINT) (parts.tm_mon + 1);
+	value->day = (SQLUSMALLINT) parts.tm_mday;
+	value->hour = (SQLUSMALLINT) parts.tm_hour;
+	value->minute = (SQLUSMALLINT) parts.tm_min;
+	value->second = (SQLUSMALLINT) parts.tm_sec;
+	value->fraction = 0;
+}
+
+/*
+ * FormatCell
+ *
+ * Render the current row's value of column (0 based) as text into
+ * stmt->cell. Numbers, dates and bits are converted from this text too so
+ * that every C type sees the same value.
+ */
+
+static void FormatCell(synth_stmt* stmt, int column) {
+	synth_column* def = &stmt->config.columns[column];
+	unsigned long long hash = CellHash(stmt, stmt->row, column);
+	size_t need = 64;
+
+	if (def->type == SYNTH_VARCHAR || def->type == SYNTH_LOB) {
+		need = (size_t) def->width + 1;
+	}
+
+	if (need > stmt->cellCapacity) {
+		free(stmt->cell);
+		stmt->cell = (char*) malloc(need);
+		stmt->cellCapacity = need;
+	}
+
+	switch (def->type) {
+		case SYNTH_INT :
+			stmt->cellLength = snprintf(stmt->cell, need, "%ld", (long) (hash % 2000000) - 1000000);
+			break;
+		case SYNTH_DOUBLE :
+			stmt->cellLength = snprintf(stmt->cell, need, "%.6f", (double) (hash >> 11) / 9007199254740992.0 * 1000000.0);
+			break;
+		case SYNTH_TIMESTAMP : {
+			SQL_TIMESTAMP_STRUCT value;
+
+			CellTimestamp(hash, &value);
+			stmt->cellLength = snprintf(stmt->cell, need, "%04d-%02d-%02d %02d:%02d:%02d",
+				value.year, value.month, value.day, value.hour, value.minute, value.second);
+		}
+		break;
+		case SYNTH_BIT :
+			stmt->cellLength = snprintf(stmt->cell, need, "%d", (int) (hash & 1));
+			break;
+		default : {
+			//with DISTINCT=n the strings only take n different values
+			unsigned long long state = (stmt->config.distinct > 0)
+				? Mix(stmt->config.seed ^ (hash % (unsigned long long) stmt->config.distinct) ^ column)
+				: hash;
+
+			for (long i = 0; i < def->width; i++) {
+				if ((i & 7) == 0) {
+					state = Mix(state);
+				}
+
+				stmt->cell[i] = 'a' + (char) (((state >> ((i & 7) * 8)) & 0xff) % 26);
+			}
+
+			stmt->cell[def->width] = '\0';
+			stmt->cellLength = (size_t) def->width;
+		}
+	}
+}
+
+static SQLSMALLINT ConciseType(int type) {
+	switch (type) {
+		case SYNTH_INT : return SQL_INTEGER;
+		case SYNTH_DOUBLE : return SQL_DOUBLE;
+		case SYNTH_LOB : return SQL_LONGVARCHAR;
+		case SYNTH_TIMESTAMP : return SQL_TYPE_TIMESTAMP;
+		case SYNTH_BIT : return SQL_BIT;
+		default : return SQL_VARCHAR;
+	}
+}
+
+static SQLLEN ColumnSize(synth_column* def) {
+	switch (def->type) {
+		case SYNTH_INT : return 10;
+		case SYNTH_DOUBLE : return 15;
+		case SYNTH_TIMESTAMP : return 19;
+		case SYNTH_BIT : return 1;
+		default : return def->width;
+	}
+}
+
+static void ResetCursor(synth_stmt* stmt) {
+	stmt->hasResult = 0;
+	stmt->row = 0;
+	stmt->rowCount = -1;
+	stmt->dataColumn = 0;
+}
+
+//statements which start with one of these do not return a result set
+static int IsModification(const char* sql) {
+	static const char* verbs[] = { "insert", "update", "delete", "merge", "create", "drop", "alter", NULL };
+
+	while (isspace((unsigned char) *sql)) {
+		sql++;
+	}
+
+	for (int i = 0; verbs[i]; i++) {
+		size_t length = strlen(verbs[i]);
+
+		if (strncasecmp(sql, verbs[i], length) == 0 && !isalnum((unsigned char) sql[length])) {
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+//read every bound parameter the way a driver would copy it to the wire
+static void ConsumeParams(synth_stmt* stmt) {
+	for (int i = 0; i < stmt->paramCount; i++) {
+		synth_param* param = &stmt->params[i];
+		SQLLEN length = (param->indicator) ? *param->indicator : param->bufferLength;
+
+		if (!param->value || length == SQL_NULL_DATA) {
+			stmt->checksum = Mix(stmt->checksum ^ i);
+			continue;
+		}
+
+		if (length == SQL_NTS) {
+			length = (param->valueType == SQL_C_WCHAR)
+				? 0
+				: (SQLLEN) strlen((const char*) param->value);
+
+			if (param->valueType == SQL_C_WCHAR) {
+				while (((const SQLWCHAR*) param->value)[length]) {
+					length++;
+				}
+
+				length *= sizeof(SQLWCHAR);
+			}
+		}
+
+		for (SQLLEN j = 0; j < length; j++) {
+			stmt->checksum = (stmt->checksum ^ ((const unsigned char*) param->value)[j]) * 0x100000001B3ULL;
+		}
+	}
+}
+
+static void Delay(long microseconds) {
+	struct timespec wait;
+
+	if (microseconds <= 0) {
+		return;
+	}
+
+	wait.tv_sec = microseconds / 1000000;
+	wait.tv_nsec = (microseconds % 1000000) * 1000;
+
+	while (nanosleep(&wait, &wait) != 0) {
+	}
+}
+
+/*
+ * Execute
+ */
+
+static SQLRETURN Execute(synth_stmt* stmt) {
+	char message[SYNTH_MESSAGE_SIZE];
+
+	ResetCursor(stmt);
+
+	stmt->config = stmt->dbc->config;
+
+	if (!ParseConfig(&stmt->config, stmt->sql, message)) {
+		return SetError(stmt, "42000", message);
+	}
+
+	Delay(stmt->config.latency);
+
+	if (IsModification(stmt->sql)) {
+		ConsumeParams(stmt);
+		stmt->rowCount = 1;
+
+		return SQL_SUCCESS;
+	}
+
+	stmt->hasResult = 1;
+	stmt->rowCount = stmt->config.rows;
+
+	return SQL_SUCCESS;
+}
+
+static SQLRETURN Prepare(synth_stmt* stmt, const void* sql, SQLINTEGER length, int wide) {
+	ClearError(stmt);
+	ResetCursor(stmt);
+
+	Narrow(sql, length, wide, stmt->sql, SYNTH_MAX_SQL);
+	stmt->prepared = 1;
+
+	return SQL_SUCCESS;
+}
+
+//an empty result set for the catalog functions
+static SQLRETURN Catalog(synth_stmt* stmt) {
+	ClearError(stmt);
+	ResetCursor(stmt);
+
+	stmt->config = stmt->dbc->config;
+	stmt->config.rows = 0;
+	stmt->config.columnCount = 0;
+	stmt->hasResult = 1;
+	stmt->rowCount = 0;
+
+	return SQL_SUCCESS;
+}
+
+/*
+ * Handles
+ */
+
+SYNTH_API SQLAllocHandle(SQLSMALLINT handleType, SQLHANDLE inputHandle, SQLHANDLE* outputHandle) {
+	synth_handle* handle;
+
+	switch (handleType) {
+		case SQL_HANDLE_ENV :
+			handle = (synth_handle*) calloc(1, sizeof(synth_env));
+			break;
+		case SQL_HANDLE_DBC : {
+			synth_dbc* dbc = (synth_dbc*) calloc(1, sizeof(synth_dbc));
+
+			if (dbc) {
+				DefaultConfig(&dbc->config);
+			}
+
+			handle = (synth_handle*) dbc;
+		}
+		break;
+		case SQL_HANDLE_STMT : {
+			synth_dbc* dbc = (synth_dbc*) inputHandle;
+			synth_stmt* stmt;
+
+			if (!dbc || dbc->head.handleType != SQL_HANDLE_DBC) {
+				return SQL_INVALID_HANDLE;
+			}
+
+			if (!dbc->connected) {
+				return SetError(dbc, "08003", "Connection not open");
+			}
+
+			stmt = (synth_stmt*) calloc(1, sizeof(synth_stmt));
+
+			if (stmt) {
+				stmt->dbc = dbc;
+				stmt->config = dbc->config;
+				ResetCursor(stmt);
+			}
+
+			handle = (synth_handle*) stmt;
+		}
+		break;
+		default :
+			return SQL_ERROR;
+	}
+
+	if (!handle) {
+		return SQL_ERROR;
+	}
+
+	handle->handleType = handleType;
+	*outputHandle = handle;
+
+	return SQL_SUCCESS;
+}
+
+SYNTH_API SQLFreeHandle(SQLSMALLINT handleType, SQLHANDLE handle) {
+	if (!handle || ((synth_handle*) handle)->handleType != handleType) {
+		return SQL_INVALID_HANDLE;
+	}
+
+	if (handleType == SQL_HANDLE_STMT) {
+		free(((synth_stmt*) handle)->cell);
+	}
+
+	free(handle);
+
+	return SQL_SUCCESS;
+}
+
+SYNTH_API SQLFreeStmt(SQLHSTMT hStmt, SQLUSMALLINT option) {
+	synth_stmt* stmt = (synth_stmt*) hStmt;
+
+	switch (option) {
+		case SQL_CLOSE :
+			ResetCursor(stmt);
+			break;
+		case SQL_RESET_PARAMS :
+			stmt->paramCount = 0;
+			break;
+		case SQL_DROP :
+			return SQLFreeHandle(SQL_HANDLE_STMT, hStmt);
+	}
+
+	return SQL_SUCCESS;
+}
+
+SYNTH_API SQLSetEnvAttr(SQLHENV hEnv, SQLINTEGER attribute, SQLPOINTER value, SQLINTEGER length) {
+	return SQL_SUCCESS;
+}
+
+SYNTH_API SQLSetConnectAttr(SQLHDBC hDBC, SQLINTEGER attribute, SQLPOINTER value, SQLINTEGER length) {
+	return SQL_SUCCESS;
+}
+
+SYNTH_API SQLGetConnectAttr(SQLHDBC hDBC, SQLINTEGER attribute, SQLPOINTER value, SQLINTEGER length, SQLINTEGER* written) {
+	if (value) {
+		*(SQLUINTEGER*) value = (attribute == SQL_ATTR_AUTOCOMMIT) ? SQL_AUTOCOMMIT_ON : 0;
+	}
+
+	if (written) {
+		*written = sizeof(SQLUINTEGER);
+	}
+
+	return SQL_SUCCESS;
+}
+
+SYNTH_API SQLSetStmtAttr(SQLHSTMT hStmt, SQLINTEGER attribute, SQLPOINTER value, SQLINTEGER length) {
+	return SQL_SUCCESS;
+}
+
+/*
+ * Connections
+ */
+
+static SQLRETURN DriverConnect(synth_dbc* dbc, const void* in, SQLSMALLINT inLength, void* out, SQLSMALLINT outSize, SQLSMALLINT* outLength, int wide) {
+	char connection[SYNTH_MAX_SQL];
+	char message[SYNTH_MESSAGE_SIZE];
+
+	ClearError(dbc);
+
+	Narrow(in, inLength, wide, connection, sizeof(connection));
+	DefaultConfig(&dbc->config);
+
+	if (!ParseConfig(&dbc->config, connection, message)) {
+		return SetError(dbc, "HY000", message);
+	}
+
+	dbc->connected = 1;
+	dbc->wideAnsi = wide;
+
+	CopyOutSmall(connection, wide, out, outSize, outLength);
+
+	return SQL_SUCCESS;
+}
+
+SYNTH_API SQLDriverConnect(SQLHDBC hDBC, SQLHWND hWnd, SQLCHAR* in, SQLSMALLINT inLength, SQLCHAR* out, SQLSMALLINT outSize, SQLSMALLINT* outLength, SQLUSMALLINT completion) {
+	//"D\0R\0..." is a SQLWCHAR connection string; no ANSI one is one byte long
+	int wide = in && in[0] && !in[1];
+
+	return DriverConnect((synth_dbc*) hDBC, in, inLength, out, outSize, outLength, wide);
+}
+
+SYNTH_API SQLDriverConnectW(SQLHDBC hDBC, SQLHWND hWnd, SQLWCHAR* in, SQLSMALLINT inLength, SQLWCHAR* out, SQLSMALLINT outSize, SQLSMALLINT* outLength, SQLUSMALLINT completion) {
+	synth_dbc* dbc = (synth_dbc*) hDBC;
+	SQLRETURN ret = DriverConnect(dbc, in, inLength, out, outSize, outLength, 1);
+
+	dbc->wideAnsi = 0;
+
+	return ret;
+}
+
+SYNTH_API SQLDisconnect(SQLHDBC hDBC) {
+	((synth_dbc*) hDBC)->connected = 0;
+
+	return SQL_SUCCESS;
+}
+
+SYNTH_API SQLEndTran(SQLSMALLINT handleType, SQLHANDLE handle, SQLSMALLINT completionType) {
+	return SQL_SUCCESS;
+}
+
+static SQLRETURN GetInfo(synth_dbc* dbc, SQLUSMALLINT type, SQLPOINTER value, SQLSMALLINT size, SQLSMALLINT* written, int wide) {
+	const char* text = NULL;
+	SQLUINTEGER number = 0;
+	int isShort = 0;
+
+	ClearError(dbc);
+
+	switch (type) {
+		case SQL_DRIVER_ODBC_VER : text = "03.52"; break;
+		case SQL_DRIVER_NAME : text = "odbc_synth.so"; break;
+		case SQL_DRIVER_VER : text = "01.00.0000"; break;
+		case SQL_DBMS_NAME : text = "Synthetic"; break;
+		case SQL_DBMS_VER : text = "01.00.0000"; break;
+		case SQL_DATA_SOURCE_NAME : text = ""; break;
+		case SQL_IDENTIFIER_QUOTE_CHAR : text = "\""; break;
+		case SQL_CURSOR_COMMIT_BEHAVIOR :
+		case SQL_CURSOR_ROLLBACK_BEHAVIOR : number = SQL_CB_PRESERVE; isShort = 1; break;
+		case SQL_TXN_CAPABLE : number = SQL_TC_ALL; isShort = 1; break;
+		case SQL_MAX_CONCURRENT_ACTIVITIES : number = 0; isShort = 1; break;
+		case SQL_GETDATA_EXTENSIONS : number = SQL_GD_ANY_COLUMN | SQL_GD_ANY_ORDER; break;
+		default :
+			return SetError(dbc, "HYC00", "Information type not supported");
+	}
+
+	if (text) {
+		return CopyOutSmall(text, wide, value, size, written);
+	}
+
+	if (isShort) {
+		if (value) {
+			*(SQLUSMALLINT*) value = (SQLUSMALLINT) number;
+		}
+
+		if (written) {
+			*written = sizeof(SQLUSMALLINT);
+		}
+	}
+	else {
+		if (value) {
+			*(SQLUINTEGER*) value = number;
+		}
+
+		if (written) {
+			*written = sizeof(SQLUINTEGER);
+		}
+	}
+
+	return SQL_SUCCESS;
+}
+
+SYNTH_API SQLGetInfo(SQLHDBC hDBC, SQLUSMALLINT type, SQLPOINTER value, SQLSMALLINT size, SQLSMALLINT* written) {
+	synth_dbc* dbc = (synth_dbc*) hDBC;
+
+	return GetInfo(dbc, type, value, size, written, dbc->wideAnsi);
+}
+
+SYNTH_API SQLGetInfoW(SQLHDBC hDBC, SQLUSMALLINT type, SQLPOINTER value, SQLSMALLINT size, SQLSMALLINT* written) {
+	return GetInfo((synth_dbc*) hDBC, type, value, size, written, 1);
+}
+
+static const SQLUSMALLINT g_functions[] = {
+	SQL_API_SQLALLOCHANDLE, SQL_API_SQLFREEHANDLE, SQL_API_SQLFREESTMT,
+	SQL_API_SQLSETENVATTR, SQL_API_SQLSETCONNECTATTR, SQL_API_SQLGETCONNECTATTR,
+	SQL_API_SQLSETSTMTATTR, SQL_API_SQLDRIVERCONNECT, SQL_API_SQLDISCONNECT,
+	SQL_API_SQLENDTRAN, SQL_API_SQLGETINFO, SQL_API_SQLGETFUNCTIONS,
+	SQL_API_SQLPREPARE, SQL_API_SQLEXECUTE, SQL_API_SQLEXECDIRECT,
+	SQL_API_SQLBINDPARAMETER, SQL_API_SQLNUMPARAMS, SQL_API_SQLNUMRESULTCOLS,
+	SQL_API_SQLDESCRIBECOL, SQL_API_SQLCOLATTRIBUTE, SQL_API_SQLFETCH,
+	SQL_API_SQLGETDATA, SQL_API_SQLROWCOUNT, SQL_API_SQLMORERESULTS,
+	SQL_API_SQLCANCEL, SQL_API_SQLTABLES, SQL_API_SQLCOLUMNS,
+	SQL_API_SQLGETDIAGREC, SQL_API_SQLGETDIAGFIELD
+};
+
+SYNTH_API SQLGetFunctions(SQLHDBC hDBC, SQLUSMALLINT function, SQLUSMALLINT* supported) {
+	int count = (int) (sizeof(g_functions) / sizeof(g_functions[0]));
+
+	if (function == SQL_API_ODBC3_ALL_FUNCTIONS) {
+		memset(supported, 0, sizeof(SQLUSMALLINT) * SQL_API_ODBC3_ALL_FUNCTIONS_SIZE);
+
+		for (int i = 0; i < count; i++) {
+			supported[g_functions[i] >> 4] |= (SQLUSMALLINT) (1 << (g_functions[i] & 0xf));
+		}
+
+		return SQL_SUCCESS;
+	}
+
+	if (function == SQL_API_ALL_FUNCTIONS) {
+		memset(supported, 0, sizeof(SQLUSMALLINT) * 100);
+
+		for (int i = 0; i < count; i++) {
+			if (g_functions[i] < 100) {
+				supported[g_functions[i]] = SQL_TRUE;
+			}
+		}
+
+		return SQL_SUCCESS;
+	}
+
+	*supported = SQL_FALSE;
+
+	for (int i = 0; i < count; i++) {
+		if (g_functions[i] == function) {
+			*supported = SQL_TRUE;
+		}
+	}
+
+	return SQL_SUCCESS;
+}
+
+/*
+ * Statements
+ */
+
+SYNTH_API SQLPrepare(SQLHSTMT hStmt, SQLCHAR* sql, SQLINTEGER length) {
+	synth_stmt* stmt = (synth_stmt*) hStmt;
+
+	return Prepare(stmt, sql, length, stmt->dbc->wideAnsi);
+}
+
+SYNTH_API SQLPrepareW(SQLHSTMT hStmt, SQLWCHAR* sql, SQLINTEGER length) {
+	return Prepare((synth_stmt*) hStmt, sql, length, 1);
+}
+
+SYNTH_API SQLExecute(SQLHSTMT hStmt) {
+	synth_stmt* stmt = (synth_stmt*) hStmt;
+
+	ClearError(stmt);
+
+	if (!stmt->prepared) {
+		return SetError(stmt, "HY010", "Statement not prepared");
+	}
+
+	return Execute(stmt);
+}
+
+SYNTH_API SQLExecDirect(SQLHSTMT hStmt, SQLCHAR* sql, SQLINTEGER length) {
+	SQLPrepare(hStmt, sql, length);
+
+	return Execute((synth_stmt*) hStmt);
+}
+
+SYNTH_API SQLExecDirectW(SQLHSTMT hStmt, SQLWCHAR* sql, SQLINTEGER length) {
+	SQLPrepareW(hStmt, sql, length);
+
+	return Execute((synth_stmt*) hStmt);
+}
+
+SYNTH_API SQLBindParameter(SQLHSTMT hStmt, SQLUSMALLINT number, SQLSMALLINT inputOutputType, SQLSMALLINT valueType, SQLSMALLINT parameterType, SQLULEN columnSize, SQLSMALLINT decimalDigits, SQLPOINTER value, SQLLEN bufferLength, SQLLEN* indicator) {
+	synth_stmt* stmt = (synth_stmt*) hStmt;
+
+	ClearError(stmt);
+
+	if (number < 1 || number > SYNTH_MAX_PARAMS) {
+		return SetError(stmt, "07009", "Invalid parameter number");
+	}
+
+	synth_param* param = &stmt->params[number - 1];
+
+	param->valueType = valueType;
+	param->value = value;
+	param->bufferLength = bufferLength;
+	param->indicator = indicator;
+
+	if (number > stmt->paramCount) {
+		stmt->paramCount = number;
+	}
+
+	return SQL_SUCCESS;
+}
+
+SYNTH_API SQLNumParams(SQLHSTMT hStmt, SQLSMALLINT* count) {
+	synth_stmt* stmt = (synth_stmt*) hStmt;
+	SQLSMALLINT markers = 0;
+
+	for (const char* c = stmt->sql; *c; c++) {
+		markers += (*c == '?');
+	}
+
+	*count = markers;
+
+	return SQL_SUCCESS;
+}
+
+SYNTH_API SQLNumResultCols(SQLHSTMT hStmt, SQLSMALLINT* count) {
+	synth_stmt* stmt = (synth_stmt*) hStmt;
+
+	*count = (stmt->hasResult) ? (SQLSMALLINT) stmt->config.columnCount : 0;
+
+	return SQL_SUCCESS;
+}
+
+SYNTH_API SQLRowCount(SQLHSTMT hStmt, SQLLEN* count) {
+	*count = ((synth_stmt*) hStmt)->rowCount;
+
+	return SQL_SUCCESS;
+}
+
+SYNTH_API SQLMoreResults(SQLHSTMT hStmt) {
+	ResetCursor((synth_stmt*) hStmt);
+
+	return SQL_NO_DATA;
+}
+
+SYNTH_API SQLCancel(SQLHSTMT hStmt) {
+	return SQL_SUCCESS;
+}
+
+SYNTH_API SQLTables(SQLHSTMT hStmt, SQLCHAR* catalog, SQLSMALLINT catalogLength, SQLCHAR* schema, SQLSMALLINT schemaLength, SQLCHAR* table, SQLSMALLINT tableLength, SQLCHAR* type, SQLSMALLINT typeLength) {
+	return Catalog((synth_stmt*) hStmt);
+}
+
+SYNTH_API SQLTablesW(SQLHSTMT hStmt, SQLWCHAR* catalog, SQLSMALLINT catalogLength, SQLWCHAR* schema, SQLSMALLINT schemaLength, SQLWCHAR* table, SQLSMALLINT tableLength, SQLWCHAR* type, SQLSMALLINT typeLength) {
+	return Catalog((synth_stmt*) hStmt);
+}
+
+SYNTH_API SQLColumns(SQLHSTMT hStmt, SQLCHAR* catalog, SQLSMALLINT catalogLength, SQLCHAR* schema, SQLSMALLINT schemaLength, SQLCHAR* table, SQLSMALLINT tableLength, SQLCHAR* column, SQLSMALLINT columnLength) {
+	return Catalog((synth_stmt*) hStmt);
+}
+
+SYNTH_API SQLColumnsW(SQLHSTMT hStmt, SQLWCHAR* catalog, SQLSMALLINT catalogLength, SQLWCHAR* schema, SQLSMALLINT schemaLength, SQLWCHAR* table, SQLSMALLINT tableLength, SQLWCHAR* column, SQLSMALLINT columnLength) {
+	return Catalog((synth_stmt*) hStmt);
+}
+
+/*
+ * Columns
+ */
+
+static SQLRETURN ColAttribute(synth_stmt* stmt, SQLUSMALLINT number, SQLUSMALLINT field, SQLPOINTER text, SQLSMALLINT size, SQLSMALLINT* written, SQLLEN* value, int wide) {
+	char name[16];
+	SQLLEN result = 0;
+
+	ClearError(stmt);
+
+	if (!stmt->hasResult || number < 1 || number > stmt->config.columnCount) {
+		return SetError(stmt, "07009", "Invalid descriptor index");
+	}
+
+	synth_column* def = &stmt->config.columns[number - 1];
+
+	switch (field) {
+		case SQL_DESC_NAME :
+		case SQL_DESC_LABEL :
+		case SQL_COLUMN_NAME :
+			snprintf(name, sizeof(name), "C%d", number);
+			return CopyOutSmall(name, wide, text, size, written);
+		case SQL_DESC_TYPE_NAME :
+			return CopyOutSmall(g_typeNames[def->type], wide, text, size, written);
+		case SQL_DESC_TYPE :
+			//the verbose type; datetime types are SQL_DATETIME
+			result = (def->type == SYNTH_TIMESTAMP) ? SQL_DATETIME : ConciseType(def->type);
+			break;
+		case SQL_DESC_CONCISE_TYPE :
+			result = ConciseType(def->type);
+			break;
+		case SQL_DESC_LENGTH :
+		case SQL_DESC_OCTET_LENGTH :
+		case SQL_DESC_DISPLAY_SIZE :
+		case SQL_COLUMN_LENGTH :
+			result = ColumnSize(def);
+			break;
+		case SQL_DESC_NULLABLE :
+			result = (stmt->config.nulls > 0) ? SQL_NULLABLE : SQL_NO_NULLS;
+			break;
+	}
+
+	if (value) {
+		*value = result;
+	}
+
+	return SQL_SUCCESS;
+}
+
+SYNTH_API SQLColAttribute(SQLHSTMT hStmt, SQLUSMALLINT number, SQLUSMALLINT field, SQLPOINTER text, SQLSMALLINT size, SQLSMALLINT* written, SQLLEN* value) {
+	synth_stmt* stmt = (synth_stmt*) hStmt;
+
+	return ColAttribute(stmt, number, field, text, size, written, value, stmt->dbc->wideAnsi);
+}
+
+SYNTH_API SQLColAttributeW(SQLHSTMT hStmt, SQLUSMALLINT number, SQLUSMALLINT field, SQLPOINTER text, SQLSMALLINT size, SQLSMALLINT* written, SQLLEN* value) {
+	return ColAttribute((synth_stmt*) hStmt, number, field, text, size, written, value, 1);
+}
+
+static SQLRETURN DescribeCol(synth_stmt* stmt, SQLUSMALLINT number, void* name, SQLSMALLINT size, SQLSMALLINT* written, SQLSMALLINT* type, SQLULEN* columnSize, SQLSMALLINT* digits, SQLSMALLINT* nullable, int wide) {
+	SQLLEN value;
+	SQLRETURN ret = ColAttribute(stmt, number, SQL_DESC_NAME, name, size, written, NULL, wide);
+
+	if (!SQL_SUCCEEDED(ret)) {
+		return ret;
+	}
+
+	if (type) {
+		ColAttribute(stmt, number, SQL_DESC_CONCISE_TYPE, NULL, 0, NULL, &value, wide);
+		*type = (SQLSMALLINT) value;
+	}
+
+	if (columnSize) {
+		ColAttribute(stmt, number, SQL_DESC_LENGTH, NULL, 0, NULL, &value, wide);
+		*columnSize = (SQLULEN) value;
+	}
+
+	if (digits) {
+		*digits = 0;
+	}
+
+	if (nullable) {
+		ColAttribute(stmt, number, SQL_DESC_NULLABLE, NULL, 0, NULL, &value, wide);
+		*nullable = (SQLSMALLINT) value;
+	}
+
+	return ret;
+}
+
+SYNTH_API SQLDescribeCol(SQLHSTMT hStmt, SQLUSMALLINT number, SQLCHAR* name, SQLSMALLINT size, SQLSMALLINT* written, SQLSMALLINT* type, SQLULEN* columnSize, SQLSMALLINT* digits, SQLSMALLINT* nullable) {
+	synth_stmt* stmt = (synth_stmt*) hStmt;
+	SQLRETURN ret = DescribeCol(stmt, number, name, size, written, type, columnSize, digits, nullable, stmt->dbc->wideAnsi);
+
+	//the length is in characters here
+	if (written && stmt->dbc->wideAnsi) {
+		*written /= sizeof(SQLWCHAR);
+	}
+
+	return ret;
+}
+
+SYNTH_API SQLDescribeColW(SQLHSTMT hStmt, SQLUSMALLINT number, SQLWCHAR* name, SQLSMALLINT size, SQLSMALLINT* written, SQLSMALLINT* type, SQLULEN* columnSize, SQLSMALLINT* digits, SQLSMALLINT* nullable) {
+	SQLRETURN ret = DescribeCol((synth_stmt*) hStmt, number, name, size * sizeof(SQLWCHAR), written, type, columnSize, digits, nullable, 1);
+
+	if (written) {
+		*written /= sizeof(SQLWCHAR);
+	}
+
+	return ret;
+}
+
+/*
+ * Rows
+ */
+
+SYNTH_API SQLFetch(SQLHSTMT hStmt) {
+	synth_stmt* stmt = (synth_stmt*) hStmt;
+
+	ClearError(stmt);
+
+	if (!stmt->hasResult) {
+		return SetError(stmt, "24000", "Invalid cursor state");
+	}
+
+	if (stmt->row >= stmt->config.rows) {
+		return SQL_NO_DATA;
+	}
+
+	stmt->row++;
+	stmt->dataColumn = 0;
+
+	return SQL_SUCCESS;
+}
+
+/*
+ * SQLGetData
+ *
+ * Numbers, dates and bits are returned whole. Character data is returned
+ * in as many chunks as the caller's buffer needs: SQL_SUCCESS_WITH_INFO
+ * (01004) while there is more, SQL_SUCCESS for the last chunk and
+ * SQL_NO_DATA after that.
+ */
+
+SYNTH_API SQLGetData(SQLHSTMT hStmt, SQLUSMALLINT number, SQLSMALLINT targetType, SQLPOINTER target, SQLLEN bufferLength, SQLLEN* indicator) {
+	synth_stmt* stmt = (synth_stmt*) hStmt;
+
+	ClearError(stmt);
+
+	if (!stmt->hasResult || stmt->row < 1 || stmt->row > stmt->config.rows) {
+		return SetError(stmt, "24000", "Invalid cursor state");
+	}
+
+	if (number < 1 || number > stmt->config.columnCount) {
+		return SetError(stmt, "07009", "Invalid descriptor index");
+	}
+
+	if (number != stmt->dataColumn) {
+		stmt->dataColumn = number;
+		stmt->dataDone = 0;
+		stmt->dataOffset = 0;
+		stmt->dataNull = CellIsNull(stmt, stmt->row, number - 1);
+
+		if (!stmt->dataNull) {
+			FormatCell(stmt, number - 1);
+		}
+	}
+
+	if (stmt->dataDone) {
+		return SQL_NO_DATA;
+	}
+
+	if (stmt->dataNull) {
+		stmt->dataDone = 1;
+
+		if (!indicator) {
+			return SetError(stmt, "22002", "Indicator variable required but not supplied");
+		}
+
+		*indicator = SQL_NULL_DATA;
+
+		return SQL_SUCCESS;
+	}
+
+	synth_column* def = &stmt->config.columns[number - 1];
+
+	switch (targetType) {
+		case SQL_C_SLONG :
+		case SQL_C_LONG :
+			*(SQLINTEGER*) target = (SQLINTEGER) atol(stmt->cell);
+			stmt->dataDone = 1;
+
+			if (indicator) {
+				*indicator = sizeof(SQLINTEGER);
+			}
+
+			return SQL_SUCCESS;
+		case SQL_C_DOUBLE :
+			*(double*) target = atof(stmt->cell);
+			stmt->dataDone = 1;
+
+			if (indicator) {
+				*indicator = sizeof(double);
+			}
+
+			return SQL_SUCCESS;
+		case SQL_C_TYPE_TIMESTAMP :
+		case SQL_C_TIMESTAMP :
+			if (def->type != SYNTH_TIMESTAMP) {
+				return SetError(stmt, "07006", "Restricted data type attribute violation");
+			}
+
+			CellTimestamp(CellHash(stmt, stmt->row, number - 1), (SQL_TIMESTAMP_STRUCT*) target);
+			stmt->dataDone = 1;
+
+			if (indicator) {
+				*indicator = sizeof(SQL_TIMESTAMP_STRUCT);
+			}
+
+			return SQL_SUCCESS;
+		case SQL_C_CHAR :
+		case SQL_C_WCHAR : {
+			int wide = (targetType == SQL_C_WCHAR);
+			size_t unit = (wide) ? sizeof(SQLWCHAR) : 1;
+			size_t remaining = stmt->cellLength - stmt->dataOffset;
+			size_t room = (bufferLength > 0) ? (size_t) bufferLength / unit : 0;
+			size_t count;
+
+			if (room == 0) {
+				return SetError(stmt, "HY090", "Invalid string or buffer length");
+			}
+
+			count = (remaining < room - 1) ? remaining : room - 1;
+
+			for (size_t i = 0; i < count; i++) {
+				if (wide) {
+					((SQLWCHAR*) target)[i] = (SQLWCHAR) (unsigned char) stmt->cell[stmt->dataOffset + i];
+				}
+				else {
+					((char*) target)[i] = stmt->cell[stmt->dataOffset + i];
+				}
+			}
+
+			if (wide) {
+				((SQLWCHAR*) target)[count] = 0;
+			}
+			else {
+				((char*) target)[count] = '\0';
+			}
+
+			if (indicator) {
+				*indicator = (SQLLEN) (remaining * unit);
+			}
+
+			stmt->dataOffset += count;
+
+			if (count < remaining) {
+				SetError(stmt, "01004", "String data, right truncated");
+				return SQL_SUCCESS_WITH_INFO;
+			}
+
+			stmt->dataDone = 1;
+
+			return SQL_SUCCESS;
+		}
+		default :
+			return SetError(stmt, "HY003", "Program type out of range");
+	}
+}
+
+/*
+ * Diagnostic records
+ *
+ * A handle keeps the record of the last call which failed or returned
+ * SQL_SUCCESS_WITH_INFO.
+ */
+
+static SQLRETURN GetDiagRec(SQLSMALLINT handleType, SQLHANDLE handle, SQLSMALLINT record, void* state, SQLINTEGER* native, void* message, SQLSMALLINT size, SQLSMALLINT* written, int wide) {
+	synth_handle* head = (synth_handle*) handle;
+	SQLSMALLINT length;
+
+	if (!head || head->handleType != handleType) {
+		return SQL_INVALID_HANDLE;
+	}
+
+	if (record != 1 || !head->hasError) {
+		return SQL_NO_DATA;
+	}
+
+	if (state) {
+		CopyOut(head->state, wide, state, (SQL_SQLSTATE_SIZE + 1) * ((wide) ? sizeof(SQLWCHAR) : 1), NULL);
+	}
+
+	if (native) {
+		*native = 0;
+	}
+
+	SQLRETURN ret = CopyOutSmall(head->message, wide, message, size * ((wide) ? sizeof(SQLWCHAR) : 1), &length);
+
+	if (written) {
+		*written = length / ((wide) ? sizeof(SQLWCHAR) : 1);
+	}
+
+	return ret;
+}
+
+static int HandleIsWideAnsi(SQLSMALLINT handleType, SQLHANDLE handle) {
+	if (handleType == SQL_HANDLE_DBC) {
+		return ((synth_dbc*) handle)->wideAnsi;
+	}
+
+	if (handleType == SQL_HANDLE_STMT) {
+		return ((synth_stmt*) handle)->dbc->wideAnsi;
+	}
+
+	return 0;
+}
+
+SYNTH_API SQLGetDiagRec(SQLSMALLINT handleType, SQLHANDLE handle, SQLSMALLINT record, SQLCHAR* state, SQLINTEGER* native, SQLCHAR* message, SQLSMALLINT size, SQLSMALLINT* written) {
+	if (!handle) {
+		return SQL_INVALID_HANDLE;
+	}
+
+	return GetDiagRec(handleType, handle, record, state, native, message, size, written, HandleIsWideAnsi(handleType, handle));
+}
+
+SYNTH_API SQLGetDiagRecW(SQLSMALLINT handleType, SQLHANDLE handle, SQLSMALLINT record, SQLWCHAR* state, SQLINTEGER* native, SQLWCHAR* message, SQLSMALLINT size, SQLSMALLINT* written) {
+	return GetDiagRec(handleType, handle, record, state, native, message, size, written, 1);
+}
+
+static SQLRETURN GetDiagField(SQLSMALLINT handleType, SQLHANDLE handle, SQLSMALLINT record, SQLSMALLINT field, SQLPOINTER value, SQLSMALLINT size, SQLSMALLINT* written, int wide) {
+	synth_handle* head = (synth_handle*) handle;
+
+	if (!head || head->handleType != handleType) {
+		return SQL_INVALID_HANDLE;
+	}
+
+	if (field == SQL_DIAG_NUMBER) {
+		*(SQLINTEGER*) value = head->hasError;
+		return SQL_SUCCESS;
+	}
+
+	if (record != 1 || !head->hasError) {
+		return SQL_NO_DATA;
+	}
+
+	switch (field) {
+		case SQL_DIAG_SQLSTATE :
+			return CopyOutSmall(head->state, wide, value, size, written);
+		case SQL_DIAG_MESSAGE_TEXT :
+			return CopyOutSmall(head->message, wide, value, size, written);
+		case SQL_DIAG_NATIVE :
+			*(SQLINTEGER*) value = 0;
+			return SQL_SUCCESS;
+		case SQL_DIAG_ROW_NUMBER :
+			*(SQLLEN*) value = SQL_ROW_NUMBER_UNKNOWN;
+			return SQL_SUCCESS;
+		case SQL_DIAG_COLUMN_NUMBER :
+			*(SQLINTEGER*) value = SQL_COLUMN_NUMBER_UNKNOWN;
+			return SQL_SUCCESS;
+	}
+
+	return SQL_ERROR;
+}
+
+SYNTH_API SQLGetDiagField(SQLSMALLINT handleType, SQLHANDLE handle, SQLSMALLINT record, SQLSMALLINT field, SQLPOINTER value, SQLSMALLINT size, SQLSMALLINT* written) {
+	if (!handle) {
+		return SQL_INVALID_HANDLE;
+	}
+
+	return GetDiagField(handleType, handle, record, field, value, size, written, HandleIsWideAnsi(handleType, handle));
+}
+
+SYNTH_API SQLGetDiagFieldW(SQLSMALLINT handleType, SQLHANDLE handle, SQLSMALLINT record, SQLSMALLINT field, SQLPOINTER value, SQLSMALLINT size, SQLSMALLINT* written) {
+	return GetDiagField(handleType, handle, record, field, value, size, written, 1);
+}
@@ -0,0 +1,555 @@
+/*
+  Copyright (c) 2013, Dan VerWeire <dverweire@gmail.com>
+
+  Permission to use, copy, modify, and/or distribute this software for any
+  purpose with or without fee is hereby granted, provided that the above
+  copyright notice and this permission notice appear in all copies.
+
+  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+
+/*
+ * Microbenchmarks for the conversion and binding kernels of the addon.
+ *
+ * odbc_microbench.node is built from the addon's own sources and the
+ * synthetic driver (test/driver/odbc_synth.c) in one module, so SQLFetch
+ * and SQLGetData are plain function calls into a driver which only
+ * formats generated values. run() times one kernel at a time on the
+ * calling isolate and reports, per cell and per row:
+ *
+ *   ns        - time spent in the kernel; the time of a loop which only
+ *               fetches the same rows is subtracted
+ *   allocs    - malloc/calloc/realloc/new calls made by the addon code
+ *   bytes     - bytes requested by those calls
+ *   heapBytes - bytes allocated on the V8 heap
+ *
+ * Run it with test/run-microbench.js.
+ */
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <new>
+#include <v8.h>
+#include <node.h>
+#include <uv.h>
+
+#include "odbc.h"
+
+using namespace v8;
+using namespace node;
+
+//the addon's module initializer, see odbc.cpp
+extern "C" void init(v8::Handle<Object> target, v8::Handle<Value> module, v8::Handle<Context> context, void* priv);
+
+//see odbc_microbench_alloc.c
+extern "C" uint64_t g_benchAllocations;
+extern "C" uint64_t g_benchAllocatedBytes;
+
+#define BENCH_DEFAULT_ROWS 10000
+#define BENCH_DEFAULT_ITERATIONS 100000
+#define BENCH_CONNECTION_SIZE 512
+
+//counted by the malloc() of odbc_microbench_alloc.c
+void* operator new(size_t size) {
+	void* pointer = malloc(size);
+
+	if (!pointer) {
+		throw std::bad_alloc();
+	}
+
+	return pointer;
+}
+
+void* operator new[](size_t size) {
+	return operator new(size);
+}
+
+void operator delete(void* pointer) throw() {
+	free(pointer);
+}
+
+void operator delete[](void* pointer) throw() {
+	free(pointer);
+}
+
+typedef struct {
+	uint64_t time;
+	uint64_t allocations;
+	uint64_t bytes;
+	uint64_t heapBytes;
+} bench_sample;
+
+class ODBCMicrobench {
+  public:
+    static void Init(v8::Handle<Object> target, v8::Handle<Value> module, v8::Handle<Context> context, void* priv);
+
+  protected:
+    static void Begin(bench_sample* sample);
+    static void End(bench_sample* sample);
+    static void GCPrologue(v8::Isolate* isolate, GCType type, GCCallbackFlags flags);
+    static void GCEpilogue(v8::Isolate* isolate, GCType type, GCCallbackFlags flags);
+    static uint64_t HeapUsed();
+
+    static SQLHSTMT Execute(const char* sql);
+    static void Fetch(SQLHSTMT hStmt, bench_sample* sample);
+    static void Report(Local<Array> results, const char* kernel, const char* type, bench_sample* sample, bench_sample* baseline, double rows, double cells);
+
+    static void BenchGetColumns(Local<Array> results, const char* types, int rows);
+    static void BenchGetColumnValue(Local<Array> results, const char* type, int rows);
+    static void BenchGetRecord(Local<Array> results, const char* types, int rows, bool tuple);
+    static void BenchGetParameters(Local<Array> results, int iterations);
+    static void BenchGetSQLError(Local<Array> results, int iterations);
+
+    //JS functions
+    static void Run(const v8::FunctionCallbackInfo<v8::Value>& info);
+
+    static HENV m_hEnv;
+    static HDBC m_hDBC;
+    static uint16_t* m_buffer;
+
+    //V8 heap accounting between Begin and End
+    static uint64_t m_heapMark;
+    static uint64_t m_heapAllocated;
+};
+
+HENV ODBCMicrobench::m_hEnv = NULL;
+HDBC ODBCMicrobench::m_hDBC = NULL;
+uint16_t* ODBCMicrobench::m_buffer = NULL;
+uint64_t ODBCMicrobench::m_heapMark = 0;
+uint64_t ODBCMicrobench::m_heapAllocated = 0;
+
+/*
+ * HeapUsed
+ */
+uint64_t ODBCMicrobench::HeapUsed() {
+	HeapStatistics stats;
+
+	v8::Isolate::GetCurrent()->GetHeapStatistics(&stats);
+
+	return stats.used_heap_size();
+}
+
+/*
+ * GCPrologue / GCEpilogue
+ *
+ * What was allocated since the last mark is added up before a collection
+ * frees it.
+ */
+void ODBCMicrobench::GCPrologue(v8::Isolate* isolate, GCType type, GCCallbackFlags flags) {
+	uint64_t used = HeapUsed();
+
+	if (used > m_heapMark) {
+		m_heapAllocated += used - m_heapMark;
+	}
+}
+
+void ODBCMicrobench::GCEpilogue(v8::Isolate* isolate, GCType type, GCCallbackFlags flags) {
+	m_heapMark = HeapUsed();
+}
+
+/*
+ * Begin / End
+ */
+void ODBCMicrobench::Begin(bench_sample* sample) {
+	m_heapAllocated = 0;
+	m_heapMark = HeapUsed();
+
+	sample->allocations = ODBC_ATOMIC_LOAD64(&g_benchAllocations);
+	sample->bytes = ODBC_ATOMIC_LOAD64(&g_benchAllocatedBytes);
+	sample->time = uv_hrtime();
+}
+
+void ODBCMicrobench::End(bench_sample* sample) {
+	sample->time = uv_hrtime() - sample->time;
+	sample->allocations = ODBC_ATOMIC_LOAD64(&g_benchAllocations) - sample->allocations;
+	sample->bytes = ODBC_ATOMIC_LOAD64(&g_benchAllocatedBytes) - sample->bytes;
+
+	uint64_t used = HeapUsed();
+
+	sample->heapBytes = m_heapAllocated + ((used > m_heapMark) ? used - m_heapMark : 0);
+}
+
+/*
+ * Execute
+ *
+ * Run a statement against the synthetic driver; its settings come from the
+ * SQL text, see test/driver/odbc_synth.c.
+ */
+SQLHSTMT ODBCMicrobench::Execute(const char* sql) {
+	SQLHSTMT hStmt;
+	SQLTCHAR text[BENCH_CONNECTION_SIZE];
+	size_t i;
+
+	for (i = 0; sql[i] && i < BENCH_CONNECTION_SIZE - 1; i++) {
+		text[i] = (SQLTCHAR) sql[i];
+	}
+	text[i] = 0;
+
+	SQLAllocHandle(SQL_HANDLE_STMT, m_hDBC, &hStmt);
+	SQLExecDirect(hStmt, text, SQL_NTS);
+
+	return hStmt;
+}
+
+/*
+ * Fetch
+ *
+ * The baseline: walk the result set and read nothing.
+ */
+void ODBCMicrobench::Fetch(SQLHSTMT hStmt, bench_sample* sample) {
+	Begin(sample);
+
+	while (SQL_SUCCEEDED(SQLFetch(hStmt))) {
+	}
+
+	End(sample);
+
+	SQLFreeHandle(SQL_HANDLE_STMT, hStmt);
+}
+
+/*
+ * Report
+ */
+void ODBCMicrobench::Report(Local<Array> results, const char* kernel, const char* type, bench_sample* sample, bench_sample* baseline, double rows, double cells) {
+	v8::Isolate* isolate = v8::Isolate::GetCurrent();
+	bench_sample none = { 0, 0, 0, 0 };
+
+	if (!baseline) {
+		baseline = &none;
+	}
+
+	double time = (sample->time > baseline->time) ? (double) (sample->time - baseline->time) : 0;
+	double allocations = (sample->allocations > baseline->allocations) ? (double) (sample->allocations - baseline->allocations) : 0;
+	double bytes = (sample->bytes > baseline->bytes) ? (double) (sample->bytes - baseline->bytes) : 0;
+
+	Local<Object> result = Object::New(isolate);
+
+	result->Set(String::NewFromUtf8(isolate, "kernel"), String::NewFromUtf8(isolate, kernel));
+	result->Set(String::NewFromUtf8(isolate, "type"), (type) ? (Handle<Value>) String::NewFromUtf8(isolate, type) : (Handle<Value>) Null(isolate));
+	result->Set(String::NewFromUtf8(isolate, "rows"), Number::New(isolate, rows));
+	result->Set(String::NewFromUtf8(isolate, "cells"), Number::New(isolate, cells));
+	result->Set(String::NewFromUtf8(isolate, "nsPerCell"), Number::New(isolate, time / cells));
+	result->Set(String::NewFromUtf8(isolate, "allocsPerRow"), Number::New(isolate, allocations / rows));
+	result->Set(String::NewFromUtf8(isolate, "bytesPerRow"), Number::New(isolate, bytes / rows));
+	result->Set(String::NewFromUtf8(isolate, "heapBytesPerRow"), Number::New(isolate, (double) sample->heapBytes / rows));
+
+	results->Set(results->Length(), result);
+}
+
+/*
+ * BenchGetColumns
+ *
+ * GetColumns and FreeColumns once per row; a cell is a column.
+ */
+void ODBCMicrobench::BenchGetColumns(Local<Array> results, const char* types, int rows) {
+	char sql[BENCH_CONNECTION_SIZE];
+	bench_sample sample;
+	short colCount = 0;
+
+	snprintf(sql, sizeof(sql), "select ROWS=1 COLUMNS=%s", types);
+
+	SQLHSTMT hStmt = Execute(sql);
+
+	Begin(&sample);
+
+	for (int i = 0; i < rows; i++) {
+		Column* columns = ODBC::GetColumns(hStmt, &colCount, false);
+		short count = colCount;
+
+		ODBC::FreeColumns(columns, &colCount);
+		colCount = count;
+	}
+
+	End(&sample);
+
+	SQLFreeHandle(SQL_HANDLE_STMT, hStmt);
+
+	Report(results, "GetColumns", types, &sample, NULL, rows, (double) rows * colCount);
+}
+
+/*
+ * BenchGetColumnValue
+ */
+void ODBCMicrobench::BenchGetColumnValue(Local<Array> results, const char* type, int rows) {
+	v8::Isolate* isolate = v8::Isolate::GetCurrent();
+	char sql[BENCH_CONNECTION_SIZE];
+	bench_sample baseline, sample;
+	short colCount = 0;
+
+	snprintf(sql, sizeof(sql), "select ROWS=%d COLUMNS=%s", rows, type);
+
+	Fetch(Execute(sql), &baseline);
+
+	SQLHSTMT hStmt = Execute(sql);
+	Column* columns = ODBC::GetColumns(hStmt, &colCount, false);
+
+	Begin(&sample);
+
+	while (SQL_SUCCEEDED(SQLFetch(hStmt))) {
+		v8::HandleScope scope(isolate);
+
+		ODBC::GetColumnValue(hStmt, columns[0], m_buffer, MAX_VALUE_SIZE - 1);
+	}
+
+	End(&sample);
+
+	ODBC::FreeColumns(columns, &colCount);
+	SQLFreeHandle(SQL_HANDLE_STMT, hStmt);
+
+	Report(results, "GetColumnValue", type, &sample, &baseline, rows, rows);
+}
+
+/*
+ * BenchGetRecord
+ *
+ * GetRecordTuple or GetRecordArray for every row of a result set with all
+ * the types.
+ */
+void ODBCMicrobench::BenchGetRecord(Local<Array> results, const char* types, int rows, bool tuple) {
+	v8::Isolate* isolate = v8::Isolate::GetCurrent();
+	char sql[BENCH_CONNECTION_SIZE];
+	bench_sample baseline, sample;
+	short colCount = 0;
+
+	snprintf(sql, sizeof(sql), "select ROWS=%d COLUMNS=%s", rows, types);
+
+	Fetch(Execute(sql), &baseline);
+
+	SQLHSTMT hStmt = Execute(sql);
+	Column* columns = ODBC::GetColumns(hStmt, &colCount, false);
+	short count = colCount;
+
+	Begin(&sample);
+
+	while (SQL_SUCCEEDED(SQLFetch(hStmt))) {
+		v8::HandleScope scope(isolate);
+
+		if (tuple) {
+			ODBC::GetRecordTuple(hStmt, columns, &colCount, m_buffer, MAX_VALUE_SIZE - 1);
+		}
+		else {
+			ODBC::GetRecordArray(hStmt, columns, &colCount, m_buffer, MAX_VALUE_SIZE - 1);
+		}
+	}
+
+	End(&sample);
+
+	ODBC::FreeColumns(columns, &colCount);
+	SQLFreeHandle(SQL_HANDLE_STMT, hStmt);
+
+	Report(results, (tuple) ? "GetRecordTuple" : "GetRecordArray", types, &sample, &baseline, rows, (double) rows * count);
+}
+
+/*
+ * BenchGetParameters
+ *
+ * GetParametersFromArray on one array of every kind of value, freed the
+ * way ODBCConnection does; a cell is a parameter.
+ */
+void ODBCMicrobench::BenchGetParameters(Local<Array> results, int iterations) {
+	v8::Isolate* isolate = v8::Isolate::GetCurrent();
+	bench_sample sample;
+	int paramCount = 0;
+
+	Local<Array> values = Array::New(isolate, 5);
+
+	values->Set(0, Integer::New(isolate, 42));
+	values->Set(1, Number::New(isolate, 3.25));
+	values->Set(2, String::NewFromUtf8(isolate, "a string parameter"));
+	values->Set(3, Null(isolate));
+	values->Set(4, True(isolate));
+
+	Begin(&sample);
+
+	for (int i = 0; i < iterations; i++) {
+		Parameter* params = ODBC::GetParametersFromArray(values, &paramCount, false);
+
+		for (int j = 0; j < paramCount; j++) {
+			switch (params[j].ValueType) {
+				case SQL_C_WCHAR :
+				case SQL_C_CHAR :
+					free(params[j].ParameterValuePtr);
+					break;
+				case SQL_C_SBIGINT :
+					delete (int64_t *) params[j].ParameterValuePtr;
+					break;
+				case SQL_C_DOUBLE :
+					delete (double *) params[j].ParameterValuePtr;
+					break;
+				case SQL_C_BIT :
+					delete (bool *) params[j].ParameterValuePtr;
+					break;
+			}
+		}
+
+		free(params);
+	}
+
+	End(&sample);
+
+	Report(results, "GetParametersFromArray", NULL, &sample, NULL, iterations, (double) iterations * paramCount);
+}
+
+/*
+ * BenchGetSQLError
+ *
+ * GetSQLError on a statement with one diagnostic record; a cell is a call.
+ */
+void ODBCMicrobench::BenchGetSQLError(Local<Array> results, int iterations) {
+	v8::Isolate* isolate = v8::Isolate::GetCurrent();
+	bench_sample sample;
+
+	SQLHSTMT hStmt = Execute("select COLUMNS=not_a_type");
+
+	Begin(&sample);
+
+	for (int i = 0; i < iterations; i++) {
+		v8::HandleScope scope(isolate);
+
+		ODBC::GetSQLError(SQL_HANDLE_STMT, hStmt);
+	}
+
+	End(&sample);
+
+	SQLFreeHandle(SQL_HANDLE_STMT, hStmt);
+
+	Report(results, "GetSQLError", NULL, &sample, NULL, iterations, iterations);
+}
+
+/*
+ * Run
+ *
+ * run([options]) -> [{ kernel, type, rows, cells, nsPerCell, allocsPerRow,
+ * bytesPerRow, heapBytesPerRow }, ...]
+ *
+ * options: rows (per result set), iterations (for the parameter and error
+ * kernels), types (an array of synthetic column types), nulls (ratio)
+ */
+void ODBCMicrobench::Run(const v8::FunctionCallbackInfo<v8::Value>& args) {
+	v8::Isolate* isolate = args.GetIsolate();
+	v8::EscapableHandleScope scope(isolate);
+
+	int rows = BENCH_DEFAULT_ROWS;
+	int iterations = BENCH_DEFAULT_ITERATIONS;
+	double nulls = 0;
+	Local<Array> types = Array::New(isolate);
+	const char* defaultTypes[] = { "int", "double", "varchar(32)", "lob(4096)", "timestamp", "bit" };
+
+	for (int i = 0; i < 6; i++) {
+		types->Set(i, String::NewFromUtf8(isolate, defaultTypes[i]));
+	}
+
+	if (args.Length() > 0 && args[0]->IsObject()) {
+		Local<Object> options = args[0]->ToObject();
+		Local<Value> value;
+
+		value = options->Get(String::NewFromUtf8(isolate, "rows"));
+		if (value->IsInt32()) {
+			rows = value->Int32Value();
+		}
+
+		value = options->Get(String::NewFromUtf8(isolate, "iterations"));
+		if (value->IsInt32()) {
+			iterations = value->Int32Value();
+		}
+
+		value = options->Get(String::NewFromUtf8(isolate, "nulls"));
+		if (value->IsNumber()) {
+			nulls = value->NumberValue();
+		}
+
+		value = options->Get(String::NewFromUtf8(isolate, "types"));
+		if (value->IsArray()) {
+			types = Local<Array>::Cast(value);
+		}
+	}
+
+	if (rows < 1 || iterations < 1 || types->Length() < 1) {
+		isolate->ThrowException(Exception::RangeError(String::NewFromUtf8(isolate, "ODBCMicrobench::Run(): rows, iterations and types must not be empty.")));
+		throw Exception::RangeError(String::NewFromUtf8(isolate, "ODBCMicrobench::Run(): rows, iterations and types must not be empty."));
+	}
+
+	//"int,double,..." for the kernels which read whole rows
+	char allTypes[BENCH_CONNECTION_SIZE / 2] = "";
+
+	for (uint32_t i = 0; i < types->Length(); i++) {
+		String::Utf8Value type(types->Get(i));
+
+		if (i > 0) {
+			strncat(allTypes, ",", sizeof(allTypes) - strlen(allTypes) - 1);
+		}
+
+		strncat(allTypes, *type, sizeof(allTypes) - strlen(allTypes) - 1);
+	}
+
+	char connection[BENCH_CONNECTION_SIZE];
+	SQLTCHAR connectionText[BENCH_CONNECTION_SIZE];
+	size_t length;
+
+	snprintf(connection, sizeof(connection), "DRIVER=odbc_synth;NULLS=%f;SEED=1", nulls);
+
+	for (length = 0; connection[length]; length++) {
+		connectionText[length] = (SQLTCHAR) connection[length];
+	}
+	connectionText[length] = 0;
+
+	SQLAllocHandle(SQL_HANDLE_ENV, SQL_NULL_HANDLE, &m_hEnv);
+	SQLSetEnvAttr(m_hEnv, SQL_ATTR_ODBC_VERSION, (void *) SQL_OV_ODBC3, 0);
+	SQLAllocHandle(SQL_HANDLE_DBC, m_hEnv, &m_hDBC);
+	SQLDriverConnect(m_hDBC, NULL, connectionText, SQL_NTS, NULL, 0, NULL, SQL_DRIVER_NOPROMPT);
+
+	m_buffer = (uint16_t *) malloc(MAX_VALUE_SIZE);
+
+	isolate->AddGCPrologueCallback(GCPrologue);
+	isolate->AddGCEpilogueCallback(GCEpilogue);
+
+	Local<Array> results = Array::New(isolate);
+
+	BenchGetColumns(results, allTypes, rows);
+
+	for (uint32_t i = 0; i < types->Length(); i++) {
+		String::Utf8Value type(types->Get(i));
+
+		BenchGetColumnValue(results, *type, rows);
+	}
+
+	BenchGetRecord(results, allTypes, rows, true);
+	BenchGetRecord(results, allTypes, rows, false);
+	BenchGetParameters(results, iterations);
+	BenchGetSQLError(results, iterations);
+
+	isolate->RemoveGCPrologueCallback(GCPrologue);
+	isolate->RemoveGCEpilogueCallback(GCEpilogue);
+
+	free(m_buffer);
+
+	SQLDisconnect(m_hDBC);
+	SQLFreeHandle(SQL_HANDLE_DBC, m_hDBC);
+	SQLFreeHandle(SQL_HANDLE_ENV, m_hEnv);
+
+	args.GetReturnValue().Set(scope.Escape(results));
+}
+
+/*
+ * Init
+ *
+ * The module is a complete build of the addon, so everything the kernels
+ * need (per-isolate state, templates) is set up by its own initializer.
+ */
+void ODBCMicrobench::Init(v8::Handle<Object> target, v8::Handle<Value> module, v8::Handle<Context> context, void* priv) {
+	v8::Isolate* isolate = context->GetIsolate();
+
+	init(target, module, context, priv);
+
+	target->Set(String::NewFromUtf8(isolate, "run"), FunctionTemplate::New(isolate, Run)->GetFunction());
+}
+
+NODE_MODULE_CONTEXT_AWARE(odbc_microbench, ODBCMicrobench::Init)
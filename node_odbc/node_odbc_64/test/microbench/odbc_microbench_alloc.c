@@ -0,0 +1,58 @@
+/*
+  Copyright (c) 2013, Dan VerWeire <dverweire@gmail.com>
+
+  Permission to use, copy, modify, and/or distribute this software for any
+  purpose with or without fee is hereby granted, provided that the above
+  copyright notice and this permission notice appear in all copies.
+
+  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+
+
+/*
+ * Allocation counters for the microbenchmark module.
+ *
+ * odbc_microbench.node is linked with -Bsymbolic, so every malloc, calloc
+ * and realloc made by the addon sources compiled into it comes here before
+ * going to glibc. Allocations made by V8 or by other modules are not
+ * counted.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+extern void* __libc_malloc(size_t size);
+extern void* __libc_calloc(size_t count, size_t size);
+extern void* __libc_realloc(void* pointer, size_t size);
+
+uint64_t g_benchAllocations = 0;
+uint64_t g_benchAllocatedBytes = 0;
+
+static void Count(size_t size) {
+	__atomic_add_fetch(&g_benchAllocations, 1, __ATOMIC_RELAXED);
+	__atomic_add_fetch(&g_benchAllocatedBytes, size, __ATOMIC_RELAXED);
+}
+
+void* malloc(size_t size) {
+	Count(size);
+
+	return __libc_malloc(size);
+}
+
+void* calloc(size_t count, size_t size) {
+	Count(count * size);
+
+	return __libc_calloc(count, size);
+}
+
+void* realloc(void* pointer, size_t size) {
+	Count(size);
+
+	return __libc_realloc(pointer, size);
+}
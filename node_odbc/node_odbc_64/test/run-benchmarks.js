@@ -0,0 +1,332 @@
+//Runs each benchmark scenario at several concurrency levels and writes the
+//results as JSON; with --baseline it fails when a metric regressed.
+//
+//usage: node run-benchmarks.js [options]
+//
+//  --connection <title>     a title from config.benchConnectionStrings.json
+//  --scenarios <a,b>        scenarios to run (default: all)
+//  --concurrency <1,4,16>   concurrency levels (default: 1,4,16)
+//  --warmup <ms>            time to run before measuring (default: 1000)
+//  --duration <ms>          time to measure (default: 5000)
+//  --out <file>             write the results to file
+//  --baseline <file>        compare with the results in file
+//  --threshold <ratio>      allowed regression (default: 0.1)
+//  --memory-slack <bytes>   allowed growth of the memory deltas (default: 1MB)
+
+var fs = require("fs")
+  , common = require("./common.js")
+  , bench = require("./bench-common.js")
+  ;
+
+//each scenario opens its connections with open() and runs one operation
+//with run(db, cb) until the time is up
+var scenarios = {
+  "query" : {
+    run : bench.query
+  }
+  , "query-parameters" : {
+    run : function (db, cb) {
+      db.query("select ? + ?, ? as test", [1, 2, "This is a string"], cb);
+    }
+  }
+  , "queryResult-fetchAll" : {
+    run : bench.queryResult("fetchAll")
+  }
+  , "prepare-execute" : {
+    setup : function (db, cb) {
+      db.prepare("select ? as test", function (err, stmt) {
+        db.benchStatement = stmt;
+        cb(err);
+      });
+    }
+    , run : function (db, cb) {
+      db.benchStatement.execute([Math.floor(Math.random() * 1000)], function (err, result) {
+        if (err) {
+          return cb(err);
+        }
+
+        result.fetchAll(function (err, data) {
+          result.closeSync();
+          cb(err, data);
+        });
+      });
+    }
+  }
+};
+
+var options = bench.parseArgs({
+  connection : null
+  , scenarios : Object.keys(scenarios)
+  , concurrency : [1, 4, 16]
+  , warmup : 1000
+  , duration : 5000
+  , out : null
+  , baseline : null
+  , threshold : 0.1
+  , memorySlack : 1048576
+  //set to the JSON description of one run in the child processes
+  , child : null
+}, {
+  "--connection" : ["connection", String]
+  , "--scenarios" : ["scenarios", bench.list]
+  , "--concurrency" : ["concurrency", bench.numbers]
+  , "--warmup" : ["warmup", Number]
+  , "--duration" : ["duration", Number]
+  , "--out" : ["out", String]
+  , "--baseline" : ["baseline", String]
+  , "--threshold" : ["threshold", Number]
+  , "--memory-slack" : ["memorySlack", Number]
+});
+
+if (options.child) {
+  runChild(JSON.parse(options.child));
+}
+else {
+  runParent();
+}
+
+/*
+ * Parent: one child process per scenario and concurrency level, so that
+ * the memory numbers of one run do not leak into the next.
+ */
+function runParent() {
+  var connection = bench.findConnection(common.benchConnectionStrings, options.connection)
+    , runs = []
+    ;
+
+  options.scenarios.forEach(function (name) {
+    if (!scenarios[name]) {
+      console.error("unknown scenario %s", name);
+      process.exit(2);
+    }
+
+    options.concurrency.forEach(function (concurrency) {
+      runs.push({
+        scenario : name
+        , concurrency : concurrency
+        , connectionString : connection.connectionString
+        , warmup : options.warmup
+        , duration : options.duration
+      });
+    });
+  });
+
+  var report = {
+    date : new Date().toISOString()
+    , node : process.version
+    , connection : connection.title
+    , results : []
+  };
+
+  bench.runChildren(__filename, runs, function (run) {
+    return "Running \033[01;33m" + run.scenario + "\033[01;0m x" + run.concurrency + " with [\033[01;29m" + connection.title + "\033[01;0m] : ";
+  }, function (run, result) {
+    if (!result) {
+      report.results.push({ scenario : run.scenario, concurrency : run.concurrency, error : "child process failed" });
+    }
+    else {
+      console.log("%d ops/sec, p50 %sms, p99 %sms, p999 %sms", Math.floor(result.throughput), result.p50.toFixed(3), result.p99.toFixed(3), result.p999.toFixed(3));
+      report.results.push(result);
+    }
+  }, function () {
+    finish(report);
+  });
+}
+
+function finish(report) {
+  var failed = report.results.some(function (result) {
+    return result.error;
+  });
+
+  if (options.out) {
+    fs.writeFileSync(options.out, JSON.stringify(report, null, 2) + "\n");
+  }
+
+  if (options.baseline) {
+    var regressions = compare(JSON.parse(fs.readFileSync(options.baseline, "utf8")), report);
+
+    regressions.forEach(function (regression) {
+      console.log("\033[01;31mregression\033[01;0m %s x%d %s: %s -> %s", regression.scenario, regression.concurrency, regression.metric, regression.baseline, regression.current);
+    });
+
+    if (regressions.length) {
+      failed = true;
+    }
+    else {
+      console.log("no regressions against %s (threshold %d%%)", options.baseline, options.threshold * 100);
+    }
+  }
+
+  process.exit(failed ? 1 : 0);
+}
+
+/*
+ * compare
+ *
+ * Throughput may not drop and latencies may not grow by more than the
+ * threshold. The memory deltas are often close to zero, so they also get
+ * an absolute slack.
+ */
+function compare(baseline, report) {
+  var regressions = [];
+
+  report.results.forEach(function (result) {
+    var previous = null;
+
+    baseline.results.forEach(function (candidate) {
+      if (candidate.scenario === result.scenario && candidate.concurrency === result.concurrency && !candidate.error) {
+        previous = candidate;
+      }
+    });
+
+    if (!previous || result.error) {
+      return;
+    }
+
+    function check(metric, worse) {
+      if (worse) {
+        regressions.push({
+          scenario : result.scenario
+          , concurrency : result.concurrency
+          , metric : metric
+          , baseline : previous[metric]
+          , current : result[metric]
+        });
+      }
+    }
+
+    check("throughput", result.throughput < previous.throughput * (1 - options.threshold));
+
+    ["p50", "p99", "p999"].forEach(function (metric) {
+      check(metric, result[metric] > previous[metric] * (1 + options.threshold));
+    });
+
+    ["rssDelta", "heapDelta"].forEach(function (metric) {
+      check(metric, result[metric] > Math.max(previous[metric], 0) * (1 + options.threshold) + options.memorySlack);
+    });
+  });
+
+  return regressions;
+}
+
+/*
+ * Child: open one connection per unit of concurrency, keep each of them
+ * busy for the warmup and then for the measured duration, and print the
+ * result as JSON.
+ */
+function runChild(run) {
+  var odbc = require("../")
+    , scenario = scenarios[run.scenario]
+    , connections = []
+    , latencies = []
+    , opened = 0
+    ;
+
+  for (var i = 0; i < run.concurrency; i++) {
+    connections.push(new odbc.Database());
+  }
+
+  connections.forEach(function (db) {
+    db.open(run.connectionString, function (err) {
+      if (err) {
+        console.error(err);
+        process.exit(1);
+      }
+
+      if (!scenario.setup) {
+        return ready();
+      }
+
+      scenario.setup(db, function (err) {
+        if (err) {
+          console.error(err);
+          process.exit(1);
+        }
+
+        ready();
+      });
+    });
+  });
+
+  function ready() {
+    if (++opened < connections.length) {
+      return;
+    }
+
+    phase(run.warmup, false, function () {
+      var before = memory();
+
+      phase(run.duration, true, function (elapsed) {
+        var after = memory();
+
+        latencies.sort(function (a, b) {
+          return a - b;
+        });
+
+        process.stdout.write(JSON.stringify({
+          scenario : run.scenario
+          , concurrency : run.concurrency
+          , ops : latencies.length
+          , throughput : latencies.length / elapsed * 1000
+          , p50 : percentile(0.5)
+          , p99 : percentile(0.99)
+          , p999 : percentile(0.999)
+          , rssDelta : after.rss - before.rss
+          , heapDelta : after.heapUsed - before.heapUsed
+        }));
+
+        process.exit(0);
+      });
+    });
+  }
+
+  //run every connection back to back for duration ms
+  function phase(duration, record, cb) {
+    var start = process.hrtime()
+      , running = connections.length
+      ;
+
+    connections.forEach(function loop(db) {
+      var time = process.hrtime();
+
+      scenario.run(db, function (err) {
+        if (err) {
+          console.error(err);
+          process.exit(1);
+        }
+
+        var now = process.hrtime(), took = process.hrtime(time);
+
+        if (record) {
+          latencies.push(took[0] * 1e3 + took[1] / 1e6);
+        }
+
+        if ((now[0] - start[0]) * 1e3 + (now[1] - start[1]) / 1e6 < duration) {
+          return loop(db);
+        }
+
+        if (--running === 0) {
+          var elapsed = process.hrtime(start);
+
+          cb(elapsed[0] * 1e3 + elapsed[1] / 1e6);
+        }
+      });
+    });
+  }
+
+  function percentile(p) {
+    if (!latencies.length) {
+      return 0;
+    }
+
+    return latencies[Math.min(latencies.length - 1, Math.floor(p * latencies.length))];
+  }
+
+  function memory() {
+    if (global.gc) {
+      global.gc();
+    }
+
+    return process.memoryUsage();
+  }
+}
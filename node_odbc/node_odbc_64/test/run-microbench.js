@@ -0,0 +1,49 @@
+//Times the addon's conversion and binding kernels against the synthetic
+//driver, without a database or the event loop in the way. Build it with:
+//
+//  node-gyp rebuild -- -Dodbc_synth=true
+//
+//usage: node run-microbench.js [rows] [iterations]
+
+var path = require("path")
+  , microbench
+  ;
+
+try {
+  microbench = require(path.join(__dirname, "../build/Release/odbc_microbench.node"));
+}
+catch (e) {
+  console.error("odbc_microbench.node was not built; run node-gyp rebuild -- -Dodbc_synth=true");
+  process.exit(1);
+}
+
+var options = {
+  rows : parseInt(process.argv[2], 10) || 10000
+  , iterations : parseInt(process.argv[3], 10) || 100000
+};
+
+//once to warm up, once to measure
+microbench.run({ rows : 100, iterations : 100 });
+
+var results = microbench.run(options);
+
+function pad(value, width) {
+  value = String(value);
+
+  while (value.length < width) {
+    value = " " + value;
+  }
+
+  return value;
+}
+
+console.log(pad("kernel", 24) + pad("type", 14) + pad("ns/cell", 10) + pad("allocs/row", 12) + pad("bytes/row", 12) + pad("heap bytes/row", 16));
+
+results.forEach(function (result) {
+  console.log(pad(result.kernel, 24)
+    + pad((result.type && result.type.length < 14) ? result.type : (result.type ? "all" : ""), 14)
+    + pad(result.nsPerCell.toFixed(1), 10)
+    + pad(result.allocsPerRow.toFixed(2), 12)
+    + pad(result.bytesPerRow.toFixed(0), 12)
+    + pad(result.heapBytesPerRow.toFixed(0), 16));
+});
@@ -0,0 +1,308 @@
+//Loops each API surface for a while and watches memory and ODBC handles
+//for slow leaks.
+//
+//usage: node run-soak.js [options]
+//
+//  --connection <title>   a title from config.testConnectionStrings.json
+//  --surfaces <a,b>       surfaces to soak (default: all)
+//  --minutes <n>          how long to loop each surface (default: 1)
+//  --sample <ops>         operations between two samples (default: 1000)
+//  --max-memory <bytes>   allowed growth per 1k operations (default: 65536)
+//  --max-handles <n>      allowed handle growth per 1k operations (default: 0.5)
+//
+//Every surface runs in a process of its own. After each --sample
+//operations it collects garbage and samples RSS, the V8 heap, external
+//memory (the addon's fetch buffers when node does not report it) and the
+//handle counts of odbc.metrics(). The report is the least squares slope
+//of each of them per 1k operations; a surface fails when memory or
+//handles keep growing.
+
+var common = require("./common.js")
+  , bench = require("./bench-common.js")
+  ;
+
+//each surface runs one operation with run(db, cb)
+var surfaces = {
+  "query" : {
+    run : bench.query
+  }
+  , "queryResult-fetch" : {
+    run : bench.queryResult("fetch")
+  }
+  //results which are never closed are freed by the garbage collector
+  , "queryResult-gc" : {
+    run : function (db, cb) {
+      db.queryResult("select 1 + 1 as test", function (err, result) {
+        if (err) {
+          return cb(err);
+        }
+
+        result.fetch(cb);
+      });
+    }
+  }
+  , "prepare-bind-execute" : {
+    run : function (db, cb) {
+      db.prepare("select ? as test", function (err, stmt) {
+        if (err) {
+          return cb(err);
+        }
+
+        stmt.bind([Math.floor(Math.random() * 1000)], function (err) {
+          if (err) {
+            return cb(err);
+          }
+
+          stmt.execute(function (err, result) {
+            if (err) {
+              return cb(err);
+            }
+
+            result.fetchAll(function (err, data) {
+              result.closeSync();
+              stmt.closeSync();
+              cb(err, data);
+            });
+          });
+        });
+      });
+    }
+  }
+  , "pool-open-close" : {
+    run : function (db, cb) {
+      var pool = new odbc.Pool();
+
+      pool.open(db.soakConnectionString, function (err, conn) {
+        if (err) {
+          return cb(err);
+        }
+
+        conn.close(function (err) {
+          if (err) {
+            return cb(err);
+          }
+
+          pool.close(cb);
+        });
+      });
+    }
+  }
+  , "beginTransaction" : {
+    run : function (db, cb) {
+      db.beginTransaction(function (err) {
+        if (err) {
+          return cb(err);
+        }
+
+        db.query("select 1 + 1 as test", function (err) {
+          if (err) {
+            return cb(err);
+          }
+
+          db.commitTransaction(cb);
+        });
+      });
+    }
+  }
+};
+
+var options = bench.parseArgs({
+  connection : null
+  , surfaces : Object.keys(surfaces)
+  , minutes : 1
+  , sample : 1000
+  , maxMemory : 65536
+  , maxHandles : 0.5
+  //set to the JSON description of one run in the child processes
+  , child : null
+}, {
+  "--connection" : ["connection", String]
+  , "--surfaces" : ["surfaces", bench.list]
+  , "--minutes" : ["minutes", Number]
+  , "--sample" : ["sample", Number]
+  , "--max-memory" : ["maxMemory", Number]
+  , "--max-handles" : ["maxHandles", Number]
+});
+
+var odbc;
+
+if (options.child) {
+  runChild(JSON.parse(options.child));
+}
+else {
+  runParent();
+}
+
+function runParent() {
+  var connection = bench.findConnection(common.testConnectionStrings, options.connection)
+    , runs = []
+    , failed = false
+    ;
+
+  options.surfaces.forEach(function (name) {
+    if (!surfaces[name]) {
+      console.error("unknown surface %s", name);
+      process.exit(2);
+    }
+
+    runs.push({
+      surface : name
+      , connectionString : connection.connectionString
+      , duration : options.minutes * 60000
+      , sample : options.sample
+    });
+  });
+
+  bench.runChildren(__filename, runs, function (run) {
+    return "Soaking \033[01;33m" + run.surface + "\033[01;0m with [\033[01;29m" + connection.title + "\033[01;0m] : ";
+  }, function (run, result) {
+    if (!result) {
+      failed = true;
+      return;
+    }
+
+    var leaks = [];
+
+    ["rss", "heapUsed", "external"].forEach(function (metric) {
+      if (result.slopes[metric] > options.maxMemory) {
+        leaks.push(metric);
+      }
+    });
+
+    ["envHandles", "dbcHandles", "stmtHandles", "results"].forEach(function (metric) {
+      if (result.slopes[metric] > options.maxHandles) {
+        leaks.push(metric);
+      }
+    });
+
+    console.log("%d ops in %d samples%s", result.ops, result.samples, leaks.length ? " \033[01;31mgrowing: " + leaks.join(", ") + "\033[01;0m" : "");
+    console.log("  per 1k ops: rss %s, heap %s, external %s bytes; env %s, dbc %s, stmt %s, results %s",
+      result.slopes.rss.toFixed(0), result.slopes.heapUsed.toFixed(0), result.slopes.external.toFixed(0),
+      result.slopes.envHandles.toFixed(2), result.slopes.dbcHandles.toFixed(2),
+      result.slopes.stmtHandles.toFixed(2), result.slopes.results.toFixed(2));
+
+    if (leaks.length) {
+      failed = true;
+    }
+  }, function () {
+    process.exit(failed ? 1 : 0);
+  });
+}
+
+/*
+ * Child: loop one surface on one connection and sample every run.sample
+ * operations.
+ */
+function runChild(run) {
+  var surface = surfaces[run.surface]
+    , db
+    , ops = 0
+    , samples = []
+    , start
+    ;
+
+  odbc = require("../");
+  db = new odbc.Database();
+  db.soakConnectionString = run.connectionString;
+
+  db.open(run.connectionString, function (err) {
+    if (err) {
+      console.error(err);
+      process.exit(1);
+    }
+
+    start = Date.now();
+    sample();
+    loop();
+  });
+
+  function loop() {
+    surface.run(db, function (err) {
+      if (err) {
+        console.error(err);
+        process.exit(1);
+      }
+
+      ops += 1;
+
+      if (ops % run.sample === 0) {
+        sample();
+
+        if (Date.now() - start >= run.duration) {
+          return finish();
+        }
+      }
+
+      //let timers and the garbage collector run between operations
+      setImmediate(loop);
+    });
+  }
+
+  function sample() {
+    global.gc();
+
+    var memory = process.memoryUsage()
+      , metrics = odbc.metrics()
+      ;
+
+    samples.push({
+      ops : ops
+      , rss : memory.rss
+      , heapUsed : memory.heapUsed
+      , external : (memory.external !== undefined) ? memory.external : metrics.bufferBytes
+      , envHandles : metrics.envHandles
+      , dbcHandles : metrics.dbcHandles
+      , stmtHandles : metrics.stmtHandles
+      , results : metrics.results
+    });
+  }
+
+  function finish() {
+    var slopes = {};
+
+    //the first sample is taken before anything was warmed up
+    var measured = (samples.length > 2) ? samples.slice(1) : samples;
+
+    ["rss", "heapUsed", "external", "envHandles", "dbcHandles", "stmtHandles", "results"].forEach(function (metric) {
+      slopes[metric] = slope(measured, metric) * 1000;
+    });
+
+    process.stdout.write(JSON.stringify({
+      surface : run.surface
+      , ops : ops
+      , samples : samples.length
+      , slopes : slopes
+      , first : samples[0]
+      , last : samples[samples.length - 1]
+    }));
+
+    db.close(function () {
+      process.exit(0);
+    });
+  }
+}
+
+//least squares slope of metric over ops
+function slope(samples, metric) {
+  var n = samples.length
+    , sumX = 0
+    , sumY = 0
+    , sumXY = 0
+    , sumXX = 0
+    ;
+
+  if (n < 2) {
+    return 0;
+  }
+
+  samples.forEach(function (sample) {
+    sumX += sample.ops;
+    sumY += sample[metric];
+    sumXY += sample.ops * sample[metric];
+    sumXX += sample.ops * sample.ops;
+  });
+
+  var denominator = n * sumXX - sumX * sumX;
+
+  return (denominator === 0) ? 0 : (n * sumXY - sumX * sumY) / denominator;
+}
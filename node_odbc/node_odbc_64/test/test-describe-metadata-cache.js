@@ -0,0 +1,51 @@
+var common = require("./common")
+  , odbc = require("../")
+  , db = new odbc.Database({ metadataCache : true })
+  , assert = require("assert")
+  , described = 0
+  ;
+
+db.openSync(common.connectionString);
+
+common.dropTables(db, function () {
+  common.createTables(db, function () {
+    var query = { database : common.databaseName, table : common.tableName }
+      , first
+      ;
+
+    //concurrent calls share one catalog query
+    db.describe(query, function (err, data) {
+      assert.equal(err, null);
+      assert.ok(data.length, "No records returned when attempting to describe the table " + common.tableName);
+      assert.ok(Object.isFrozen(data));
+
+      first = data;
+      described += 1;
+    });
+
+    db.describe(query, function (err, data) {
+      assert.equal(err, null);
+      assert.strictEqual(data, first);
+      assert.equal(db.metadataCache.stats().misses, 1);
+
+      described += 1;
+
+      db.refreshMetadata(common.tableName);
+
+      db.describe(query, function (err, data) {
+        assert.equal(err, null);
+        assert.notStrictEqual(data, first);
+        assert.deepEqual(data, first);
+        assert.equal(db.metadataCache.stats().misses, 2);
+
+        described += 1;
+
+        db.closeSync();
+      });
+    });
+  });
+});
+
+process.on("exit", function () {
+  assert.equal(described, 3);
+});
@@ -0,0 +1,32 @@
+var common = require("./common")
+  , odbc = require("../")
+  , db = new odbc.Database({ encoding : 'utf8' })
+  , assert = require("assert")
+  ;
+
+assert.throws(function () {
+  new odbc.Database({ encoding : 'latin1' });
+});
+
+db.openSync(common.connectionString);
+assert.equal(db.conn.encoding, 'utf8');
+
+var data = db.querySync("select 'ꜨꜢ' as UNICODETEXT, ? as PARAMETER", ['Zürich €']);
+assert.deepEqual(data, [{ UNICODETEXT: 'ꜨꜢ', PARAMETER: 'Zürich €' }]);
+
+//async query, fetched through a row set
+db.query("select ? as PARAMETER", ['naïve'], function (err, data) {
+  assert.equal(err, null);
+  assert.deepEqual(data, [{ PARAMETER: 'naïve' }]);
+
+  //back to the wide functions on the same connection
+  db.conn.encoding = 'utf16';
+  assert.equal(db.conn.encoding, 'utf16');
+
+  data = db.querySync("select 'ꜨꜢ' as UNICODETEXT");
+  assert.deepEqual(data, [{ UNICODETEXT: 'ꜨꜢ' }]);
+
+  db.close(function () {
+    assert.equal(db.connected, false);
+  });
+});
@@ -0,0 +1,44 @@
+var common = require("./common")
+  , odbc = require("../")
+  , executor = new odbc.ODBCExecutor(2)
+  , db = new odbc.Database({ executor : executor })
+  , assert = require("assert")
+  ;
+
+assert.equal(executor.threads, 2);
+assert.throws(function () {
+  new odbc.ODBCExecutor(0);
+});
+
+db.open(common.connectionString, function (err) {
+  assert.equal(err, null);
+  assert.equal(db.connected, true);
+
+  db.query("select 1 as COLINT, 'some test' as COLTEXT union select 2, 'something else' ", function (err, data) {
+    assert.equal(err, null);
+    assert.deepEqual(data, [
+        {"COLINT":1,"COLTEXT":"some test"}
+      ,{"COLINT":2,"COLTEXT":"something else"}
+    ]);
+
+    db.prepare("select ? as COLINT", function (err, stmt) {
+      assert.equal(err, null);
+
+      stmt.execute([3], function (err, result) {
+        assert.equal(err, null);
+
+        result.fetchAll(function (err, data) {
+          assert.equal(err, null);
+          assert.deepEqual(data, [{ COLINT : 3 }]);
+
+          result.closeSync();
+
+          db.close(function (err) {
+            assert.equal(err, null);
+            assert.equal(db.connected, false);
+          });
+        });
+      });
+    });
+  });
+});
@@ -0,0 +1,40 @@
+var common = require("./common")
+  , odbc = require("../")
+  , db = new odbc.Database()
+  , assert = require("assert")
+  , before = odbc.metrics()
+  ;
+
+db.open(common.connectionString, function (err) {
+  assert.equal(err, null);
+
+  var open = odbc.metrics();
+
+  assert.equal(open.dbcHandles, before.dbcHandles + 1);
+  assert.ok(open.calls.SQLDriverConnect > before.calls.SQLDriverConnect);
+
+  db.query("select 1 as COLINT, 'some test' as COLTEXT", function (err, data) {
+    assert.equal(err, null);
+
+    var after = odbc.metrics();
+
+    assert.equal(after.rowsFetched, open.rowsFetched + 1);
+    assert.ok(after.bytesDecoded > open.bytesDecoded);
+    assert.ok(after.calls.SQLExecDirect > open.calls.SQLExecDirect);
+
+    db.query("select * from table_that_does_not_exist", function (err) {
+      assert.ok(err);
+      assert.ok(odbc.metrics().errors[err.state] >= 1);
+
+      var text = odbc.metricsText();
+
+      assert.ok(/^odbc_handles\{type="dbc"\} \d+$/m.test(text));
+      assert.ok(/^odbc_driver_calls_total\{function="SQLFetch"\} \d+$/m.test(text));
+
+      db.close(function (err) {
+        assert.equal(err, null);
+        assert.equal(odbc.metrics().dbcHandles, before.dbcHandles);
+      });
+    });
+  });
+});
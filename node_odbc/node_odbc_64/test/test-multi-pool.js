@@ -0,0 +1,45 @@
+var common = require("./common")
+  , odbc = require("../")
+  , assert = require("assert")
+  , pool = new odbc.MultiPool({
+      members : [
+        { connectionString : common.connectionString, role : "write" }
+        , { connectionString : common.connectionString, role : "read" }
+        , { connectionString : "DRIVER={this driver does not exist}", role : "read" }
+      ]
+      , probeInterval : 60000
+    })
+  ;
+
+pool.open({ role : "read" }, function (err, db) {
+  assert.equal(err, null);
+
+  pool.open({ role : "read" }, function (err, db2) {
+    assert.equal(err, null);
+
+    var stats = pool.stats();
+
+    //the bad replica is out of rotation and nothing was routed to the
+    //primary while the good replica was available
+    assert.equal(stats[2].healthy, false);
+    assert.equal(stats[0].leased, 0);
+    assert.equal(stats[1].leased, 2);
+    assert.equal(stats[1].inFlight, 0);
+
+    db.query("select 1 as COLINT", function (err, data) {
+      assert.equal(err, null);
+      assert.deepEqual(data, [{ COLINT : 1 }]);
+      assert.equal(pool.stats()[1].inFlight, 0);
+
+      db.close(function () {});
+      db2.close(function () {});
+
+      assert.equal(pool.stats()[1].leased, 0);
+
+      pool.close(function () {});
+    });
+
+    //counted while the query runs
+    assert.equal(pool.stats()[1].inFlight, 1);
+  });
+});
@@ -0,0 +1,40 @@
+var common = require("./common")
+  , odbc = require("../")
+  , db = new odbc.Database({ pipeline : true })
+  , assert = require("assert")
+  , count = 10
+  , seen = []
+  ;
+
+db.open(common.connectionString, function (err) {
+  assert.equal(err, null);
+
+  for (var i = 0; i < count; i++) {
+    (function (i) {
+      db.query("select ? as COLINT, 'some test' as COLTEXT", [i], function (err, data, more) {
+        assert.equal(err, null);
+        assert.equal(more, false);
+        assert.deepEqual(data, [{ COLINT : i, COLTEXT : "some test" }]);
+
+        seen.push(i);
+      });
+    })(i);
+  }
+
+  db.query("select * from this_table_does_not_exist", function (err, data) {
+    assert.ok(err);
+    assert.deepEqual(data, []);
+  });
+
+  db.conn.pipeline({ sql : "select 1 as COLINT", fetchMode : odbc.FETCH_ARRAY }, function (err, sets) {
+    assert.equal(err, null);
+    assert.deepEqual(sets, [[[1]]]);
+  });
+
+  db.close(function (err) {
+    assert.equal(err, null);
+
+    //callbacks come back in the order the queries were issued
+    assert.deepEqual(seen, [0, 1, 2, 3, 4, 5, 6, 7, 8, 9]);
+  });
+});
@@ -0,0 +1,93 @@
+var common = require("./common")
+  , odbc = require("../")
+  , db = new odbc.Database()
+  , assert = require("assert")
+  , sql = "select 1 as COLINT union all select 2 union all select 3"
+  , finished = false
+  ;
+
+if (typeof(Promise) == 'undefined') {
+  console.log("Promise is not available; skipping");
+  return;
+}
+
+db.open(common.connectionString)
+  .then(function () {
+    return db.query("select 1 as COLINT");
+  })
+  .then(function (rows) {
+    assert.deepEqual(rows, [{ COLINT : 1 }]);
+
+    //a batch resolves with the rows of each result set
+    return db.query("select 1 as COLINT; select 2 as COLINT");
+  })
+  .then(function (sets) {
+    assert.deepEqual(sets, [[{ COLINT : 1 }], [{ COLINT : 2 }]]);
+
+    //the native methods settle their promises themselves
+    return db.conn.query(sql);
+  })
+  .then(function (result) {
+    return result.fetchBatch(2).then(function (rows) {
+      assert.deepEqual(rows, [{ COLINT : 1 }, { COLINT : 2 }]);
+
+      return result.fetchBatch(2);
+    }).then(function (rows) {
+      assert.deepEqual(rows, [{ COLINT : 3 }]);
+
+      return result.fetchBatch(2);
+    }).then(function (rows) {
+      assert.equal(rows, null);
+
+      result.closeSync();
+    });
+  })
+  .then(function () {
+    if (typeof(Symbol) == 'undefined' || !Symbol.asyncIterator) {
+      return;
+    }
+
+    return db.conn.query(sql).then(function (result) {
+      var iterator = result[Symbol.asyncIterator]()
+        , batches = []
+        ;
+
+      result.batchSize = 2;
+
+      return (function next() {
+        return iterator.next().then(function (item) {
+          if (item.done) {
+            result.closeSync();
+            return batches;
+          }
+
+          batches.push(item.value);
+          return next();
+        });
+      })();
+    }).then(function (batches) {
+      assert.deepEqual(batches, [[{ COLINT : 1 }, { COLINT : 2 }], [{ COLINT : 3 }]]);
+    });
+  })
+  .then(function () {
+    return db.query("select * from this_table_does_not_exist").then(function () {
+      assert.fail("query should have been rejected");
+    }, function (err) {
+      assert.ok(err);
+    });
+  })
+  .then(function () {
+    db.close(function (err) {
+      assert.equal(err, null);
+      finished = true;
+    });
+  })
+  .catch(function (err) {
+    process.nextTick(function () {
+      throw err;
+    });
+  });
+
+process.on("exit", function () {
+  assert.ok(finished);
+});
@@ -0,0 +1,69 @@
+var common = require("./common")
+  , odbc = require("../")
+  , db = new odbc.Database()
+  , assert = require("assert")
+  , sql = "select 'IT' as COUNTRY, 'open' as STATUS, 10 as AMOUNT "
+    + "union all select 'IT', 'closed', 20 "
+    + "union all select 'CH', 'open', 5 "
+    + "union all select 'IT', 'open', 30 "
+    + "union all select 'CH', 'hold', null "
+    + "union all select 'FR', 'closed', 40"
+  ;
+
+db.openSync(common.connectionString);
+
+db.queryResult(sql, function (err, result) {
+  assert.equal(err, null);
+
+  result.aggregate({
+    where : [{ column : 'STATUS', op : 'in', value : ['open', 'hold'] }]
+    , groupBy : 'COUNTRY'
+    , select : {
+      ROWS : { count : '*' }
+      , AMOUNTS : { count : 'AMOUNT' }
+      , TOTAL : { sum : 'AMOUNT' }
+      , AVERAGE : { avg : 'AMOUNT' }
+      , SMALLEST : { min : 'AMOUNT' }
+      , LARGEST : { max : 'AMOUNT' }
+    }
+  }, function (err, groups, info) {
+    assert.equal(err, null);
+
+    //in the order the groups were first seen
+    assert.deepEqual(groups, [
+      { COUNTRY : 'IT', ROWS : 2, AMOUNTS : 2, TOTAL : 40, AVERAGE : 20, SMALLEST : 10, LARGEST : 30 }
+      , { COUNTRY : 'CH', ROWS : 2, AMOUNTS : 1, TOTAL : 5, AVERAGE : 5, SMALLEST : 5, LARGEST : 5 }
+    ]);
+    assert.deepEqual(info, { rows : 6, matched : 4, groups : 2 });
+
+    result.closeSync();
+
+    //without group by there is one group, even when no row matches
+    var result2 = db.queryResultSync(sql);
+
+    result2.aggregate({
+      where : [{ column : 'AMOUNT', op : '>', value : 100 }]
+      , select : { N : { count : '*' }, TOTAL : { sum : 'AMOUNT' } }
+    }, function (err, groups) {
+      assert.equal(err, null);
+      assert.deepEqual(groups, [{ N : 0, TOTAL : null }]);
+
+      result2.closeSync();
+
+      var result3 = db.queryResultSync(sql);
+
+      result3.aggregate({ groupBy : ['NO_SUCH_COLUMN'] }, function (err, groups) {
+        assert.ok(err);
+        assert.equal(groups, null);
+
+        result3.closeSync();
+
+        assert.throws(function () {
+          db.queryResultSync(sql).aggregate({ select : { N : { median : 'AMOUNT' } } }, function () {});
+        }, TypeError);
+
+        db.closeSync();
+      });
+    });
+  });
+});
@@ -0,0 +1,85 @@
+var common = require("./common")
+  , odbc = require("../")
+  , db = new odbc.Database({ cache : { maxBytes : 1024 * 1024, ttl : 0 } })
+  , assert = require("assert")
+  , sql = "select ? as COLINT, 'some test' as COLTEXT"
+  ;
+
+db.open(common.connectionString, function (err) {
+  assert.equal(err, null);
+
+  db.query({ sql : sql, params : [1], cache : { tags : ["test"] } }, function (err, data) {
+    assert.equal(err, null);
+    assert.deepEqual(data, [{ COLINT : 1, COLTEXT : "some test" }]);
+    assert.equal(db.cacheStats().entries, 1);
+    assert.equal(db.cacheStats().misses, 1);
+
+    //answered from the cache, rebuilt from the native copy
+    db.query({ sql : sql, params : [1], cache : true }, function (err, cached) {
+      assert.equal(err, null);
+      assert.deepEqual(cached, data);
+      assert.notStrictEqual(cached, data);
+      assert.equal(db.cacheStats().hits, 1);
+
+      //different parameters are a different entry
+      db.query({ sql : sql, params : [2], cache : true }, function (err, other) {
+        assert.equal(err, null);
+        assert.deepEqual(other, [{ COLINT : 2, COLTEXT : "some test" }]);
+        assert.equal(db.cacheStats().entries, 2);
+
+        assert.equal(db.invalidate("test"), 1);
+        assert.equal(db.cacheStats().entries, 1);
+        assert.equal(db.cacheStats().invalidations, 1);
+
+        //another connection string sharing the cache is a different entry
+        var other = new odbc.Database({ cache : db.cache });
+
+        other.open(common.connectionString + ";", function (err) {
+          assert.equal(err, null);
+
+          other.query({ sql : sql, params : [2], cache : true }, function (err, data) {
+            assert.equal(err, null);
+            assert.deepEqual(data, [{ COLINT : 2, COLTEXT : "some test" }]);
+            assert.equal(db.cacheStats().entries, 2);
+            assert.equal(db.cacheStats().misses, 3);
+
+            other.close(function (err) {
+              assert.equal(err, null);
+
+              db.close(function (err) {
+                assert.equal(err, null);
+
+                //a closed Database is not answered from the cache
+                db.query({ sql : sql, params : [2], cache : true }, function (err, data) {
+                  assert.equal(err.message, "Connection not open.");
+                  assert.deepEqual(data, []);
+                  assert.equal(db.cacheStats().hits, 1);
+                });
+              });
+            });
+          });
+        });
+      });
+    });
+  });
+});
+
+//eviction works without a connection
+var cache = new odbc.ODBCCache(64 * 1024, 0)
+  , big = []
+  ;
+
+for (var i = 0; i < 500; i++) {
+  big.push({ ID : i, NAME : "row number " + i, CREATED : new Date(0) });
+}
+
+assert.equal(cache.set("a", big), true);
+assert.deepEqual(cache.get("a")[499], big[499]);
+assert.equal(cache.set("b", big), true);
+assert.equal(cache.set("c", big), true);
+
+//the oldest entries made room for the newest one
+assert.ok(cache.stats().bytes <= 64 * 1024);
+assert.ok(cache.stats().evictions > 0);
+assert.ok(cache.get("c"));
+assert.equal(cache.get("a"), undefined);
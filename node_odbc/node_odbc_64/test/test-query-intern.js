@@ -0,0 +1,51 @@
+var common = require("./common")
+  , odbc = require("../")
+  , db = new odbc.Database({ intern : true })
+  , assert = require("assert")
+  ;
+
+var sql = "select 'open' as S, 'Zürich' as C, ? as L, 1 as N "
+  + "union all select 'closed', 'Zürich', ?, 2 "
+  + "union all select 'open', 'Genève', ?, 3 "
+  + "union all select 'open', 'Zürich', ?, 4"
+  , long = new Array(301).join("x")
+  , params = ["a", long, "a", long]
+  , expected = [
+    { S : 'open', C : 'Zürich', L : 'a', N : 1 }
+    , { S : 'closed', C : 'Zürich', L : long, N : 2 }
+    , { S : 'open', C : 'Genève', L : 'a', N : 3 }
+    , { S : 'open', C : 'Zürich', L : long, N : 4 }
+  ]
+  ;
+
+db.openSync(common.connectionString);
+
+//repeated values come back unchanged, including those too long to intern
+assert.deepEqual(db.querySync(sql, params), expected);
+
+db.queryResult(sql, params, function (err, result) {
+  assert.equal(err, null);
+  assert.equal(result.intern, true);
+
+  result.fetchAll(function (err, data) {
+    assert.equal(err, null);
+    assert.deepEqual(data, expected);
+
+    result.closeSync();
+
+    //and per result on a database without intern
+    var plain = new odbc.Database();
+
+    plain.openSync(common.connectionString);
+
+    var result2 = plain.queryResultSync(sql, params);
+
+    assert.equal(result2.intern, false);
+    result2.intern = true;
+    assert.deepEqual(result2.fetchAllSync(), expected);
+    result2.closeSync();
+
+    plain.closeSync();
+    db.closeSync();
+  });
+});
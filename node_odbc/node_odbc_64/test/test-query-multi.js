@@ -0,0 +1,50 @@
+var common = require("./common")
+  , odbc = require("../")
+  , db = new odbc.Database()
+  , assert = require("assert")
+  ;
+
+db.open(common.connectionString, function (err) {
+  assert.equal(err, null);
+
+  db.queryMulti("select ? as COLINT, 'some test' as COLTEXT", [1], function (err, sets) {
+    assert.equal(err, null);
+    assert.equal(sets.length, 1);
+    assert.deepEqual(sets[0].columns.map(function (c) { return c.name; }), ["COLINT", "COLTEXT"]);
+    assert.deepEqual(sets[0].rows, [{ COLINT : 1, COLTEXT : "some test" }]);
+    assert.equal(sets[0].rowCount, 1);
+
+    db.query("create temp table NODE_ODBC_TEST_MULTI (COLINT INTEGER, COLTEXT TEXT)", function (err) {
+      assert.equal(err, null);
+
+      //a non-query set followed by two query sets
+      db.queryMulti("insert into NODE_ODBC_TEST_MULTI values (1, 'one'), (2, 'two'); "
+        + "select COLINT, COLTEXT from NODE_ODBC_TEST_MULTI order by COLINT; "
+        + "select count(*) as TOTAL from NODE_ODBC_TEST_MULTI", function (err, sets) {
+        assert.equal(err, null);
+        assert.equal(sets.length, 3);
+
+        assert.deepEqual(sets[0].columns, []);
+        assert.deepEqual(sets[0].rows, []);
+        assert.equal(sets[0].rowCount, 2);
+
+        assert.deepEqual(sets[1].columns.map(function (c) { return c.name; }), ["COLINT", "COLTEXT"]);
+        assert.deepEqual(sets[1].rows, [{ COLINT : 1, COLTEXT : "one" }, { COLINT : 2, COLTEXT : "two" }]);
+        assert.equal(sets[1].rowCount, 2);
+
+        assert.deepEqual(sets[2].columns.map(function (c) { return c.name; }), ["TOTAL"]);
+        assert.deepEqual(sets[2].rows, [{ TOTAL : 2 }]);
+        assert.equal(sets[2].rowCount, 1);
+
+        db.queryMulti("select * from this_table_does_not_exist", function (err, sets) {
+          assert.ok(err);
+          assert.deepEqual(sets, []);
+
+          db.close(function (err) {
+            assert.equal(err, null);
+          });
+        });
+      });
+    });
+  });
+});
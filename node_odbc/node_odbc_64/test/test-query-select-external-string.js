@@ -0,0 +1,32 @@
+var common = require("./common")
+  , odbc = require("../")
+  , db = new odbc.Database()
+  , assert = require("assert")
+  ;
+
+//every value of 64 bytes or more becomes an external string
+odbc.setExternalStringThreshold(64);
+
+var latin1 = new Array(201).join("abcdé")
+  , wide = latin1 + "Ꜩ"
+  , short = "abc"
+  ;
+
+db.openSync(common.connectionString);
+
+var data = db.querySync("select ? as L, ? as W, ? as S", [latin1, wide, short]);
+
+assert.deepEqual(data, [{ L : latin1, W : wide, S : short }]);
+assert.ok(odbc.metrics().externalStringBytes > 0);
+
+db.query("select ? as L, ? as W, ? as S", [latin1, wide, short], function (err, data) {
+  assert.equal(err, null);
+  assert.deepEqual(data, [{ L : latin1, W : wide, S : short }]);
+
+  assert.throws(function () {
+    odbc.setExternalStringThreshold(-1);
+  });
+
+  odbc.setExternalStringThreshold(0);
+  db.closeSync();
+});
@@ -0,0 +1,27 @@
+var common = require("./common")
+  , odbc = require("../")
+  , db = new odbc.Database()
+  , assert = require("assert")
+  ;
+
+//long enough for the SIMD kernels, with the wide character in the middle
+//of a block, at its end and in the tail
+var latin1 = new Array(101).join("abcdÀÿ")
+  , wideMiddle = latin1.substr(0, 40) + "Ꜩ" + latin1.substr(40)
+  , wideEnd = latin1.substr(0, 31) + "€"
+  , wideTail = latin1 + "Ꜣ"
+  ;
+
+db.openSync(common.connectionString);
+
+var data = db.querySync("select ? as L, ? as M, ? as E, ? as T, 'é' as S", [latin1, wideMiddle, wideEnd, wideTail]);
+
+assert.deepEqual(data, [{ L : latin1, M : wideMiddle, E : wideEnd, T : wideTail, S : 'é' }]);
+
+//the same through the row sets of query()
+db.query("select ? as L, ? as M, ? as E, ? as T, 'é' as S", [latin1, wideMiddle, wideEnd, wideTail], function (err, data) {
+  assert.equal(err, null);
+  assert.deepEqual(data, [{ L : latin1, M : wideMiddle, E : wideEnd, T : wideTail, S : 'é' }]);
+
+  db.closeSync();
+});
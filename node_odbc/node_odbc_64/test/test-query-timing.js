@@ -0,0 +1,61 @@
+var common = require("./common")
+  , odbc = require("../")
+  , db = new odbc.Database()
+  , assert = require("assert")
+  , phases = ["queue", "wait", "execute", "fetch", "materialize", "callback", "total"]
+  ;
+
+odbc.getStats({ reset : true });
+
+db.open(common.connectionString, function (err) {
+  assert.equal(err, null);
+
+  db.query("select 1 as COLINT, 'some test' as COLTEXT", function (err, data, more, timing) {
+    assert.equal(err, null);
+    assert.deepEqual(data, [{ COLINT : 1, COLTEXT : "some test" }]);
+
+    //callback is only known once this function returns
+    phases.forEach(function (phase) {
+      if (phase != "callback") {
+        assert.equal(typeof timing[phase], "number");
+        assert.ok(timing[phase] >= 0);
+      }
+    });
+
+    assert.ok(timing.total >= timing.execute + timing.fetch + timing.materialize);
+
+    setImmediate(function () {
+      assert.equal(typeof timing.callback, "number");
+
+      var stats = odbc.getStats({ reset : true });
+
+      phases.forEach(function (phase) {
+        assert.equal(stats[phase].count, 1);
+        assert.ok(stats[phase].p50 <= stats[phase].p99);
+        assert.ok(stats[phase].p99 <= stats[phase].max);
+      });
+
+      assert.equal(odbc.getStats().total.count, 0);
+
+      //a batch is one query execution, whatever the number of result sets
+      db.query("select 1 as COLINT; select 2 as COLINT", function (err, data, more, timing) {
+        assert.equal(err, null);
+        assert.equal(typeof timing.total, "number");
+
+        if (more) {
+          return;
+        }
+
+        setImmediate(function () {
+          phases.forEach(function (phase) {
+            assert.equal(odbc.getStats()[phase].count, 1);
+          });
+
+          db.close(function (err) {
+            assert.equal(err, null);
+          });
+        });
+      });
+    });
+  });
+});
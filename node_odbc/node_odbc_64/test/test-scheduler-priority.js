@@ -0,0 +1,48 @@
+var common = require("./common")
+  , odbc = require("../")
+  , db = new odbc.Database()
+  , assert = require("assert")
+  , order = []
+  , expired = false
+  ;
+
+db.open(common.connectionString, function (err) {
+  assert.equal(err, null);
+
+  //occupies the connection while the others are queued
+  db.query("select 1 as COLINT", function (err, data) {
+    assert.equal(err, null);
+    order.push("first");
+  });
+
+  db.query({ sql : "select 2 as COLINT", priority : "low" }, function (err, data) {
+    assert.equal(err, null);
+    assert.deepEqual(data, [{ COLINT : 2 }]);
+    order.push("low");
+  });
+
+  db.query({ sql : "select 3 as COLINT", priority : "high" }, function (err, data) {
+    assert.equal(err, null);
+    assert.deepEqual(data, [{ COLINT : 3 }]);
+    order.push("high");
+  });
+
+  db.query({ sql : "select 4 as COLINT", deadline : Date.now() - 1 }, function (err, data, more) {
+    assert.equal(err.code, "EDEADLINE");
+    assert.deepEqual(data, []);
+    assert.equal(more, false);
+    expired = true;
+  });
+
+  db.close(function (err) {
+    assert.equal(err, null);
+    assert.equal(expired, true);
+    assert.deepEqual(order, ["first", "high", "low"]);
+
+    var stats = db.queueStats();
+
+    assert.equal(stats.high.started, 1);
+    assert.equal(stats.low.started, 1);
+    assert.equal(stats.normal.expired, 1);
+  });
+});
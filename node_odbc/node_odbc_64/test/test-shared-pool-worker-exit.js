@@ -0,0 +1,78 @@
+var common = require("./common")
+  , odbc = require("../")
+  , assert = require("assert")
+  , workerThreads
+  ;
+
+try {
+  workerThreads = require("worker_threads");
+}
+catch (e) {
+  console.log("worker_threads are not available; skipping");
+  return;
+}
+
+var pool = new odbc.SharedPool("test-shared-pool-worker-exit", common.connectionString, { max : 1 })
+  , exited = false
+  ;
+
+//the worker queues for the only connection and exits while it waits
+var source = [
+  "var odbc = require(" + JSON.stringify(require.resolve("../")) + ")"
+  , "  , parentPort = require('worker_threads').parentPort"
+  , "  , pool = new odbc.SharedPool('test-shared-pool-worker-exit', " + JSON.stringify(common.connectionString) + ");"
+  , "pool.acquire(function (err, db) {"
+  , "  throw new Error('acquire() called back in an exiting worker');"
+  , "});"
+  , "parentPort.postMessage('waiting');"
+  , "setTimeout(function () {"
+  , "  process.exit(0);"
+  , "}, 100);"
+  ].join("\n");
+
+pool.acquire(function (err, db) {
+  assert.equal(err, null);
+
+  var worker = new workerThreads.Worker(source, { eval : true });
+
+  worker.on("message", function (message) {
+    assert.equal(message, "waiting");
+    assert.equal(pool.stats().waits, 1);
+  });
+
+  worker.on("error", function (err) {
+    throw err;
+  });
+
+  worker.on("exit", function (code) {
+    assert.equal(code, 0);
+    exited = true;
+
+    //the waiter of the worker is gone; only our connection is in use
+    var stats = pool.stats();
+
+    assert.equal(stats.inUse, 1);
+    assert.equal(stats.timeouts, 0);
+
+    db.close(function () {
+      var stats = pool.stats();
+
+      assert.equal(stats.inUse, 0);
+      assert.equal(stats.idle, 1);
+
+      //and the connection is not handed to the dead worker
+      pool.acquire(function (err, db) {
+        assert.equal(err, null);
+
+        db.close(function () {
+          assert.equal(pool.stats().acquired, 2);
+          pool.close();
+        });
+      });
+    });
+  });
+});
+
+process.on("exit", function () {
+  assert.ok(exited);
+});
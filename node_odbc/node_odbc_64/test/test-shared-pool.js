@@ -0,0 +1,89 @@
+var common = require("./common")
+  , odbc = require("../")
+  , assert = require("assert")
+  , workerThreads
+  ;
+
+try {
+  workerThreads = require("worker_threads");
+}
+catch (e) {
+  console.log("worker_threads are not available; skipping");
+  return;
+}
+
+var pool = new odbc.SharedPool("test-shared-pool", common.connectionString, { max : 2 })
+  , remaining = 2
+  ;
+
+var source = [
+  "var odbc = require(" + JSON.stringify(require.resolve("../")) + ")"
+  , "  , parentPort = require('worker_threads').parentPort"
+  , "  , pool = new odbc.SharedPool('test-shared-pool', " + JSON.stringify(common.connectionString) + ");"
+  , "pool.acquire(function (err, db) {"
+  , "  if (err) throw err;"
+  , "  db.query('select 1 as COLINT', function (err, data) {"
+  , "    if (err) throw err;"
+  , "    db.close(function () {"
+  , "      pool.close();"
+  , "      parentPort.postMessage(data);"
+  , "    });"
+  , "  });"
+  , "});"
+  ].join("\n");
+
+for (var i = 0; i < 2; i++) {
+  var worker = new workerThreads.Worker(source, { eval : true });
+
+  worker.on("message", function (data) {
+    assert.deepEqual(data, [{ COLINT : 1 }]);
+  });
+
+  worker.on("error", function (err) {
+    throw err;
+  });
+
+  worker.on("exit", function (code) {
+    assert.equal(code, 0);
+
+    if (--remaining === 0) {
+      done();
+    }
+  });
+}
+
+function done() {
+  pool.acquire(function (err, db) {
+    assert.equal(err, null);
+
+    db.close(function () {
+      var stats = pool.stats();
+
+      //both workers and the main thread went through the same two connections
+      assert.equal(stats.max, 2);
+      assert.ok(stats.size <= 2);
+      assert.equal(stats.acquired, 3);
+      assert.equal(stats.released, 3);
+      assert.equal(stats.inUse, 0);
+
+      pool.close();
+
+      //the options of the pool apply to the connections it hands out
+      var utf8 = new odbc.SharedPool("test-shared-pool-utf8", common.connectionString, { encoding : 'utf8' });
+
+      utf8.acquire(function (err, db) {
+        assert.equal(err, null);
+        assert.equal(db.conn.encoding, 'utf8');
+        assert.deepEqual(db.querySync("select 'é' as S"), [{ S : 'é' }]);
+
+        db.close(function () {
+          utf8.close();
+        });
+      });
+    });
+  });
+}
+
+process.on("exit", function () {
+  assert.equal(remaining, 0);
+});
@@ -0,0 +1,87 @@
+var common = require("./common")
+  , odbc = require("../")
+  , db = new odbc.Database({ slowQueryThreshold : 0 })
+  , assert = require("assert")
+  , sql = "select ? as COLINT, ? as COLTEXT"
+  ;
+
+//only this connection logs, everything it runs is slow enough
+odbc.setSlowQueryLog({ threshold : -1, redact : true });
+odbc.drainSlowQueries();
+
+db.open(common.connectionString, function (err) {
+  assert.equal(err, null);
+
+  db.query(sql, [1, "secret"], function (err, data) {
+    assert.equal(err, null);
+
+    var entries = odbc.drainSlowQueries();
+
+    assert.equal(entries.length, 1);
+    assert.equal(entries[0].sql, sql);
+    assert.equal(entries[0].rows, 1);
+    assert.equal(entries[0].connectionId, db.conn.id);
+    assert.deepEqual(entries[0].params, [{ type : "integer" }, { type : "string", length : 6 }]);
+    assert.ok(entries[0].timing.total >= entries[0].timing.execute);
+
+    //drained
+    assert.equal(odbc.drainSlowQueries().length, 0);
+
+    odbc.setSlowQueryLog({ redact : false });
+
+    db.query(sql, [2, "shown"], function (err, data) {
+      assert.equal(err, null);
+
+      var entries = odbc.drainSlowQueries();
+
+      assert.deepEqual(entries[0].params, [
+        { type : "integer", value : 2 }
+        , { type : "string", length : 5, value : "shown" }
+      ]);
+
+      odbc.setSlowQueryLog({ redact : true });
+
+      //noResults queries are logged once they have run
+      db.conn.query({ sql : sql, params : [3, "none"], noResults : true, slowThreshold : 0 }, function (err) {
+        assert.equal(err, null);
+
+        var entries = odbc.drainSlowQueries();
+
+        assert.equal(entries.length, 1);
+        assert.equal(entries[0].sql, sql);
+        assert.equal(entries[0].connectionId, db.conn.id);
+
+        //and so are the executions of prepared statements, with the
+        //parameters they were bound to
+        odbc.setSlowQueryLog({ threshold : 0 });
+
+        var stmt = db.prepareSync(sql);
+
+        stmt.execute([4, "bound"], function (err, result) {
+          assert.equal(err, null);
+
+          result.fetchAll(function (err, data) {
+            assert.equal(err, null);
+            result.closeSync();
+
+            var entries = odbc.drainSlowQueries();
+
+            assert.equal(entries.length, 1);
+            assert.equal(entries[0].sql, sql);
+            assert.equal(entries[0].rows, 1);
+            assert.equal(entries[0].connectionId, db.conn.id);
+            assert.deepEqual(entries[0].params, [{ type : "integer" }, { type : "string", length : 5 }]);
+            assert.ok(entries[0].timing.total >= entries[0].timing.execute);
+
+            odbc.setSlowQueryLog({ threshold : -1 });
+            stmt.closeSync();
+
+            db.close(function (err) {
+              assert.equal(err, null);
+            });
+          });
+        });
+      });
+    });
+  });
+});
@@ -0,0 +1,57 @@
+var odbc = require("../")
+  , assert = require("assert")
+  , fs = require("fs")
+  , path = require("path")
+  , driver = path.join(__dirname, "../build/Release/lib.target/odbc_synth.so")
+  , db = new odbc.Database()
+  ;
+
+//only built with node-gyp rebuild -- -Dodbc_synth=true
+if (!fs.existsSync(driver)) {
+  console.log("skipped: odbc_synth.so was not built");
+  return;
+}
+
+var connectionString = "DRIVER=" + driver + ";ROWS=50;COLUMNS=int,double,varchar(16),lob(70000),timestamp,bit;NULLS=0.1;SEED=3";
+
+db.open(connectionString, function (err) {
+  assert.equal(err, null);
+
+  db.query("select *", function (err, data) {
+    assert.equal(err, null);
+    assert.equal(data.length, 50);
+    assert.deepEqual(Object.keys(data[0]), ["C1", "C2", "C3", "C4", "C5", "C6"]);
+
+    var nulls = 0;
+
+    data.forEach(function (row) {
+      nulls += (row.C3 === null) ? 1 : 0;
+
+      assert.ok(row.C3 === null || row.C3.length === 16);
+      assert.ok(row.C4 === null || row.C4.length === 70000);
+      assert.ok(row.C5 === null || row.C5 instanceof Date);
+    });
+
+    assert.ok(nulls > 0 && nulls < 50);
+
+    //same seed, same rows; settings in the SQL override the connection string
+    db.query("select ROWS=2", function (err, again) {
+      assert.equal(err, null);
+      assert.equal(again.length, 2);
+      assert.deepEqual(again, data.slice(0, 2));
+
+      db.query("insert into t values (?, ?) LATENCY=20000", [1, "a"], function (err, rows) {
+        assert.equal(err, null);
+
+        db.query("select COLUMNS=nothing", function (err) {
+          assert.ok(err);
+          assert.equal(err.state, "42000");
+
+          db.close(function (err) {
+            assert.equal(err, null);
+          });
+        });
+      });
+    });
+  });
+});
@@ -0,0 +1,36 @@
+var common = require("./common")
+  , odbc = require("../")
+  , db = new odbc.Database()
+  , assert = require("assert")
+  , fs = require("fs")
+  , file = __dirname + "/trace-" + process.pid + ".log"
+  ;
+
+db.open(common.connectionString, function (err) {
+  assert.equal(err, null);
+
+  var status = odbc.setTrace({ fetch : true, connection : true, level : "debug", file : file });
+
+  assert.equal(typeof status.dropped, "number");
+
+  db.query("select 1 as COLINT", function (err, data) {
+    assert.equal(err, null);
+
+    odbc.setTrace(false);
+
+    //the flusher writes the ring out every 100ms
+    setTimeout(function () {
+      var text = fs.readFileSync(file, "utf8");
+
+      fs.unlinkSync(file);
+
+      assert.ok(/ debug fetch: ODBCResult::/.test(text));
+      assert.ok(/ debug connection: ODBCConnection::/.test(text));
+      assert.ok(!/ statement: /.test(text));
+
+      db.close(function (err) {
+        assert.equal(err, null);
+      });
+    }, 300);
+  });
+});
@@ -0,0 +1,59 @@
+var common = require("./common")
+  , assert = require("assert")
+  , workerThreads
+  ;
+
+try {
+  workerThreads = require("worker_threads");
+}
+catch (e) {
+  console.log("worker_threads are not available; skipping");
+  return;
+}
+
+var source = [
+  "var odbc = require(" + JSON.stringify(require.resolve("../")) + ")"
+  , "  , parentPort = require('worker_threads').parentPort"
+  , "  , db = new odbc.Database({ executor : true });"
+  , "db.open(" + JSON.stringify(common.connectionString) + ", function (err) {"
+  , "  if (err) throw err;"
+  , "  db.query('select 1 as COLINT', function (err, data) {"
+  , "    if (err) throw err;"
+  , "    db.close(function () { parentPort.postMessage(data); });"
+  , "  });"
+  , "});"
+  ].join("\n");
+
+var remaining = 2;
+
+for (var i = 0; i < 2; i++) {
+  var worker = new workerThreads.Worker(source, { eval : true });
+
+  worker.on("message", function (data) {
+    assert.deepEqual(data, [{ COLINT : 1 }]);
+  });
+
+  worker.on("error", function (err) {
+    throw err;
+  });
+
+  worker.on("exit", function (code) {
+    assert.equal(code, 0);
+    remaining--;
+  });
+}
+
+//the main thread can still use the addon as well
+var odbc = require("../")
+  , db = new odbc.Database()
+  ;
+
+db.open(common.connectionString, function (err) {
+  assert.equal(err, null);
+
+  db.close(function () {});
+});
+
+process.on("exit", function () {
+  assert.equal(remaining, 0);
+});